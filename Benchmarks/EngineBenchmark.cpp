@@ -0,0 +1,128 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+
+#include "Module.hpp"
+
+using namespace sharpsenLang;
+
+namespace
+{
+	// The fastest of a few calls, so one slow run doesn't skew the comparison.
+	double run(ExecutionEngine engine, const std::string &source, Number n, int repetitions)
+	{
+		ModuleSettings settings;
+		settings.engine = engine;
+
+		Module module(settings);
+		auto sMain = module.createPublicFunctionCaller<Number, Number>("main");
+		if (!module.tryLoadSource(source, &std::cerr))
+		{
+			return 0;
+		}
+
+		double ms = 0;
+		Number result = 0;
+		for (int r = 0; r < repetitions; ++r)
+		{
+			auto t0 = std::chrono::steady_clock::now();
+			result = sMain(n);
+			auto t1 = std::chrono::steady_clock::now();
+
+			double elapsed = std::chrono::duration<double, std::milli>(t1 - t0).count();
+			ms = r == 0 || elapsed < ms ? elapsed : ms;
+		}
+		std::cout << "  " << (engine == ExecutionEngine::Tree ? "tree" : "vm  ") << ": " << ms << " ms (" << result << ")" << std::endl;
+		return ms;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Number iterations = argc > 1 ? std::stod(argv[1]) : 3e6;
+	int repetitions = argc > 2 ? std::stoi(argv[2]) : 5;
+
+	struct Script
+	{
+		const char *name;
+		const char *source;
+		Number n;
+	};
+
+	Script scripts[] = {
+		{"sum", R"(
+			public function number main(number n) {
+				number s = 0;
+				for (number i = 0; i < n; ++i)
+					s = s + i;
+				return s;
+			}
+		)",
+		 iterations},
+		{"mixed", R"(
+			public function number main(number n) {
+				number s = 0;
+				number x = 1;
+				number i = 0;
+				while (i < n) {
+					if (i % 3 == 0)
+						s += x * 2 - 1;
+					else
+						s -= (x \ 2) & 7;
+					x = x < 1000 ? x + i % 7 : 1;
+					++i;
+				}
+				return s;
+			}
+		)",
+		 iterations},
+		// An FNV style hash kept to 32 bits, then over the full 64. Slots only
+		// hold ints of up to 48 bits inline, so in the wide hash h is updated
+		// through its box and k gets a new box on every declaration.
+		{"ints", R"(
+			public function number main(number n) {
+				int h = 2166136261;
+				int c = toInt(n);
+				for (int i = 0; i < c; ++i) {
+					int k = h ^ (i & 255);
+					h = (k * 16777619) & 4294967295;
+				}
+				return h;
+			}
+		)",
+		 iterations},
+		{"wide ints", R"(
+			public function number main(number n) {
+				int h = 2166136261;
+				h <<= 20;
+				int c = toInt(n);
+				for (int i = 0; i < c; ++i) {
+					int k = h ^ (i & 255);
+					h = k * 1099511628211;
+				}
+				return h >> 48;
+			}
+		)",
+		 iterations},
+		{"calls", R"(
+			function number fib(number n) {
+				return n < 2 ? n : fib(n - 1) + fib(n - 2);
+			}
+
+			public function number main(number n) {
+				return fib(n);
+			}
+		)",
+		 25},
+	};
+
+	for (const Script &script : scripts)
+	{
+		std::cout << script.name << ":" << std::endl;
+		double tree = run(ExecutionEngine::Tree, script.source, script.n, repetitions);
+		double vm = run(ExecutionEngine::Vm, script.source, script.n, repetitions);
+		std::cout << "  vm / tree: " << vm / tree << std::endl;
+	}
+
+	return 0;
+}
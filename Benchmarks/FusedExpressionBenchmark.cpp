@@ -0,0 +1,87 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+
+#include "Module.hpp"
+
+using namespace sharpsenLang;
+
+namespace
+{
+	// A loop repeating the statement, with locals of every shape the patterns use.
+	std::string generateSource(const std::string &statement, size_t repeat)
+	{
+		std::string source = "public function number main(number n) {\n";
+		source += "\tnumber acc = 0;\n";
+		source += "\tnumber m = n / 2;\n";
+		source += "\tnumber x = 0;\n";
+		source += "\tnumber k = 3;\n";
+		source += "\tint c = 0;\n";
+		source += "\tnumber[] a = {1, 2, 3, 4, 5, 6, 7, 8};\n";
+		source += "\tfor (number i = 0; i < n; ++i) {\n";
+		for (size_t i = 0; i < repeat; ++i)
+		{
+			source += "\t\t" + statement + "\n";
+		}
+		source += "\t}\n";
+		source += "\treturn acc + x + c;\n";
+		source += "}\n";
+		return source;
+	}
+
+	void run(const char *name, ExecutionEngine engine, bool fuse, const std::string &source, Number iterations)
+	{
+		ModuleSettings settings;
+		settings.engine = engine;
+		settings.fuseExpressions = fuse;
+
+		Module module(settings);
+		auto sMain = module.createPublicFunctionCaller<Number, Number>("main");
+		if (!module.tryLoadSource(source, &std::cerr))
+		{
+			return;
+		}
+
+		auto t0 = std::chrono::steady_clock::now();
+		Number result = sMain(iterations);
+		auto t1 = std::chrono::steady_clock::now();
+
+		double seconds = std::chrono::duration<double>(t1 - t0).count();
+		std::cout << name << (engine == ExecutionEngine::Tree ? " tree" : " vm") << (fuse ? " fused: " : " plain: ")
+				  << (iterations / seconds / 1e6) << " Miterations/s (" << result << ")" << std::endl;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Number iterations = argc > 1 ? std::stod(argv[1]) : 2e6;
+
+	struct Pattern
+	{
+		const char *name;
+		const char *statement;
+	};
+
+	Pattern patterns[] = {
+		{"local < local", "acc += i < m;"},
+		{"local < constant", "acc += i < 1000;"},
+		{"++local", "++acc;"},
+		{"local += expr", "acc += i;"},
+		{"++int local", "++c;"},
+		{"int local += expr", "c += 3;"},
+		{"arr[local]", "acc += a[k];"},
+		{"local = local op local", "x = i + acc;"},
+	};
+
+	for (const Pattern &pattern : patterns)
+	{
+		std::string source = generateSource(pattern.statement, 8);
+		for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+		{
+			run(pattern.name, engine, false, source, iterations);
+			run(pattern.name, engine, true, source, iterations);
+		}
+	}
+
+	return 0;
+}
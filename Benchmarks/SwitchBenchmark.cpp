@@ -0,0 +1,81 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <functional>
+
+#include "Module.hpp"
+
+using namespace sharpsenLang;
+
+namespace
+{
+	// A state machine dispatching on 256 states, each moving to another one.
+	std::string generateSource(size_t cases, const std::function<std::string(size_t)> &label)
+	{
+		std::string source = "public function number main(number n) {\n";
+		source += "\tnumber acc = 0;\n";
+		source += "\tnumber state = " + label(0) + ";\n";
+		source += "\tfor (number i = 0; i < n; ++i) {\n";
+		source += "\t\tswitch (state) {\n";
+		for (size_t i = 0; i < cases; ++i)
+		{
+			source += "\t\t\tcase " + label(i) + ":\n";
+			source += "\t\t\t\tacc += " + std::to_string(i % 7) + ";\n";
+			source += "\t\t\t\tstate = " + label((i * 37 + 11) % cases) + ";\n";
+			source += "\t\t\t\tbreak;\n";
+		}
+		source += "\t\t}\n";
+		source += "\t}\n";
+		source += "\treturn acc;\n";
+		source += "}\n";
+		return source;
+	}
+
+	void run(const char *name, ExecutionEngine engine, const std::string &source, Number iterations)
+	{
+		ModuleSettings settings;
+		settings.engine = engine;
+
+		Module module(settings);
+		auto sMain = module.createPublicFunctionCaller<Number, Number>("main");
+		if (!module.tryLoadSource(source, &std::cerr))
+		{
+			return;
+		}
+
+		auto t0 = std::chrono::steady_clock::now();
+		Number result = sMain(iterations);
+		auto t1 = std::chrono::steady_clock::now();
+
+		double seconds = std::chrono::duration<double>(t1 - t0).count();
+		std::cout << name << (engine == ExecutionEngine::Tree ? " tree: " : " vm: ")
+				  << (iterations / seconds / 1e6) << " Mdispatches/s (" << result << ")" << std::endl;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	Number iterations = argc > 1 ? std::stod(argv[1]) : 2e6;
+
+	struct Layout
+	{
+		const char *name;
+		size_t cases;
+		std::function<std::string(size_t)> label;
+	};
+
+	Layout layouts[] = {
+		{"dense 256", 256, [](size_t i) { return std::to_string(i); }},
+		{"sparse 32", 32, [](size_t i) { return std::to_string(i * 1000); }},
+		{"sparse 256", 256, [](size_t i) { return std::to_string(i * 1000); }},
+	};
+
+	for (const Layout &layout : layouts)
+	{
+		std::string source = generateSource(layout.cases, layout.label);
+		run(layout.name, ExecutionEngine::Tree, source, iterations);
+		run(layout.name, ExecutionEngine::Vm, source, iterations);
+	}
+
+	return 0;
+}
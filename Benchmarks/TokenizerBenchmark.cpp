@@ -0,0 +1,305 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <functional>
+#include <stack>
+#include <cctype>
+
+#include "Tokenizer.hpp"
+#include "Lookup.hpp"
+#include "BufferStream.hpp"
+#include "PushBackStream.hpp"
+
+using namespace sharpsenLang;
+
+namespace
+{
+	std::string generateSource(size_t functions)
+	{
+		std::string source;
+		for (size_t i = 0; i < functions; ++i)
+		{
+			std::string n = std::to_string(i);
+			source += "function number rule_" + n + "(number a, number b) {\n";
+			source += "\t// generated rule " + n + "\n";
+			source += "\tstring s = \"rule " + n + "\" .. toString(a);\n";
+			source += "\tfor (number i = 0; i < b; ++i) {\n";
+			source += "\t\tif (a >= " + n + " && b != 0.5 || !(a <= b)) { a += b * 2; }\n";
+			source += "\t\telse { a <<= 1; b >>= 1; s ..= \"x\"; }\n";
+			source += "\t}\n";
+			source += "\treturn a - b;\n";
+			source += "}\n";
+		}
+		return source;
+	}
+
+	// The sorted table lookups recognition used before keywords and operators
+	// were compiled into a perfect hash and a transition table.
+	class TableRecognizer
+	{
+	private:
+		using TokenMap = Lookup<std::string_view, ReservedToken>;
+
+		class MaximalMunchComparator
+		{
+		private:
+			size_t _idx;
+
+		public:
+			MaximalMunchComparator(size_t idx) : _idx(idx)
+			{
+			}
+
+			bool operator()(std::pair<std::string_view, ReservedToken> l, char r) const
+			{
+				return l.first.size() <= _idx || l.first[_idx] < r;
+			}
+
+			bool operator()(char l, std::pair<std::string_view, ReservedToken> r) const
+			{
+				return r.first.size() > _idx && l < r.first[_idx];
+			}
+		};
+
+		std::vector<std::string> _spellings;
+		TokenMap _keywords;
+		TokenMap _operators;
+
+		TableRecognizer(std::vector<std::string> spellings)
+			: _spellings(std::move(spellings)),
+			  _keywords(entries(true)),
+			  _operators(entries(false))
+		{
+		}
+
+		TokenMap::ContainerType entries(bool keywords) const
+		{
+			TokenMap::ContainerType ret;
+			for (size_t i = 0; i < _spellings.size(); ++i)
+			{
+				if (bool(std::isalpha(static_cast<unsigned char>(_spellings[i][0]))) == keywords)
+				{
+					ret.emplace_back(_spellings[i], ReservedToken(i));
+				}
+			}
+			return ret;
+		}
+
+		static std::vector<std::string> spellings()
+		{
+			std::vector<std::string> ret;
+			for (size_t i = 0; i <= size_t(ReservedToken::KwPublic); ++i)
+			{
+				ret.push_back(std::to_string(ReservedToken(i)));
+			}
+			return ret;
+		}
+
+	public:
+		TableRecognizer()
+			: TableRecognizer(spellings())
+		{
+		}
+
+		std::optional<ReservedToken> getKeyword(std::string_view word) const
+		{
+			auto it = _keywords.find(word);
+			return it == _keywords.end() ? std::nullopt : std::make_optional(it->second);
+		}
+
+		std::optional<ReservedToken> getOperator(BufferStream &stream) const
+		{
+			auto candidates = std::make_pair(_operators.begin(), _operators.end());
+
+			std::optional<ReservedToken> ret;
+			size_t matchSize = 0;
+
+			std::stack<int> chars;
+
+			for (size_t idx = 0; candidates.first != candidates.second; ++idx)
+			{
+				chars.push(stream());
+
+				candidates = std::equal_range(candidates.first, candidates.second, char(chars.top()), MaximalMunchComparator(idx));
+
+				if (candidates.first != candidates.second && candidates.first->first.size() == idx + 1)
+				{
+					matchSize = idx + 1;
+					ret = candidates.first->second;
+				}
+			}
+
+			while (chars.size() > matchSize)
+			{
+				stream.pushBack(chars.top());
+				chars.pop();
+			}
+
+			return ret;
+		}
+	};
+
+	// Words and operator runs of the source, outside comments and strings,
+	// in the form the tokenizer hands them to recognition.
+	void splitSource(const std::string &source, std::vector<std::string_view> &words, std::vector<std::string_view> &operators)
+	{
+		auto isWord = [](char c)
+		{
+			return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+		};
+		auto isOperator = [&](char c)
+		{
+			return !isWord(c) && !std::isspace(static_cast<unsigned char>(c)) && c != '"';
+		};
+
+		for (size_t i = 0; i < source.size();)
+		{
+			size_t begin = i;
+			if (source.compare(i, 2, "//") == 0)
+			{
+				i = source.find('\n', i);
+			}
+			else if (source[i] == '"')
+			{
+				i = source.find('"', i + 1) + 1;
+			}
+			else if (std::isalpha(static_cast<unsigned char>(source[i])))
+			{
+				while (i < source.size() && isWord(source[i]))
+				{
+					++i;
+				}
+				words.emplace_back(source.data() + begin, i - begin);
+			}
+			else if (isOperator(source[i]))
+			{
+				while (i < source.size() && isOperator(source[i]))
+				{
+					++i;
+				}
+				operators.emplace_back(source.data() + begin, i - begin);
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+
+	template <typename GetKeyword, typename GetOperator>
+	void runRecognition(const char *name, const std::vector<std::string_view> &words, const std::vector<std::string_view> &operators, int repetitions, GetKeyword getKeyword, GetOperator getOperator)
+	{
+		size_t keywords = 0;
+		auto t0 = std::chrono::steady_clock::now();
+		for (int r = 0; r < repetitions; ++r)
+		{
+			for (std::string_view word : words)
+			{
+				keywords += getKeyword(word).has_value();
+			}
+		}
+		auto t1 = std::chrono::steady_clock::now();
+
+		size_t tokens = 0;
+		for (int r = 0; r < repetitions; ++r)
+		{
+			for (std::string_view run : operators)
+			{
+				BufferStream stream(run);
+				while (getOperator(stream))
+				{
+					++tokens;
+				}
+			}
+		}
+		auto t2 = std::chrono::steady_clock::now();
+
+		double keywordSeconds = std::chrono::duration<double>(t1 - t0).count();
+		double operatorSeconds = std::chrono::duration<double>(t2 - t1).count();
+		std::cout << name << ": "
+				  << (double(words.size()) * repetitions / keywordSeconds / 1e6) << " Mwords/s ("
+				  << keywords / repetitions << " keywords), "
+				  << (double(tokens) / operatorSeconds / 1e6) << " Moperators/s" << std::endl;
+	}
+
+	template <typename MakeIterator>
+	void run(const char *name, const std::string &source, int repetitions, MakeIterator makeIterator)
+	{
+		size_t tokens = 0;
+		auto t0 = std::chrono::steady_clock::now();
+		for (int r = 0; r < repetitions; ++r)
+		{
+			makeIterator(
+				[&](TokensIterator &it)
+				{
+					for (; it; ++it)
+					{
+						++tokens;
+					}
+				});
+		}
+		auto t1 = std::chrono::steady_clock::now();
+
+		double seconds = std::chrono::duration<double>(t1 - t0).count();
+		std::cout << name << ": "
+				  << (double(source.size()) * repetitions / seconds / (1 << 20)) << " MB/s, "
+				  << (double(tokens) / seconds / 1e6) << " Mtokens/s" << std::endl;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	size_t functions = argc > 1 ? std::stoul(argv[1]) : 2000;
+	int repetitions = argc > 2 ? std::stoi(argv[2]) : 10;
+
+	std::string source = generateSource(functions);
+	std::cout << "source: " << source.size() << " bytes, " << repetitions << " repetitions" << std::endl;
+
+	run("buffer", source, repetitions,
+		[&](auto consume)
+		{
+			BufferStream stream(source);
+			TokensIterator it(stream);
+			consume(it);
+		});
+
+	run("stream", source, repetitions,
+		[&](auto consume)
+		{
+			size_t i = 0;
+			GetCharacter get = [&]()
+			{
+				return i < source.size() ? int(static_cast<unsigned char>(source[i++])) : -1;
+			};
+			PushBackStream stream(&get);
+			TokensIterator it(stream);
+			consume(it);
+		});
+
+	std::vector<std::string_view> words;
+	std::vector<std::string_view> operators;
+	splitSource(source, words, operators);
+
+	TableRecognizer table;
+	runRecognition("table lookup", words, operators, repetitions,
+				   [&](std::string_view word)
+				   {
+					   return table.getKeyword(word);
+				   },
+				   [&](BufferStream &stream)
+				   {
+					   return table.getOperator(stream);
+				   });
+
+	runRecognition("perfect hash", words, operators, repetitions,
+				   [](std::string_view word)
+				   {
+					   return getKeyword(word);
+				   },
+				   [](BufferStream &stream)
+				   {
+					   return getOperator(stream);
+				   });
+
+	return 0;
+}
@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <cstdint>
+
+#include "Arena.hpp"
+
+namespace sharpsenLang
+{
+	Arena::Arena(size_t blockSize)
+		: _current(nullptr),
+		  _remaining(0),
+		  _blockSize(blockSize),
+		  _bytesAllocated(0)
+	{
+	}
+
+	void *Arena::allocate(size_t size, size_t alignment)
+	{
+		size_t padding = (alignment - reinterpret_cast<uintptr_t>(_current) % alignment) % alignment;
+		if (padding + size > _remaining)
+		{
+			size_t blockSize = std::max(_blockSize, size + alignment);
+			_blocks.emplace_back(new char[blockSize]);
+			_current = _blocks.back().get();
+			_remaining = blockSize;
+			padding = (alignment - reinterpret_cast<uintptr_t>(_current) % alignment) % alignment;
+		}
+
+		void *ret = _current + padding;
+		_current += padding + size;
+		_remaining -= padding + size;
+		_bytesAllocated += size;
+		return ret;
+	}
+
+	std::string_view Arena::copyString(std::string_view text)
+	{
+		char *data = static_cast<char *>(allocate(text.size(), 1));
+		std::copy(text.begin(), text.end(), data);
+		return std::string_view(data, text.size());
+	}
+
+	void Arena::release()
+	{
+		_blocks.clear();
+		_current = nullptr;
+		_remaining = 0;
+		_bytesAllocated = 0;
+	}
+
+	size_t Arena::blockCount() const
+	{
+		return _blocks.size();
+	}
+
+	size_t Arena::bytesAllocated() const
+	{
+		return _bytesAllocated;
+	}
+}
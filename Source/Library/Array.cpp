@@ -0,0 +1,94 @@
+#include <typeinfo>
+
+#include "Array.hpp"
+
+namespace sharpsenLang
+{
+	namespace
+	{
+		// Arrays, tuples and classes may hold escaped boxes of their own, so only
+		// scalars nobody else references can stay in shared storage.
+		bool isPrivateScalar(const Variable &variable)
+		{
+			const std::type_info &type = typeid(variable);
+			return variable.refCount() == 1 &&
+				   (type == typeid(VariableImpl<Number>) ||
+					type == typeid(VariableImpl<Integer>) ||
+					type == typeid(VariableImpl<String>) ||
+					type == typeid(VariableImpl<Function>));
+		}
+	}
+
+	const std::vector<Value> &Array::emptyElements()
+	{
+		static const std::vector<Value> empty;
+		return empty;
+	}
+
+	bool Array::canShare() const
+	{
+		if (!_storage->escaped)
+		{
+			return true;
+		}
+		for (const Value &v : _storage->elements)
+		{
+			if (Variable *variable = v.variable(); variable && !isPrivateScalar(*variable))
+			{
+				return false;
+			}
+		}
+		_storage->escaped = false;
+		return true;
+	}
+
+	void Array::detach()
+	{
+		std::shared_ptr<Storage> storage = std::make_shared<Storage>();
+		if (_storage)
+		{
+			storage->elements.reserve(_storage->elements.size());
+			for (const Value &v : _storage->elements)
+			{
+				if (Variable *variable = v.variable())
+				{
+					storage->elements.emplace_back(variable->clone());
+				}
+				else
+				{
+					storage->elements.push_back(v);
+				}
+			}
+		}
+		_storage = std::move(storage);
+	}
+
+	Array::Array(std::vector<Value> elements)
+		: _storage(std::make_shared<Storage>())
+	{
+		_storage->elements = std::move(elements);
+	}
+
+	Array::Array(std::initializer_list<Value> elements)
+		: Array(std::vector<Value>(elements))
+	{
+	}
+
+	Array::Array(const Array &other)
+		: _storage(other._storage)
+	{
+		if (_storage && !canShare())
+		{
+			detach();
+		}
+	}
+
+	Array &Array::operator=(const Array &other)
+	{
+		if (this != &other)
+		{
+			*this = Array(other);
+		}
+		return *this;
+	}
+}
@@ -0,0 +1,862 @@
+#include "Bytecode.hpp"
+#include "VirtualMachine.hpp"
+#include "RuntimeContext.hpp"
+
+namespace sharpsenLang
+{
+	namespace
+	{
+		enum Fields
+		{
+			FieldA = 1,
+			FieldB = 2,
+			FieldC = 4,
+		};
+
+		bool isNumberComparison(OpCode op)
+		{
+			return op >= OpCode::Eq && op <= OpCode::Ge;
+		}
+
+		bool isIntegerComparison(OpCode op)
+		{
+			return op >= OpCode::EqInteger && op <= OpCode::GeInteger;
+		}
+
+		// The fields of an instruction that hold number registers.
+		int numberFields(OpCode op)
+		{
+			if (op >= OpCode::Add && op <= OpCode::Ge)
+			{
+				return FieldA | FieldB | FieldC;
+			}
+			if (isIntegerComparison(op))
+			{
+				return FieldA;
+			}
+			switch (op)
+			{
+			case OpCode::IndexLocal:
+			case OpCode::IndexLocalInRange:
+				return FieldA | FieldC;
+			case OpCode::JumpIfLess:
+			case OpCode::JumpIfNotLess:
+			case OpCode::JumpIfEqual:
+			case OpCode::JumpIfNotEqual:
+			case OpCode::Move:
+			case OpCode::Negative:
+			case OpCode::Bnot:
+			case OpCode::Lnot:
+				return FieldA | FieldB;
+			case OpCode::LoadGlobal:
+			case OpCode::IntegerToNumber:
+			case OpCode::IncrementLocal:
+			case OpCode::DecrementLocal:
+			case OpCode::JumpIfFalse:
+			case OpCode::JumpIfTrue:
+			case OpCode::Switch:
+			case OpCode::EvaluateNumber:
+			case OpCode::PushArgument:
+			case OpCode::Call:
+			case OpCode::CallLocal:
+			case OpCode::CallGlobal:
+			case OpCode::Return:
+				return FieldA;
+			case OpCode::StoreGlobal:
+			case OpCode::NumberToInteger:
+			case OpCode::DeclareLocal:
+				return FieldB;
+			default:
+				return 0;
+			}
+		}
+
+		// True if the instruction sets the number register in its field a.
+		bool writesNumber(OpCode op)
+		{
+			switch (op)
+			{
+			case OpCode::Move:
+			case OpCode::LoadGlobal:
+			case OpCode::IntegerToNumber:
+			case OpCode::Negative:
+			case OpCode::Bnot:
+			case OpCode::Lnot:
+			case OpCode::EvaluateNumber:
+			case OpCode::DeclareLocal:
+			case OpCode::IncrementLocal:
+			case OpCode::DecrementLocal:
+			case OpCode::IndexLocal:
+			case OpCode::IndexLocalInRange:
+			case OpCode::Call:
+			case OpCode::CallLocal:
+			case OpCode::CallGlobal:
+				return true;
+			default:
+				return (op >= OpCode::Add && op <= OpCode::Ge) || isIntegerComparison(op);
+			}
+		}
+
+		// The jump taken when the comparison op yields expected.
+		Instruction fuseComparison(const Instruction &comparison, bool expected, int label)
+		{
+			bool integer = isIntegerComparison(comparison.op);
+			OpCode less = integer ? OpCode::JumpIfLessInteger : OpCode::JumpIfLess;
+			OpCode notLess = integer ? OpCode::JumpIfNotLessInteger : OpCode::JumpIfNotLess;
+			OpCode equal = integer ? OpCode::JumpIfEqualInteger : OpCode::JumpIfEqual;
+			OpCode notEqual = integer ? OpCode::JumpIfNotEqualInteger : OpCode::JumpIfNotEqual;
+			int b = comparison.b;
+			int c = comparison.c;
+			OpCode op = integer ? OpCode(size_t(comparison.op) - size_t(OpCode::EqInteger) + size_t(OpCode::Eq)) : comparison.op;
+			switch (op)
+			{
+			case OpCode::Eq:
+				return Instruction{expected ? equal : notEqual, b, c, label};
+			case OpCode::Ne:
+				return Instruction{expected ? notEqual : equal, b, c, label};
+			case OpCode::Lt:
+				return Instruction{expected ? less : notLess, b, c, label};
+			case OpCode::Gt:
+				return Instruction{expected ? less : notLess, c, b, label};
+			case OpCode::Le:
+				return Instruction{expected ? notLess : less, c, b, label};
+			default:
+				return Instruction{expected ? notLess : less, b, c, label};
+			}
+		}
+	}
+
+	Operand Operand::none()
+	{
+		return Operand{OperandKind::None, 0};
+	}
+
+	Operand Operand::inRegister(int index)
+	{
+		return Operand{OperandKind::Register, index};
+	}
+
+	Operand Operand::local(int index)
+	{
+		return Operand{OperandKind::Local, index};
+	}
+
+	Operand Operand::global(int index)
+	{
+		return Operand{OperandKind::Global, index};
+	}
+
+	Operand Operand::function(int index)
+	{
+		return Operand{OperandKind::Function, index};
+	}
+
+	bool Operand::isLocation() const
+	{
+		return kind == OperandKind::Local || kind == OperandKind::Global;
+	}
+
+	BytecodeFunction::BytecodeFunction(SharedStatementPtr body, size_t localCount)
+		: _body(std::move(body)),
+		  _localCount(localCount),
+		  _registerCount(0),
+		  _integerRegisterCount(0)
+	{
+	}
+
+	const std::vector<Instruction> &BytecodeFunction::code() const
+	{
+		return _code;
+	}
+
+	size_t BytecodeFunction::frameSize() const
+	{
+		return _localCount + _registerCount + _constants.size();
+	}
+
+	size_t BytecodeFunction::firstRegister() const
+	{
+		return _localCount + 1;
+	}
+
+	size_t BytecodeFunction::registerCount() const
+	{
+		return _registerCount;
+	}
+
+	const std::vector<Register> &BytecodeFunction::constants() const
+	{
+		return _constants;
+	}
+
+	const std::vector<Register> &BytecodeFunction::integerConstants() const
+	{
+		return _integerConstants;
+	}
+
+	const CaseTable &BytecodeFunction::switchTable(int idx) const
+	{
+		return _switchTables[idx];
+	}
+
+	const Expression<Void> &BytecodeFunction::voidExpression(int idx) const
+	{
+		return *_voidExpressions[idx];
+	}
+
+	const Expression<Number> &BytecodeFunction::numberExpression(int idx) const
+	{
+		return *_numberExpressions[idx];
+	}
+
+	const Expression<Integer> &BytecodeFunction::integerExpression(int idx) const
+	{
+		return *_integerExpressions[idx];
+	}
+
+	const Expression<Lvalue> &BytecodeFunction::lvalueExpression(int idx) const
+	{
+		return *_lvalueExpressions[idx];
+	}
+
+	size_t BytecodeFunction::integerRegisterCount() const
+	{
+		return _integerRegisterCount;
+	}
+
+	BytecodeBuilder::BytecodeBuilder(BytecodeFunction &function)
+		: _function(function),
+		  _nextRegister(0),
+		  _nextIntegerRegister(0)
+	{
+	}
+
+	BytecodeBuilder::Mark BytecodeBuilder::mark() const
+	{
+		return Mark{
+			_function._code.size(),
+			_function._constants.size(),
+			_function._integerConstants.size(),
+			_function._switchTables.size(),
+			_function._voidExpressions.size(),
+			_function._numberExpressions.size(),
+			_function._integerExpressions.size(),
+			_function._lvalueExpressions.size(),
+			_labels.size(),
+			_nextRegister,
+			_nextIntegerRegister};
+	}
+
+	void BytecodeBuilder::rollback(const Mark &m)
+	{
+		_function._code.resize(m.code);
+		_function._constants.resize(m.constants);
+		_function._integerConstants.resize(m.integerConstants);
+		_function._switchTables.erase(_function._switchTables.begin() + m.switchTables, _function._switchTables.end());
+		_function._voidExpressions.resize(m.voidExpressions);
+		_function._numberExpressions.resize(m.numberExpressions);
+		_function._integerExpressions.resize(m.integerExpressions);
+		_function._lvalueExpressions.resize(m.lvalueExpressions);
+		_labels.resize(m.labels);
+		_nextRegister = m.nextRegister;
+		_nextIntegerRegister = m.nextIntegerRegister;
+	}
+
+	void BytecodeBuilder::emit(OpCode op, int a, int b, int c)
+	{
+		_function._code.push_back(Instruction{op, a, b, c});
+	}
+
+	Operand BytecodeBuilder::allocateRegister()
+	{
+		Operand ret = Operand::inRegister(int(_function.firstRegister()) + _nextRegister++);
+		if (size_t(_nextRegister) > _function._registerCount)
+		{
+			_function._registerCount = _nextRegister;
+		}
+		return ret;
+	}
+
+	void BytecodeBuilder::releaseRegisters()
+	{
+		_nextRegister = 0;
+		_nextIntegerRegister = 0;
+	}
+
+	Operand BytecodeBuilder::constantRegister(std::vector<Register> &constants, Register value, int first)
+	{
+		size_t idx = 0;
+		while (idx < constants.size() && constants[idx].integer != value.integer)
+		{
+			++idx;
+		}
+		if (idx == constants.size())
+		{
+			constants.push_back(value);
+		}
+		return Operand::inRegister(first + int(idx));
+	}
+
+	bool BytecodeBuilder::isTemporary(Operand value) const
+	{
+		return value.kind == OperandKind::Register && value.index >= int(_function.firstRegister()) &&
+			   value.index < firstConstant;
+	}
+
+	bool BytecodeBuilder::isBound(size_t position) const
+	{
+		for (int label : _labels)
+		{
+			if (label == int(position))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	Instruction *BytecodeBuilder::producer(Operand value)
+	{
+		if (!isTemporary(value) || _function._code.empty() || isBound(_function._code.size()))
+		{
+			return nullptr;
+		}
+		Instruction &last = _function._code.back();
+		if (!writesNumber(last.op) || last.a != value.index)
+		{
+			return nullptr;
+		}
+		return &last;
+	}
+
+	Operand BytecodeBuilder::constant(Number value)
+	{
+		Register constant;
+		constant.number = value;
+		return constantRegister(_function._constants, constant, firstConstant);
+	}
+
+	Operand BytecodeBuilder::load(Operand location)
+	{
+		switch (location.kind)
+		{
+		case OperandKind::Local:
+			return Operand::inRegister(location.index);
+		case OperandKind::Global:
+		{
+			Operand ret = allocateRegister();
+			emit(OpCode::LoadGlobal, ret.index, location.index);
+			return ret;
+		}
+		default:
+			return location;
+		}
+	}
+
+	Operand BytecodeBuilder::copy(Operand value)
+	{
+		Operand ret = allocateRegister();
+		emit(OpCode::Move, ret.index, value.index);
+		return ret;
+	}
+
+	Operand BytecodeBuilder::store(Operand location, Operand value)
+	{
+		switch (location.kind)
+		{
+		case OperandKind::Local:
+		case OperandKind::Register:
+		{
+			Operand ret = Operand::inRegister(location.index);
+			if (value.index == ret.index)
+			{
+				return ret;
+			}
+			if (Instruction *instruction = producer(value))
+			{
+				instruction->a = ret.index;
+			}
+			else
+			{
+				emit(OpCode::Move, ret.index, value.index);
+			}
+			return ret;
+		}
+		case OperandKind::Global:
+			emit(OpCode::StoreGlobal, location.index, value.index);
+			return value;
+		default:
+			return value;
+		}
+	}
+
+	bool BytecodeBuilder::mayWrite(const Mark &m, Operand value) const
+	{
+		if (value.kind != OperandKind::Register || value.index >= int(_function.firstRegister()))
+		{
+			return false;
+		}
+		for (size_t pc = m.code; pc < _function._code.size(); ++pc)
+		{
+			const Instruction &instruction = _function._code[pc];
+			switch (instruction.op)
+			{
+			case OpCode::EvaluateVoid:
+			case OpCode::EvaluateNumber:
+			case OpCode::EvaluateInteger:
+			case OpCode::DeclareLocalTree:
+			case OpCode::PushArgumentTree:
+				return true;
+			case OpCode::PushLocalReference:
+				if (instruction.a == value.index)
+				{
+					return true;
+				}
+				break;
+			default:
+				if (writesNumber(instruction.op) && instruction.a == value.index)
+				{
+					return true;
+				}
+				break;
+			}
+		}
+		return false;
+	}
+
+	Operand BytecodeBuilder::allocateIntegerRegister()
+	{
+		Operand ret = Operand::inRegister(_nextIntegerRegister++);
+		if (size_t(_nextIntegerRegister) > _function._integerRegisterCount)
+		{
+			_function._integerRegisterCount = _nextIntegerRegister;
+		}
+		return ret;
+	}
+
+	Operand BytecodeBuilder::integerConstant(Integer value)
+	{
+		Register constant;
+		constant.integer = value;
+		Operand ret = constantRegister(_function._integerConstants, constant, 0);
+		return Operand::inRegister(-1 - ret.index);
+	}
+
+	Operand BytecodeBuilder::loadInteger(Operand location)
+	{
+		switch (location.kind)
+		{
+		case OperandKind::Local:
+		{
+			Operand ret = allocateIntegerRegister();
+			emit(OpCode::LoadLocalInteger, ret.index, location.index);
+			return ret;
+		}
+		case OperandKind::Global:
+		{
+			Operand ret = allocateIntegerRegister();
+			emit(OpCode::LoadGlobalInteger, ret.index, location.index);
+			return ret;
+		}
+		default:
+			return location;
+		}
+	}
+
+	Operand BytecodeBuilder::storeInteger(Operand location, Operand value)
+	{
+		switch (location.kind)
+		{
+		case OperandKind::Local:
+			emit(OpCode::StoreLocalInteger, location.index, value.index);
+			break;
+		case OperandKind::Global:
+			emit(OpCode::StoreGlobalInteger, location.index, value.index);
+			break;
+		case OperandKind::Register:
+			emit(OpCode::MoveInteger, location.index, value.index);
+			return location;
+		default:
+			break;
+		}
+		return value;
+	}
+
+	Operand BytecodeBuilder::lowerVoid(const Expression<Void> &expr)
+	{
+		Mark m = mark();
+		Operand ret;
+		if (!expr.lower(*this, ret))
+		{
+			rollback(m);
+			_function._voidExpressions.push_back(&expr);
+			emit(OpCode::EvaluateVoid, int(_function._voidExpressions.size() - 1));
+		}
+		return Operand::none();
+	}
+
+	Operand BytecodeBuilder::lowerNumber(const Expression<Number> &expr)
+	{
+		Mark m = mark();
+		Operand ret;
+		if (expr.lower(*this, ret) && ret.kind == OperandKind::Register)
+		{
+			return ret;
+		}
+		rollback(m);
+		ret = allocateRegister();
+		_function._numberExpressions.push_back(&expr);
+		emit(OpCode::EvaluateNumber, ret.index, int(_function._numberExpressions.size() - 1));
+		return ret;
+	}
+
+	Operand BytecodeBuilder::lowerLnumber(const Expression<Lnumber> &expr)
+	{
+		Mark m = mark();
+		Operand ret;
+		if (expr.lower(*this, ret) && ret.isLocation())
+		{
+			return ret;
+		}
+		rollback(m);
+		return Operand::none();
+	}
+
+	Operand BytecodeBuilder::lowerInteger(const Expression<Integer> &expr)
+	{
+		Mark m = mark();
+		Operand ret;
+		if (expr.lower(*this, ret) && ret.kind == OperandKind::Register)
+		{
+			return ret;
+		}
+		rollback(m);
+		ret = allocateIntegerRegister();
+		_function._integerExpressions.push_back(&expr);
+		emit(OpCode::EvaluateInteger, ret.index, int(_function._integerExpressions.size() - 1));
+		return ret;
+	}
+
+	Operand BytecodeBuilder::lowerLinteger(const Expression<Linteger> &expr)
+	{
+		Mark m = mark();
+		Operand ret;
+		if (expr.lower(*this, ret) && ret.isLocation())
+		{
+			return ret;
+		}
+		rollback(m);
+		return Operand::none();
+	}
+
+	BytecodeBuilder::Label BytecodeBuilder::createLabel()
+	{
+		_labels.push_back(-1);
+		return Label(_labels.size() - 1);
+	}
+
+	void BytecodeBuilder::bindLabel(Label label)
+	{
+		_labels[label] = int(_function._code.size());
+	}
+
+	void BytecodeBuilder::jump(Label label)
+	{
+		emit(OpCode::Jump, label);
+	}
+
+	void BytecodeBuilder::jumpIfFalse(Operand condition, Label label)
+	{
+		Instruction *instruction = producer(condition);
+		if (instruction && (isNumberComparison(instruction->op) || isIntegerComparison(instruction->op)))
+		{
+			*instruction = fuseComparison(*instruction, false, label);
+			return;
+		}
+		emit(OpCode::JumpIfFalse, condition.index, label);
+	}
+
+	void BytecodeBuilder::jumpIfTrue(Operand condition, Label label)
+	{
+		Instruction *instruction = producer(condition);
+		if (instruction && (isNumberComparison(instruction->op) || isIntegerComparison(instruction->op)))
+		{
+			*instruction = fuseComparison(*instruction, true, label);
+			return;
+		}
+		emit(OpCode::JumpIfTrue, condition.index, label);
+	}
+
+	void BytecodeBuilder::switchJump(Operand value, const std::unordered_map<Number, size_t> &cases, const std::vector<Label> &labels, Label dflt)
+	{
+		std::unordered_map<Number, size_t> targets;
+		for (const auto &p : cases)
+		{
+			targets.emplace(p.first, size_t(labels[p.second]));
+		}
+		_function._switchTables.emplace_back(targets, size_t(dflt));
+		emit(OpCode::Switch, value.index, int(_function._switchTables.size() - 1));
+	}
+
+	void BytecodeBuilder::declareLocal(const Expression<Lvalue> &expr, int slot)
+	{
+		Mark m = mark();
+		Operand value;
+		if (const Expression<Integer> *integer = findUnboxedValue(expr).integer)
+		{
+			value = lowerInteger(*integer);
+			emit(OpCode::DeclareLocalInteger, slot, value.index);
+		}
+		else if (expr.lower(*this, value) && value.kind == OperandKind::Register)
+		{
+			emit(OpCode::DeclareLocal, slot, value.index);
+		}
+		else
+		{
+			rollback(m);
+			_function._lvalueExpressions.push_back(&expr);
+			emit(OpCode::DeclareLocalTree, slot, int(_function._lvalueExpressions.size() - 1));
+		}
+		releaseRegisters();
+	}
+
+	void BytecodeBuilder::enterBreakable(Label breakLabel)
+	{
+		_breakables.push_back(Breakable{breakLabel, -1, false});
+	}
+
+	void BytecodeBuilder::enterLoop(Label breakLabel, Label continueLabel)
+	{
+		_breakables.push_back(Breakable{breakLabel, continueLabel, true});
+	}
+
+	void BytecodeBuilder::leaveBreakable()
+	{
+		_breakables.pop_back();
+	}
+
+	void BytecodeBuilder::breakFlow(int breakLevel)
+	{
+		jump(_breakables[_breakables.size() - breakLevel].breakLabel);
+	}
+
+	void BytecodeBuilder::continueFlow()
+	{
+		for (auto it = _breakables.rbegin(); it != _breakables.rend(); ++it)
+		{
+			if (it->isLoop)
+			{
+				jump(it->continueLabel);
+				return;
+			}
+		}
+	}
+
+	void BytecodeBuilder::beginCall(size_t argc)
+	{
+		emit(OpCode::BeginCall, int(argc));
+	}
+
+	void BytecodeBuilder::pushArgument(const Expression<Lvalue> &expr, size_t slot)
+	{
+		if (const Expression<Integer> *integer = findUnboxedValue(expr).integer)
+		{
+			Operand value = lowerInteger(*integer);
+			emit(OpCode::PushArgumentInteger, value.index, int(slot));
+			return;
+		}
+
+		Mark m = mark();
+		Operand value;
+		if (expr.lower(*this, value))
+		{
+			switch (value.kind)
+			{
+			case OperandKind::Register:
+				emit(OpCode::PushArgument, value.index, int(slot));
+				return;
+			case OperandKind::Local:
+				emit(OpCode::PushLocalReference, value.index, int(slot));
+				return;
+			case OperandKind::Global:
+				emit(OpCode::PushGlobalReference, value.index, int(slot));
+				return;
+			default:
+				break;
+			}
+		}
+		rollback(m);
+		_function._lvalueExpressions.push_back(&expr);
+		emit(OpCode::PushArgumentTree, int(_function._lvalueExpressions.size() - 1), int(slot));
+	}
+
+	void BytecodeBuilder::call(Operand callee, size_t argc, Operand result)
+	{
+		emitCall(callee, argc, result, OpCode::Call, OpCode::CallLocal, OpCode::CallGlobal);
+	}
+
+	void BytecodeBuilder::callInteger(Operand callee, size_t argc, Operand result)
+	{
+		emitCall(callee, argc, result, OpCode::CallInteger, OpCode::CallLocalInteger, OpCode::CallGlobalInteger);
+	}
+
+	void BytecodeBuilder::emitCall(Operand callee, size_t argc, Operand result, OpCode function, OpCode local, OpCode global)
+	{
+		int dst = result.kind == OperandKind::Register ? result.index : NoResult;
+		switch (callee.kind)
+		{
+		case OperandKind::Function:
+			emit(function, dst, callee.index, int(argc));
+			break;
+		case OperandKind::Local:
+			emit(local, dst, callee.index, int(argc));
+			break;
+		case OperandKind::Global:
+			emit(global, dst, callee.index, int(argc));
+			break;
+		default:
+			break;
+		}
+	}
+
+	void BytecodeBuilder::tailCall(Operand callee, size_t argc)
+	{
+		emit(OpCode::TailCall, callee.index, int(argc));
+	}
+
+	void BytecodeBuilder::returnValue(const Expression<Lvalue> &expr)
+	{
+		Mark m = mark();
+		Operand value;
+		if (const Expression<Integer> *integer = findUnboxedValue(expr).integer)
+		{
+			value = lowerInteger(*integer);
+			emit(OpCode::ReturnInteger, value.index);
+		}
+		else if (expr.lower(*this, value) && value.kind == OperandKind::Register)
+		{
+			emit(OpCode::Return, value.index);
+		}
+		else
+		{
+			rollback(m);
+			_function._lvalueExpressions.push_back(&expr);
+			emit(OpCode::ReturnTree, int(_function._lvalueExpressions.size() - 1));
+		}
+		releaseRegisters();
+	}
+
+	void BytecodeBuilder::returnVoid()
+	{
+		emit(OpCode::ReturnVoid);
+	}
+
+	void BytecodeBuilder::finish()
+	{
+		emit(OpCode::ReturnVoid);
+
+		// Temporaries no instruction refers to anymore, like those of comparisons
+		// fused with their jump, are dropped to keep the frame small.
+		int first = int(_function.firstRegister());
+		std::vector<int> temporaries(_function._registerCount, -1);
+		auto forEachRegister = [&](auto &&f)
+		{
+			for (Instruction &instruction : _function._code)
+			{
+				int fields = numberFields(instruction.op);
+				if (fields & FieldA)
+				{
+					f(instruction.a);
+				}
+				if (fields & FieldB)
+				{
+					f(instruction.b);
+				}
+				if (fields & FieldC)
+				{
+					f(instruction.c);
+				}
+			}
+		};
+		forEachRegister(
+			[&](int &field)
+			{
+				if (field >= first && field < firstConstant)
+				{
+					temporaries[field - first] = 0;
+				}
+			});
+		int registerCount = 0;
+		for (int &idx : temporaries)
+		{
+			if (idx == 0)
+			{
+				idx = registerCount++;
+			}
+		}
+		_function._registerCount = registerCount;
+		forEachRegister(
+			[&](int &field)
+			{
+				if (field >= firstConstant)
+				{
+					field = first + registerCount + field - firstConstant;
+				}
+				else if (field >= first)
+				{
+					field = first + temporaries[field - first];
+				}
+			});
+
+		for (Instruction &instruction : _function._code)
+		{
+
+			switch (instruction.op)
+			{
+			case OpCode::Jump:
+				instruction.a = _labels[instruction.a];
+				break;
+			case OpCode::JumpIfFalse:
+			case OpCode::JumpIfTrue:
+				instruction.b = _labels[instruction.b];
+				break;
+			case OpCode::JumpIfLess:
+			case OpCode::JumpIfNotLess:
+			case OpCode::JumpIfEqual:
+			case OpCode::JumpIfNotEqual:
+			case OpCode::JumpIfLessInteger:
+			case OpCode::JumpIfNotLessInteger:
+			case OpCode::JumpIfEqualInteger:
+			case OpCode::JumpIfNotEqualInteger:
+				instruction.c = _labels[instruction.c];
+				break;
+			default:
+				break;
+			}
+		}
+
+		for (CaseTable &table : _function._switchTables)
+		{
+			table.retarget(
+				[&](size_t label)
+				{
+					return size_t(_labels[label]);
+				});
+		}
+	}
+
+	Function createBytecodeFunction(SharedStatementPtr body, size_t frameSize)
+	{
+		std::shared_ptr<BytecodeFunction> function = std::make_shared<BytecodeFunction>(body, frameSize);
+
+		BytecodeBuilder builder(*function);
+		body->lower(builder);
+		builder.finish();
+
+		return [function = std::shared_ptr<const BytecodeFunction>(std::move(function))](RuntimeContext &ctx)
+		{
+			ctx.enterFrame(function->frameSize());
+			executeBytecode(ctx, *function);
+		};
+	}
+}
@@ -0,0 +1,57 @@
+#include <cmath>
+
+#include "CaseTable.hpp"
+
+namespace sharpsenLang
+{
+	namespace
+	{
+		// Dense tables may be this many times larger than the label set.
+		constexpr size_t maxDenseSpread = 4;
+
+		// Larger sparse sets are hashed, as searching them takes too many steps.
+		constexpr size_t maxSortedCases = 64;
+	}
+
+	CaseTable::CaseTable(const std::unordered_map<Number, size_t> &cases, size_t dflt)
+		: _kind(Kind::Dense),
+		  _dflt(dflt),
+		  _min(0)
+	{
+		if (cases.empty())
+		{
+			return;
+		}
+
+		bool integral = true;
+		Number min = cases.begin()->first;
+		Number max = min;
+		for (const auto &p : cases)
+		{
+			integral = integral && std::trunc(p.first) == p.first;
+			min = std::min(min, p.first);
+			max = std::max(max, p.first);
+		}
+
+		if (integral && max - min < Number(maxDenseSpread * cases.size()))
+		{
+			_min = min;
+			_dense.assign(size_t(max - min) + 1, dflt);
+			for (const auto &p : cases)
+			{
+				_dense[size_t(p.first - min)] = p.second;
+			}
+		}
+		else if (cases.size() <= maxSortedCases)
+		{
+			_kind = Kind::Sorted;
+			_sorted.assign(cases.begin(), cases.end());
+			std::sort(_sorted.begin(), _sorted.end());
+		}
+		else
+		{
+			_kind = Kind::Hashed;
+			_hashed = cases;
+		}
+	}
+}
@@ -1,3 +1,9 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <iterator>
+#include <thread>
+
 #include "Compiler.hpp"
 #include "Errors.hpp"
 #include "CompilerContext.hpp"
@@ -8,6 +14,7 @@
 #include "Helpers.hpp"
 #include "PushBackStream.hpp"
 #include "IncompleteClass.hpp"
+#include "LoopOptimizer.hpp"
 
 namespace sharpsenLang
 {
@@ -45,6 +52,7 @@ namespace sharpsenLang
 						{
 						case ReservedToken::KwNumber:
 						case ReservedToken::KwString:
+						case ReservedToken::KwInt:
 						case ReservedToken::KwVoid:
 						case ReservedToken::OpenSquare:
 							return true;
@@ -54,7 +62,7 @@ namespace sharpsenLang
 					},
 					[&ctx](const Identifier &t) -> bool
 					{
-						return ctx.findClass(t.name);
+						return ctx.findClass(std::string(t.name));
 					},
 					[](const TokenValue &)
 					{
@@ -179,6 +187,19 @@ namespace sharpsenLang
 			return compileSimpleStatement(ctx, it);
 		}
 
+		// Declares the values hoisted out of a loop in a block around it.
+		StatementPtr withHoistedValues(std::vector<Expression<Lvalue>::Ptr> hoisted, size_t slot, StatementPtr loop)
+		{
+			if (hoisted.empty())
+			{
+				return loop;
+			}
+			std::vector<StatementPtr> block;
+			block.push_back(createLocalDeclarationStatement(std::move(hoisted), slot));
+			block.push_back(std::move(loop));
+			return createBlockStatement(std::move(block));
+		}
+
 		StatementPtr compileSimpleStatement(CompilerContext &ctx, TokensIterator &it)
 		{
 			StatementPtr ret = createSimpleStatement(buildVoidExpression(ctx, it));
@@ -189,11 +210,14 @@ namespace sharpsenLang
 		StatementPtr compileForStatement(CompilerContext &ctx, TokensIterator &it, PossibleFlow pf)
 		{
 			auto _ = ctx.scope();
+			LoopInvariants invariants(ctx);
 
 			parseTokenValue(ctx, it, ReservedToken::KwFor);
 			parseTokenValue(ctx, it, ReservedToken::OpenRound);
+			CountedLoop counted(ctx, it);
 
 			std::vector<Expression<Lvalue>::Ptr> decls;
+			size_t slot = ctx.nextLocalSlot();
 			Expression<Void>::Ptr expr1;
 
 			if (isTypename(ctx, it))
@@ -207,35 +231,52 @@ namespace sharpsenLang
 
 			parseTokenValue(ctx, it, ReservedToken::Semicolon);
 
-			Expression<Number>::Ptr expr2 = buildNumberExpression(ctx, it);
+			invariants.parseCondition(it);
 			parseTokenValue(ctx, it, ReservedToken::Semicolon);
 
-			Expression<Void>::Ptr expr3 = buildVoidExpression(ctx, it);
+			invariants.parseStep(it);
 			parseTokenValue(ctx, it, ReservedToken::CloseRound);
 
+			invariants.reserve();
+			counted.enterBody();
 			StatementPtr block = compileBlockStatement(ctx, it, pf);
+			counted.leaveBody();
+
+			Expression<Number>::Ptr expr2 = invariants.buildCondition();
+			Expression<Void>::Ptr expr3 = invariants.buildStep();
+			std::vector<Expression<Lvalue>::Ptr> hoisted = invariants.initializers();
 
 			if (!decls.empty())
 			{
-				return createForStatement(std::move(decls), std::move(expr2), std::move(expr3), std::move(block));
+				// The hoisted values are declared after the loop's own variables.
+				std::move(hoisted.begin(), hoisted.end(), std::back_inserter(decls));
+				return createForStatement(std::move(decls), slot, std::move(expr2), std::move(expr3), std::move(block));
 			}
 			else
 			{
-				return createForStatement(std::move(expr1), std::move(expr2), std::move(expr3), std::move(block));
+				return withHoistedValues(
+					std::move(hoisted),
+					invariants.slot(),
+					createForStatement(std::move(expr1), std::move(expr2), std::move(expr3), std::move(block)));
 			}
 		}
 
 		StatementPtr compileWhileStatement(CompilerContext &ctx, TokensIterator &it, PossibleFlow pf)
 		{
+			auto _ = ctx.scope();
+			LoopInvariants invariants(ctx);
+
 			parseTokenValue(ctx, it, ReservedToken::KwWhile);
 
 			parseTokenValue(ctx, it, ReservedToken::OpenRound);
-			Expression<Number>::Ptr expr = buildNumberExpression(ctx, it);
+			invariants.parseCondition(it);
 			parseTokenValue(ctx, it, ReservedToken::CloseRound);
 
+			invariants.reserve();
 			StatementPtr block = compileBlockStatement(ctx, it, pf);
 
-			return createWhileStatement(std::move(expr), std::move(block));
+			Expression<Number>::Ptr expr = invariants.buildCondition();
+			return withHoistedValues(invariants.initializers(), invariants.slot(), createWhileStatement(std::move(expr), std::move(block)));
 		}
 
 		StatementPtr compileDoStatement(CompilerContext &ctx, TokensIterator &it, PossibleFlow pf)
@@ -261,6 +302,7 @@ namespace sharpsenLang
 			parseTokenValue(ctx, it, ReservedToken::OpenRound);
 
 			std::vector<Expression<Lvalue>::Ptr> decls;
+			size_t slot = ctx.nextLocalSlot();
 
 			if (isTypename(ctx, it))
 			{
@@ -294,7 +336,7 @@ namespace sharpsenLang
 				stmts.emplace_back(createBlockStatement({}));
 			}
 
-			return createIfStatement(std::move(decls), std::move(exprs), std::move(stmts));
+			return createIfStatement(std::move(decls), slot, std::move(exprs), std::move(stmts));
 		}
 
 		StatementPtr compileSwitchStatement(CompilerContext &ctx, TokensIterator &it, PossibleFlow pf)
@@ -305,6 +347,7 @@ namespace sharpsenLang
 			parseTokenValue(ctx, it, ReservedToken::OpenRound);
 
 			std::vector<Expression<Lvalue>::Ptr> decls;
+			size_t slot = ctx.nextLocalSlot();
 
 			if (isTypename(ctx, it))
 			{
@@ -353,14 +396,15 @@ namespace sharpsenLang
 				dflt = stmts.size();
 			}
 
-			return createSwitchStatement(std::move(decls), std::move(expr), std::move(stmts), std::move(cases), dflt);
+			return createSwitchStatement(std::move(decls), slot, std::move(expr), std::move(stmts), std::move(cases), dflt);
 		}
 
 		StatementPtr compileVarStatement(CompilerContext &ctx, TokensIterator &it)
 		{
+			size_t slot = ctx.nextLocalSlot();
 			std::vector<Expression<Lvalue>::Ptr> decls = compileVariableDeclaration(ctx, it);
 			parseTokenValue(ctx, it, ReservedToken::Semicolon);
-			return createLocalDeclarationStatement(std::move(decls));
+			return createLocalDeclarationStatement(std::move(decls), slot);
 		}
 
 		StatementPtr compileBreakStatement(CompilerContext &ctx, TokensIterator &it, PossibleFlow pf)
@@ -417,8 +461,13 @@ namespace sharpsenLang
 			}
 			else
 			{
-				Expression<Lvalue>::Ptr expr = buildInitializationExpression(ctx, it, pf.returnTypeId, true);
+				Expression<void>::Ptr tailCall;
+				Expression<Lvalue>::Ptr expr = buildReturnExpression(ctx, it, pf.returnTypeId, tailCall);
 				parseTokenValue(ctx, it, ReservedToken::Semicolon);
+				if (tailCall)
+				{
+					return createTailCallStatement(std::move(tailCall));
+				}
 				return createReturnStatement(std::move(expr));
 			}
 		}
@@ -471,7 +520,7 @@ namespace sharpsenLang
 			throw unexpectedSyntax(it);
 		}
 
-		std::string ret = it->getIdentifier().name;
+		std::string ret(it->getIdentifier().name);
 
 		if (!ctx.canDeclare(ret))
 		{
@@ -503,6 +552,10 @@ namespace sharpsenLang
 				t = ctx.getHandle(SimpleType::String);
 				++it;
 				break;
+			case ReservedToken::KwInt:
+				t = ctx.getHandle(SimpleType::Int);
+				++it;
+				break;
 			case ReservedToken::OpenSquare:
 			{
 				TupleType tt;
@@ -525,7 +578,7 @@ namespace sharpsenLang
 		}
 		else if (it->isIdentifier())
 		{
-			if (auto classType = ctx.findClass(it->getIdentifier().name))
+			if (auto classType = ctx.findClass(std::string(it->getIdentifier().name)))
 			{
 				t = classType->typeId();
 				++it;
@@ -592,12 +645,81 @@ namespace sharpsenLang
 		return createSharedBlockStatement(std::move(block));
 	}
 
-	RuntimeContext compile(
+	namespace
+	{
+		std::vector<Function> compileFunctions(
+			CompilerContext &ctx,
+			std::vector<IncompleteFunction> &incompleteFunctions,
+			size_t threadCount)
+		{
+			if (threadCount == 0)
+			{
+				threadCount = std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+			}
+			threadCount = std::min(threadCount, incompleteFunctions.size());
+
+			std::vector<Function> ret(incompleteFunctions.size());
+
+			if (threadCount <= 1)
+			{
+				for (size_t i = 0; i < incompleteFunctions.size(); ++i)
+				{
+					ret[i] = incompleteFunctions[i].compile(ctx);
+				}
+				return ret;
+			}
+
+			std::vector<std::exception_ptr> errors(incompleteFunctions.size());
+			std::atomic<size_t> next = 0;
+
+			auto worker = [&]()
+			{
+				std::unique_ptr<CompilerContext> local = ctx.fork();
+				for (size_t i = next++; i < incompleteFunctions.size(); i = next++)
+				{
+					try
+					{
+						ret[i] = incompleteFunctions[i].compile(*local);
+					}
+					catch (...)
+					{
+						errors[i] = std::current_exception();
+					}
+				}
+			};
+
+			std::vector<std::thread> threads;
+			for (size_t i = 1; i < threadCount; ++i)
+			{
+				threads.emplace_back(worker);
+			}
+			worker();
+			for (std::thread &thread : threads)
+			{
+				thread.join();
+			}
+
+			// Report the same error a sequential compilation would have stopped at.
+			for (const std::exception_ptr &error : errors)
+			{
+				if (error)
+				{
+					std::rethrow_exception(error);
+				}
+			}
+
+			return ret;
+		}
+	}
+
+	ProgramPtr compile(
 		TokensIterator &it,
 		const std::vector<std::pair<std::string, Function>> &externalFunctions,
-		std::vector<std::string> public_declarations)
+		std::vector<std::string> public_declarations,
+		const ModuleSettings &settings)
 	{
-		CompilerContext ctx;
+		std::shared_ptr<CompilerContext> sharedCtx = std::make_shared<CompilerContext>(settings);
+		CompilerContext &ctx = *sharedCtx;
 
 		for (const std::pair<std::string, Function> &p : externalFunctions)
 		{
@@ -686,7 +808,7 @@ namespace sharpsenLang
 							lineNumber,
 							charIndex);
 					}
-					else
+					else if (it != public_function_types.end())
 					{
 						public_function_types.erase(it);
 					}
@@ -726,6 +848,22 @@ namespace sharpsenLang
 				it->getCharIndex());
 		}
 
+		// Specialized functions may be created while compiling bodies, lazily too,
+		// so the program owns them.
+		std::shared_ptr<Specializations> specializations = std::make_shared<Specializations>();
+		ctx.setSpecializations(specializations);
+
+		if (settings.engine == ExecutionEngine::Tree)
+		{
+			for (const IncompleteFunction &f : incompleteFunctions)
+			{
+				if (std::shared_ptr<const FunctionBody> body = f.body(settings))
+				{
+					ctx.addFunctionBody(ctx.find(f.getDecl().name)->index(), std::move(body));
+				}
+			}
+		}
+
 		std::vector<Function> functions;
 		std::vector<Class> classes;
 
@@ -736,11 +874,28 @@ namespace sharpsenLang
 			functions.emplace_back(p.second);
 		}
 
-		for (IncompleteFunction &f : incompleteFunctions)
+		if (settings.lazyCompile)
+		{
+			for (IncompleteFunction &f : incompleteFunctions)
+			{
+				functions.emplace_back(createLazyFunction(sharedCtx, std::move(f)));
+			}
+		}
+		else
 		{
-			functions.emplace_back(f.compile(ctx));
+			for (Function &f : compileFunctions(ctx, incompleteFunctions, settings.compileThreads))
+			{
+				functions.emplace_back(std::move(f));
+			}
 		}
 
-		return RuntimeContext(std::move(initializers), std::move(functions), std::move(classes), std::move(publicFunctions));
+		return std::make_shared<const Program>(
+			std::move(initializers),
+			std::move(functions),
+			std::move(classes),
+			std::move(publicFunctions),
+			settings.stackCapacity,
+			ctx.sharedCounters(),
+			std::move(specializations));
 	}
 }
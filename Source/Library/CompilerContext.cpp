@@ -1,11 +1,15 @@
+#include <algorithm>
+
 #include "CompilerContext.hpp"
+#include "IncompleteFunction.hpp"
 
 namespace sharpsenLang
 {
-	IdentifierInfo::IdentifierInfo(TypeHandle typeId, size_t index, IdentifierScope scope)
+	IdentifierInfo::IdentifierInfo(TypeHandle typeId, size_t index, IdentifierScope scope, bool reference)
 		: _typeId(typeId),
 		  _index(index),
-		  _scope(scope)
+		  _scope(scope),
+		  _reference(reference)
 	{
 	}
 
@@ -24,6 +28,11 @@ namespace sharpsenLang
 		return _scope;
 	}
 
+	bool IdentifierInfo::isReference() const
+	{
+		return _reference;
+	}
+
 	ClassInfo::ClassInfo(TypeHandle typeId, size_t index, IdentifierScope scope, std::vector<std::string> properties)
 		: IdentifierInfo(typeId, index, scope)
 	{
@@ -74,9 +83,9 @@ namespace sharpsenLang
 		return _identifiers.find(name) == _identifiers.end();
 	}
 
-	const IdentifierInfo *IdentifierLookup::insertIdentifier(std::string name, TypeHandle typeId, size_t index, IdentifierScope scope)
+	const IdentifierInfo *IdentifierLookup::insertIdentifier(std::string name, TypeHandle typeId, size_t index, IdentifierScope scope, bool reference)
 	{
-		return &_identifiers.emplace(std::move(name), IdentifierInfo(typeId, index, scope)).first->second;
+		return &_identifiers.emplace(std::move(name), IdentifierInfo(typeId, index, scope, reference)).first->second;
 	}
 
 	size_t IdentifierLookup::identifiersSize() const
@@ -138,15 +147,25 @@ namespace sharpsenLang
 		return std::move(_parent);
 	}
 
+	int LocalVariableLookup::nextIdentifierIndex() const
+	{
+		return _nextIdentifierIndex;
+	}
+
 	ParamLookup::ParamLookup()
 		: LocalVariableLookup(nullptr),
 		  _nextParamIndex(-1)
 	{
 	}
 
-	const IdentifierInfo *ParamLookup::createParam(std::string name, TypeHandle typeId)
+	const IdentifierInfo *ParamLookup::createParam(std::string name, TypeHandle typeId, bool byRef)
 	{
-		return insertIdentifier(std::move(name), typeId, _nextParamIndex--, IdentifierScope::LocalVariable);
+		return insertIdentifier(std::move(name), typeId, _nextParamIndex--, IdentifierScope::LocalVariable, byRef);
+	}
+
+	const IdentifierInfo *ParamLookup::bindParam(std::string name, TypeHandle typeId, size_t functionIndex)
+	{
+		return insertIdentifier(std::move(name), typeId, functionIndex, IdentifierScope::Function);
 	}
 
 	const IdentifierInfo *FunctionLookup::createIdentifier(std::string name, TypeHandle typeId)
@@ -154,14 +173,47 @@ namespace sharpsenLang
 		return insertIdentifier(std::move(name), typeId, identifiersSize(), IdentifierScope::Function);
 	}
 
-	CompilerContext::CompilerContext()
-		: _params(nullptr)
+	CompilerContext::CompilerContext(ModuleSettings settings)
+		: CompilerContext(std::make_shared<SharedState>())
+	{
+		_shared->settings = settings;
+	}
+
+	CompilerContext::CompilerContext(std::shared_ptr<SharedState> shared)
+		: _shared(std::move(shared)),
+		  _params(nullptr),
+		  _frameSize(0)
+	{
+	}
+
+	std::unique_ptr<CompilerContext> CompilerContext::fork() const
+	{
+		return std::unique_ptr<CompilerContext>(new CompilerContext(_shared));
+	}
+
+	const ModuleSettings &CompilerContext::settings() const
+	{
+		return _shared->settings;
+	}
+
+	CompileCounters &CompilerContext::counters()
+	{
+		return *_shared->counters;
+	}
+
+	std::shared_ptr<const CompileCounters> CompilerContext::sharedCounters() const
 	{
+		return _shared->counters;
+	}
+
+	Arena &CompilerContext::arena()
+	{
+		return _arena;
 	}
 
 	const Type *CompilerContext::getHandle(const Type &t)
 	{
-		return _types.getHandle(t);
+		return _shared->types.getHandle(t);
 	}
 
 	const IdentifierInfo *CompilerContext::find(const std::string &name) const
@@ -173,48 +225,65 @@ namespace sharpsenLang
 				return ret;
 			}
 		}
-		if (const IdentifierInfo *ret = _functions.find(name))
+		if (const IdentifierInfo *ret = _shared->functions.find(name))
 		{
 			return ret;
 		}
-		return _globals.find(name);
+		return _shared->globals.find(name);
 	}
 
 	const IdentifierInfo *CompilerContext::findClass(const std::string &name) const
 	{
-		return _classes.find(name);
+		return _shared->classes.find(name);
 	}
 
 	const Property *CompilerContext::getClassProperty(const ClassType *ct, std::string_view propertyName) const
 	{
-		return _types.getClassProperty(ct, propertyName);
+		return _shared->types.getClassProperty(ct, propertyName);
 	}
 
 	const IdentifierInfo *CompilerContext::createIdentifier(std::string name, TypeHandle typeId)
 	{
 		if (_locals)
 		{
-			return _locals->createIdentifier(std::move(name), typeId);
+			const IdentifierInfo *ret = _locals->createIdentifier(std::move(name), typeId);
+			_frameSize = std::max(_frameSize, ret->index());
+			return ret;
 		}
 		else
 		{
-			return _globals.createIdentifier(std::move(name), typeId);
+			return _shared->globals.createIdentifier(std::move(name), typeId);
 		}
 	}
 
-	const IdentifierInfo *CompilerContext::createParam(std::string name, TypeHandle typeId)
+	const IdentifierInfo *CompilerContext::createParam(std::string name, TypeHandle typeId, bool byRef)
+	{
+		return _params->createParam(name, typeId, byRef);
+	}
+
+	const IdentifierInfo *CompilerContext::bindParam(std::string name, TypeHandle typeId, size_t functionIndex)
+	{
+		return _params->bindParam(name, typeId, functionIndex);
+	}
+
+	size_t CompilerContext::frameSize() const
+	{
+		return _frameSize;
+	}
+
+	size_t CompilerContext::nextLocalSlot() const
 	{
-		return _params->createParam(name, typeId);
+		return _locals->nextIdentifierIndex();
 	}
 
 	const IdentifierInfo *CompilerContext::createFunction(std::string name, TypeHandle typeId)
 	{
-		return _functions.createIdentifier(name, typeId);
+		return _shared->functions.createIdentifier(name, typeId);
 	}
 
 	const IdentifierInfo *CompilerContext::createClass(std::string name, TypeHandle typeId, std::vector<std::string> properties)
 	{
-		return _classes.createClass(name, typeId, std::move(properties));
+		return _shared->classes.createClass(name, typeId, std::move(properties));
 	}
 
 	void CompilerContext::enterScope()
@@ -226,6 +295,7 @@ namespace sharpsenLang
 	{
 		std::unique_ptr<ParamLookup> params = std::make_unique<ParamLookup>();
 		_params = params.get();
+		_frameSize = 0;
 		_locals = std::move(params);
 	}
 
@@ -241,7 +311,101 @@ namespace sharpsenLang
 
 	bool CompilerContext::canDeclare(const std::string &name) const
 	{
-		return _locals ? _locals->canDeclare(name) : (_globals.canDeclare(name) && _functions.canDeclare(name) && _classes.canDeclare(name));
+		return _locals ? _locals->canDeclare(name) : (_shared->globals.canDeclare(name) && _shared->functions.canDeclare(name) && _shared->classes.canDeclare(name));
+	}
+
+	void CompilerContext::addFunctionBody(size_t functionIndex, std::shared_ptr<const FunctionBody> body)
+	{
+		_shared->functionBodies.emplace(functionIndex, std::move(body));
+	}
+
+	const FunctionBody *CompilerContext::findFunctionBody(size_t functionIndex) const
+	{
+		auto it = _shared->functionBodies.find(functionIndex);
+		return it == _shared->functionBodies.end() ? nullptr : it->second.get();
+	}
+
+	const FunctionBody *CompilerContext::findInlineFunction(size_t functionIndex) const
+	{
+		const FunctionBody *body = findFunctionBody(functionIndex);
+		if (!body || !body->inlinable ||
+			std::find(_inlining.begin(), _inlining.end(), functionIndex) != _inlining.end())
+		{
+			return nullptr;
+		}
+		return body;
+	}
+
+	bool CompilerContext::isInlining() const
+	{
+		return !_inlining.empty();
+	}
+
+	void CompilerContext::enterLoop(LoopWrites &writes)
+	{
+		_loops.push_back(&writes);
+	}
+
+	void CompilerContext::leaveLoop()
+	{
+		_loops.pop_back();
+	}
+
+	const std::vector<LoopWrites *> &CompilerContext::loops() const
+	{
+		return _loops;
+	}
+
+	void CompilerContext::enterIndexRange(IndexRange &range)
+	{
+		_indexRanges.push_back(&range);
+	}
+
+	void CompilerContext::leaveIndexRange()
+	{
+		_indexRanges.pop_back();
+	}
+
+	std::shared_ptr<const bool> CompilerContext::findIndexRange(const IdentifierInfo *counter, const IdentifierInfo *array)
+	{
+		if (!counter || !array)
+		{
+			return nullptr;
+		}
+		for (IndexRange *range : _indexRanges)
+		{
+			if (range->counter == counter && range->array == array)
+			{
+				++range->indexes;
+				return range->checked;
+			}
+		}
+		return nullptr;
+	}
+
+	void CompilerContext::setSpecializations(const std::shared_ptr<Specializations> &specializations)
+	{
+		_shared->specializations = specializations;
+	}
+
+	const Function *CompilerContext::specialize(size_t functionIndex, const Specializations::Bindings &bindings)
+	{
+		std::shared_ptr<Specializations> specializations = _shared->specializations.lock();
+		const FunctionBody *body = findFunctionBody(functionIndex);
+		if (!specializations || !body)
+		{
+			return nullptr;
+		}
+
+		// Bodies are compiled on first call, so recursive calls inside them find
+		// the specialization being compiled instead of making it again. A body
+		// that doesn't compile with the bindings runs the function itself.
+		auto create = [&]()
+		{
+			return createLazyFunction(fork(), IncompleteFunction(*body, bindings), createUnspecializedCall(functionIndex, bindings));
+		};
+
+		return &specializations->get(functionIndex, bindings, create);
 	}
 
 	CompilerContext::ScopeRaii CompilerContext::scope()
@@ -254,6 +418,11 @@ namespace sharpsenLang
 		return FunctionRaii(*this);
 	}
 
+	CompilerContext::InlineRaii CompilerContext::inlineFunction(size_t functionIndex)
+	{
+		return InlineRaii(*this, functionIndex);
+	}
+
 	CompilerContext::ScopeRaii::ScopeRaii(CompilerContext &context)
 		: _context(context)
 	{
@@ -275,4 +444,22 @@ namespace sharpsenLang
 	{
 		_context.leaveScope();
 	}
+
+	CompilerContext::InlineRaii::InlineRaii(CompilerContext &context, size_t functionIndex)
+		: _context(context),
+		  _params(context._params),
+		  _locals(std::move(context._locals)),
+		  _frameSize(context._frameSize)
+	{
+		_context._inlining.push_back(functionIndex);
+		_context.enterFunction();
+	}
+
+	CompilerContext::InlineRaii::~InlineRaii()
+	{
+		_context._inlining.pop_back();
+		_context._params = _params;
+		_context._locals = std::move(_locals);
+		_context._frameSize = _frameSize;
+	}
 }
@@ -1,6 +1,6 @@
 #include <sstream>
 
-#include "errors.hpp"
+#include "Errors.hpp"
 
 namespace sharpsenLang
 {
@@ -1,13 +1,19 @@
+#include <cmath>
 #include <type_traits>
 
 #include "Expression.hpp"
 #include "ExpressionTree.hpp"
 #include "ExpressionTreeParser.hpp"
+#include "ExpressionTreeOptimizer.hpp"
 #include "Helpers.hpp"
 #include "Errors.hpp"
 #include "RuntimeContext.hpp"
 #include "Tokenizer.hpp"
 #include "CompilerContext.hpp"
+#include "Bytecode.hpp"
+#include "Compiler.hpp"
+#include "IncompleteFunction.hpp"
+#include "LoopOptimizer.hpp"
 
 namespace sharpsenLang
 {
@@ -20,34 +26,46 @@ namespace sharpsenLang
 		};
 
 		template <typename T>
-		struct IsBoxed<std::shared_ptr<VariableImpl<T>>, T>
+		struct IsBoxed<VariableRef<VariableImpl<T>>, T>
 		{
 			static const bool value = true;
 		};
 
 		template <typename T>
-		struct RemoveCvref
+		struct IsVariableRef
 		{
-			using type = typename std::remove_cv<typename std::remove_reference<T>::type>::type;
+			static const bool value = false;
+		};
+
+		template <typename T>
+		struct IsVariableRef<VariableRef<T>>
+		{
+			static const bool value = true;
+		};
+
+		// Number and int variables converted to the other type's value.
+		template <class V, typename T>
+		struct IsBoxedNumeric
+		{
+			static const bool value =
+				(std::is_same<V, Lnumber>::value || std::is_same<V, Linteger>::value) &&
+				(std::is_same<T, Number>::value || std::is_same<T, Integer>::value);
 		};
 
 		template <typename T>
 		auto unbox(T &&t)
 		{
-			if constexpr (std::is_same<typename RemoveCvref<T>::type, Larray>::value)
-			{
-				return cloneVariableValue(t->value);
-			}
-			else
-			{
-				return t->value;
-			}
+			return t->value;
 		}
 
 		template <typename To, typename From>
 		auto convert(From &&from)
 		{
-			if constexpr (std::is_convertible<From, To>::value)
+			if constexpr (std::is_same<To, Integer>::value && std::is_same<std::decay_t<From>, Number>::value)
+			{
+				return convertToInteger(from);
+			}
+			else if constexpr (std::is_convertible<From, To>::value)
 			{
 				return std::forward<From>(from);
 			}
@@ -55,6 +73,14 @@ namespace sharpsenLang
 			{
 				return unbox(std::forward<From>(from));
 			}
+			else if constexpr (IsBoxedNumeric<std::decay_t<From>, To>::value)
+			{
+				return convert<To>(unbox(std::forward<From>(from)));
+			}
+			else if constexpr (std::is_same<To, String>::value && std::is_arithmetic<std::decay_t<From>>::value && !std::is_same<std::decay_t<From>, Integer>::value)
+			{
+				return convertToString(Number(from));
+			}
 			else if constexpr (std::is_same<To, String>::value)
 			{
 				return convertToString(from);
@@ -71,9 +97,12 @@ namespace sharpsenLang
 			static const bool value =
 				std::is_convertible<From, To>::value ||
 				IsBoxed<From, To>::value ||
+				IsBoxedNumeric<From, To>::value ||
 				(std::is_same<To, String>::value &&
 				 (std::is_same<From, Number>::value ||
-				  std::is_same<From, Lnumber>::value)) ||
+				  std::is_same<From, Lnumber>::value ||
+				  std::is_same<From, Integer>::value ||
+				  std::is_same<From, Linteger>::value)) ||
 				std::is_void<To>::value;
 		};
 
@@ -82,11 +111,326 @@ namespace sharpsenLang
 			return n1 < n2;
 		}
 
+		Number lt(Integer i1, Integer i2)
+		{
+			return i1 < i2;
+		}
+
+		// Arithmetic shared by numbers and ints. Numbers go through int for the
+		// integer operations, while ints use the native 64-bit instructions and
+		// wrap around on overflow.
+		Number add(Number n1, Number n2)
+		{
+			return n1 + n2;
+		}
+
+		Integer add(Integer i1, Integer i2)
+		{
+			return Integer(uint64_t(i1) + uint64_t(i2));
+		}
+
+		Number sub(Number n1, Number n2)
+		{
+			return n1 - n2;
+		}
+
+		Integer sub(Integer i1, Integer i2)
+		{
+			return Integer(uint64_t(i1) - uint64_t(i2));
+		}
+
+		Number mul(Number n1, Number n2)
+		{
+			return n1 * n2;
+		}
+
+		Integer mul(Integer i1, Integer i2)
+		{
+			return Integer(uint64_t(i1) * uint64_t(i2));
+		}
+
+		Number idiv(Number n1, Number n2)
+		{
+			return int(n1 / n2);
+		}
+
+		Integer idiv(Integer i1, Integer i2)
+		{
+			runtimeAssertion(i2 != 0, "Integer division by zero");
+			return i2 == -1 ? sub(Integer(0), i1) : i1 / i2;
+		}
+
+		Number mod(Number n1, Number n2)
+		{
+			return n1 - n2 * int(n1 / n2);
+		}
+
+		Integer mod(Integer i1, Integer i2)
+		{
+			runtimeAssertion(i2 != 0, "Integer division by zero");
+			return i2 == -1 ? 0 : i1 % i2;
+		}
+
+		Number band(Number n1, Number n2)
+		{
+			return int(n1) & int(n2);
+		}
+
+		Integer band(Integer i1, Integer i2)
+		{
+			return i1 & i2;
+		}
+
+		Number bor(Number n1, Number n2)
+		{
+			return int(n1) | int(n2);
+		}
+
+		Integer bor(Integer i1, Integer i2)
+		{
+			return i1 | i2;
+		}
+
+		Number bxor(Number n1, Number n2)
+		{
+			return int(n1) ^ int(n2);
+		}
+
+		Integer bxor(Integer i1, Integer i2)
+		{
+			return i1 ^ i2;
+		}
+
+		// Shift counts of ints are taken modulo 64.
+		Number bsl(Number n1, Number n2)
+		{
+			return int(n1) << int(n2);
+		}
+
+		Integer bsl(Integer i1, Integer i2)
+		{
+			return Integer(uint64_t(i1) << (i2 & 63));
+		}
+
+		Number bsr(Number n1, Number n2)
+		{
+			return int(n1) >> int(n2);
+		}
+
+		Integer bsr(Integer i1, Integer i2)
+		{
+			return i1 >> (i2 & 63);
+		}
+
+		Number negative(Number n)
+		{
+			return -n;
+		}
+
+		Integer negative(Integer i)
+		{
+			return sub(Integer(0), i);
+		}
+
+		Number bnot(Number n)
+		{
+			return ~int(n);
+		}
+
+		Integer bnot(Integer i)
+		{
+			return ~i;
+		}
+
+		Number inc(Number n)
+		{
+			return n + 1;
+		}
+
+		Integer inc(Integer i)
+		{
+			return add(i, Integer(1));
+		}
+
+		Number dec(Number n)
+		{
+			return n - 1;
+		}
+
+		Integer dec(Integer i)
+		{
+			return sub(i, Integer(1));
+		}
+
 		Number lt(String s1, String s2)
 		{
 			return *s1 < *s2;
 		}
 
+		// Registers hold numbers or ints. Lowered<T>::Type is the one a value or
+		// location of type T is kept in, or void if T isn't lowered to registers.
+		template <typename T>
+		struct Lowered
+		{
+			using Type = void;
+			static constexpr bool location = false;
+		};
+
+		template <>
+		struct Lowered<Number>
+		{
+			using Type = Number;
+			static constexpr bool location = false;
+		};
+
+		template <>
+		struct Lowered<Integer>
+		{
+			using Type = Integer;
+			static constexpr bool location = false;
+		};
+
+		template <>
+		struct Lowered<Lnumber>
+		{
+			using Type = Number;
+			static constexpr bool location = true;
+		};
+
+		template <>
+		struct Lowered<Linteger>
+		{
+			using Type = Integer;
+			static constexpr bool location = true;
+		};
+
+		template <typename V>
+		Operand lowerValue(BytecodeBuilder &builder, const Expression<V> &expr)
+		{
+			if constexpr (std::is_same<V, Integer>::value)
+			{
+				return builder.lowerInteger(expr);
+			}
+			else
+			{
+				return builder.lowerNumber(expr);
+			}
+		}
+
+		template <typename L>
+		Operand lowerLocation(BytecodeBuilder &builder, const Expression<L> &expr)
+		{
+			if constexpr (std::is_same<L, Linteger>::value)
+			{
+				return builder.lowerLinteger(expr);
+			}
+			else
+			{
+				return builder.lowerLnumber(expr);
+			}
+		}
+
+		template <typename V>
+		Operand loadValue(BytecodeBuilder &builder, Operand location)
+		{
+			if constexpr (std::is_same<V, Integer>::value)
+			{
+				return builder.loadInteger(location);
+			}
+			else
+			{
+				return builder.load(location);
+			}
+		}
+
+		// Returns the register holding the stored value.
+		template <typename V>
+		Operand storeValue(BytecodeBuilder &builder, Operand location, Operand value)
+		{
+			if constexpr (std::is_same<V, Integer>::value)
+			{
+				return builder.storeInteger(location, value);
+			}
+			else
+			{
+				return builder.store(location, value);
+			}
+		}
+
+		template <typename V>
+		Operand allocateRegister(BytecodeBuilder &builder)
+		{
+			if constexpr (std::is_same<V, Integer>::value)
+			{
+				return builder.allocateIntegerRegister();
+			}
+			else
+			{
+				return builder.allocateRegister();
+			}
+		}
+
+		template <typename V>
+		Operand lowerOne(BytecodeBuilder &builder)
+		{
+			if constexpr (std::is_same<V, Integer>::value)
+			{
+				return builder.integerConstant(1);
+			}
+			else
+			{
+				return builder.constant(1);
+			}
+		}
+
+		// Converts a register holding a From to the To an expression yields, like
+		// convert does. Registers of void expressions are left as they are.
+		template <typename To, typename From>
+		Operand lowerConversion(BytecodeBuilder &builder, Operand value)
+		{
+			if constexpr (std::is_same<To, Number>::value && std::is_same<From, Integer>::value)
+			{
+				Operand ret = builder.allocateRegister();
+				builder.emit(OpCode::IntegerToNumber, ret.index, value.index);
+				return ret;
+			}
+			else if constexpr (std::is_same<To, Integer>::value && std::is_same<From, Number>::value)
+			{
+				Operand ret = builder.allocateIntegerRegister();
+				builder.emit(OpCode::NumberToInteger, ret.index, value.index);
+				return ret;
+			}
+			else
+			{
+				return value;
+			}
+		}
+
+		template <typename R, typename T>
+		bool lowerVariable(BytecodeBuilder &builder, Operand location, Operand &result)
+		{
+			if constexpr (
+				Lowered<T>::location && !std::is_void<typename Lowered<R>::Type>::value && !Lowered<R>::location)
+			{
+				using V = typename Lowered<T>::Type;
+				result = lowerConversion<R, V>(builder, loadValue<V>(builder, location));
+				return true;
+			}
+			else if constexpr (
+				(std::is_same<R, Lnumber>::value && std::is_same<T, Lnumber>::value) ||
+				(std::is_same<R, Linteger>::value && std::is_same<T, Linteger>::value) ||
+				(std::is_same<R, Function>::value && std::is_same<T, Lfunction>::value) ||
+				std::is_same<R, Lvalue>::value)
+			{
+				result = location;
+				return true;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
 		template <typename R, typename T>
 		class GlobalVariableExpression : public Expression<R>
 		{
@@ -103,6 +447,11 @@ namespace sharpsenLang
 			{
 				return convert<R>(context.global(_idx)->template staticPointerDowncast<T>());
 			}
+
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
+			{
+				return lowerVariable<R, T>(builder, Operand::global(_idx), result);
+			}
 		};
 
 		template <typename R, typename T>
@@ -119,7 +468,24 @@ namespace sharpsenLang
 
 			R evaluate(RuntimeContext &context) const override
 			{
-				return convert<R>(context.local(_idx)->template staticPointerDowncast<T>());
+				if constexpr (std::is_same<T, Lnumber>::value && (std::is_same<R, Number>::value || std::is_same<R, Integer>::value))
+				{
+					// Inlined calls pass numbers unboxed.
+					return convert<R>(context.localValue(_idx).toNumber());
+				}
+				else if constexpr (std::is_same<T, Linteger>::value && (std::is_same<R, Number>::value || std::is_same<R, Integer>::value))
+				{
+					return convert<R>(context.localValue(_idx).toInteger());
+				}
+				else
+				{
+					return convert<R>(context.local(_idx)->template staticPointerDowncast<T>());
+				}
+			}
+
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
+			{
+				return lowerVariable<R, T>(builder, Operand::local(_idx), result);
 			}
 		};
 
@@ -135,47 +501,122 @@ namespace sharpsenLang
 			{
 			}
 
+			int index() const
+			{
+				return _idx;
+			}
+
 			R evaluate(RuntimeContext &context) const override
 			{
 				return convert<R>(context.getFunction(_idx));
 			}
+
+			bool lower([[maybe_unused]] BytecodeBuilder &builder, [[maybe_unused]] Operand &result) const override
+			{
+				if constexpr (std::is_same<R, Function>::value)
+				{
+					result = Operand::function(_idx);
+					return true;
+				}
+				else
+				{
+					return false;
+				}
+			}
 		};
 
 		template <typename R, typename T>
 		class ConstantExpression : public Expression<R>
 		{
 		private:
-			T _c;
+			// Converted once here rather than on every evaluation.
+			using ValueType = std::conditional_t<std::is_void<R>::value, T, R>;
+
+			ValueType _c;
+
+			static ValueType convertConstant(T c)
+			{
+				if constexpr (std::is_void<R>::value)
+				{
+					return c;
+				}
+				else
+				{
+					return convert<R>(std::move(c));
+				}
+			}
 
 		public:
 			ConstantExpression(T c)
-				: _c(std::move(c))
+				: _c(convertConstant(std::move(c)))
 			{
 			}
 
 			R evaluate(RuntimeContext &context) const override
 			{
-				return convert<R>(_c);
+				if constexpr (!std::is_void<R>::value)
+				{
+					return _c;
+				}
+			}
+
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
+			{
+				if constexpr (std::is_same<R, Number>::value && std::is_same<T, Number>::value)
+				{
+					result = builder.constant(_c);
+					return true;
+				}
+				else if constexpr (std::is_same<R, Integer>::value)
+				{
+					result = builder.integerConstant(_c);
+					return true;
+				}
+				else
+				{
+					return false;
+				}
 			}
 		};
 
+		enum struct LoweringKind
+		{
+			None,
+			Positive,
+			Unary,
+			Binary,
+			Assign,
+			CompoundAssign,
+			PreIncrement,
+			PostIncrement,
+		};
+
+		// The instructions an operation lowers to. Operations that also take ints
+		// have an integerCode for them.
+		template <class O>
+		struct Lowering
+		{
+			static constexpr LoweringKind kind = LoweringKind::None;
+			static constexpr OpCode code = OpCode::Move;
+			static constexpr bool integer = false;
+			static constexpr OpCode integerCode = OpCode::Move;
+		};
+
 		template <class O, typename R, typename... Ts>
 		class GenericExpression : public Expression<R>
 		{
 		private:
 			std::tuple<typename Expression<Ts>::Ptr...> _exprs;
 
-			template <typename... Exprs>
-			R evaluateTuple(RuntimeContext &context, const Exprs &...exprs) const
+			static R apply(std::tuple<Ts...> &&values)
 			{
 				if constexpr (std::is_same<R, void>::value)
 				{
-					O()
-					(std::move(exprs->evaluate(context))...);
+					std::apply(O(), std::move(values));
 				}
 				else
 				{
-					return convert<R>(O()(std::move(exprs->evaluate(context))...));
+					return convert<R>(std::apply(O(), std::move(values)));
 				}
 			}
 
@@ -185,15 +626,130 @@ namespace sharpsenLang
 			{
 			}
 
+			// Operands are evaluated left to right, in the order the bytecode
+			// lowering below evaluates them.
 			R evaluate(RuntimeContext &context) const override
 			{
 				return std::apply(
 					[&](const auto &...exprs)
 					{
-						return this->evaluateTuple(context, exprs...);
+						return apply(std::tuple<Ts...>{exprs->evaluate(context)...});
 					},
 					_exprs);
 			}
+
+			// Lowers ops on numbers, and ops on ints that have int instructions.
+			// The result is converted to the type the expression yields.
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
+			{
+				using Types = std::tuple<Ts...>;
+				using T1 = std::tuple_element_t<0, Types>;
+				using V = typename Lowered<T1>::Type;
+				constexpr LoweringKind kind = Lowering<O>::kind;
+				constexpr bool lowered =
+					std::is_same<V, Number>::value || (std::is_same<V, Integer>::value && Lowering<O>::integer);
+				constexpr OpCode code = std::is_same<V, Integer>::value ? Lowering<O>::integerCode : Lowering<O>::code;
+				constexpr bool valueResult =
+					std::is_void<R>::value || (!std::is_void<typename Lowered<R>::Type>::value && !Lowered<R>::location);
+				constexpr bool locationResult = Lowered<R>::location && std::is_same<typename Lowered<R>::Type, V>::value;
+
+				if constexpr (!lowered)
+				{
+					return false;
+				}
+				else if constexpr (kind == LoweringKind::Positive && valueResult && std::is_same<Types, std::tuple<V>>::value)
+				{
+					result = lowerConversion<R, V>(builder, lowerValue(builder, *std::get<0>(_exprs)));
+					return true;
+				}
+				else if constexpr (kind == LoweringKind::Unary && valueResult && std::is_same<Types, std::tuple<V>>::value)
+				{
+					Operand value = lowerValue(builder, *std::get<0>(_exprs));
+					result = allocateRegister<V>(builder);
+					builder.emit(code, result.index, value.index);
+					result = lowerConversion<R, V>(builder, result);
+					return true;
+				}
+				else if constexpr (kind == LoweringKind::Binary && valueResult && std::is_same<Types, std::tuple<V, V>>::value)
+				{
+					// Comparisons of ints yield numbers.
+					using W = typename Lowered<decltype(std::apply(O(), std::declval<Types>()))>::Type;
+					Operand value1 = lowerValue(builder, *std::get<0>(_exprs));
+					BytecodeBuilder::Mark m = builder.mark();
+					Operand value2 = lowerValue(builder, *std::get<1>(_exprs));
+					if constexpr (std::is_same<V, Number>::value)
+					{
+						// A local read in place is copied if the second operand may change it.
+						if (builder.mayWrite(m, value1))
+						{
+							builder.rollback(m);
+							value1 = builder.copy(value1);
+							value2 = lowerValue(builder, *std::get<1>(_exprs));
+						}
+					}
+					result = allocateRegister<W>(builder);
+					builder.emit(code, result.index, value1.index, value2.index);
+					result = lowerConversion<R, W>(builder, result);
+					return true;
+				}
+				else if constexpr (
+					(kind == LoweringKind::Assign || kind == LoweringKind::CompoundAssign) &&
+					(valueResult || locationResult) && Lowered<T1>::location && std::is_same<Types, std::tuple<T1, V>>::value)
+				{
+					Operand location = lowerLocation(builder, *std::get<0>(_exprs));
+					if (location.kind == OperandKind::None)
+					{
+						return false;
+					}
+					Operand value = lowerValue(builder, *std::get<1>(_exprs));
+					if constexpr (kind == LoweringKind::CompoundAssign)
+					{
+						Operand current = loadValue<V>(builder, location);
+						Operand updated = allocateRegister<V>(builder);
+						builder.emit(code, updated.index, current.index, value.index);
+						value = updated;
+					}
+					value = storeValue<V>(builder, location, value);
+					result = locationResult ? location : lowerConversion<R, V>(builder, value);
+					return true;
+				}
+				else if constexpr (
+					(kind == LoweringKind::PreIncrement || kind == LoweringKind::PostIncrement) &&
+					(valueResult || locationResult) && Lowered<T1>::location && std::is_same<Types, std::tuple<T1>>::value)
+				{
+					Operand location = lowerLocation(builder, *std::get<0>(_exprs));
+					if (location.kind == OperandKind::None)
+					{
+						return false;
+					}
+					Operand current = loadValue<V>(builder, location);
+					if constexpr (kind == LoweringKind::PostIncrement && std::is_same<V, Number>::value && !std::is_void<R>::value)
+					{
+						// The old value of a local read in place.
+						if (location.kind == OperandKind::Local)
+						{
+							current = builder.copy(current);
+						}
+					}
+					Operand one = lowerOne<V>(builder);
+					Operand updated = allocateRegister<V>(builder);
+					builder.emit(code, updated.index, current.index, one.index);
+					updated = storeValue<V>(builder, location, updated);
+					if constexpr (kind == LoweringKind::PostIncrement)
+					{
+						result = lowerConversion<R, V>(builder, current);
+					}
+					else
+					{
+						result = locationResult ? location : lowerConversion<R, V>(builder, updated);
+					}
+					return true;
+				}
+				else
+				{
+					return false;
+				}
+			}
 		};
 
 #define UNARY_EXPRESSION(name, code)   \
@@ -209,22 +765,28 @@ namespace sharpsenLang
 	using name##Expression = GenericExpression<name##Op, R, T1>;
 
 		UNARY_EXPRESSION(Preinc,
-						 ++t1->value;
+						 t1->value = inc(t1->value);
 						 return t1;);
 
 		UNARY_EXPRESSION(Predec,
-						 --t1->value;
+						 t1->value = dec(t1->value);
 						 return t1;);
 
-		UNARY_EXPRESSION(Postinc, return t1->value++);
+		UNARY_EXPRESSION(Postinc,
+						 auto old = t1->value;
+						 t1->value = inc(old);
+						 return old;);
 
-		UNARY_EXPRESSION(Postdec, return t1->value--);
+		UNARY_EXPRESSION(Postdec,
+						 auto old = t1->value;
+						 t1->value = dec(old);
+						 return old;);
 
 		UNARY_EXPRESSION(Positive, return t1);
 
-		UNARY_EXPRESSION(Negative, return -t1);
+		UNARY_EXPRESSION(Negative, return negative(t1));
 
-		UNARY_EXPRESSION(Bnot, return ~int(t1));
+		UNARY_EXPRESSION(Bnot, return bnot(t1));
 
 		UNARY_EXPRESSION(Lnot, return !t1);
 
@@ -234,6 +796,8 @@ namespace sharpsenLang
 		UNARY_EXPRESSION(ToString,
 						 return convertToString(t1););
 
+		UNARY_EXPRESSION(ToInt, return t1);
+
 #undef UNARY_EXPRESSION
 
 #define BINARY_EXPRESSION(name, code)               \
@@ -248,73 +812,80 @@ namespace sharpsenLang
 	template <typename R, typename T1, typename T2> \
 	using name##Expression = GenericExpression<name##Op, R, T1, T2>;
 
-		BINARY_EXPRESSION(Add, return t1 + t2);
+		BINARY_EXPRESSION(Add, return add(t1, t2));
 
-		BINARY_EXPRESSION(Sub, return t1 - t2);
+		BINARY_EXPRESSION(Sub, return sub(t1, t2));
 
-		BINARY_EXPRESSION(Mul, return t1 * t2);
+		BINARY_EXPRESSION(Mul, return mul(t1, t2));
 
 		BINARY_EXPRESSION(Div, return t1 / t2);
 
-		BINARY_EXPRESSION(Idiv, return int(t1 / t2));
+		BINARY_EXPRESSION(Idiv, return idiv(t1, t2));
 
-		BINARY_EXPRESSION(Mod, return t1 - t2 * int(t1 / t2));
+		BINARY_EXPRESSION(Mod, return mod(t1, t2));
 
-		BINARY_EXPRESSION(Band, return int(t1) & int(t2));
+		BINARY_EXPRESSION(Band, return band(t1, t2));
 
-		BINARY_EXPRESSION(Bor, return int(t1) | int(t2));
+		BINARY_EXPRESSION(Bor, return bor(t1, t2));
 
-		BINARY_EXPRESSION(Bxor, return int(t1) ^ int(t2));
+		BINARY_EXPRESSION(Bxor, return bxor(t1, t2));
 
-		BINARY_EXPRESSION(Bsl, return int(t1) << int(t2));
+		BINARY_EXPRESSION(Bsl, return bsl(t1, t2));
 
-		BINARY_EXPRESSION(Bsr, return int(t1) >> int(t2));
+		BINARY_EXPRESSION(Bsr, return bsr(t1, t2));
 
 		BINARY_EXPRESSION(Concat, return std::make_shared<std::string>(*t1 + *t2));
 
 		BINARY_EXPRESSION(AddAssign,
-						  t1->value += t2;
+						  t1->value = add(t1->value, t2);
 						  return t1;);
 
 		BINARY_EXPRESSION(SubAssign,
-						  t1->value -= t2;
+						  t1->value = sub(t1->value, t2);
 						  return t1;);
 
 		BINARY_EXPRESSION(MulAssign,
-						  t1->value *= t2;
+						  t1->value = mul(t1->value, t2);
 						  return t1;);
 
+		// An int divided in place keeps the integer part of the quotient.
 		BINARY_EXPRESSION(DivAssign,
-						  t1->value /= t2;
+						  if constexpr (std::is_same<decltype(t2), Integer>::value)
+						  {
+							  t1->value = idiv(t1->value, t2);
+						  }
+						  else
+						  {
+							  t1->value /= t2;
+						  }
 						  return t1;);
 
 		BINARY_EXPRESSION(IdivAssign,
-						  t1->value = int(t1->value / t2);
+						  t1->value = idiv(t1->value, t2);
 						  return t1;);
 
 		BINARY_EXPRESSION(ModAssign,
-						  t1->value = t1->value - t2 * int(t1->value / t2);
-						  ;
+						  t1->value = mod(t1->value, t2);
 						  return t1;);
 
 		BINARY_EXPRESSION(BandAssign,
-						  t1->value = int(t1->value) & int(t2);
+						  t1->value = band(t1->value, t2);
 						  return t1;);
 
 		BINARY_EXPRESSION(BorAssign,
-						  t1->value = int(t1->value) | int(t2);
+						  t1->value = bor(t1->value, t2);
 						  return t1;);
 
 		BINARY_EXPRESSION(BxorAssign,
-						  t1->value = int(t1->value) ^ int(t2);
+						  t1->value = bxor(t1->value, t2);
 						  return t1;);
 
 		BINARY_EXPRESSION(BslAssign,
-						  t1->value = int(t1->value) << int(t2);
+						  t1->value = bsl(t1->value, t2);
 						  return t1;);
 
 		BINARY_EXPRESSION(BsrAssign,
-						  t1->value = int(t1->value) >> int(t2);
+						  t1->value = bsr(t1->value, t2);
 						  return t1;);
 
 		BINARY_EXPRESSION(ConcatAssign,
@@ -339,6 +910,349 @@ namespace sharpsenLang
 
 #undef BINARY_EXPRESSION
 
+#define EXPRESSION_LOWERING(name, loweringKind, opCode)                  \
+	template <>                                                          \
+	struct Lowering<name##Op>                                            \
+	{                                                                    \
+		static constexpr LoweringKind kind = LoweringKind::loweringKind; \
+		static constexpr OpCode code = OpCode::opCode;                   \
+		static constexpr bool integer = false;                           \
+		static constexpr OpCode integerCode = OpCode::Move;              \
+	};
+
+#define INTEGER_EXPRESSION_LOWERING(name, loweringKind, opCode, integerOpCode) \
+	template <>                                                                \
+	struct Lowering<name##Op>                                                  \
+	{                                                                          \
+		static constexpr LoweringKind kind = LoweringKind::loweringKind;       \
+		static constexpr OpCode code = OpCode::opCode;                         \
+		static constexpr bool integer = true;                                  \
+		static constexpr OpCode integerCode = OpCode::integerOpCode;           \
+	};
+
+		INTEGER_EXPRESSION_LOWERING(Preinc, PreIncrement, Add, AddInteger);
+		INTEGER_EXPRESSION_LOWERING(Predec, PreIncrement, Sub, SubInteger);
+		INTEGER_EXPRESSION_LOWERING(Postinc, PostIncrement, Add, AddInteger);
+		INTEGER_EXPRESSION_LOWERING(Postdec, PostIncrement, Sub, SubInteger);
+		INTEGER_EXPRESSION_LOWERING(Positive, Positive, Move, Move);
+		INTEGER_EXPRESSION_LOWERING(ToInt, Positive, Move, Move);
+		INTEGER_EXPRESSION_LOWERING(Negative, Unary, Negative, NegativeInteger);
+		INTEGER_EXPRESSION_LOWERING(Bnot, Unary, Bnot, BnotInteger);
+		EXPRESSION_LOWERING(Lnot, Unary, Lnot);
+		INTEGER_EXPRESSION_LOWERING(Add, Binary, Add, AddInteger);
+		INTEGER_EXPRESSION_LOWERING(Sub, Binary, Sub, SubInteger);
+		INTEGER_EXPRESSION_LOWERING(Mul, Binary, Mul, MulInteger);
+		EXPRESSION_LOWERING(Div, Binary, Div);
+		INTEGER_EXPRESSION_LOWERING(Idiv, Binary, Idiv, IdivInteger);
+		INTEGER_EXPRESSION_LOWERING(Mod, Binary, Mod, ModInteger);
+		INTEGER_EXPRESSION_LOWERING(Band, Binary, Band, BandInteger);
+		INTEGER_EXPRESSION_LOWERING(Bor, Binary, Bor, BorInteger);
+		INTEGER_EXPRESSION_LOWERING(Bxor, Binary, Bxor, BxorInteger);
+		INTEGER_EXPRESSION_LOWERING(Bsl, Binary, Bsl, BslInteger);
+		INTEGER_EXPRESSION_LOWERING(Bsr, Binary, Bsr, BsrInteger);
+		INTEGER_EXPRESSION_LOWERING(Eq, Binary, Eq, EqInteger);
+		INTEGER_EXPRESSION_LOWERING(Ne, Binary, Ne, NeInteger);
+		INTEGER_EXPRESSION_LOWERING(Lt, Binary, Lt, LtInteger);
+		INTEGER_EXPRESSION_LOWERING(Gt, Binary, Gt, GtInteger);
+		INTEGER_EXPRESSION_LOWERING(Le, Binary, Le, LeInteger);
+		INTEGER_EXPRESSION_LOWERING(Ge, Binary, Ge, GeInteger);
+		INTEGER_EXPRESSION_LOWERING(Assign, Assign, Move, Move);
+		INTEGER_EXPRESSION_LOWERING(AddAssign, CompoundAssign, Add, AddInteger);
+		INTEGER_EXPRESSION_LOWERING(SubAssign, CompoundAssign, Sub, SubInteger);
+		INTEGER_EXPRESSION_LOWERING(MulAssign, CompoundAssign, Mul, MulInteger);
+		// An int divided in place keeps the integer part of the quotient.
+		INTEGER_EXPRESSION_LOWERING(DivAssign, CompoundAssign, Div, IdivInteger);
+		INTEGER_EXPRESSION_LOWERING(IdivAssign, CompoundAssign, Idiv, IdivInteger);
+		INTEGER_EXPRESSION_LOWERING(ModAssign, CompoundAssign, Mod, ModInteger);
+		INTEGER_EXPRESSION_LOWERING(BandAssign, CompoundAssign, Band, BandInteger);
+		INTEGER_EXPRESSION_LOWERING(BorAssign, CompoundAssign, Bor, BorInteger);
+		INTEGER_EXPRESSION_LOWERING(BxorAssign, CompoundAssign, Bxor, BxorInteger);
+		INTEGER_EXPRESSION_LOWERING(BslAssign, CompoundAssign, Bsl, BslInteger);
+		INTEGER_EXPRESSION_LOWERING(BsrAssign, CompoundAssign, Bsr, BsrInteger);
+
+#undef INTEGER_EXPRESSION_LOWERING
+#undef EXPRESSION_LOWERING
+
+		// Instructions updating a local in place when the result is unused. A step
+		// updates it by one.
+		template <class O>
+		struct UpdateLowering
+		{
+			static constexpr bool lowered = false;
+			static constexpr OpCode step = OpCode::Move;
+			static constexpr OpCode integerStep = OpCode::Move;
+			static constexpr OpCode integerCode = OpCode::Move;
+		};
+
+		template <>
+		struct UpdateLowering<AddOp>
+		{
+			static constexpr bool lowered = true;
+			static constexpr OpCode step = OpCode::IncrementLocal;
+			static constexpr OpCode integerStep = OpCode::IncrementLocalInteger;
+			static constexpr OpCode integerCode = OpCode::AddLocalInteger;
+		};
+
+		template <>
+		struct UpdateLowering<SubOp>
+		{
+			static constexpr bool lowered = true;
+			static constexpr OpCode step = OpCode::DecrementLocal;
+			static constexpr OpCode integerStep = OpCode::DecrementLocalInteger;
+			static constexpr OpCode integerCode = OpCode::SubLocalInteger;
+		};
+
+		template <typename V>
+		V readSlot(const Value &slot)
+		{
+			if constexpr (std::is_same<V, Integer>::value)
+			{
+				return slot.toInteger();
+			}
+			else
+			{
+				return slot.toNumber();
+			}
+		}
+
+		template <typename V>
+		void writeSlot(Value &slot, V value)
+		{
+			if constexpr (std::is_same<V, Integer>::value)
+			{
+				slot.setInteger(value);
+			}
+			else
+			{
+				slot.setNumber(value);
+			}
+		}
+
+		// Updates a number or int local in its stack slot. Evaluating the local as
+		// an lvalue boxes it for good, so updates whose result is only read are
+		// built as this instead, and the local stays unboxed until a reference to
+		// it is taken. O combines the old value with the operand, which is one when
+		// there is no operand expression; a plain assignment has no O. Post updates
+		// result in the old value.
+		template <typename R, typename V, class O, bool Post = false>
+		class LocalUpdateExpression : public Expression<R>
+		{
+		private:
+			int _idx;
+			typename Expression<V>::Ptr _expr;
+
+		public:
+			LocalUpdateExpression(int idx, typename Expression<V>::Ptr expr)
+				: _idx(idx),
+				  _expr(std::move(expr))
+			{
+			}
+
+			R evaluate(RuntimeContext &context) const override
+			{
+				V operand = _expr ? _expr->evaluate(context) : V(1);
+				Value &slot = context.localValue(_idx);
+				V old = readSlot<V>(slot);
+				V updated = operand;
+				if constexpr (!std::is_void<O>::value)
+				{
+					updated = O()(old, operand);
+				}
+				writeSlot<V>(slot, updated);
+
+				if constexpr (!std::is_void<R>::value)
+				{
+					return Post ? old : updated;
+				}
+			}
+
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
+			{
+				if constexpr (std::is_void<R>::value && UpdateLowering<O>::lowered)
+				{
+					if (!_expr)
+					{
+						builder.emit(std::is_same<V, Integer>::value ? UpdateLowering<O>::integerStep : UpdateLowering<O>::step, _idx);
+						return true;
+					}
+					if constexpr (std::is_same<V, Integer>::value)
+					{
+						Operand operand = builder.lowerInteger(*_expr);
+						builder.emit(UpdateLowering<O>::integerCode, _idx, operand.index);
+						return true;
+					}
+				}
+
+				Operand location = Operand::local(_idx);
+				Operand operand = _expr ? lowerValue(builder, *_expr) : lowerOne<V>(builder);
+				Operand current;
+				Operand updated = operand;
+				if constexpr (!std::is_void<O>::value)
+				{
+					current = loadValue<V>(builder, location);
+					if constexpr (Post && std::is_same<V, Number>::value && !std::is_void<R>::value)
+					{
+						current = builder.copy(current);
+					}
+					constexpr OpCode code = std::is_same<V, Integer>::value ? Lowering<O>::integerCode : Lowering<O>::code;
+					updated = allocateRegister<V>(builder);
+					builder.emit(code, updated.index, current.index, operand.index);
+				}
+				updated = storeValue<V>(builder, location, updated);
+				result = Post ? current : updated;
+				return true;
+			}
+		};
+
+		// Operands of fused expressions, read straight from the frame instead of
+		// through a child expression.
+		struct LocalOperand
+		{
+			int idx;
+
+			Number evaluate(RuntimeContext &context) const
+			{
+				return context.localValue(idx).toNumber();
+			}
+
+			Operand lower(BytecodeBuilder &builder) const
+			{
+				return builder.load(Operand::local(idx));
+			}
+		};
+
+		struct ConstantOperand
+		{
+			Number value;
+
+			Number evaluate(RuntimeContext &) const
+			{
+				return value;
+			}
+
+			Operand lower(BytecodeBuilder &builder) const
+			{
+				return builder.constant(value);
+			}
+		};
+
+		// `a op b` where both operands are number locals or constants, such as
+		// `i < n` or `i < 10`.
+		template <typename R, class O, class A1, class A2>
+		class FusedBinaryExpression : public Expression<R>
+		{
+		private:
+			A1 _a1;
+			A2 _a2;
+
+		public:
+			FusedBinaryExpression(A1 a1, A2 a2)
+				: _a1(a1),
+				  _a2(a2)
+			{
+			}
+
+			R evaluate(RuntimeContext &context) const override
+			{
+				Number value1 = _a1.evaluate(context);
+				Number value2 = _a2.evaluate(context);
+				return R(O()(value1, value2));
+			}
+
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
+			{
+				Operand value1 = _a1.lower(builder);
+				Operand value2 = _a2.lower(builder);
+				result = builder.allocateRegister();
+				builder.emit(Lowering<O>::code, result.index, value1.index, value2.index);
+				return true;
+			}
+		};
+
+		// `x = a op b` where x is a number local and the operands are number locals
+		// or constants.
+		template <typename R, class O, class A1, class A2>
+		class FusedAssignExpression : public Expression<R>
+		{
+		private:
+			int _idx;
+			A1 _a1;
+			A2 _a2;
+
+		public:
+			FusedAssignExpression(int idx, A1 a1, A2 a2)
+				: _idx(idx),
+				  _a1(a1),
+				  _a2(a2)
+			{
+			}
+
+			R evaluate(RuntimeContext &context) const override
+			{
+				Number value1 = _a1.evaluate(context);
+				Number value2 = _a2.evaluate(context);
+				Number value = O()(value1, value2);
+				context.localValue(_idx).setNumber(value);
+				if constexpr (!std::is_void<R>::value)
+				{
+					return value;
+				}
+			}
+
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
+			{
+				Operand value1 = _a1.lower(builder);
+				Operand value2 = _a2.lower(builder);
+				result = builder.allocateRegister();
+				builder.emit(Lowering<O>::code, result.index, value1.index, value2.index);
+				result = builder.store(Operand::local(_idx), result);
+				return true;
+			}
+		};
+
+		// `a[i]` read as a number, where a is a local number array and i a number
+		// local. Unless Checked, the index is checked only if its counted loop set
+		// the flag.
+		template <bool Checked>
+		class FusedIndexExpression : public Expression<Number>
+		{
+		private:
+			int _array;
+			int _index;
+			std::shared_ptr<const bool> _checked;
+
+		public:
+			FusedIndexExpression(int array, int index, std::shared_ptr<const bool> checked = nullptr)
+				: _array(array),
+				  _index(index),
+				  _checked(std::move(checked))
+			{
+			}
+
+			Number evaluate(RuntimeContext &context) const override
+			{
+				Array &array = static_cast<VariableImpl<Array> *>(context.localValue(_array).variable())->value;
+				int idx = int(context.localValue(_index).toNumber());
+				if (Checked || *_checked)
+				{
+					runtimeAssertion(idx >= 0, "Negative index is invalid");
+					if (size_t(idx) >= array.size())
+					{
+						array.elements().resize(idx + 1, Value(Number(0)));
+					}
+				}
+				return array[idx].toNumber();
+			}
+
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
+			{
+				// The flag is final once the function is built.
+				result = builder.allocateRegister();
+				builder.emit(Checked || *_checked ? OpCode::IndexLocal : OpCode::IndexLocalInRange, result.index, _array, _index);
+				return true;
+			}
+		};
+
 		template <typename R, typename T1, typename T2>
 		class CommaExpression : public Expression<R>
 		{
@@ -366,8 +1280,67 @@ namespace sharpsenLang
 					return convert<R>(_expr2->evaluate(context));
 				}
 			}
+
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
+			{
+				if constexpr (std::is_void<T1>::value && std::is_void<R>::value && std::is_void<T2>::value)
+				{
+					builder.lowerVoid(*_expr1);
+					builder.lowerVoid(*_expr2);
+					return true;
+				}
+				else if constexpr (std::is_void<T1>::value && std::is_same<R, Number>::value && std::is_same<T2, Number>::value)
+				{
+					builder.lowerVoid(*_expr1);
+					result = builder.lowerNumber(*_expr2);
+					return true;
+				}
+				else
+				{
+					return false;
+				}
+			}
 		};
 
+		template <typename R, typename T1, typename T2>
+		bool lowerShortCircuit(
+			BytecodeBuilder &builder,
+			Operand &result,
+			const Expression<T1> &expr1,
+			const Expression<T2> &expr2,
+			bool shortCircuitValue)
+		{
+			if constexpr (
+				(std::is_void<R>::value || std::is_same<R, Number>::value) &&
+				std::is_same<T1, Number>::value && std::is_same<T2, Number>::value)
+			{
+				BytecodeBuilder::Label end = builder.createLabel();
+				result = builder.allocateRegister();
+
+				Operand value = builder.lowerNumber(expr1);
+				builder.emit(OpCode::Lnot, result.index, value.index);
+				builder.emit(OpCode::Lnot, result.index, result.index);
+				if (shortCircuitValue)
+				{
+					builder.jumpIfTrue(result, end);
+				}
+				else
+				{
+					builder.jumpIfFalse(result, end);
+				}
+
+				value = builder.lowerNumber(expr2);
+				builder.emit(OpCode::Lnot, result.index, value.index);
+				builder.emit(OpCode::Lnot, result.index, result.index);
+				builder.bindLabel(end);
+				return true;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
 		template <typename R, typename T1, typename T2>
 		class LandExpression : public Expression<R>
 		{
@@ -386,6 +1359,11 @@ namespace sharpsenLang
 			{
 				return convert<R>(_expr1->evaluate(context) && _expr2->evaluate(context));
 			}
+
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
+			{
+				return lowerShortCircuit<R, T1, T2>(builder, result, *_expr1, *_expr2, false);
+			}
 		};
 
 		template <typename R, typename T1, typename T2>
@@ -402,9 +1380,14 @@ namespace sharpsenLang
 			{
 			}
 
-			R evaluate(RuntimeContext &context) const override
+			R evaluate(RuntimeContext &context) const override
+			{
+				return convert<R>(_expr1->evaluate(context) || _expr2->evaluate(context));
+			}
+
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
 			{
-				return convert<R>(_expr1->evaluate(context) || _expr2->evaluate(context));
+				return lowerShortCircuit<R, T1, T2>(builder, result, *_expr1, *_expr2, true);
 			}
 		};
 
@@ -439,15 +1422,68 @@ namespace sharpsenLang
 						_expr1->evaluate(context) ? _expr2->evaluate(context) : _expr3->evaluate(context));
 				}
 			}
+
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
+			{
+				constexpr bool isVoid =
+					std::is_void<R>::value && std::is_void<T2>::value && std::is_void<T3>::value;
+				constexpr bool isNumber =
+					std::is_same<R, Number>::value && std::is_same<T2, Number>::value && std::is_same<T3, Number>::value;
+
+				if constexpr (std::is_same<T1, Number>::value && (isVoid || isNumber))
+				{
+					BytecodeBuilder::Label otherwise = builder.createLabel();
+					BytecodeBuilder::Label end = builder.createLabel();
+
+					if constexpr (isNumber)
+					{
+						result = builder.allocateRegister();
+					}
+
+					builder.jumpIfFalse(builder.lowerNumber(*_expr1), otherwise);
+
+					if constexpr (isNumber)
+					{
+						builder.store(result, builder.lowerNumber(*_expr2));
+					}
+					else
+					{
+						builder.lowerVoid(*_expr2);
+					}
+					builder.jump(end);
+
+					builder.bindLabel(otherwise);
+					if constexpr (isNumber)
+					{
+						builder.store(result, builder.lowerNumber(*_expr3));
+					}
+					else
+					{
+						builder.lowerVoid(*_expr3);
+					}
+					builder.bindLabel(end);
+					return true;
+				}
+				else
+				{
+					return false;
+				}
+			}
 		};
 
-		template <typename R, typename A, typename T>
+		// Unless Checked, the index is built in a counted loop and is checked only
+		// if the loop set the flag. Otherwise it stays within the array, which
+		// then never grows.
+		template <typename R, typename A, typename T, bool Checked = true>
 		class IndexExpression : public Expression<R>
 		{
 		private:
 			typename Expression<A>::Ptr _expr1;
 			Expression<Number>::Ptr _expr2;
 			Expression<Lvalue>::Ptr _init;
+			std::shared_ptr<const bool> _checked;
+
+			static constexpr bool isNumberElement = std::is_same<T, Number>::value || std::is_same<T, Lnumber>::value;
 
 			static Array &value(A &arr)
 			{
@@ -471,15 +1507,16 @@ namespace sharpsenLang
 				else
 				{
 					static_assert(std::is_same<Array, A>::value);
-					return std::static_pointer_cast<VariableImpl<T>>(v);
+					return staticPointerCast<VariableImpl<T>>(v);
 				}
 			}
 
 		public:
-			IndexExpression(typename Expression<A>::Ptr expr1, Expression<Number>::Ptr expr2, Expression<Lvalue>::Ptr init)
+			IndexExpression(typename Expression<A>::Ptr expr1, Expression<Number>::Ptr expr2, Expression<Lvalue>::Ptr init, std::shared_ptr<const bool> checked = nullptr)
 				: _expr1(std::move(expr1)),
 				  _expr2(std::move(expr2)),
-				  _init(std::move(init))
+				  _init(std::move(init)),
+				  _checked(std::move(checked))
 			{
 			}
 
@@ -488,15 +1525,96 @@ namespace sharpsenLang
 				A arr = _expr1->evaluate(context);
 				int idx = int(_expr2->evaluate(context));
 
-				runtimeAssertion(idx >= 0, "Negative index is invalid");
+				Array &array = value(arr);
+				bool checked = Checked || *_checked;
+				if (checked)
+				{
+					runtimeAssertion(idx >= 0, "Negative index is invalid");
+				}
+				if (checked && size_t(idx) >= array.size())
+				{
+					std::vector<Value> &elements = array.elements();
+					while (size_t(idx) >= elements.size())
+					{
+						if constexpr (isNumberElement)
+						{
+							elements.emplace_back(Number(0));
+						}
+						else
+						{
+							elements.emplace_back(_init->evaluate(context));
+						}
+					}
+				}
 
-				while (idx >= value(arr).size())
+				if constexpr (isNumberElement && (std::is_same<R, Number>::value || std::is_void<R>::value))
+				{
+					return R(array[idx].toNumber());
+				}
+				else if constexpr (isNumberElement && !IsVariableRef<R>::value)
+				{
+					return convert<R>(array[idx].toNumber());
+				}
+				else if constexpr (!IsVariableRef<R>::value)
+				{
+					return convert<R>(
+						toLvalueImpl(VariablePtr(array[idx].variable())));
+				}
+				else
 				{
-					value(arr).push_back(_init->evaluate(context));
+					return convert<R>(
+						toLvalueImpl(array.reference(idx)));
 				}
+			}
+		};
 
-				return convert<R>(
-					toLvalueImpl(value(arr)[idx]));
+		// Checked like IndexExpression.
+		template <typename R, typename A, bool Checked = true>
+		class IndexAssignExpression : public Expression<R>
+		{
+		private:
+			typename Expression<A>::Ptr _expr1;
+			Expression<Number>::Ptr _expr2;
+			Expression<Number>::Ptr _expr3;
+			std::shared_ptr<const bool> _checked;
+
+		public:
+			IndexAssignExpression(typename Expression<A>::Ptr expr1, Expression<Number>::Ptr expr2, Expression<Number>::Ptr expr3, std::shared_ptr<const bool> checked = nullptr)
+				: _expr1(std::move(expr1)),
+				  _expr2(std::move(expr2)),
+				  _expr3(std::move(expr3)),
+				  _checked(std::move(checked))
+			{
+			}
+
+			R evaluate(RuntimeContext &context) const override
+			{
+				A arr = _expr1->evaluate(context);
+				int idx = int(_expr2->evaluate(context));
+
+				bool checked = Checked || *_checked;
+				if (checked)
+				{
+					runtimeAssertion(idx >= 0, "Negative index is invalid");
+				}
+
+				Number n = _expr3->evaluate(context);
+
+				std::vector<Value> &elements = arr->value.elements();
+				if (checked && size_t(idx) >= elements.size())
+				{
+					elements.resize(idx + 1, Value(Number(0)));
+				}
+				elements[idx].setNumber(n);
+
+				if constexpr (std::is_same<R, Number>::value || std::is_void<R>::value)
+				{
+					return R(n);
+				}
+				else
+				{
+					return convert<R>(arr->value.reference(idx)->template staticPointerDowncast<Lnumber>());
+				}
 			}
 		};
 
@@ -529,7 +1647,7 @@ namespace sharpsenLang
 				else
 				{
 					static_assert(std::is_same<Array, A>::value);
-					return std::static_pointer_cast<VariableImpl<T>>(v);
+					return staticPointerCast<VariableImpl<T>>(v);
 				}
 			}
 
@@ -544,8 +1662,16 @@ namespace sharpsenLang
 			{
 				A tup = _expr->evaluate(context);
 
-				return convert<R>(
-					toLvalueImpl(value(tup)[_idx]));
+				if constexpr (!IsVariableRef<R>::value)
+				{
+					return convert<R>(
+						toLvalueImpl(VariablePtr(value(tup)[_idx].variable())));
+				}
+				else
+				{
+					return convert<R>(
+						toLvalueImpl(value(tup).reference(_idx)));
+				}
 			}
 		};
 
@@ -578,7 +1704,7 @@ namespace sharpsenLang
 				else
 				{
 					static_assert(std::is_same<Class, A>::value);
-					return std::static_pointer_cast<VariableImpl<T>>(v);
+					return staticPointerCast<VariableImpl<T>>(v);
 				}
 			}
 
@@ -594,10 +1720,51 @@ namespace sharpsenLang
 				A tup = _expr->evaluate(context);
 
 				return convert<R>(
-					toLvalueImpl(value(tup).properties[_idx]));
+					toLvalueImpl((*value(tup).properties)[_idx]));
 			}
 		};
 
+		template <typename R, typename T>
+		bool lowerCall(
+			BytecodeBuilder &builder,
+			Operand callee,
+			const std::vector<Expression<Lvalue>::Ptr> &exprs,
+			Operand &result)
+		{
+			if constexpr (std::is_void<R>::value || (std::is_same<R, Number>::value && std::is_same<T, Number>::value))
+			{
+				builder.beginCall(exprs.size());
+				for (size_t i = 0; i < exprs.size(); ++i)
+				{
+					builder.pushArgument(*exprs[i], i);
+				}
+
+				if constexpr (std::is_same<R, Number>::value)
+				{
+					result = builder.allocateRegister();
+				}
+				builder.call(callee, exprs.size(), result);
+				return true;
+			}
+			else if constexpr (std::is_same<T, Integer>::value && (std::is_same<R, Number>::value || std::is_same<R, Integer>::value))
+			{
+				builder.beginCall(exprs.size());
+				for (size_t i = 0; i < exprs.size(); ++i)
+				{
+					builder.pushArgument(*exprs[i], i);
+				}
+
+				result = builder.allocateIntegerRegister();
+				builder.callInteger(callee, exprs.size(), result);
+				result = lowerConversion<R, Integer>(builder, result);
+				return true;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
 		template <typename R, typename T>
 		class CallExpression : public Expression<R>
 		{
@@ -624,16 +1791,299 @@ namespace sharpsenLang
 					params.push_back(_exprs[i]->evaluate(context));
 				}
 
-				Function f = _fexpr->evaluate(context);
+				Function f = _fexpr->evaluate(context);
+
+				if constexpr (std::is_same<R, void>::value)
+				{
+					context.call(f, std::move(params));
+				}
+				else
+				{
+					return convert<R>(std::move(
+						staticPointerCast<VariableImpl<T>>(context.call(f, std::move(params)))->value));
+				}
+			}
+
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
+			{
+				Operand callee;
+				if (!_fexpr->lower(builder, callee) ||
+					(callee.kind != OperandKind::Function && !callee.isLocation()))
+				{
+					return false;
+				}
+				return lowerCall<R, T>(builder, callee, _exprs, result);
+			}
+		};
+
+		// Arguments of by-value number and int parameters, which are passed
+		// unboxed. Empty for the other arguments.
+		std::vector<UnboxedValue> findUnboxedArguments(const std::vector<Expression<Lvalue>::Ptr> &exprs)
+		{
+			std::vector<UnboxedValue> ret;
+			for (const Expression<Lvalue>::Ptr &expr : exprs)
+			{
+				ret.push_back(findUnboxedValue(*expr));
+			}
+			return ret;
+		}
+
+		void pushArguments(
+			RuntimeContext &context,
+			const std::vector<Expression<Lvalue>::Ptr> &exprs,
+			const std::vector<UnboxedValue> &values)
+		{
+			context.reserveArguments(exprs.size());
+
+			for (size_t i = 0; i < exprs.size(); ++i)
+			{
+				if (values[i])
+				{
+					context.argument(i) = values[i].evaluate(context);
+				}
+				else
+				{
+					VariablePtr argument = exprs[i]->evaluate(context);
+					context.argument(i) = Value(std::move(argument));
+				}
+			}
+		}
+
+		template <typename R, typename T>
+		R callDirect(
+			RuntimeContext &context,
+			const Function &f,
+			const std::vector<Expression<Lvalue>::Ptr> &exprs,
+			const std::vector<UnboxedValue> &values)
+		{
+			pushArguments(context, exprs, values);
+
+			if constexpr (std::is_same<R, void>::value)
+			{
+				context.callFrame(f, exprs.size());
+			}
+			else if constexpr (std::is_same<T, Number>::value)
+			{
+				return convert<R>(context.callFrame(f, exprs.size()).toNumber());
+			}
+			else if constexpr (std::is_same<T, Integer>::value)
+			{
+				return convert<R>(context.callFrame(f, exprs.size()).toInteger());
+			}
+			else
+			{
+				return convert<R>(std::move(
+					staticPointerCast<VariableImpl<T>>(context.callFrame(f, exprs.size()).boxed())->value));
+			}
+		}
+
+		template <typename R, typename T>
+		class DirectCallExpression : public Expression<R>
+		{
+		private:
+			int _idx;
+			std::vector<Expression<Lvalue>::Ptr> _exprs;
+			std::vector<UnboxedValue> _values;
+
+		public:
+			DirectCallExpression(
+				int idx,
+				std::vector<Expression<Lvalue>::Ptr> exprs)
+				: _idx(idx),
+				  _exprs(std::move(exprs)),
+				  _values(findUnboxedArguments(_exprs))
+			{
+			}
+
+			R evaluate(RuntimeContext &context) const override
+			{
+				return callDirect<R, T>(context, context.getFunction(_idx), _exprs, _values);
+			}
+
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
+			{
+				return lowerCall<R, T>(builder, Operand::function(_idx), _exprs, result);
+			}
+		};
+
+		// Call of a copy of the function specialized for the functions passed to it.
+		// Arguments of the bound parameters are left out.
+		template <typename R, typename T>
+		class SpecializedCallExpression : public Expression<R>
+		{
+		private:
+			const Function &_f;
+			std::vector<Expression<Lvalue>::Ptr> _exprs;
+			std::vector<UnboxedValue> _values;
+
+		public:
+			SpecializedCallExpression(
+				const Function &f,
+				std::vector<Expression<Lvalue>::Ptr> exprs)
+				: _f(f),
+				  _exprs(std::move(exprs)),
+				  _values(findUnboxedArguments(_exprs))
+			{
+			}
+
+			R evaluate(RuntimeContext &context) const override
+			{
+				return callDirect<R, T>(context, _f, _exprs, _values);
+			}
+		};
+
+		void tailCall(
+			RuntimeContext &context,
+			const Function &f,
+			const std::vector<Expression<Lvalue>::Ptr> &exprs,
+			const std::vector<UnboxedValue> &values)
+		{
+			pushArguments(context, exprs, values);
+			context.tailCall(f, exprs.size());
+		}
+
+		class DirectTailCallExpression : public Expression<void>
+		{
+		private:
+			int _idx;
+			std::vector<Expression<Lvalue>::Ptr> _exprs;
+			std::vector<UnboxedValue> _values;
+
+		public:
+			DirectTailCallExpression(
+				int idx,
+				std::vector<Expression<Lvalue>::Ptr> exprs)
+				: _idx(idx),
+				  _exprs(std::move(exprs)),
+				  _values(findUnboxedArguments(_exprs))
+			{
+			}
+
+			void evaluate(RuntimeContext &context) const override
+			{
+				tailCall(context, context.getFunction(_idx), _exprs, _values);
+			}
+
+			bool lower(BytecodeBuilder &builder, Operand &) const override
+			{
+				builder.beginCall(_exprs.size());
+				for (size_t i = 0; i < _exprs.size(); ++i)
+				{
+					builder.pushArgument(*_exprs[i], i);
+				}
+				builder.tailCall(Operand::function(_idx), _exprs.size());
+				return true;
+			}
+		};
+
+		class SpecializedTailCallExpression : public Expression<void>
+		{
+		private:
+			const Function &_f;
+			std::vector<Expression<Lvalue>::Ptr> _exprs;
+			std::vector<UnboxedValue> _values;
+
+		public:
+			SpecializedTailCallExpression(
+				const Function &f,
+				std::vector<Expression<Lvalue>::Ptr> exprs)
+				: _f(f),
+				  _exprs(std::move(exprs)),
+				  _values(findUnboxedArguments(_exprs))
+			{
+			}
+
+			void evaluate(RuntimeContext &context) const override
+			{
+				tailCall(context, _f, _exprs, _values);
+			}
+		};
+
+		template <typename R, typename T>
+		typename Expression<R>::Ptr createCallExpression(
+			Expression<Function>::Ptr fexpr,
+			std::vector<Expression<Lvalue>::Ptr> exprs)
+		{
+			if (const FunctionExpression<Function> *direct = dynamic_cast<const FunctionExpression<Function> *>(fexpr.get()))
+			{
+				return std::make_unique<DirectCallExpression<R, T>>(direct->index(), std::move(exprs));
+			}
+			return std::make_unique<CallExpression<R, T>>(std::move(fexpr), std::move(exprs));
+		}
+
+		template <typename R, typename T>
+		class InlineCallExpression : public Expression<R>
+		{
+		private:
+			// Arguments for by-value number parameters are passed unboxed, in
+			// _numbers; the others are in _exprs, like for a call.
+			std::vector<Expression<Number>::Ptr> _numbers;
+			std::vector<Expression<Lvalue>::Ptr> _exprs;
+			typename Expression<T>::Ptr _result;
+			SharedStatementPtr _body;
+			size_t _frameSize;
+
+		public:
+			InlineCallExpression(
+				std::vector<Expression<Number>::Ptr> numbers,
+				std::vector<Expression<Lvalue>::Ptr> exprs,
+				typename Expression<T>::Ptr result,
+				SharedStatementPtr body,
+				size_t frameSize)
+				: _numbers(std::move(numbers)),
+				  _exprs(std::move(exprs)),
+				  _result(std::move(result)),
+				  _body(std::move(body)),
+				  _frameSize(frameSize)
+			{
+			}
+
+			R evaluate(RuntimeContext &context) const override
+			{
+				context.reserveArguments(_exprs.size());
+
+				for (size_t i = 0; i < _exprs.size(); ++i)
+				{
+					if (_numbers[i])
+					{
+						context.argument(i) = Value(_numbers[i]->evaluate(context));
+					}
+					else
+					{
+						VariablePtr argument = _exprs[i]->evaluate(context);
+						context.argument(i) = Value(std::move(argument));
+					}
+				}
+
+				auto _ = context.enterInlineFrame(_exprs.size(), _frameSize);
+
+				if (_result)
+				{
+					if constexpr (std::is_same<R, void>::value)
+					{
+						_result->evaluate(context);
+						return;
+					}
+					else
+					{
+						return convert<R>(_result->evaluate(context));
+					}
+				}
+
+				_body->execute(context);
 
 				if constexpr (std::is_same<R, void>::value)
 				{
-					context.call(f, std::move(params));
+					return;
+				}
+				else if constexpr (std::is_same<T, Number>::value)
+				{
+					return convert<R>(context.retvalValue().toNumber());
 				}
 				else
 				{
 					return convert<R>(std::move(
-						std::static_pointer_cast<VariableImpl<T>>(context.call(f, std::move(params)))->value));
+						staticPointerCast<VariableImpl<T>>(context.retvalValue().boxed())->value));
 				}
 			}
 		};
@@ -662,12 +2112,13 @@ namespace sharpsenLang
 				}
 				else if constexpr (std::is_same<Array, R>() || std::is_same<Tuple, R>())
 				{
-					InitializerList lst;
+					std::vector<Value> lst;
+					lst.reserve(_exprs.size());
 					for (const Expression<Lvalue>::Ptr &expr : _exprs)
 					{
-						lst.push_back(expr->evaluate(context));
+						lst.emplace_back(expr->evaluate(context));
 					}
-					return lst;
+					return InitializerList(std::move(lst));
 				}
 			}
 		};
@@ -684,9 +2135,27 @@ namespace sharpsenLang
 			{
 			}
 
+			const Expression<T> &value() const
+			{
+				return *_expr;
+			}
+
 			Lvalue evaluate(RuntimeContext &context) const override
 			{
-				return std::make_shared<VariableImpl<T>>(_expr->evaluate(context));
+				return createVariable<T>(_expr->evaluate(context));
+			}
+
+			bool lower(BytecodeBuilder &builder, Operand &result) const override
+			{
+				if constexpr (std::is_same<T, Number>::value)
+				{
+					result = builder.lowerNumber(*_expr);
+					return true;
+				}
+				else
+				{
+					return false;
+				}
 			}
 		};
 
@@ -710,14 +2179,15 @@ namespace sharpsenLang
 
 			Lvalue evaluate(RuntimeContext &context) const override
 			{
-				Tuple ret;
+				std::vector<Value> ret;
+				ret.reserve(_exprs.size());
 
 				for (const Expression<Lvalue>::Ptr &expr : _exprs)
 				{
-					ret.push_back(expr->evaluate(context));
+					ret.emplace_back(expr->evaluate(context));
 				}
 
-				return std::make_unique<VariableImpl<Tuple>>(std::move(ret));
+				return createVariable<Tuple>(Tuple(std::move(ret)));
 			}
 		};
 
@@ -734,19 +2204,23 @@ namespace sharpsenLang
 
 			Lvalue evaluate(RuntimeContext &context) const override
 			{
-				Class ret;
+				std::vector<VariablePtr> properties;
+				properties.reserve(_exprs.size());
 
 				for (const Expression<Lvalue>::Ptr &expr : _exprs)
 				{
-					ret.properties.push_back(expr->evaluate(context));
+					properties.push_back(expr->evaluate(context));
 				}
 
-				return std::make_unique<VariableImpl<Class>>(std::move(ret));
+				return createVariable<Class>(Class{std::make_shared<const std::vector<VariablePtr>>(std::move(properties))});
 			}
 		};
 
 		Expression<Lvalue>::Ptr buildLvalueExpression(TypeHandle typeId, const NodePtr &np, CompilerContext &context);
 
+		template <typename R>
+		typename Expression<R>::Ptr buildExpression(TypeHandle typeId, CompilerContext &context, TokensIterator &it, bool allow_comma);
+
 #define RETURN_EXPRESSION_OF_TYPE(T)              \
 	if constexpr (IsConvertible<T, R>::value)     \
 	{                                             \
@@ -762,7 +2236,7 @@ namespace sharpsenLang
 	if (std::holds_alternative<Identifier>(np->getValue()))                          \
 	{                                                                                \
 		const Identifier &id = std::get<Identifier>(np->getValue());                 \
-		const IdentifierInfo *info = context.find(id.name);                          \
+		const IdentifierInfo *info = context.find(std::string(id.name));             \
 		switch (info->getScope())                                                    \
 		{                                                                            \
 		case IdentifierScope::GlobalVariable:                                        \
@@ -779,7 +2253,7 @@ namespace sharpsenLang
 	if (std::holds_alternative<Identifier>(np->getValue()))                                      \
 	{                                                                                            \
 		const Identifier &id = std::get<Identifier>(np->getValue());                             \
-		info = context.find(id.name);                                                            \
+		info = context.find(std::string(id.name));                                               \
 	}                                                                                            \
 	else if (std::holds_alternative<NodeOperation>(np->getValue()))                              \
 	{                                                                                            \
@@ -791,7 +2265,7 @@ namespace sharpsenLang
 				if (np->getChildren()[1]->isIdentifier())                                        \
 				{                                                                                \
 					auto name = np->getChildren()[1]->getIdentifier();                           \
-					info = context.find(ct->name + "::" + name);                                 \
+					info = context.find(ct->name + "::" + std::string(name));                    \
 				}                                                                                \
 			}                                                                                    \
 		}                                                                                        \
@@ -847,6 +2321,9 @@ namespace sharpsenLang
 					case SimpleType::String:                                                                  \
 						return ExpressionPtr(std::make_unique<ToStringExpression<R, String>>(                 \
 							ExpressionBuilder<String>::buildExpression(np->getChildren()[0], context)));      \
+					case SimpleType::Int:                                                                     \
+						return ExpressionPtr(std::make_unique<ToStringExpression<R, Integer>>(                \
+							ExpressionBuilder<Integer>::buildExpression(np->getChildren()[0], context)));     \
 					case SimpleType::Void:                                                                    \
 						throw ExpressionBuilderError();                                                       \
 						return ExpressionPtr();                                                               \
@@ -881,122 +2358,672 @@ namespace sharpsenLang
 				ExpressionBuilder<T1>::buildExpression(np->getChildren()[0], context), \
 				ExpressionBuilder<T2>::buildExpression(np->getChildren()[1], context)));
 
-#define CHECK_TERNARY_OPERATION(name, T1, T2, T3)                                      \
-	case NodeOperation::name:                                                          \
-		return ExpressionPtr(                                                          \
-			std::make_unique<name##Expression<R, T1, T2, T3>>(                         \
-				ExpressionBuilder<T1>::buildExpression(np->getChildren()[0], context), \
-				ExpressionBuilder<T2>::buildExpression(np->getChildren()[1], context), \
-				ExpressionBuilder<T3>::buildExpression(np->getChildren()[2], context)));
+#define CHECK_TERNARY_OPERATION(name, T1, T2, T3)                                      \
+	case NodeOperation::name:                                                          \
+		return ExpressionPtr(                                                          \
+			std::make_unique<name##Expression<R, T1, T2, T3>>(                         \
+				ExpressionBuilder<T1>::buildExpression(np->getChildren()[0], context), \
+				ExpressionBuilder<T2>::buildExpression(np->getChildren()[1], context), \
+				ExpressionBuilder<T3>::buildExpression(np->getChildren()[2], context)));
+
+#define CHECK_COMPARISON_OPERATION(name)                                                         \
+	case NodeOperation::name:                                                                    \
+		if (isIntegerOperation(*np->getChildren()[0], *np->getChildren()[1]))                    \
+		{                                                                                        \
+			return ExpressionPtr(                                                                \
+				std::make_unique<name##Expression<R, Integer, Integer>>(                         \
+					ExpressionBuilder<Integer>::buildExpression(np->getChildren()[0], context),  \
+					ExpressionBuilder<Integer>::buildExpression(np->getChildren()[1], context))); \
+		}                                                                                        \
+		else if (isNumeric(*np->getChildren()[0]) && isNumeric(*np->getChildren()[1]))          \
+		{                                                                                        \
+			return ExpressionPtr(                                                                \
+				std::make_unique<name##Expression<R, Number, Number>>(                           \
+					ExpressionBuilder<Number>::buildExpression(np->getChildren()[0], context),   \
+					ExpressionBuilder<Number>::buildExpression(np->getChildren()[1], context))); \
+		}                                                                                        \
+		else                                                                                     \
+		{                                                                                        \
+			return ExpressionPtr(                                                                \
+				std::make_unique<name##Expression<R, String, String>>(                           \
+					ExpressionBuilder<String>::buildExpression(np->getChildren()[0], context),   \
+					ExpressionBuilder<String>::buildExpression(np->getChildren()[1], context))); \
+		}
+
+#define CHECK_INDEX_OPERATION(T, A)                                                                \
+	case NodeOperation::Index:                                                                     \
+	{                                                                                              \
+		const TupleType *tt = std::get_if<TupleType>(np->getChildren()[0]->getTypeId());           \
+		if (tt)                                                                                    \
+		{                                                                                          \
+			return ExpressionPtr(                                                                  \
+				std::make_unique<MemberExpression<R, A, T>>(                                       \
+					ExpressionBuilder<A>::buildExpression(np->getChildren()[0], context),          \
+					size_t(np->getChildren()[1]->getNumber())));                                   \
+		}                                                                                          \
+		else                                                                                       \
+		{                                                                                          \
+			const ArrayType *at = std::get_if<ArrayType>(np->getChildren()[0]->getTypeId());       \
+			if (std::shared_ptr<const bool> checked = findIndexRange(np, context))                 \
+			{                                                                                      \
+				return ExpressionPtr(                                                              \
+					std::make_unique<IndexExpression<R, A, T, false>>(                             \
+						ExpressionBuilder<A>::buildExpression(np->getChildren()[0], context),      \
+						ExpressionBuilder<Number>::buildExpression(np->getChildren()[1], context), \
+						buildDefaultInitialization(at->innerTypeId),                               \
+						std::move(checked)));                                                      \
+			}                                                                                      \
+			return ExpressionPtr(                                                                  \
+				std::make_unique<IndexExpression<R, A, T>>(                                        \
+					ExpressionBuilder<A>::buildExpression(np->getChildren()[0], context),          \
+					ExpressionBuilder<Number>::buildExpression(np->getChildren()[1], context),     \
+					buildDefaultInitialization(at->innerTypeId)));                                 \
+		}                                                                                          \
+	}
+
+#define CHECK_INDEX_ASSIGN_OPERATION()                                                                 \
+	case NodeOperation::Assign:                                                                        \
+	{                                                                                                  \
+		const NodePtr &target = np->getChildren()[0];                                                  \
+		if (                                                                                           \
+			target->isNodeOperation() &&                                                               \
+			std::get<NodeOperation>(target->getValue()) == NodeOperation::Index &&                     \
+			std::holds_alternative<ArrayType>(*target->getChildren()[0]->getTypeId()))                 \
+		{                                                                                              \
+			if (std::shared_ptr<const bool> checked = findIndexRange(target, context))                 \
+			{                                                                                          \
+				return ExpressionPtr(                                                                  \
+					std::make_unique<IndexAssignExpression<R, Larray, false>>(                         \
+						ExpressionBuilder<Larray>::buildExpression(target->getChildren()[0], context), \
+						ExpressionBuilder<Number>::buildExpression(target->getChildren()[1], context), \
+						ExpressionBuilder<Number>::buildExpression(np->getChildren()[1], context),     \
+						std::move(checked)));                                                          \
+			}                                                                                          \
+			return ExpressionPtr(                                                                      \
+				std::make_unique<IndexAssignExpression<R, Larray>>(                                    \
+					ExpressionBuilder<Larray>::buildExpression(target->getChildren()[0], context),     \
+					ExpressionBuilder<Number>::buildExpression(target->getChildren()[1], context),     \
+					ExpressionBuilder<Number>::buildExpression(np->getChildren()[1], context)));       \
+		}                                                                                              \
+		return ExpressionPtr(                                                                          \
+			std::make_unique<AssignExpression<R, Lnumber, Number>>(                                    \
+				ExpressionBuilder<Lnumber>::buildExpression(target, context),                          \
+				ExpressionBuilder<Number>::buildExpression(np->getChildren()[1], context)));           \
+	}
+
+#define CHECK_GET_OPERATION(T, A)                                                                           \
+	case NodeOperation::Get:                                                                                \
+	{                                                                                                       \
+		const ClassType *ct = std::get_if<ClassType>(np->getChildren()[0]->getTypeId());                    \
+		if (ct)                                                                                             \
+		{                                                                                                   \
+			const FunctionType *ft = std::get_if<FunctionType>(np->getTypeId());                            \
+			if (ft)                                                                                         \
+			{                                                                                               \
+				break;                                                                                      \
+			}                                                                                               \
+			const Property *property = context.getClassProperty(ct, np->getChildren()[1]->getIdentifier()); \
+                                                                                                            \
+			return ExpressionPtr(                                                                           \
+				std::make_unique<ClassMemberExpression<R, A, T>>(                                           \
+					ExpressionBuilder<A>::buildExpression(np->getChildren()[0], context),                   \
+					property->index));                                                                      \
+		}                                                                                                   \
+		else                                                                                                \
+		{                                                                                                   \
+			throw ExpressionBuilderError();                                                                 \
+			return ExpressionPtr();                                                                         \
+		}                                                                                                   \
+	}
+
+#define CHECK_CALL_OPERATION(T)                                                                                               \
+	case NodeOperation::Call:                                                                                                 \
+	{                                                                                                                         \
+		if (ExpressionPtr inlined = buildInlineCall<T>(np, context))                                                          \
+		{                                                                                                                     \
+			return inlined;                                                                                                   \
+		}                                                                                                                     \
+		if (ExpressionPtr specialized = buildSpecializedCall<T>(np, context))                                                 \
+		{                                                                                                                     \
+			return specialized;                                                                                               \
+		}                                                                                                                     \
+		std::vector<Expression<Lvalue>::Ptr> arguments;                                                                       \
+		auto &firstChild = np->getChildren()[0];                                                                              \
+		const FunctionType *ft = std::get_if<FunctionType>(firstChild->getTypeId());                                          \
+		if (std::holds_alternative<NodeOperation>(firstChild->getValue()))                                                    \
+		{                                                                                                                     \
+			const NodeOperation no = std::get<NodeOperation>(firstChild->getValue());                                         \
+			if (no == NodeOperation::Get)                                                                                     \
+			{                                                                                                                 \
+				arguments.push_back(                                                                                          \
+					buildLvalueExpression(firstChild->getChildren()[0]->getTypeId(), firstChild->getChildren()[0], context)); \
+			}                                                                                                                 \
+		}                                                                                                                     \
+		for (size_t i = 1; i < np->getChildren().size(); ++i)                                                                 \
+		{                                                                                                                     \
+			const NodePtr &child = np->getChildren()[i];                                                                      \
+			if (                                                                                                              \
+				child->isNodeOperation() &&                                                                                   \
+				std::get<NodeOperation>(child->getValue()) == NodeOperation::Param)                                           \
+			{                                                                                                                 \
+				arguments.push_back(                                                                                          \
+					buildLvalueExpression(ft->paramTypeId[i - 1].typeId, child->getChildren()[0], context));                  \
+			}                                                                                                                 \
+			else                                                                                                              \
+			{                                                                                                                 \
+				arguments.push_back(                                                                                          \
+					ExpressionBuilder<Lvalue>::buildExpression(child, context));                                              \
+			}                                                                                                                 \
+		}                                                                                                                     \
+		return createCallExpression<R, T>(                                                                                    \
+			ExpressionBuilder<Function>::buildExpression(np->getChildren()[0], context),                                      \
+			std::move(arguments));                                                                                            \
+	}
+
+		template <typename R>
+		class ExpressionBuilder
+		{
+		private:
+			using ExpressionPtr = typename Expression<R>::Ptr;
+
+			// The script function called by np, if the call names it.
+			static const IdentifierInfo *findCallee(const NodePtr &np, CompilerContext &context)
+			{
+				const NodePtr &callee = np->getChildren()[0];
+				if (!callee->isIdentifier())
+				{
+					return nullptr;
+				}
+				const IdentifierInfo *info = context.find(std::string(callee->getIdentifier()));
+				return info && info->getScope() == IdentifierScope::Function ? info : nullptr;
+			}
+
+			// True if the node yields a number or an int.
+			static bool isNumeric(const Node &node)
+			{
+				return node.getTypeId() == TypeRegistry::getNumberHandle() || node.getTypeId() == TypeRegistry::getIntHandle();
+			}
+
+			// The check flag of the counted loop whose counter indexes the array, or
+			// null if the index always needs its check.
+			static std::shared_ptr<const bool> findIndexRange(const NodePtr &np, CompilerContext &context)
+			{
+				const NodePtr &array = np->getChildren()[0];
+				const NodePtr &index = np->getChildren()[1];
+				if (!array->isIdentifier() || !index->isIdentifier())
+				{
+					return nullptr;
+				}
+				return context.findIndexRange(context.find(std::string(index->getIdentifier())), context.find(std::string(array->getIdentifier())));
+			}
+
+			// Named functions passed to the callee's by-value function parameters.
+			// Empty if there are none.
+			static Specializations::Bindings bindFunctionArguments(const NodePtr &np, CompilerContext &context, const FunctionBody &body)
+			{
+				Specializations::Bindings ret;
+				for (size_t i = 1; i < np->getChildren().size(); ++i)
+				{
+					const NodePtr &child = np->getChildren()[i];
+					if (!body.bindableParams[i - 1] || !child->isNodeOperation() ||
+						child->getNodeOperation() != NodeOperation::Param || !child->getChildren()[0]->isIdentifier())
+					{
+						continue;
+					}
+					const IdentifierInfo *info = context.find(std::string(child->getChildren()[0]->getIdentifier()));
+					if (info && info->getScope() == IdentifierScope::Function)
+					{
+						ret.resize(body.bindableParams.size(), Specializations::NoBinding);
+						ret[i - 1] = info->index();
+					}
+				}
+				return ret;
+			}
+
+			static bool isBound(const Specializations::Bindings &bindings, size_t param)
+			{
+				return !bindings.empty() && bindings[param] != Specializations::NoBinding;
+			}
+
+			static bool callsFunctions(const FunctionBody &body, CompilerContext &context)
+			{
+				for (size_t i = 0; i + 1 < body.tokens.size(); ++i)
+				{
+					if (body.tokens[i].isIdentifier() && body.tokens[i + 1].hasValue(ReservedToken::OpenRound))
+					{
+						const IdentifierInfo *info = context.find(std::string(body.tokens[i].getIdentifier().name));
+						if (info && info->getScope() == IdentifierScope::Function)
+						{
+							return true;
+						}
+					}
+				}
+				return false;
+			}
+
+			// Arguments of a call to a named function, leaving out the bound ones.
+			static std::vector<Expression<Lvalue>::Ptr> buildArguments(
+				const NodePtr &np,
+				CompilerContext &context,
+				const Specializations::Bindings &bindings)
+			{
+				const FunctionType *ft = std::get_if<FunctionType>(np->getChildren()[0]->getTypeId());
+				std::vector<Expression<Lvalue>::Ptr> ret;
+
+				for (size_t i = 1; i < np->getChildren().size(); ++i)
+				{
+					const NodePtr &child = np->getChildren()[i];
+					if (isBound(bindings, i - 1))
+					{
+						continue;
+					}
+					if (child->isNodeOperation() && child->getNodeOperation() == NodeOperation::Param)
+					{
+						ret.push_back(buildLvalueExpression(ft->paramTypeId[i - 1].typeId, child->getChildren()[0], context));
+					}
+					else
+					{
+						ret.push_back(ExpressionBuilder<Lvalue>::buildExpression(child, context));
+					}
+				}
+				return ret;
+			}
+
+			// Compiles a call to a small script function as a copy of its body,
+			// or returns null for a regular call.
+			template <typename T>
+			static ExpressionPtr buildInlineCall(const NodePtr &np, CompilerContext &context)
+			{
+				if constexpr (!std::is_void<T>::value && !std::is_same<T, Number>::value && !std::is_same<T, String>::value)
+				{
+					return nullptr;
+				}
+				else
+				{
+					const IdentifierInfo *info = findCallee(np, context);
+					const FunctionBody *function = info ? context.findInlineFunction(info->index()) : nullptr;
+					if (!function)
+					{
+						return nullptr;
+					}
+
+					const FunctionType *ft = std::get_if<FunctionType>(function->decl.typeId);
+					Specializations::Bindings bindings = bindFunctionArguments(np, context, *function);
+					typename Expression<T>::Ptr result;
+					SharedStatementPtr body;
+					size_t frameSize;
+
+					// A body that assigns a bound parameter doesn't compile with it
+					// bound, so it is compiled again taking the argument.
+					while (true)
+					{
+						try
+						{
+							auto _ = context.inlineFunction(info->index());
+
+							for (size_t i = 0; i < function->decl.params.size(); ++i)
+							{
+								if (isBound(bindings, i))
+								{
+									context.bindParam(function->decl.params[i], ft->paramTypeId[i].typeId, bindings[i]);
+								}
+								else
+								{
+									context.createParam(function->decl.params[i], ft->paramTypeId[i].typeId, ft->paramTypeId[i].byRef);
+								}
+							}
+
+							std::deque<Token> tokens = function->tokens;
+							TokensIterator it(tokens);
+
+							if (function->expressionBody)
+							{
+								parseTokenValue(context, it, ReservedToken::OpenCurly);
+								parseTokenValue(context, it, ReservedToken::KwReturn);
+								result = sharpsenLang::buildExpression<T>(ft->returnTypeId, context, it, true);
+							}
+							else
+							{
+								body = compileFunctionBlock(context, it, ft->returnTypeId);
+							}
+							frameSize = context.frameSize();
+							break;
+						}
+						catch (const Error &)
+						{
+							if (bindings.empty())
+							{
+								// The error is reported when the function itself is compiled.
+								return nullptr;
+							}
+							bindings.clear();
+						}
+					}
+
+					std::vector<Expression<Number>::Ptr> numbers;
+					std::vector<Expression<Lvalue>::Ptr> exprs;
+
+					for (size_t i = 1; i < np->getChildren().size(); ++i)
+					{
+						const NodePtr &child = np->getChildren()[i];
+						if (isBound(bindings, i - 1))
+						{
+							continue;
+						}
+						if (!child->isNodeOperation() || child->getNodeOperation() != NodeOperation::Param)
+						{
+							numbers.emplace_back();
+							exprs.push_back(ExpressionBuilder<Lvalue>::buildExpression(child, context));
+						}
+						else if (ft->paramTypeId[i - 1].typeId == TypeRegistry::getNumberHandle())
+						{
+							numbers.push_back(ExpressionBuilder<Number>::buildExpression(child->getChildren()[0], context));
+							exprs.emplace_back();
+						}
+						else
+						{
+							numbers.emplace_back();
+							exprs.push_back(buildLvalueExpression(ft->paramTypeId[i - 1].typeId, child->getChildren()[0], context));
+						}
+					}
+
+					context.counters().addInlinedCall();
+
+					return std::make_unique<InlineCallExpression<R, T>>(
+						std::move(numbers), std::move(exprs), std::move(result), std::move(body), frameSize);
+				}
+			}
+
+			// Compiles a call passing named functions to a script function as a call
+			// of its specialization for them, or returns null for a regular call.
+			template <typename T>
+			static ExpressionPtr buildSpecializedCall(const NodePtr &np, CompilerContext &context)
+			{
+				const IdentifierInfo *info = findCallee(np, context);
+				const FunctionBody *function = info ? context.findFunctionBody(info->index()) : nullptr;
+				if (!function)
+				{
+					return nullptr;
+				}
+
+				Specializations::Bindings bindings = bindFunctionArguments(np, context, *function);
+				const Function *f = bindings.empty() ? nullptr : context.specialize(info->index(), bindings);
+				if (!f)
+				{
+					return nullptr;
+				}
+
+				return std::make_unique<SpecializedCallExpression<R, T>>(*f, buildArguments(np, context, bindings));
+			}
+
+			// The local if the node names a local of the type, or null.
+			static const IdentifierInfo *findLocal(const NodePtr &np, CompilerContext &context, TypeHandle typeId)
+			{
+				if (!np->isIdentifier())
+				{
+					return nullptr;
+				}
+				const IdentifierInfo *info = context.find(std::string(np->getIdentifier()));
+				if (!info || info->getScope() != IdentifierScope::LocalVariable || info->typeId() != typeId)
+				{
+					return nullptr;
+				}
+				return info;
+			}
+
+			static const IdentifierInfo *findNumberLocal(const NodePtr &np, CompilerContext &context)
+			{
+				return findLocal(np, context, TypeRegistry::getNumberHandle());
+			}
+
+			template <class O, class A1, class A2>
+			static ExpressionPtr buildFused(CompilerContext &context, const IdentifierInfo *target, A1 a1, A2 a2)
+			{
+				context.counters().addFusedExpression();
+				if (target)
+				{
+					return std::make_unique<FusedAssignExpression<R, O, A1, A2>>(int(target->index()), a1, a2);
+				}
+				if constexpr (std::is_same<R, Number>::value)
+				{
+					return std::make_unique<FusedBinaryExpression<R, O, A1, A2>>(a1, a2);
+				}
+				return nullptr;
+			}
+
+			template <class O>
+			static ExpressionPtr buildFused(const NodePtr &np, CompilerContext &context, const IdentifierInfo *target)
+			{
+				const NodePtr &n1 = np->getChildren()[0];
+				const NodePtr &n2 = np->getChildren()[1];
+				const IdentifierInfo *local1 = findNumberLocal(n1, context);
+				const IdentifierInfo *local2 = findNumberLocal(n2, context);
+				if (local1 && local2)
+				{
+					return buildFused<O>(context, target, LocalOperand{int(local1->index())}, LocalOperand{int(local2->index())});
+				}
+				if (local1 && n2->isNumber())
+				{
+					return buildFused<O>(context, target, LocalOperand{int(local1->index())}, ConstantOperand{n2->getNumber()});
+				}
+				if (n1->isNumber() && local2)
+				{
+					return buildFused<O>(context, target, ConstantOperand{n1->getNumber()}, LocalOperand{int(local2->index())});
+				}
+				return nullptr;
+			}
+
+			// Builds binary number operations on locals and constants as a single
+			// node reading the frame directly. With a target, the result is assigned
+			// to that number local.
+			static ExpressionPtr buildFusedOperation(const NodePtr &np, CompilerContext &context, const IdentifierInfo *target)
+			{
+				if constexpr (!std::is_void<R>::value && !std::is_same<R, Number>::value)
+				{
+					return nullptr;
+				}
+				else
+				{
+					if (!context.settings().fuseExpressions || !np->isNodeOperation() || np->getChildren().size() != 2)
+					{
+						return nullptr;
+					}
+					if (std::is_void<R>::value && !target)
+					{
+						return nullptr;
+					}
+
+					switch (np->getNodeOperation())
+					{
+					case NodeOperation::Add:
+						return buildFused<AddOp>(np, context, target);
+					case NodeOperation::Sub:
+						return buildFused<SubOp>(np, context, target);
+					case NodeOperation::Mul:
+						return buildFused<MulOp>(np, context, target);
+					case NodeOperation::Div:
+						return buildFused<DivOp>(np, context, target);
+					case NodeOperation::Idiv:
+						return buildFused<IdivOp>(np, context, target);
+					case NodeOperation::Mod:
+						return buildFused<ModOp>(np, context, target);
+					case NodeOperation::Band:
+						return buildFused<BandOp>(np, context, target);
+					case NodeOperation::Bor:
+						return buildFused<BorOp>(np, context, target);
+					case NodeOperation::Bxor:
+						return buildFused<BxorOp>(np, context, target);
+					case NodeOperation::Bsl:
+						return buildFused<BslOp>(np, context, target);
+					case NodeOperation::Bsr:
+						return buildFused<BsrOp>(np, context, target);
+					case NodeOperation::Eq:
+						return buildFused<EqOp>(np, context, target);
+					case NodeOperation::Ne:
+						return buildFused<NeOp>(np, context, target);
+					case NodeOperation::Lt:
+						return buildFused<LtOp>(np, context, target);
+					case NodeOperation::Gt:
+						return buildFused<GtOp>(np, context, target);
+					case NodeOperation::Le:
+						return buildFused<LeOp>(np, context, target);
+					case NodeOperation::Ge:
+						return buildFused<GeOp>(np, context, target);
+					default:
+						return nullptr;
+					}
+				}
+			}
 
-#define CHECK_COMPARISON_OPERATION(name)                                                         \
-	case NodeOperation::name:                                                                    \
-		if (                                                                                     \
-			np->getChildren()[0]->getTypeId() == TypeRegistry::getNumberHandle() &&              \
-			np->getChildren()[1]->getTypeId() == TypeRegistry::getNumberHandle())                \
-		{                                                                                        \
-			return ExpressionPtr(                                                                \
-				std::make_unique<name##Expression<R, Number, Number>>(                           \
-					ExpressionBuilder<Number>::buildExpression(np->getChildren()[0], context),   \
-					ExpressionBuilder<Number>::buildExpression(np->getChildren()[1], context))); \
-		}                                                                                        \
-		else                                                                                     \
-		{                                                                                        \
-			return ExpressionPtr(                                                                \
-				std::make_unique<name##Expression<R, String, String>>(                           \
-					ExpressionBuilder<String>::buildExpression(np->getChildren()[0], context),   \
-					ExpressionBuilder<String>::buildExpression(np->getChildren()[1], context))); \
-		}
+			// `a[i]` read from a local number array with a number local index.
+			static ExpressionPtr buildFusedIndex(const NodePtr &np, CompilerContext &context)
+			{
+				if constexpr (!std::is_same<R, Number>::value)
+				{
+					return nullptr;
+				}
+				else
+				{
+					if (!context.settings().fuseExpressions || !np->isNodeOperation() || np->getNodeOperation() != NodeOperation::Index)
+					{
+						return nullptr;
+					}
+					const NodePtr &array = np->getChildren()[0];
+					const IdentifierInfo *index = findNumberLocal(np->getChildren()[1], context);
+					const ArrayType *at = std::get_if<ArrayType>(array->getTypeId());
+					if (!index || !at || at->innerTypeId != TypeRegistry::getNumberHandle() || !array->isIdentifier())
+					{
+						return nullptr;
+					}
+					const IdentifierInfo *info = context.find(std::string(array->getIdentifier()));
+					if (!info || info->getScope() != IdentifierScope::LocalVariable)
+					{
+						return nullptr;
+					}
 
-#define CHECK_INDEX_OPERATION(T, A)                                                            \
-	case NodeOperation::Index:                                                                 \
-	{                                                                                          \
-		const TupleType *tt = std::get_if<TupleType>(np->getChildren()[0]->getTypeId());       \
-		if (tt)                                                                                \
-		{                                                                                      \
-			return ExpressionPtr(                                                              \
-				std::make_unique<MemberExpression<R, A, T>>(                                   \
-					ExpressionBuilder<A>::buildExpression(np->getChildren()[0], context),      \
-					size_t(np->getChildren()[1]->getNumber())));                               \
-		}                                                                                      \
-		else                                                                                   \
-		{                                                                                      \
-			const ArrayType *at = std::get_if<ArrayType>(np->getChildren()[0]->getTypeId());   \
-			return ExpressionPtr(                                                              \
-				std::make_unique<IndexExpression<R, A, T>>(                                    \
-					ExpressionBuilder<A>::buildExpression(np->getChildren()[0], context),      \
-					ExpressionBuilder<Number>::buildExpression(np->getChildren()[1], context), \
-					buildDefaultInitialization(at->innerTypeId)));                             \
-		}                                                                                      \
-	}
+					context.counters().addFusedExpression();
+					if (std::shared_ptr<const bool> checked = findIndexRange(np, context))
+					{
+						return std::make_unique<FusedIndexExpression<false>>(int(info->index()), int(index->index()), std::move(checked));
+					}
+					return std::make_unique<FusedIndexExpression<true>>(int(info->index()), int(index->index()));
+				}
+			}
 
-#define CHECK_GET_OPERATION(T, A)                                                                           \
-	case NodeOperation::Get:                                                                                \
-	{                                                                                                       \
-		const ClassType *ct = std::get_if<ClassType>(np->getChildren()[0]->getTypeId());                    \
-		if (ct)                                                                                             \
-		{                                                                                                   \
-			const FunctionType *ft = std::get_if<FunctionType>(np->getTypeId());                            \
-			if (ft)                                                                                         \
-			{                                                                                               \
-				break;                                                                                      \
-			}                                                                                               \
-			const Property *property = context.getClassProperty(ct, np->getChildren()[1]->getIdentifier()); \
-                                                                                                            \
-			return ExpressionPtr(                                                                           \
-				std::make_unique<ClassMemberExpression<R, A, T>>(                                           \
-					ExpressionBuilder<A>::buildExpression(np->getChildren()[0], context),                   \
-					property->index));                                                                      \
-		}                                                                                                   \
-		else                                                                                                \
-		{                                                                                                   \
-			throw ExpressionBuilderError();                                                                 \
-			return ExpressionPtr();                                                                         \
-		}                                                                                                   \
-	}
+			// Builds an assignment, increment or decrement of a number or int local
+			// whose result isn't used as an lvalue in the local's stack slot, or
+			// returns null for other expressions.
+			static ExpressionPtr buildLocalUpdate(const NodePtr &np, CompilerContext &context)
+			{
+				if (!np->isNodeOperation() || np->getChildren().empty())
+				{
+					return nullptr;
+				}
+				if (const IdentifierInfo *info = findNumberLocal(np->getChildren()[0], context))
+				{
+					return buildLocalUpdate<Number>(np, context, info);
+				}
+				if (const IdentifierInfo *info = findLocal(np->getChildren()[0], context, TypeRegistry::getIntHandle()))
+				{
+					return buildLocalUpdate<Integer>(np, context, info);
+				}
+				return nullptr;
+			}
 
-#define CHECK_CALL_OPERATION(T)                                                                                               \
-	case NodeOperation::Call:                                                                                                 \
-	{                                                                                                                         \
-		std::vector<Expression<Lvalue>::Ptr> arguments;                                                                       \
-		auto &firstChild = np->getChildren()[0];                                                                              \
-		const FunctionType *ft = std::get_if<FunctionType>(firstChild->getTypeId());                                          \
-		if (std::holds_alternative<NodeOperation>(firstChild->getValue()))                                                    \
-		{                                                                                                                     \
-			const NodeOperation no = std::get<NodeOperation>(firstChild->getValue());                                         \
-			if (no == NodeOperation::Get)                                                                                     \
-			{                                                                                                                 \
-				arguments.push_back(                                                                                          \
-					buildLvalueExpression(firstChild->getChildren()[0]->getTypeId(), firstChild->getChildren()[0], context)); \
-			}                                                                                                                 \
-		}                                                                                                                     \
-		for (size_t i = 1; i < np->getChildren().size(); ++i)                                                                 \
-		{                                                                                                                     \
-			const NodePtr &child = np->getChildren()[i];                                                                      \
-			if (                                                                                                              \
-				child->isNodeOperation() &&                                                                                   \
-				std::get<NodeOperation>(child->getValue()) == NodeOperation::Param)                                           \
-			{                                                                                                                 \
-				arguments.push_back(                                                                                          \
-					buildLvalueExpression(ft->paramTypeId[i - 1].typeId, child->getChildren()[0], context));                  \
-			}                                                                                                                 \
-			else                                                                                                              \
-			{                                                                                                                 \
-				arguments.push_back(                                                                                          \
-					ExpressionBuilder<Lvalue>::buildExpression(child, context));                                              \
-			}                                                                                                                 \
-		}                                                                                                                     \
-		return ExpressionPtr(                                                                                                 \
-			std::make_unique<CallExpression<R, T>>(                                                                           \
-				ExpressionBuilder<Function>::buildExpression(np->getChildren()[0], context),                                  \
-				std::move(arguments)));                                                                                       \
-	}
+			// Without fusion, the update is built as an assignment of the generic
+			// operation on the local's value, so a post update is built only when its
+			// result is unused.
+			template <typename V, class O, bool Post = false>
+			static ExpressionPtr buildUpdate(CompilerContext &context, int idx, typename Expression<V>::Ptr operand)
+			{
+				if (context.settings().fuseExpressions)
+				{
+					context.counters().addFusedExpression();
+					return std::make_unique<LocalUpdateExpression<R, V, O, Post>>(idx, std::move(operand));
+				}
+				if (Post && !std::is_void<R>::value)
+				{
+					return nullptr;
+				}
+				using L = std::conditional_t<std::is_same<V, Integer>::value, Linteger, Lnumber>;
+				if (!operand)
+				{
+					operand = std::make_unique<ConstantExpression<V, V>>(V(1));
+				}
+				return std::make_unique<LocalUpdateExpression<R, V, void>>(
+					idx,
+					std::make_unique<GenericExpression<O, V, V, V>>(std::make_unique<LocalVariableExpression<V, L>>(idx), std::move(operand)));
+			}
 
-		template <typename R>
-		class ExpressionBuilder
-		{
-		private:
-			using ExpressionPtr = typename Expression<R>::Ptr;
+			template <typename V>
+			static ExpressionPtr buildLocalUpdate(const NodePtr &np, CompilerContext &context, const IdentifierInfo *info)
+			{
+				if constexpr (!std::is_void<R>::value && !std::is_same<R, V>::value)
+				{
+					return nullptr;
+				}
+				else
+				{
+					int idx = int(info->index());
+					auto operand = [&]()
+					{
+						return ExpressionBuilder<V>::buildExpression(np->getChildren()[1], context);
+					};
+
+					switch (np->getNodeOperation())
+					{
+					case NodeOperation::Assign:
+						if constexpr (std::is_same<V, Number>::value)
+						{
+							if (ExpressionPtr fused = buildFusedOperation(np->getChildren()[1], context, info))
+							{
+								return fused;
+							}
+						}
+						return std::make_unique<LocalUpdateExpression<R, V, void>>(idx, operand());
+					case NodeOperation::AddAssign:
+						return buildUpdate<V, AddOp>(context, idx, operand());
+					case NodeOperation::SubAssign:
+						return buildUpdate<V, SubOp>(context, idx, operand());
+					case NodeOperation::MulAssign:
+						return buildUpdate<V, MulOp>(context, idx, operand());
+					case NodeOperation::DivAssign:
+						// An int divided in place keeps the integer part of the quotient.
+						if constexpr (std::is_same<V, Integer>::value)
+						{
+							return buildUpdate<V, IdivOp>(context, idx, operand());
+						}
+						else
+						{
+							return buildUpdate<V, DivOp>(context, idx, operand());
+						}
+					case NodeOperation::IdivAssign:
+						return buildUpdate<V, IdivOp>(context, idx, operand());
+					case NodeOperation::ModAssign:
+						return buildUpdate<V, ModOp>(context, idx, operand());
+					case NodeOperation::BandAssign:
+						return buildUpdate<V, BandOp>(context, idx, operand());
+					case NodeOperation::BorAssign:
+						return buildUpdate<V, BorOp>(context, idx, operand());
+					case NodeOperation::BxorAssign:
+						return buildUpdate<V, BxorOp>(context, idx, operand());
+					case NodeOperation::BslAssign:
+						return buildUpdate<V, BslOp>(context, idx, operand());
+					case NodeOperation::BsrAssign:
+						return buildUpdate<V, BsrOp>(context, idx, operand());
+					case NodeOperation::Preinc:
+						return buildUpdate<V, AddOp>(context, idx, nullptr);
+					case NodeOperation::Predec:
+						return buildUpdate<V, SubOp>(context, idx, nullptr);
+					case NodeOperation::Postinc:
+						return buildUpdate<V, AddOp, true>(context, idx, nullptr);
+					case NodeOperation::Postdec:
+						return buildUpdate<V, SubOp, true>(context, idx, nullptr);
+					default:
+						return nullptr;
+					}
+				}
+			}
 
 			static ExpressionPtr buildVoidExpression(const NodePtr &np, CompilerContext &context)
 			{
@@ -1020,6 +3047,15 @@ namespace sharpsenLang
 
 				CHECK_IDENTIFIER(Lnumber);
 
+				if (ExpressionPtr update = buildLocalUpdate(np, context))
+				{
+					return update;
+				}
+				if (ExpressionPtr fused = buildFusedOperation(np, context, nullptr))
+				{
+					return fused;
+				}
+
 				switch (std::get<NodeOperation>(np->getValue()))
 				{
 					CHECK_UNARY_OPERATION(Postinc, Lnumber);
@@ -1061,11 +3097,20 @@ namespace sharpsenLang
 			{
 				CHECK_IDENTIFIER(Lnumber);
 
+				if (ExpressionPtr update = buildLocalUpdate(np, context))
+				{
+					return update;
+				}
+				if (ExpressionPtr fused = buildFusedIndex(np, context))
+				{
+					return fused;
+				}
+
 				switch (std::get<NodeOperation>(np->getValue()))
 				{
 					CHECK_UNARY_OPERATION(Preinc, Lnumber);
 					CHECK_UNARY_OPERATION(Predec, Lnumber);
-					CHECK_BINARY_OPERATION(Assign, Lnumber, Number);
+					CHECK_INDEX_ASSIGN_OPERATION();
 					CHECK_BINARY_OPERATION(AddAssign, Lnumber, Number);
 					CHECK_BINARY_OPERATION(SubAssign, Lnumber, Number);
 					CHECK_BINARY_OPERATION(MulAssign, Lnumber, Number);
@@ -1086,12 +3131,89 @@ namespace sharpsenLang
 				}
 			}
 
+			static ExpressionPtr buildIntegerExpression(const NodePtr &np, CompilerContext &context)
+			{
+				// Integral literals in an initializer list of ints.
+				if (std::holds_alternative<double>(np->getValue()))
+				{
+					return std::make_unique<ConstantExpression<R, Integer>>(
+						convertToInteger(std::get<double>(np->getValue())));
+				}
+
+				CHECK_IDENTIFIER(Linteger);
+
+				if (ExpressionPtr update = buildLocalUpdate(np, context))
+				{
+					return update;
+				}
+
+				switch (std::get<NodeOperation>(np->getValue()))
+				{
+					CHECK_UNARY_OPERATION(Postinc, Linteger);
+					CHECK_UNARY_OPERATION(Postdec, Linteger);
+					CHECK_UNARY_OPERATION(Positive, Integer);
+					CHECK_UNARY_OPERATION(Negative, Integer);
+					CHECK_UNARY_OPERATION(Bnot, Integer);
+					CHECK_UNARY_OPERATION(ToInt, Integer);
+					CHECK_BINARY_OPERATION(Add, Integer, Integer);
+					CHECK_BINARY_OPERATION(Sub, Integer, Integer);
+					CHECK_BINARY_OPERATION(Mul, Integer, Integer);
+					CHECK_BINARY_OPERATION(Idiv, Integer, Integer);
+					CHECK_BINARY_OPERATION(Mod, Integer, Integer);
+					CHECK_BINARY_OPERATION(Band, Integer, Integer);
+					CHECK_BINARY_OPERATION(Bor, Integer, Integer);
+					CHECK_BINARY_OPERATION(Bxor, Integer, Integer);
+					CHECK_BINARY_OPERATION(Bsl, Integer, Integer);
+					CHECK_BINARY_OPERATION(Bsr, Integer, Integer);
+					CHECK_BINARY_OPERATION(Comma, Void, Integer);
+					CHECK_INDEX_OPERATION(Integer, Array);
+					CHECK_TERNARY_OPERATION(Ternary, Number, Integer, Integer);
+					CHECK_CALL_OPERATION(Integer);
+				default:
+					throw ExpressionBuilderError();
+				}
+			}
+
+			static ExpressionPtr buildLintegerExpression(const NodePtr &np, CompilerContext &context)
+			{
+				CHECK_IDENTIFIER(Linteger);
+
+				if (ExpressionPtr update = buildLocalUpdate(np, context))
+				{
+					return update;
+				}
+
+				switch (std::get<NodeOperation>(np->getValue()))
+				{
+					CHECK_UNARY_OPERATION(Preinc, Linteger);
+					CHECK_UNARY_OPERATION(Predec, Linteger);
+					CHECK_BINARY_OPERATION(Assign, Linteger, Integer);
+					CHECK_BINARY_OPERATION(AddAssign, Linteger, Integer);
+					CHECK_BINARY_OPERATION(SubAssign, Linteger, Integer);
+					CHECK_BINARY_OPERATION(MulAssign, Linteger, Integer);
+					CHECK_BINARY_OPERATION(DivAssign, Linteger, Integer);
+					CHECK_BINARY_OPERATION(IdivAssign, Linteger, Integer);
+					CHECK_BINARY_OPERATION(ModAssign, Linteger, Integer);
+					CHECK_BINARY_OPERATION(BandAssign, Linteger, Integer);
+					CHECK_BINARY_OPERATION(BorAssign, Linteger, Integer);
+					CHECK_BINARY_OPERATION(BxorAssign, Linteger, Integer);
+					CHECK_BINARY_OPERATION(BslAssign, Linteger, Integer);
+					CHECK_BINARY_OPERATION(BsrAssign, Linteger, Integer);
+					CHECK_BINARY_OPERATION(Comma, Void, Linteger);
+					CHECK_INDEX_OPERATION(Linteger, Larray);
+					CHECK_GET_OPERATION(Linteger, Lclass);
+					CHECK_TERNARY_OPERATION(Ternary, Number, Linteger, Linteger);
+				default:
+					throw ExpressionBuilderError();
+				}
+			}
+
 			static ExpressionPtr buildStringExpression(const NodePtr &np, CompilerContext &context)
 			{
-				if (std::holds_alternative<std::string>(np->getValue()))
+				if (std::holds_alternative<std::string_view>(np->getValue()))
 				{
 					return std::make_unique<ConstantExpression<R, String>>(
-						std::make_shared<std::string>(std::get<std::string>(np->getValue())));
+						std::make_shared<std::string>(std::get<std::string_view>(np->getValue())));
 				}
 
 				CHECK_IDENTIFIER(Lstring);
@@ -1299,6 +3421,15 @@ namespace sharpsenLang
 								{
 									RETURN_EXPRESSION_OF_TYPE(String);
 								}
+							case SimpleType::Int:
+								if (np->isLvalue())
+								{
+									RETURN_EXPRESSION_OF_TYPE(Linteger);
+								}
+								else
+								{
+									RETURN_EXPRESSION_OF_TYPE(Integer);
+								}
 							case SimpleType::Void:
 								RETURN_EXPRESSION_OF_TYPE(Void);
 							}
@@ -1359,9 +3490,37 @@ namespace sharpsenLang
 				return std::make_unique<ParamExpression<R>>(
 					ExpressionBuilder<R>::buildExpression(np, context));
 			}
+
+			// Compiles a returned call of a named function as a tail call, or returns
+			// null if it is inlined or isn't a call of a named function. Only callees
+			// that call no named function are inlined here, since inlining one that
+			// does would nest mutually recursive calls again.
+			static Expression<void>::Ptr buildTailCall(const NodePtr &np, CompilerContext &context)
+			{
+				const IdentifierInfo *info = findCallee(np, context);
+				if (!info)
+				{
+					return nullptr;
+				}
+				if (const FunctionBody *inlined = context.findInlineFunction(info->index()); inlined && !callsFunctions(*inlined, context))
+				{
+					return nullptr;
+				}
+
+				context.counters().addTailCall();
+
+				const FunctionBody *function = context.findFunctionBody(info->index());
+				Specializations::Bindings bindings = function ? bindFunctionArguments(np, context, *function) : Specializations::Bindings();
+				if (const Function *f = bindings.empty() ? nullptr : context.specialize(info->index(), bindings))
+				{
+					return std::make_unique<SpecializedTailCallExpression>(*f, buildArguments(np, context, bindings));
+				}
+				return std::make_unique<DirectTailCallExpression>(info->index(), buildArguments(np, context, {}));
+			}
 		};
 
 #undef CHECK_CALL_OPERATION
+#undef CHECK_INDEX_ASSIGN_OPERATION
 #undef CHECK_INDEX_OPERATION
 #undef CHECK_COMPARISON_OPERATION
 #undef CHECK_TERNARY_OPERATION
@@ -1385,6 +3544,8 @@ namespace sharpsenLang
 							return ExpressionBuilder<Number>::buildParamExpression(np, context);
 						case SimpleType::String:
 							return ExpressionBuilder<String>::buildParamExpression(np, context);
+						case SimpleType::Int:
+							return ExpressionBuilder<Integer>::buildParamExpression(np, context);
 						case SimpleType::Void:
 							throw ExpressionBuilderError();
 							return Expression<Lvalue>::Ptr();
@@ -1422,15 +3583,10 @@ namespace sharpsenLang
 		};
 
 		template <typename R>
-		typename Expression<R>::Ptr buildExpression(TypeHandle typeId, CompilerContext &context, TokensIterator &it, bool allow_comma)
+		typename Expression<R>::Ptr buildExpression(TypeHandle typeId, CompilerContext &context, const NodePtr &np, size_t line_number, size_t char_index)
 		{
-			size_t line_number = it->getLineNumber();
-			size_t char_index = it->getCharIndex();
-
 			try
 			{
-				NodePtr np = parseExpressionTree(context, it, typeId, allow_comma);
-
 				if constexpr (std::is_same<void, R>::value)
 				{
 					if (!np)
@@ -1458,17 +3614,49 @@ namespace sharpsenLang
 			}
 		}
 
+		template <typename R>
+		typename Expression<R>::Ptr buildExpression(TypeHandle typeId, CompilerContext &context, TokensIterator &it, bool allow_comma)
+		{
+			size_t line_number = it->getLineNumber();
+			size_t char_index = it->getCharIndex();
+
+			NodePtr np = parseExpression(context, it, typeId, allow_comma);
+			return buildExpression<R>(typeId, context, np, line_number, char_index);
+		}
+
+		template <typename R>
+		typename Expression<R>::Ptr buildExpression(TypeHandle typeId, CompilerContext &context, const NodePtr &np)
+		{
+			return np ? buildExpression<R>(typeId, context, np, np->getLineNumber(), np->getCharIndex())
+					  : buildExpression<R>(typeId, context, np, 0, 0);
+		}
+
 		template <typename T>
 		class DefaultInitializationExpression : public Expression<Lvalue>
 		{
 		public:
 			Lvalue evaluate(RuntimeContext &context) const override
 			{
-				return std::make_shared<VariableImpl<T>>(T{});
+				return createVariable<T>(T{});
 			}
 		};
 	}
 
+	NodePtr parseExpression(CompilerContext &context, TokensIterator &it, TypeHandle typeId, bool allow_comma)
+	{
+		NodePtr np = parseExpressionTree(context, it, typeId, allow_comma);
+
+		if (np && context.settings().optimizeExpressions)
+		{
+			np = optimizeExpressionTree(context, std::move(np));
+		}
+		if (np && !context.loops().empty())
+		{
+			recordLoopWrites(context, *np);
+		}
+		return np;
+	}
+
 	Expression<void>::Ptr buildVoidExpression(CompilerContext &context, TokensIterator &it)
 	{
 		return buildExpression<void>(TypeRegistry::getVoidHandle(), context, it, true);
@@ -1488,6 +3676,78 @@ namespace sharpsenLang
 		return buildExpression<Lvalue>(typeId, context, it, allow_comma);
 	}
 
+	Expression<void>::Ptr buildVoidExpression(CompilerContext &context, const NodePtr &np)
+	{
+		return buildExpression<void>(TypeRegistry::getVoidHandle(), context, np);
+	}
+
+	Expression<Number>::Ptr buildNumberExpression(CompilerContext &context, const NodePtr &np)
+	{
+		return buildExpression<Number>(TypeRegistry::getNumberHandle(), context, np);
+	}
+
+	Expression<Lvalue>::Ptr buildInitializationExpression(CompilerContext &context, const NodePtr &np, TypeHandle typeId)
+	{
+		return buildExpression<Lvalue>(typeId, context, np);
+	}
+
+	Expression<Lvalue>::Ptr buildReturnExpression(
+		CompilerContext &context,
+		TokensIterator &it,
+		TypeHandle returnTypeId,
+		Expression<void>::Ptr &tailCall)
+	{
+		size_t line_number = it->getLineNumber();
+		size_t char_index = it->getCharIndex();
+
+		try
+		{
+			NodePtr np = parseExpression(context, it, returnTypeId, true);
+
+			// Inlined bodies return to the function they are inlined into, and a
+			// call returning another type still has its result converted.
+			if (np && context.settings().eliminateTailCalls && !context.isInlining() &&
+				np->isNodeOperation() && np->getNodeOperation() == NodeOperation::Call &&
+				np->getTypeId() == returnTypeId)
+			{
+				tailCall = ExpressionBuilder<void>::buildTailCall(np, context);
+				if (tailCall)
+				{
+					return nullptr;
+				}
+			}
+			return buildLvalueExpression(returnTypeId, np, context);
+		}
+		catch (const ExpressionBuilderError &)
+		{
+			throw compilerError("Expression building failed", line_number, char_index);
+		}
+	}
+
+	UnboxedValue::operator bool() const
+	{
+		return number || integer;
+	}
+
+	Value UnboxedValue::evaluate(RuntimeContext &context) const
+	{
+		return number ? Value(number->evaluate(context)) : Value(integer->evaluate(context));
+	}
+
+	UnboxedValue findUnboxedValue(const Expression<Lvalue> &expr)
+	{
+		UnboxedValue ret;
+		if (const ParamExpression<Number> *param = dynamic_cast<const ParamExpression<Number> *>(&expr))
+		{
+			ret.number = &param->value();
+		}
+		else if (const ParamExpression<Integer> *param = dynamic_cast<const ParamExpression<Integer> *>(&expr))
+		{
+			ret.integer = &param->value();
+		}
+		return ret;
+	}
+
 	Expression<Lvalue>::Ptr buildDefaultInitialization(TypeHandle typeId)
 	{
 		return std::visit(
@@ -1497,9 +3757,14 @@ namespace sharpsenLang
 					switch (st)
 					{
 					case SimpleType::Number:
-						return Expression<Lvalue>::Ptr(std::make_unique<DefaultInitializationExpression<Number>>());
+						// Like an initialization with zero, so it can be stored unboxed.
+						return Expression<Lvalue>::Ptr(std::make_unique<ParamExpression<Number>>(
+							std::make_unique<ConstantExpression<Number, Number>>(0)));
 					case SimpleType::String:
 						return Expression<Lvalue>::Ptr(std::make_unique<DefaultInitializationExpression<String>>());
+					case SimpleType::Int:
+						return Expression<Lvalue>::Ptr(std::make_unique<ParamExpression<Integer>>(
+							std::make_unique<ConstantExpression<Integer, Integer>>(0)));
 					case SimpleType::Void:
 						return Expression<Lvalue>::Ptr(nullptr); //cannot happen
 					}
@@ -1,3 +1,5 @@
+#include <cmath>
+
 #include "ExpressionTree.hpp"
 #include "Helpers.hpp"
 #include "Errors.hpp"
@@ -63,11 +65,108 @@ namespace sharpsenLang
 											 }},
 								  *type_to);
 			}
-			return type_from == TypeRegistry::getNumberHandle() && type_to == TypeRegistry::getStringHandle();
+			const TypeHandle number_handle = TypeRegistry::getNumberHandle();
+			const TypeHandle int_handle = TypeRegistry::getIntHandle();
+			if (type_from == int_handle)
+			{
+				return type_to == number_handle || type_to == TypeRegistry::getStringHandle();
+			}
+			if (type_from == number_handle)
+			{
+				return type_to == TypeRegistry::getStringHandle();
+			}
+			return false;
+		}
+
+		bool isIntegerOperand(const Node &node)
+		{
+			if (node.getTypeId() == TypeRegistry::getIntHandle())
+			{
+				return true;
+			}
+			if (node.isNodeOperation() && node.getNodeOperation() == NodeOperation::Negative)
+			{
+				return isIntegerOperand(*node.getChildren()[0]);
+			}
+			return node.isNumber() && std::trunc(node.getNumber()) == node.getNumber() && std::fabs(node.getNumber()) < 0x1p63;
+		}
+
+		// Elements of an initializer list keep their type, apart from integral
+		// literals initializing ints.
+		bool isElementConvertible(const Node &node, TypeHandle type_to)
+		{
+			if (node.getTypeId() == type_to)
+			{
+				return true;
+			}
+			return type_to == TypeRegistry::getIntHandle() && node.getTypeId() == TypeRegistry::getNumberHandle() && isIntegerOperand(node);
+		}
+
+		// Numbers convert to ints only through toInt, apart from integral literals.
+		// The elements of an initializer list are checked one by one, so the
+		// literals in it may initialize ints.
+		bool isConvertible(const Node &node, TypeHandle type_to, bool lvalue_to)
+		{
+			if (lvalue_to)
+			{
+				return isConvertible(node.getTypeId(), node.isLvalue(), type_to, lvalue_to);
+			}
+			if (type_to == TypeRegistry::getIntHandle() && node.getTypeId() == TypeRegistry::getNumberHandle())
+			{
+				return isIntegerOperand(node);
+			}
+			if (node.isNodeOperation() && node.getNodeOperation() == NodeOperation::Init)
+			{
+				const NodeList &children = node.getChildren();
+				if (const ArrayType *at = std::get_if<ArrayType>(type_to))
+				{
+					for (const NodePtr &child : children)
+					{
+						if (!isElementConvertible(*child, at->innerTypeId))
+						{
+							return false;
+						}
+					}
+					return true;
+				}
+				if (const TupleType *tt = std::get_if<TupleType>(type_to))
+				{
+					if (tt->innerTypeId.size() != children.size())
+					{
+						return false;
+					}
+					for (size_t i = 0; i < children.size(); ++i)
+					{
+						if (!isElementConvertible(*children[i], tt->innerTypeId[i]))
+						{
+							return false;
+						}
+					}
+					return true;
+				}
+			}
+			return isConvertible(node.getTypeId(), node.isLvalue(), type_to, lvalue_to);
 		}
+
+		// The type of an operation that is computed on ints when its operands are.
+		TypeHandle arithmeticType(const Node &node1, const Node &node2)
+		{
+			return isIntegerOperation(node1, node2) ? TypeRegistry::getIntHandle() : TypeRegistry::getNumberHandle();
+		}
+
+		TypeHandle arithmeticType(const Node &node)
+		{
+			return node.getTypeId() == TypeRegistry::getIntHandle() ? TypeRegistry::getIntHandle() : TypeRegistry::getNumberHandle();
+		}
+	}
+
+	bool isIntegerOperation(const Node &node1, const Node &node2)
+	{
+		return (node1.getTypeId() == TypeRegistry::getIntHandle() || node2.getTypeId() == TypeRegistry::getIntHandle()) &&
+			   isIntegerOperand(node1) && isIntegerOperand(node2);
 	}
 
-	Node::Node(CompilerContext &context, NodeValue value, std::vector<NodePtr> children, size_t line_number, size_t char_index, bool canBeUndefined)
+	Node::Node(CompilerContext &context, NodeValue value, NodeList children, size_t line_number, size_t char_index, bool canBeUndefined)
 		: _value(std::move(value)),
 		  _children(std::move(children)),
 		  _lineNumber(line_number),
@@ -79,7 +178,7 @@ namespace sharpsenLang
 
 		std::visit(
 			overloaded{
-				[&](const std::string &value)
+				[&](std::string_view value)
 				{
 					_typeId = string_handle;
 					_lvalue = false;
@@ -91,7 +190,7 @@ namespace sharpsenLang
 				},
 				[&](const Identifier &value)
 				{
-					if (const IdentifierInfo *info = context.find(value.name))
+					if (const IdentifierInfo *info = context.find(std::string(value.name)))
 					{
 						_typeId = info->typeId();
 						_lvalue = (info->getScope() != IdentifierScope::Function);
@@ -105,7 +204,7 @@ namespace sharpsenLang
 						}
 						else
 						{
-							throw undeclaredError(value.name, _lineNumber, _charIndex);
+							throw undeclaredError(std::string(value.name), _lineNumber, _charIndex);
 						}
 					}
 				},
@@ -119,19 +218,23 @@ namespace sharpsenLang
 						break;
 					case NodeOperation::Preinc:
 					case NodeOperation::Predec:
-						_typeId = number_handle;
+						_typeId = arithmeticType(*_children[0]);
 						_lvalue = true;
-						_children[0]->checkConversion(number_handle, true);
+						_children[0]->checkConversion(_typeId, true);
 						break;
 					case NodeOperation::Postinc:
 					case NodeOperation::Postdec:
-						_typeId = number_handle;
+						_typeId = arithmeticType(*_children[0]);
 						_lvalue = false;
-						_children[0]->checkConversion(number_handle, true);
+						_children[0]->checkConversion(_typeId, true);
 						break;
 					case NodeOperation::Positive:
 					case NodeOperation::Negative:
 					case NodeOperation::Bnot:
+						_typeId = arithmeticType(*_children[0]);
+						_lvalue = false;
+						_children[0]->checkConversion(_typeId, false);
+						break;
 					case NodeOperation::Lnot:
 						_typeId = number_handle;
 						_lvalue = false;
@@ -145,10 +248,14 @@ namespace sharpsenLang
 						_typeId = string_handle;
 						_lvalue = false;
 						break;
+					case NodeOperation::ToInt:
+						_typeId = TypeRegistry::getIntHandle();
+						_lvalue = false;
+						_children[0]->checkConversion(number_handle, false);
+						break;
 					case NodeOperation::Add:
 					case NodeOperation::Sub:
 					case NodeOperation::Mul:
-					case NodeOperation::Div:
 					case NodeOperation::Idiv:
 					case NodeOperation::Mod:
 					case NodeOperation::Band:
@@ -156,6 +263,12 @@ namespace sharpsenLang
 					case NodeOperation::Bxor:
 					case NodeOperation::Bsl:
 					case NodeOperation::Bsr:
+						_typeId = arithmeticType(*_children[0], *_children[1]);
+						_lvalue = false;
+						_children[0]->checkConversion(_typeId, false);
+						_children[1]->checkConversion(_typeId, false);
+						break;
+					case NodeOperation::Div:
 					case NodeOperation::Land:
 					case NodeOperation::Lor:
 						_typeId = number_handle;
@@ -205,10 +318,10 @@ namespace sharpsenLang
 					case NodeOperation::BxorAssign:
 					case NodeOperation::BslAssign:
 					case NodeOperation::BsrAssign:
-						_typeId = number_handle;
+						_typeId = arithmeticType(*_children[0]);
 						_lvalue = true;
-						_children[0]->checkConversion(number_handle, true);
-						_children[1]->checkConversion(number_handle, false);
+						_children[0]->checkConversion(_typeId, true);
+						_children[1]->checkConversion(_typeId, false);
 						break;
 					case NodeOperation::ConcatAssign:
 						_typeId = string_handle;
@@ -257,9 +370,18 @@ namespace sharpsenLang
 						break;
 					case NodeOperation::Ternary:
 						_children[0]->checkConversion(number_handle, false);
-						if (isConvertible(
-								_children[2]->getTypeId(), _children[2]->isLvalue(),
-								_children[1]->getTypeId(), _children[1]->isLvalue()))
+						// An int and a number branch result in a number rather than an int,
+						// unless the number is an integral literal.
+						if (arithmeticType(*_children[1]) != arithmeticType(*_children[2]) &&
+							isConvertible(_children[1]->getTypeId(), false, number_handle, false) &&
+							isConvertible(_children[2]->getTypeId(), false, number_handle, false))
+						{
+							_typeId = arithmeticType(*_children[1], *_children[2]);
+							_lvalue = false;
+							_children[1]->checkConversion(_typeId, false);
+							_children[2]->checkConversion(_typeId, false);
+						}
+						else if (isConvertible(*_children[2], _children[1]->getTypeId(), _children[1]->isLvalue()))
 						{
 							_children[2]->checkConversion(_children[1]->getTypeId(), _children[1]->isLvalue());
 							_typeId = _children[1]->getTypeId();
@@ -328,7 +450,7 @@ namespace sharpsenLang
 									_lvalue = true;
 									return;
 								}
-								else if (const auto function = context.find(ct->name + "::" + name))
+								else if (const auto function = context.find(ct->name + "::" + std::string(name)))
 								{
 									if (const FunctionType *ft = std::get_if<FunctionType>(function->typeId()))
 									{
@@ -371,7 +493,7 @@ namespace sharpsenLang
 
 	bool Node::isString() const
 	{
-		return std::holds_alternative<std::string>(_value);
+		return std::holds_alternative<std::string_view>(_value);
 	}
 
 	NodeOperation Node::getNodeOperation() const
@@ -379,7 +501,7 @@ namespace sharpsenLang
 		return std::get<NodeOperation>(_value);
 	}
 
-	const std::string &Node::getIdentifier() const
+	std::string_view Node::getIdentifier() const
 	{
 		return std::get<Identifier>(_value).name;
 	}
@@ -391,14 +513,19 @@ namespace sharpsenLang
 
 	std::string_view Node::getString() const
 	{
-		return std::get<std::string>(_value);
+		return std::get<std::string_view>(_value);
 	}
 
-	const std::vector<NodePtr> &Node::getChildren() const
+	const NodeList &Node::getChildren() const
 	{
 		return _children;
 	}
 
+	NodePtr &Node::getChild(size_t idx)
+	{
+		return _children[idx];
+	}
+
 	TypeHandle Node::getTypeId() const
 	{
 		return _typeId;
@@ -419,12 +546,39 @@ namespace sharpsenLang
 		return _charIndex;
 	}
 
-	void Node::checkConversion(TypeHandle typeId, bool lvalue) const
+	void Node::checkConversion(TypeHandle typeId, bool lvalue)
 	{
-		if (!isConvertible(_typeId, _lvalue, typeId, lvalue))
+		if (!isConvertible(*this, typeId, lvalue))
 		{
 			throw wrongTypeError(std::to_string(_typeId), std::to_string(typeId), lvalue,
 								 _lineNumber, _charIndex);
 		}
+
+		// Elements of an initializer list are built by their own type, so the
+		// literals initializing ints become ints.
+		if (lvalue || !isNodeOperation() || getNodeOperation() != NodeOperation::Init)
+		{
+			return;
+		}
+		const ArrayType *at = std::get_if<ArrayType>(typeId);
+		const TupleType *tt = std::get_if<TupleType>(typeId);
+		if (!at && !tt)
+		{
+			return;
+		}
+		for (size_t i = 0; i < _children.size(); ++i)
+		{
+			_children[i]->_typeId = at ? at->innerTypeId : tt->innerTypeId[i];
+		}
+	}
+
+	NodePtr Node::create(CompilerContext &context, NodeValue value, NodeList children, size_t lineNumber, size_t charIndex, bool canBeUndefined)
+	{
+		return NodePtr(context.arena().create<Node>(context, std::move(value), std::move(children), lineNumber, charIndex, canBeUndefined));
+	}
+
+	NodeList Node::createList(CompilerContext &context)
+	{
+		return NodeList(ArenaAllocator<NodePtr>(context.arena()));
 	}
 }
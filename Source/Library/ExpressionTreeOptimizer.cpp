@@ -0,0 +1,445 @@
+#include <climits>
+#include <optional>
+#include <string>
+
+#include "ExpressionTreeOptimizer.hpp"
+#include "ExpressionTree.hpp"
+#include "CompilerContext.hpp"
+#include "Variable.hpp"
+
+namespace sharpsenLang
+{
+	bool isPure(const Node &node)
+	{
+		if (!node.isNodeOperation())
+		{
+			return true;
+		}
+		switch (node.getNodeOperation())
+		{
+		case NodeOperation::Idiv:
+		case NodeOperation::Mod:
+			// Ints raise an error when divided by zero.
+			if (node.getTypeId() == TypeRegistry::getIntHandle())
+			{
+				return false;
+			}
+			[[fallthrough]];
+		case NodeOperation::Positive:
+		case NodeOperation::Negative:
+		case NodeOperation::Bnot:
+		case NodeOperation::Lnot:
+		case NodeOperation::Size:
+		case NodeOperation::ToString:
+		case NodeOperation::ToInt:
+		case NodeOperation::Add:
+		case NodeOperation::Sub:
+		case NodeOperation::Mul:
+		case NodeOperation::Div:
+		case NodeOperation::Band:
+		case NodeOperation::Bor:
+		case NodeOperation::Bxor:
+		case NodeOperation::Bsl:
+		case NodeOperation::Bsr:
+		case NodeOperation::Concat:
+		case NodeOperation::Eq:
+		case NodeOperation::Ne:
+		case NodeOperation::Lt:
+		case NodeOperation::Gt:
+		case NodeOperation::Le:
+		case NodeOperation::Ge:
+		case NodeOperation::Land:
+		case NodeOperation::Lor:
+		case NodeOperation::Ternary:
+			for (const NodePtr &child : node.getChildren())
+			{
+				if (!isPure(*child))
+				{
+					return false;
+				}
+			}
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	namespace
+	{
+		size_t countNodes(const Node &node)
+		{
+			size_t ret = 1;
+			for (const NodePtr &child : node.getChildren())
+			{
+				ret += countNodes(*child);
+			}
+			return ret;
+		}
+
+		// Operations that go through int() are only folded where that conversion is defined.
+		bool isInt(Number n)
+		{
+			return n >= INT_MIN && n <= INT_MAX;
+		}
+
+		bool isNumberLiteral(const Node &node, Number n)
+		{
+			return node.isNumber() && node.getNumber() == n;
+		}
+
+		// Mirrors the runtime operators in Expression.cpp.
+		std::optional<Number> foldNumbers(NodeOperation op, Number t1, Number t2)
+		{
+			switch (op)
+			{
+			case NodeOperation::Add:
+				return t1 + t2;
+			case NodeOperation::Sub:
+				return t1 - t2;
+			case NodeOperation::Mul:
+				return t1 * t2;
+			case NodeOperation::Div:
+				return t1 / t2;
+			case NodeOperation::Idiv:
+				if (isInt(t1 / t2))
+				{
+					return int(t1 / t2);
+				}
+				return std::nullopt;
+			case NodeOperation::Mod:
+				if (isInt(t1 / t2))
+				{
+					return t1 - t2 * int(t1 / t2);
+				}
+				return std::nullopt;
+			case NodeOperation::Band:
+			case NodeOperation::Bor:
+			case NodeOperation::Bxor:
+				if (!isInt(t1) || !isInt(t2))
+				{
+					return std::nullopt;
+				}
+				if (op == NodeOperation::Band)
+				{
+					return int(t1) & int(t2);
+				}
+				else if (op == NodeOperation::Bor)
+				{
+					return int(t1) | int(t2);
+				}
+				return int(t1) ^ int(t2);
+			case NodeOperation::Bsl:
+			case NodeOperation::Bsr:
+				if (!isInt(t1) || !(t2 >= 0 && t2 < 32))
+				{
+					return std::nullopt;
+				}
+				return op == NodeOperation::Bsl ? int(t1) << int(t2) : int(t1) >> int(t2);
+			case NodeOperation::Eq:
+				return !(t1 < t2) && !(t2 < t1);
+			case NodeOperation::Ne:
+				return (t1 < t2) || (t2 < t1);
+			case NodeOperation::Lt:
+				return t1 < t2;
+			case NodeOperation::Gt:
+				return t2 < t1;
+			case NodeOperation::Le:
+				return !(t2 < t1);
+			case NodeOperation::Ge:
+				return !(t1 < t2);
+			case NodeOperation::Land:
+				return t1 && t2;
+			case NodeOperation::Lor:
+				return t1 || t2;
+			default:
+				return std::nullopt;
+			}
+		}
+
+		std::optional<Number> compareStrings(NodeOperation op, std::string_view s1, std::string_view s2)
+		{
+			switch (op)
+			{
+			case NodeOperation::Eq:
+				return s1 == s2;
+			case NodeOperation::Ne:
+				return s1 != s2;
+			case NodeOperation::Lt:
+				return s1 < s2;
+			case NodeOperation::Gt:
+				return s2 < s1;
+			case NodeOperation::Le:
+				return !(s2 < s1);
+			case NodeOperation::Ge:
+				return !(s1 < s2);
+			default:
+				return std::nullopt;
+			}
+		}
+
+		std::optional<std::string> literalToString(const Node &node)
+		{
+			if (node.isString())
+			{
+				return std::string(node.getString());
+			}
+			if (node.isNumber())
+			{
+				return *convertToString(node.getNumber());
+			}
+			return std::nullopt;
+		}
+
+		class Optimizer
+		{
+		private:
+			CompilerContext &_context;
+			size_t _removed;
+
+			NodePtr replace(NodePtr np, NodeValue value)
+			{
+				_removed += countNodes(*np) - 1;
+				return Node::create(_context, std::move(value), Node::createList(_context), np->getLineNumber(), np->getCharIndex());
+			}
+
+			NodePtr replaceWithChild(NodePtr np, size_t idx)
+			{
+				size_t count = countNodes(*np);
+				NodePtr child = std::move(np->getChild(idx));
+				_removed += count - countNodes(*child);
+				return child;
+			}
+
+			NodePtr foldUnary(NodePtr np)
+			{
+				const Node &child = *np->getChildren()[0];
+				if (np->getNodeOperation() == NodeOperation::Positive)
+				{
+					return replaceWithChild(std::move(np), 0);
+				}
+				if (np->getNodeOperation() == NodeOperation::ToString)
+				{
+					if (child.isString())
+					{
+						return replaceWithChild(std::move(np), 0);
+					}
+					if (std::optional<std::string> str = literalToString(child))
+					{
+						return replace(std::move(np), _context.arena().copyString(*str));
+					}
+					return np;
+				}
+				// Negated literals in an initializer list of ints are ints and have to stay so.
+				if (!child.isNumber() || np->getTypeId() != TypeRegistry::getNumberHandle())
+				{
+					return np;
+				}
+				Number n = child.getNumber();
+				switch (np->getNodeOperation())
+				{
+				case NodeOperation::Negative:
+					return replace(std::move(np), -n);
+				case NodeOperation::Lnot:
+					return replace(std::move(np), Number(!n));
+				case NodeOperation::Bnot:
+					if (isInt(n))
+					{
+						return replace(std::move(np), Number(~int(n)));
+					}
+					return np;
+				default:
+					return np;
+				}
+			}
+
+			NodePtr foldBinary(NodePtr np)
+			{
+				NodeOperation op = np->getNodeOperation();
+				const Node &left = *np->getChildren()[0];
+				const Node &right = *np->getChildren()[1];
+
+				if (left.isNumber() && right.isNumber())
+				{
+					if (std::optional<Number> n = foldNumbers(op, left.getNumber(), right.getNumber()))
+					{
+						return replace(std::move(np), *n);
+					}
+					return np;
+				}
+				if (left.isString() && right.isString())
+				{
+					if (std::optional<Number> n = compareStrings(op, left.getString(), right.getString()))
+					{
+						return replace(std::move(np), *n);
+					}
+					return np;
+				}
+
+				// x + 0 ignores the sign of a negative zero x, which only shows through 1 / x.
+				// Only applies where x already has the result type, so an int x / 1 stays a number.
+				auto keeps = [&np](const Node &child)
+				{
+					return child.getTypeId() == np->getTypeId();
+				};
+				switch (op)
+				{
+				case NodeOperation::Add:
+					if (isNumberLiteral(right, 0) && keeps(left))
+					{
+						return replaceWithChild(std::move(np), 0);
+					}
+					if (isNumberLiteral(left, 0) && keeps(right))
+					{
+						return replaceWithChild(std::move(np), 1);
+					}
+					break;
+				case NodeOperation::Sub:
+					if (isNumberLiteral(right, 0) && keeps(left))
+					{
+						return replaceWithChild(std::move(np), 0);
+					}
+					break;
+				case NodeOperation::Mul:
+					if (isNumberLiteral(right, 1) && keeps(left))
+					{
+						return replaceWithChild(std::move(np), 0);
+					}
+					if (isNumberLiteral(left, 1) && keeps(right))
+					{
+						return replaceWithChild(std::move(np), 1);
+					}
+					break;
+				case NodeOperation::Div:
+					if (isNumberLiteral(right, 1) && keeps(left))
+					{
+						return replaceWithChild(std::move(np), 0);
+					}
+					break;
+				case NodeOperation::Land:
+					if ((left.isNumber() && !left.getNumber()) ||
+						(right.isNumber() && !right.getNumber() && isPure(left)))
+					{
+						return replace(std::move(np), Number(0));
+					}
+					break;
+				case NodeOperation::Lor:
+					if ((left.isNumber() && left.getNumber()) ||
+						(right.isNumber() && right.getNumber() && isPure(left)))
+					{
+						return replace(std::move(np), Number(1));
+					}
+					break;
+				default:
+					break;
+				}
+				return np;
+			}
+
+			NodePtr foldConcat(NodePtr np)
+			{
+				const Node &left = *np->getChildren()[0];
+				const Node &right = *np->getChildren()[1];
+				std::optional<std::string> s1 = literalToString(left);
+				std::optional<std::string> s2 = literalToString(right);
+
+				if (s1 && s2)
+				{
+					return replace(std::move(np), _context.arena().copyString(*s1 + *s2));
+				}
+				if (s2 && s2->empty() && left.getTypeId() == np->getTypeId())
+				{
+					return replaceWithChild(std::move(np), 0);
+				}
+				if (s1 && s1->empty() && right.getTypeId() == np->getTypeId())
+				{
+					return replaceWithChild(std::move(np), 1);
+				}
+				return np;
+			}
+
+			NodePtr foldTernary(NodePtr np)
+			{
+				const Node &condition = *np->getChildren()[0];
+				if (!condition.isNumber())
+				{
+					return np;
+				}
+				size_t idx = condition.getNumber() ? 1 : 2;
+				if (np->getChildren()[idx]->getTypeId() != np->getTypeId())
+				{
+					return np;
+				}
+				return replaceWithChild(std::move(np), idx);
+			}
+
+		public:
+			Optimizer(CompilerContext &context)
+				: _context(context),
+				  _removed(0)
+			{
+			}
+
+			size_t removed() const
+			{
+				return _removed;
+			}
+
+			NodePtr optimize(NodePtr np)
+			{
+				if (!np->isNodeOperation())
+				{
+					return np;
+				}
+
+				for (size_t i = 0; i < np->getChildren().size(); ++i)
+				{
+					np->getChild(i) = optimize(std::move(np->getChild(i)));
+				}
+
+				switch (np->getNodeOperation())
+				{
+				case NodeOperation::Positive:
+				case NodeOperation::Negative:
+				case NodeOperation::Bnot:
+				case NodeOperation::Lnot:
+				case NodeOperation::ToString:
+					return foldUnary(std::move(np));
+				case NodeOperation::Add:
+				case NodeOperation::Sub:
+				case NodeOperation::Mul:
+				case NodeOperation::Div:
+				case NodeOperation::Idiv:
+				case NodeOperation::Mod:
+				case NodeOperation::Band:
+				case NodeOperation::Bor:
+				case NodeOperation::Bxor:
+				case NodeOperation::Bsl:
+				case NodeOperation::Bsr:
+				case NodeOperation::Eq:
+				case NodeOperation::Ne:
+				case NodeOperation::Lt:
+				case NodeOperation::Gt:
+				case NodeOperation::Le:
+				case NodeOperation::Ge:
+				case NodeOperation::Land:
+				case NodeOperation::Lor:
+					return foldBinary(std::move(np));
+				case NodeOperation::Concat:
+					return foldConcat(std::move(np));
+				case NodeOperation::Ternary:
+					return foldTernary(std::move(np));
+				default:
+					return np;
+				}
+			}
+		};
+	}
+
+	NodePtr optimizeExpressionTree(CompilerContext &context, NodePtr np)
+	{
+		Optimizer optimizer(context);
+		np = optimizer.optimize(std::move(np));
+		context.counters().addRemovedNodes(optimizer.removed());
+		return np;
+	}
+}
@@ -2,6 +2,7 @@
 
 #include "ExpressionTreeParser.hpp"
 #include "ExpressionTree.hpp"
+#include "CompilerContext.hpp"
 #include "Tokenizer.hpp"
 #include "Tokens.hpp"
 #include "Errors.hpp"
@@ -71,6 +72,7 @@ namespace sharpsenLang
 				case NodeOperation::Lnot:
 				case NodeOperation::Size:
 				case NodeOperation::ToString:
+				case NodeOperation::ToInt:
 					precedence = OperatorPrecedence::Prefix;
 					break;
 				case NodeOperation::Mul:
@@ -160,6 +162,7 @@ namespace sharpsenLang
 				case NodeOperation::Lnot:
 				case NodeOperation::Size:
 				case NodeOperation::ToString:
+				case NodeOperation::ToInt:
 				case NodeOperation::Call: //at least one
 					number_of_operands = 1;
 					break;
@@ -220,7 +223,7 @@ namespace sharpsenLang
 			case ReservedToken::ConcatAssign:
 				return OperatorInfo(NodeOperation::ConcatAssign, lineNumber, charIndex);
 			case ReservedToken::MulAssign:
-				return OperatorInfo(NodeOperation::ModAssign, lineNumber, charIndex);
+				return OperatorInfo(NodeOperation::MulAssign, lineNumber, charIndex);
 			case ReservedToken::DivAssign:
 				return OperatorInfo(NodeOperation::DivAssign, lineNumber, charIndex);
 			case ReservedToken::IdivAssign:
@@ -269,6 +272,8 @@ namespace sharpsenLang
 				return OperatorInfo(NodeOperation::Size, lineNumber, charIndex);
 			case ReservedToken::KwToString:
 				return OperatorInfo(NodeOperation::ToString, lineNumber, charIndex);
+			case ReservedToken::KwToInt:
+				return OperatorInfo(NodeOperation::ToInt, lineNumber, charIndex);
 			case ReservedToken::OpenCurly:
 				return OperatorInfo(NodeOperation::Init, lineNumber, charIndex);
 			default:
@@ -308,16 +313,23 @@ namespace sharpsenLang
 			return l.associativity == OperatorAssociativity::LeftToRight ? l.precedence <= r.precedence : l.precedence < r.precedence;
 		}
 
+		// Text in the source outlives compilation. Text the token built up itself is
+		// released once the iterator moves on, so the node gets a copy.
+		std::string_view tokenText(CompilerContext &context, const Token &token, std::string_view text)
+		{
+			return token.ownsText() ? context.arena().copyString(text) : text;
+		}
+
 		void popOneOperator(
 			std::stack<OperatorInfo> &operatorStack, std::stack<NodePtr> &operandStack,
 			CompilerContext &context, size_t lineNumber, size_t charIndex)
 		{
-			if (operandStack.size() < operatorStack.top().number_of_operands)
+			if (operandStack.size() < size_t(operatorStack.top().number_of_operands))
 			{
 				throw compilerError("Failed to parse an expression", lineNumber, charIndex);
 			}
 
-			std::vector<NodePtr> operands;
+			NodeList operands = Node::createList(context);
 			operands.resize(operatorStack.top().number_of_operands);
 
 			if (operatorStack.top().precedence != OperatorPrecedence::Prefix)
@@ -332,7 +344,7 @@ namespace sharpsenLang
 				operandStack.pop();
 			}
 
-			operandStack.push(std::make_unique<Node>(
+			operandStack.push(Node::create(
 				context, operatorStack.top().operation, std::move(operands), operatorStack.top().lineNumber, operatorStack.top().charIndex));
 
 			operatorStack.pop();
@@ -378,7 +390,7 @@ namespace sharpsenLang
 					if (oi.operation == NodeOperation::Init && expectedOperand)
 					{
 						++it;
-						std::vector<NodePtr> children;
+						NodeList children = Node::createList(context);
 						if (!it->hasValue(ReservedToken::CloseCurly))
 						{
 							while (true)
@@ -398,7 +410,7 @@ namespace sharpsenLang
 								}
 							}
 						}
-						operandStack.push(std::make_unique<Node>(
+						operandStack.push(Node::create(
 							context,
 							NodeOperation::Init,
 							std::move(children),
@@ -440,9 +452,9 @@ namespace sharpsenLang
 								{
 									size_t lineNumber = argument->getLineNumber();
 									size_t charIndex = argument->getCharIndex();
-									std::vector<NodePtr> argumentVector;
+									NodeList argumentVector = Node::createList(context);
 									argumentVector.push_back(std::move(argument));
-									argument = std::make_unique<Node>(
+									argument = Node::create(
 										context,
 										NodeOperation::Param,
 										std::move(argumentVector),
@@ -513,18 +525,18 @@ namespace sharpsenLang
 					}
 					if (it->isNumber())
 					{
-						operandStack.push(std::make_unique<Node>(
-							context, it->getNumber(), std::vector<NodePtr>(), it->getLineNumber(), it->getCharIndex()));
+						operandStack.push(Node::create(
+							context, it->getNumber(), Node::createList(context), it->getLineNumber(), it->getCharIndex()));
 					}
 					else if (it->isString())
 					{
-						operandStack.push(std::make_unique<Node>(
-							context, it->getString(), std::vector<NodePtr>(), it->getLineNumber(), it->getCharIndex()));
+						operandStack.push(Node::create(
+							context, tokenText(context, *it, it->getString()), Node::createList(context), it->getLineNumber(), it->getCharIndex()));
 					}
 					else
 					{
-						operandStack.push(std::make_unique<Node>(
-							context, it->getIdentifier(), std::vector<NodePtr>(), it->getLineNumber(), it->getCharIndex(), objectOperation));
+						operandStack.push(Node::create(
+							context, Identifier{tokenText(context, *it, it->getIdentifier().name)}, Node::createList(context), it->getLineNumber(), it->getCharIndex(), objectOperation));
 					}
 					objectOperation = false;
 					expectedOperand = false;
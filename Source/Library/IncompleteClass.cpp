@@ -15,7 +15,7 @@ namespace sharpsenLang
 				throw "todo error";
 			}
 
-			std::string ret = it->getIdentifier().name;
+			std::string ret(it->getIdentifier().name);
 
 			++it;
 
@@ -1,11 +1,115 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <optional>
+
 #include "IncompleteFunction.hpp"
 #include "Compiler.hpp"
 #include "CompilerContext.hpp"
 #include "Errors.hpp"
 #include "Tokenizer.hpp"
+#include "Bytecode.hpp"
+#include "RuntimeContext.hpp"
+#include "ModuleSettings.hpp"
 
 namespace sharpsenLang
 {
+	namespace
+	{
+		struct LazyFunction
+		{
+			std::shared_ptr<CompilerContext> context;
+			std::optional<IncompleteFunction> function;
+			Function fallback;
+			std::mutex mutex;
+			std::atomic<bool> ready = false;
+			Function compiled;
+			std::string error;
+
+			void compile()
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (ready.load(std::memory_order_relaxed))
+				{
+					return;
+				}
+
+				runtimeAssertion(error.empty(), error.c_str());
+
+				try
+				{
+					// Programs may be shared between threads, so every body gets its own
+					// locals and arena instead of the context used for loading.
+					compiled = function->compile(*context->fork());
+				}
+				catch (const Error &e)
+				{
+					if (fallback)
+					{
+						compiled = std::move(fallback);
+						function.reset();
+						context.reset();
+						ready.store(true, std::memory_order_release);
+						return;
+					}
+					error = "Error in function '" + function->getDecl().name +
+							"' at line " + std::to_string(e.lineNumber() + 1) + ": " + e.what();
+					function.reset();
+					context.reset();
+					throw RuntimeError(error);
+				}
+
+				function.reset();
+				context.reset();
+				ready.store(true, std::memory_order_release);
+			}
+		};
+
+		// Copies of the tokens whose identifiers and strings point into one
+		// buffer of their own instead of into the source.
+		std::deque<Token> copyTokenText(const std::deque<Token> &tokens)
+		{
+			std::shared_ptr<std::string> text = std::make_shared<std::string>();
+			for (const Token &token : tokens)
+			{
+				if (token.isIdentifier())
+				{
+					*text += token.getIdentifier().name;
+				}
+				else if (token.isString())
+				{
+					*text += token.getString();
+				}
+			}
+
+			std::shared_ptr<const std::string> storage = std::move(text);
+			std::deque<Token> ret;
+			size_t offset = 0;
+			auto view = [&](size_t size)
+			{
+				std::string_view ret(storage->data() + offset, size);
+				offset += size;
+				return ret;
+			};
+			for (const Token &token : tokens)
+			{
+				if (token.isIdentifier())
+				{
+					ret.emplace_back(Identifier{view(token.getIdentifier().name.size())}, storage, token.getLineNumber(), token.getCharIndex());
+				}
+				else if (token.isString())
+				{
+					ret.emplace_back(view(token.getString().size()), storage, token.getLineNumber(), token.getCharIndex());
+				}
+				else
+				{
+					ret.push_back(token);
+				}
+			}
+			return ret;
+		}
+	}
+
 	FunctionDeclaration parseFunctionDeclaration(CompilerContext &ctx, TokensIterator &it)
 	{
 		FunctionDeclaration ret;
@@ -92,8 +196,16 @@ namespace sharpsenLang
 		ctx.createFunction(_decl.name, _decl.typeId);
 	}
 
+	IncompleteFunction::IncompleteFunction(const FunctionBody &body, Specializations::Bindings bindings)
+		: _decl(body.decl),
+		  _tokens(body.tokens),
+		  _bindings(std::move(bindings))
+	{
+	}
+
 	IncompleteFunction::IncompleteFunction(IncompleteFunction &&orig) noexcept : _tokens(std::move(orig._tokens)),
-																				 _decl(std::move(orig._decl))
+																				 _decl(std::move(orig._decl)),
+																				 _bindings(std::move(orig._bindings))
 	{
 	}
 
@@ -115,20 +227,140 @@ namespace sharpsenLang
 
 		if (_decl.isMethod())
 		{
-			ctx.createParam("this", _decl.parentTypeId);
+			ctx.createParam("this", _decl.parentTypeId, true);
 		}
 		for (int i = 0; i < int(_decl.params.size()); ++i)
 		{
-			ctx.createParam(std::move(_decl.params[i]), ft->paramTypeId[i].typeId);
+			if (!_bindings.empty() && _bindings[i] != Specializations::NoBinding)
+			{
+				ctx.bindParam(std::move(_decl.params[i]), ft->paramTypeId[i].typeId, _bindings[i]);
+			}
+			else
+			{
+				ctx.createParam(std::move(_decl.params[i]), ft->paramTypeId[i].typeId, ft->paramTypeId[i].byRef);
+			}
 		}
 
 		TokensIterator it(_tokens);
 
 		SharedStatementPtr stmt = compileFunctionBlock(ctx, it, ft->returnTypeId);
+		size_t frameSize = ctx.frameSize();
+
+		if (!_bindings.empty())
+		{
+			ctx.counters().addSpecialization();
+		}
+
+		if (ctx.settings().engine == ExecutionEngine::Vm)
+		{
+			return createBytecodeFunction(std::move(stmt), frameSize);
+		}
 
-		return [stmt = std::move(stmt)](RuntimeContext &ctx)
+		return [stmt = std::move(stmt), frameSize](RuntimeContext &ctx)
 		{
+			ctx.enterFrame(frameSize);
 			stmt->execute(ctx);
 		};
 	}
+
+	std::shared_ptr<const FunctionBody> IncompleteFunction::body(const ModuleSettings &settings) const
+	{
+		if (_decl.isMethod())
+		{
+			return nullptr;
+		}
+
+		const FunctionType *ft = std::get_if<FunctionType>(_decl.typeId);
+		std::shared_ptr<FunctionBody> ret = std::make_shared<FunctionBody>();
+
+		// The braces around the body don't count towards its size.
+		ret->inlinable = settings.inlineThreshold && _tokens.size() <= settings.inlineThreshold + 2;
+
+		for (size_t i = 0; i < _decl.params.size(); ++i)
+		{
+			ret->bindableParams.push_back(
+				settings.specializeFunctionArguments &&
+				!ft->paramTypeId[i].byRef &&
+				std::holds_alternative<FunctionType>(*ft->paramTypeId[i].typeId));
+		}
+
+		size_t semicolons = 0;
+		for (const Token &token : _tokens)
+		{
+			semicolons += token.hasValue(ReservedToken::Semicolon);
+
+			if (!token.isIdentifier())
+			{
+				continue;
+			}
+			if (token.getIdentifier().name == _decl.name)
+			{
+				ret->inlinable = false;
+			}
+		}
+
+		if (!ret->inlinable && std::find(ret->bindableParams.begin(), ret->bindableParams.end(), true) == ret->bindableParams.end())
+		{
+			return nullptr;
+		}
+
+		ret->decl = _decl;
+		// Specialized copies are compiled on their first call, after the source
+		// may be gone, so their bodies keep the text they need.
+		if (settings.specializeFunctionArguments && settings.engine == ExecutionEngine::Tree)
+		{
+			ret->tokens = copyTokenText(_tokens);
+		}
+		else
+		{
+			ret->tokens = _tokens;
+		}
+		ret->expressionBody =
+			ft->returnTypeId != TypeRegistry::getVoidHandle() &&
+			_tokens.size() > 3 &&
+			_tokens[1].hasValue(ReservedToken::KwReturn) &&
+			_tokens[_tokens.size() - 2].hasValue(ReservedToken::Semicolon) &&
+			semicolons == 1;
+		return ret;
+	}
+
+	Function createLazyFunction(std::shared_ptr<CompilerContext> ctx, IncompleteFunction function, Function fallback)
+	{
+		std::shared_ptr<LazyFunction> lazy = std::make_shared<LazyFunction>();
+		lazy->context = std::move(ctx);
+		lazy->function.emplace(std::move(function));
+		lazy->fallback = std::move(fallback);
+
+		return [lazy = std::move(lazy)](RuntimeContext &context)
+		{
+			if (!lazy->ready.load(std::memory_order_acquire))
+			{
+				lazy->compile();
+			}
+			lazy->compiled(context);
+		};
+	}
+
+	Function createUnspecializedCall(size_t functionIndex, Specializations::Bindings bindings)
+	{
+		return [functionIndex, bindings = std::move(bindings)](RuntimeContext &context)
+		{
+			// The specialization's arguments are its params, in order.
+			context.reserveArguments(bindings.size());
+			int param = -1;
+			for (size_t i = 0; i < bindings.size(); ++i)
+			{
+				if (bindings[i] == Specializations::NoBinding)
+				{
+					context.argument(i) = std::move(context.localValue(param--));
+				}
+				else
+				{
+					VariablePtr f = createVariable<Function>(context.getFunction(int(bindings[i])));
+					context.argument(i) = Value(std::move(f));
+				}
+			}
+			context.retvalValue() = context.callFrame(context.getFunction(int(functionIndex)), bindings.size());
+		};
+	}
 }
@@ -0,0 +1,430 @@
+#include "LoopOptimizer.hpp"
+#include "ExpressionTree.hpp"
+#include "ExpressionTreeOptimizer.hpp"
+#include "Tokenizer.hpp"
+
+namespace sharpsenLang
+{
+	namespace
+	{
+		// Globals and reference parameters may name the same variable as another identifier.
+		bool isAliasable(const IdentifierInfo &info)
+		{
+			return info.getScope() == IdentifierScope::GlobalVariable || info.isReference();
+		}
+
+		// Records the variable an lvalue expression ends up writing, as a whole or
+		// only through an element or member.
+		void recordWrite(CompilerContext &context, const Node &node, bool whole = true)
+		{
+			if (node.isIdentifier())
+			{
+				const IdentifierInfo *info = context.find(std::string(node.getIdentifier()));
+				if (!info)
+				{
+					return;
+				}
+				for (LoopWrites *writes : context.loops())
+				{
+					writes->identifiers.insert(info);
+					if (whole)
+					{
+						writes->replaced.insert(info);
+						writes->aliasedReplaced = writes->aliasedReplaced || isAliasable(*info);
+					}
+					writes->aliased = writes->aliased || isAliasable(*info);
+				}
+				return;
+			}
+			if (!node.isNodeOperation())
+			{
+				return;
+			}
+
+			const NodeList &children = node.getChildren();
+			switch (node.getNodeOperation())
+			{
+			case NodeOperation::Ternary:
+				recordWrite(context, *children[1], whole);
+				recordWrite(context, *children[2], whole);
+				break;
+			case NodeOperation::Comma:
+				recordWrite(context, *children.back(), whole);
+				break;
+			case NodeOperation::Index:
+			case NodeOperation::Get:
+				recordWrite(context, *children[0], false);
+				break;
+			case NodeOperation::Preinc:
+			case NodeOperation::Predec:
+			case NodeOperation::Assign:
+			case NodeOperation::AddAssign:
+			case NodeOperation::SubAssign:
+			case NodeOperation::MulAssign:
+			case NodeOperation::DivAssign:
+			case NodeOperation::IdivAssign:
+			case NodeOperation::ModAssign:
+			case NodeOperation::BandAssign:
+			case NodeOperation::BorAssign:
+			case NodeOperation::BxorAssign:
+			case NodeOperation::BslAssign:
+			case NodeOperation::BsrAssign:
+			case NodeOperation::ConcatAssign:
+				recordWrite(context, *children[0]);
+				break;
+			default:
+				break;
+			}
+		}
+
+		bool isToken(const Token *token, ReservedToken value)
+		{
+			return token && token->hasValue(value);
+		}
+
+		bool isLiteral(const Token *token, Number min)
+		{
+			return token && token->isNumber() && token->getNumber() >= min;
+		}
+
+		bool isName(const Token *token, std::string_view name)
+		{
+			return token && token->isIdentifier() && token->getIdentifier().name == name;
+		}
+	}
+
+	void recordLoopWrites(CompilerContext &context, const Node &node)
+	{
+		if (!node.isNodeOperation())
+		{
+			return;
+		}
+
+		const NodeList &children = node.getChildren();
+		switch (node.getNodeOperation())
+		{
+		case NodeOperation::Preinc:
+		case NodeOperation::Predec:
+		case NodeOperation::Postinc:
+		case NodeOperation::Postdec:
+		case NodeOperation::Assign:
+		case NodeOperation::AddAssign:
+		case NodeOperation::SubAssign:
+		case NodeOperation::MulAssign:
+		case NodeOperation::DivAssign:
+		case NodeOperation::IdivAssign:
+		case NodeOperation::ModAssign:
+		case NodeOperation::BandAssign:
+		case NodeOperation::BorAssign:
+		case NodeOperation::BxorAssign:
+		case NodeOperation::BslAssign:
+		case NodeOperation::BsrAssign:
+		case NodeOperation::ConcatAssign:
+			recordWrite(context, *children[0]);
+			break;
+		// Reading past the end of an array grows it.
+		case NodeOperation::Index:
+			recordWrite(context, *children[0], false);
+			break;
+		case NodeOperation::Call:
+			// The callee may write any global and the arguments passed by reference.
+			for (LoopWrites *writes : context.loops())
+			{
+				writes->aliased = true;
+				writes->aliasedReplaced = true;
+			}
+			if (children[0]->isNodeOperation() && children[0]->getNodeOperation() == NodeOperation::Get)
+			{
+				recordWrite(context, *children[0]->getChildren()[0]);
+			}
+			for (size_t i = 1; i < children.size(); ++i)
+			{
+				if (!children[i]->isNodeOperation() || children[i]->getNodeOperation() != NodeOperation::Param)
+				{
+					recordWrite(context, *children[i]);
+				}
+			}
+			break;
+		default:
+			break;
+		}
+
+		for (const NodePtr &child : children)
+		{
+			recordLoopWrites(context, *child);
+		}
+	}
+
+	LoopInvariants::LoopInvariants(CompilerContext &context)
+		: _context(context),
+		  _slot(0)
+	{
+		_context.enterLoop(_writes);
+	}
+
+	LoopInvariants::~LoopInvariants()
+	{
+		_context.leaveLoop();
+	}
+
+	void LoopInvariants::parseCondition(TokensIterator &it)
+	{
+		_condition = parseExpression(_context, it, TypeRegistry::getNumberHandle(), true);
+	}
+
+	void LoopInvariants::parseStep(TokensIterator &it)
+	{
+		_step = parseExpression(_context, it, TypeRegistry::getVoidHandle(), true);
+	}
+
+	bool LoopInvariants::isInvariant(const Node &node) const
+	{
+		if (node.isIdentifier())
+		{
+			const IdentifierInfo *info = _context.find(std::string(node.getIdentifier()));
+			if (!info || info->getScope() == IdentifierScope::Function)
+			{
+				return info != nullptr;
+			}
+			return _writes.identifiers.count(info) == 0 && !(_writes.aliased && isAliasable(*info));
+		}
+		for (const NodePtr &child : node.getChildren())
+		{
+			if (!isInvariant(*child))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void LoopInvariants::collectCandidates(NodePtr &np, size_t enclosing)
+	{
+		if (!np || !np->isNodeOperation())
+		{
+			return;
+		}
+		if (np->getTypeId() == TypeRegistry::getNumberHandle() && !np->isLvalue() && isPure(*np) && isInvariant(*np))
+		{
+			_candidates.push_back(Candidate{&np, enclosing});
+			enclosing = _candidates.size() - 1;
+		}
+		// The loop may never evaluate the right operand of a logical operator or
+		// a branch of a ternary, so only their first operand is searched.
+		size_t searched = np->getChildren().size();
+		switch (np->getNodeOperation())
+		{
+		case NodeOperation::Land:
+		case NodeOperation::Lor:
+		case NodeOperation::Ternary:
+			searched = 1;
+			break;
+		default:
+			break;
+		}
+		for (size_t i = 0; i < searched; ++i)
+		{
+			collectCandidates(np->getChild(i), enclosing);
+		}
+	}
+
+	void LoopInvariants::reserve()
+	{
+		if (!_context.settings().hoistLoopInvariants)
+		{
+			return;
+		}
+
+		_slot = _context.nextLocalSlot();
+
+		// The body may still write what the outer candidates use, so their parts
+		// are candidates too.
+		collectCandidates(_condition, noCandidate);
+		collectCandidates(_step, noCandidate);
+
+		for (size_t i = 0; i < _candidates.size(); ++i)
+		{
+			// Not a valid identifier, so it can't clash with the script's own.
+			_slots.push_back("@invariant" + std::to_string(i));
+			_context.createIdentifier(_slots.back(), TypeRegistry::getNumberHandle());
+		}
+	}
+
+	void LoopInvariants::hoist()
+	{
+		_hoisted.resize(_candidates.size());
+		std::vector<bool> covered(_candidates.size(), false);
+		for (size_t i = 0; i < _candidates.size(); ++i)
+		{
+			// Candidates precede the ones inside them, which are hoisted along with them.
+			size_t enclosing = _candidates[i].enclosing;
+			if (enclosing != noCandidate && (covered[enclosing] || _hoisted[enclosing]))
+			{
+				covered[i] = true;
+				continue;
+			}
+
+			NodePtr &np = *_candidates[i].node;
+			if (!isInvariant(*np))
+			{
+				continue;
+			}
+
+			size_t lineNumber = np->getLineNumber();
+			size_t charIndex = np->getCharIndex();
+			_hoisted[i] = std::move(np);
+			np = Node::create(_context, Identifier{_context.arena().copyString(_slots[i])}, Node::createList(_context), lineNumber, charIndex);
+			_context.counters().addHoistedExpression();
+		}
+	}
+
+	Expression<Number>::Ptr LoopInvariants::buildCondition()
+	{
+		hoist();
+		return buildNumberExpression(_context, _condition);
+	}
+
+	Expression<void>::Ptr LoopInvariants::buildStep()
+	{
+		return buildVoidExpression(_context, _step);
+	}
+
+	size_t LoopInvariants::slot() const
+	{
+		return _slot;
+	}
+
+	std::vector<Expression<Lvalue>::Ptr> LoopInvariants::initializers()
+	{
+		std::vector<Expression<Lvalue>::Ptr> ret;
+		for (const NodePtr &np : _hoisted)
+		{
+			if (np)
+			{
+				ret.push_back(buildInitializationExpression(_context, np, TypeRegistry::getNumberHandle()));
+			}
+			else
+			{
+				ret.push_back(buildDefaultInitialization(TypeRegistry::getNumberHandle()));
+			}
+		}
+		return ret;
+	}
+
+	CountedLoop::CountedLoop(CompilerContext &context, const TokensIterator &it)
+		: _context(context),
+		  _matched(context.settings().eliminateBoundsChecks && match(it)),
+		  _entered(false)
+	{
+	}
+
+	CountedLoop::~CountedLoop()
+	{
+		leaveBody();
+	}
+
+	bool CountedLoop::match(const TokensIterator &it)
+	{
+		// number i = c;
+		if (!isToken(it.lookAhead(0), ReservedToken::KwNumber) || !it.lookAhead(1) || !it.lookAhead(1)->isIdentifier() ||
+			!isToken(it.lookAhead(2), ReservedToken::Assign) || !isLiteral(it.lookAhead(3), 0) ||
+			!isToken(it.lookAhead(4), ReservedToken::Semicolon))
+		{
+			return false;
+		}
+		_counter = it.lookAhead(1)->getIdentifier().name;
+
+		// i < sizeof(a) - d;
+		bool inclusive = isToken(it.lookAhead(6), ReservedToken::Le);
+		if (!isName(it.lookAhead(5), _counter) || (!inclusive && !isToken(it.lookAhead(6), ReservedToken::Lt)) ||
+			!isToken(it.lookAhead(7), ReservedToken::KwSizeof) || !isToken(it.lookAhead(8), ReservedToken::OpenRound) ||
+			!it.lookAhead(9) || !it.lookAhead(9)->isIdentifier() || !isToken(it.lookAhead(10), ReservedToken::CloseRound))
+		{
+			return false;
+		}
+		_array = it.lookAhead(9)->getIdentifier().name;
+
+		size_t n = 11;
+		if (isToken(it.lookAhead(n), ReservedToken::Sub) && isLiteral(it.lookAhead(n + 1), inclusive ? 1 : 0))
+		{
+			n += 2;
+		}
+		else if (inclusive)
+		{
+			return false;
+		}
+		if (!isToken(it.lookAhead(n++), ReservedToken::Semicolon))
+		{
+			return false;
+		}
+
+		// ++i), i++) or i += e)
+		if (isToken(it.lookAhead(n), ReservedToken::Inc) && isName(it.lookAhead(n + 1), _counter))
+		{
+			n += 2;
+		}
+		else if (isName(it.lookAhead(n), _counter) && isToken(it.lookAhead(n + 1), ReservedToken::Inc))
+		{
+			n += 2;
+		}
+		else if (isName(it.lookAhead(n), _counter) && isToken(it.lookAhead(n + 1), ReservedToken::AddAssign) &&
+				 isLiteral(it.lookAhead(n + 2), 0))
+		{
+			n += 3;
+		}
+		else
+		{
+			return false;
+		}
+		return isToken(it.lookAhead(n), ReservedToken::CloseRound) && _counter != _array;
+	}
+
+	void CountedLoop::enterBody()
+	{
+		if (!_matched)
+		{
+			return;
+		}
+
+		const IdentifierInfo *counter = _context.find(_counter);
+		const IdentifierInfo *array = _context.find(_array);
+		if (!counter || !array || counter->getScope() != IdentifierScope::LocalVariable ||
+			array->getScope() == IdentifierScope::Function || !std::holds_alternative<ArrayType>(*array->typeId()))
+		{
+			return;
+		}
+
+		_range.counter = counter;
+		_range.array = array;
+		_context.enterIndexRange(_range);
+		_context.enterLoop(_writes);
+		_entered = true;
+	}
+
+	void CountedLoop::leaveBody()
+	{
+		if (!_entered)
+		{
+			return;
+		}
+		_context.leaveLoop();
+		_context.leaveIndexRange();
+		_entered = false;
+
+		// Growing the array through other indexes leaves a[i] in range, but
+		// replacing it or changing i doesn't. Globals and reference parameters
+		// may also be replaced through other names.
+		bool safe =
+			_writes.identifiers.count(_range.counter) == 0 &&
+			_writes.replaced.count(_range.array) == 0 &&
+			!(_writes.aliasedReplaced && isAliasable(*_range.array));
+		*_range.checked = !safe;
+		if (safe)
+		{
+			for (size_t i = 0; i < _range.indexes; ++i)
+			{
+				_context.counters().addRemovedBoundsCheck();
+			}
+		}
+	}
+}
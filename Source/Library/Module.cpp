@@ -1,9 +1,11 @@
 #include <vector>
-#include <cstdio>
+#include <string_view>
 
 #include "Module.hpp"
 #include "Errors.hpp"
 #include "PushBackStream.hpp"
+#include "BufferStream.hpp"
+#include "SourceFile.hpp"
 #include "Tokenizer.hpp"
 #include "Compiler.hpp"
 
@@ -11,36 +13,13 @@ namespace sharpsenLang
 {
 	namespace
 	{
-		class File
+		GetCharacter sourceReader(std::string_view source)
 		{
-			File(const File &) = delete;
-			void operator=(const File &) = delete;
-
-		private:
-			FILE *_fp;
-
-		public:
-			File(const char *path) : _fp(fopen(path, "rt"))
-			{
-				if (!_fp)
-				{
-					throw FileNotFound(std::string("'") + path + "' not found");
-				}
-			}
-
-			~File()
+			return [source, i = size_t(0)]() mutable
 			{
-				if (_fp)
-				{
-					fclose(_fp);
-				}
-			}
-
-			int operator()()
-			{
-				return fgetc(_fp);
-			}
-		};
+				return i < source.size() ? int(static_cast<unsigned char>(source[i++])) : -1;
+			};
+		}
 	}
 
 	class ModuleImpl
@@ -49,10 +28,13 @@ namespace sharpsenLang
 		std::vector<std::pair<std::string, Function>> _externalFunctions;
 		std::vector<std::string> _publicDeclarations;
 		std::unordered_map<std::string, std::shared_ptr<Function>> _publicFunctions;
+		ProgramPtr _program;
 		std::unique_ptr<RuntimeContext> _context;
+		ModuleSettings _settings;
 
 	public:
-		ModuleImpl()
+		ModuleImpl(ModuleSettings settings)
+			: _settings(settings)
 		{
 		}
 
@@ -61,6 +43,11 @@ namespace sharpsenLang
 			return _context.get();
 		}
 
+		const ProgramPtr &program() const
+		{
+			return _program;
+		}
+
 		void addPublicFunctionDeclaration(std::string declaration, std::string name, std::shared_ptr<Function> fptr)
 		{
 			_publicDeclarations.push_back(std::move(declaration));
@@ -72,18 +59,34 @@ namespace sharpsenLang
 			_externalFunctions.emplace_back(std::move(declaration), std::move(f));
 		}
 
-		void load(const char *path)
+		void loadSource(std::string_view source, std::shared_ptr<const void> owner = nullptr)
 		{
-			File f(path);
-			GetCharacter get = [&]()
+			// Lazily compiled bodies refer to the source text until their first call.
+			// Bodies kept for specialization hold copies of their own text.
+			bool keepSource = _settings.lazyCompile;
+
+			if (keepSource && !owner)
 			{
-				return f();
-			};
-			PushBackStream stream(&get);
+				std::shared_ptr<const std::string> copy = std::make_shared<const std::string>(source);
+				source = *copy;
+				owner = std::move(copy);
+			}
+
+			BufferStream stream(source);
 
 			TokensIterator it(stream);
 
-			_context = std::make_unique<RuntimeContext>(compile(it, _externalFunctions, _publicDeclarations));
+			ProgramPtr program = compile(it, _externalFunctions, _publicDeclarations, _settings);
+
+			if (keepSource)
+			{
+				// Tie the source lifetime to the program, which may outlive this module.
+				auto holder = std::make_shared<std::pair<ProgramPtr, std::shared_ptr<const void>>>(std::move(program), std::move(owner));
+				program = ProgramPtr(holder, holder->first.get());
+			}
+
+			_context = std::make_unique<RuntimeContext>(program);
+			_program = std::move(program);
 
 			for (const auto &p : _publicFunctions)
 			{
@@ -91,12 +94,18 @@ namespace sharpsenLang
 			}
 		}
 
+		void load(const char *path)
+		{
+			std::shared_ptr<const SourceFile> file = std::make_shared<const SourceFile>(path);
+			loadSource(file->view(), file);
+		}
+
 		bool tryLoad(const char *path, std::ostream *err) noexcept
 		{
 			try
 			{
-				load(path);
-				return true;
+				std::shared_ptr<const SourceFile> file = std::make_shared<const SourceFile>(path);
+				return tryLoadSource(file->view(), file, err);
 			}
 			catch (const FileNotFound &e)
 			{
@@ -105,18 +114,21 @@ namespace sharpsenLang
 					*err << e.what() << std::endl;
 				}
 			}
+			return false;
+		}
+
+		bool tryLoadSource(std::string_view source, std::shared_ptr<const void> owner, std::ostream *err) noexcept
+		{
+			try
+			{
+				loadSource(source, std::move(owner));
+				return true;
+			}
 			catch (const Error &e)
 			{
 				if (err)
 				{
-					File f(path);
-					formatError(
-						e,
-						[&]()
-						{
-							return f();
-						},
-						*err);
+					formatError(e, sourceReader(source), *err);
 				}
 			}
 			catch (const RuntimeError &e)
@@ -138,7 +150,11 @@ namespace sharpsenLang
 		}
 	};
 
-	Module::Module() : _impl(std::make_unique<ModuleImpl>())
+	Module::Module() : _impl(std::make_unique<ModuleImpl>(ModuleSettings()))
+	{
+	}
+
+	Module::Module(ModuleSettings settings) : _impl(std::make_unique<ModuleImpl>(settings))
 	{
 	}
 
@@ -147,6 +163,11 @@ namespace sharpsenLang
 		return _impl->getRuntimeContext();
 	}
 
+	const ProgramPtr &Module::program() const
+	{
+		return _impl->program();
+	}
+
 	void Module::addExternalFunctionImpl(std::string declaration, Function f)
 	{
 		_impl->addExternalFunctionImpl(std::move(declaration), std::move(f));
@@ -167,6 +188,16 @@ namespace sharpsenLang
 		return _impl->tryLoad(path, err);
 	}
 
+	void Module::loadSource(std::string_view source)
+	{
+		_impl->loadSource(source);
+	}
+
+	bool Module::tryLoadSource(std::string_view source, std::ostream *err) noexcept
+	{
+		return _impl->tryLoadSource(source, nullptr, err);
+	}
+
 	void Module::resetGlobals()
 	{
 		_impl->resetGlobals();
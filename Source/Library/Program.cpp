@@ -0,0 +1,56 @@
+#include "Program.hpp"
+
+namespace sharpsenLang
+{
+	Program::Program(
+		std::vector<Expression<Lvalue>::Ptr> initializers,
+		std::vector<Function> functions,
+		std::vector<Class> classes,
+		std::unordered_map<std::string, size_t> publicFunctions,
+		size_t stackCapacity,
+		std::shared_ptr<const CompileCounters> counters,
+		std::shared_ptr<Specializations> specializations)
+		: _functions(std::move(functions)),
+		  _classes(std::move(classes)),
+		  _publicFunctions(std::move(publicFunctions)),
+		  _initializers(std::move(initializers)),
+		  _stackCapacity(stackCapacity),
+		  _counters(std::move(counters)),
+		  _specializations(std::move(specializations))
+	{
+	}
+
+	const std::vector<Function> &Program::functions() const
+	{
+		return _functions;
+	}
+
+	const Function &Program::getFunction(int idx) const
+	{
+		return _functions[idx];
+	}
+
+	const Function *Program::findPublicFunction(const std::string &name) const
+	{
+		if (auto it = _publicFunctions.find(name); it != _publicFunctions.end())
+		{
+			return &_functions[it->second];
+		}
+		return nullptr;
+	}
+
+	const std::vector<Expression<Lvalue>::Ptr> &Program::initializers() const
+	{
+		return _initializers;
+	}
+
+	size_t Program::stackCapacity() const
+	{
+		return _stackCapacity;
+	}
+
+	CompileStats Program::compileStats() const
+	{
+		return _counters->stats();
+	}
+}
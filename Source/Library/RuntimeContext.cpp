@@ -3,45 +3,55 @@
 
 namespace sharpsenLang
 {
-	RuntimeContext::RuntimeContext(
-		std::vector<Expression<Lvalue>::Ptr> initializers,
-		std::vector<Function> functions,
-		std::vector<Class> classes,
-		std::unordered_map<std::string, size_t> publicFunctions)
-		: _functions(std::move(functions)),
-		  _classes(std::move(classes)),
-		  _publicFunctions(std::move(publicFunctions)),
-		  _initializers(std::move(initializers)),
-		  _retvalIdx(0)
-	{
-		_globals.reserve(_initializers.size());
+	RuntimeContext::RuntimeContext(ProgramPtr program)
+		: _program(std::move(program)),
+		  _functions(_program->functions().data()),
+		  _pool(new VariablePool()),
+		  _stack(std::make_unique<Value[]>(_program->stackCapacity())),
+		  _stackCapacity(_program->stackCapacity()),
+		  _stackTop(0),
+		  _retvalIdx(0),
+		  _tailCall(nullptr)
+	{
+		_globals.reserve(_program->initializers().size());
 		initialize();
 	}
 
+	const ProgramPtr &RuntimeContext::program() const
+	{
+		return _program;
+	}
+
+	const VariablePool &RuntimeContext::variablePool() const
+	{
+		return *_pool;
+	}
+
 	void RuntimeContext::initialize()
 	{
+		VariablePool::Scope pool(_pool.get());
 		_globals.clear();
 
-		for (const auto &initializer : _initializers)
+		for (const auto &initializer : _program->initializers())
 		{
 			_globals.emplace_back(initializer->evaluate(*this));
 		}
 	}
 
-	VariablePtr &RuntimeContext::global(int idx)
+	VariablePtr RuntimeContext::global(int idx)
 	{
-		runtimeAssertion(idx < _globals.size(), "Uninitialized global variable access");
-		return _globals[idx];
+		return globalValue(idx).boxed();
 	}
 
-	VariablePtr &RuntimeContext::retval()
+	VariablePtr RuntimeContext::local(int idx)
 	{
-		return _stack[_retvalIdx];
+		return localValue(idx).boxed();
 	}
 
-	VariablePtr &RuntimeContext::local(int idx)
+	Value &RuntimeContext::globalValue(int idx)
 	{
-		return _stack[_retvalIdx + idx];
+		runtimeAssertion(idx >= 0 && size_t(idx) < _globals.size(), "Uninitialized global variable access");
+		return _globals[idx];
 	}
 
 	const Function &RuntimeContext::getFunction(int idx) const
@@ -51,51 +61,137 @@ namespace sharpsenLang
 
 	const Function &RuntimeContext::getPublicFunction(const char *name) const
 	{
-		return _functions[_publicFunctions.find(name)->second];
+		const Function *f = _program->findPublicFunction(name);
+		runtimeAssertion(f, "Unknown public function");
+		return *f;
 	}
 
-	RuntimeContext::scope RuntimeContext::enterScope()
+	void RuntimeContext::enterFrame(size_t frameSize)
 	{
-		return scope(*this);
+		runtimeAssertion(_retvalIdx + 1 + frameSize <= _stackCapacity, "Stack overflow");
+		_stackTop = _retvalIdx + 1 + frameSize;
 	}
 
-	void RuntimeContext::push(VariablePtr v)
+	void RuntimeContext::popTo(size_t top)
 	{
-		_stack.push_back(std::move(v));
+		while (_stackTop > top)
+		{
+			_stack[--_stackTop] = Value();
+		}
 	}
 
-	VariablePtr RuntimeContext::call(const Function &f, std::vector<VariablePtr> params)
+	size_t RuntimeContext::allocateRegisters(size_t count)
 	{
-		for (size_t i = params.size(); i > 0; --i)
-		{
-			_stack.push_back(std::move(params[i - 1]));
-		}
-		size_t old_retval_idx = _retvalIdx;
+		size_t base = _registers.size();
+		_registers.resize(base + count);
+		return base;
+	}
+
+	void RuntimeContext::releaseRegisters(size_t base)
+	{
+		_registers.resize(base);
+	}
+
+	void RuntimeContext::reserveArguments(size_t count)
+	{
+		runtimeAssertion(_stackTop + count + 1 <= _stackCapacity, "Stack overflow");
+		_stackTop += count;
+	}
 
-		_retvalIdx = _stack.size();
-		_stack.resize(_retvalIdx + 1);
+	Value RuntimeContext::callFrame(const Function &f, size_t argc)
+	{
+		size_t base = _stackTop - argc;
+		frame _(*this, argc, 0);
 
 		runtimeAssertion(bool(f), "Uninitialized Function call");
 
 		f(*this);
 
-		VariablePtr ret = std::move(_stack[_retvalIdx]);
+		if (_tailCall) [[unlikely]]
+		{
+			runTailCalls(base);
+		}
 
-		_stack.resize(_retvalIdx - params.size());
+		return std::move(_stack[_retvalIdx]);
+	}
 
-		_retvalIdx = old_retval_idx;
+	void RuntimeContext::runTailCalls(size_t base)
+	{
+		// Tail calls replace the frame instead of nesting in it, so they run in
+		// constant stack space. The arguments were pushed above the old frame,
+		// so the new one fits.
+		while (_tailCall)
+		{
+			const Function &next = *_tailCall;
+			_tailCall = nullptr;
+
+			popTo(base);
+			_stackTop += _tailArguments.size();
+			for (size_t i = 0; i < _tailArguments.size(); ++i)
+			{
+				argument(i) = std::move(_tailArguments[i]);
+			}
+			_tailArguments.clear();
+			_retvalIdx = _stackTop++;
+
+			next(*this);
+		}
+	}
+
+	void RuntimeContext::tailCall(const Function &f, size_t argc)
+	{
+		_tailArguments.resize(argc);
+		for (size_t i = 0; i < argc; ++i)
+		{
+			_tailArguments[i] = std::move(argument(i));
+		}
+		popTo(_stackTop - argc);
+		_tailCall = &f;
+	}
+
+	RuntimeContext::frame RuntimeContext::enterInlineFrame(size_t argc, size_t frameSize)
+	{
+		runtimeAssertion(_stackTop + 1 + frameSize <= _stackCapacity, "Stack overflow");
+		return frame(*this, argc, frameSize);
+	}
 
-		return ret;
+	template <typename T>
+	Value RuntimeContext::callImpl(const Function &f, std::vector<T> &params)
+	{
+		reserveArguments(params.size());
+
+		for (size_t i = 0; i < params.size(); ++i)
+		{
+			argument(i) = Value(std::move(params[i]));
+		}
+
+		return callFrame(f, params.size());
+	}
+
+	VariablePtr RuntimeContext::call(const Function &f, std::vector<VariablePtr> params)
+	{
+		VariablePool::Scope pool(_pool.get());
+		return callImpl(f, params).boxed();
+	}
+
+	Value RuntimeContext::callValue(const Function &f, std::vector<Value> params)
+	{
+		VariablePool::Scope pool(_pool.get());
+		return callImpl(f, params);
 	}
 
-	RuntimeContext::scope::scope(RuntimeContext &context)
+	RuntimeContext::frame::frame(RuntimeContext &context, size_t argc, size_t frameSize)
 		: _context(context),
-		  _stackSize(context._stack.size())
+		  _stackTop(context._stackTop - argc),
+		  _retvalIdx(context._retvalIdx)
 	{
+		_context._retvalIdx = _context._stackTop++;
+		_context._stackTop += frameSize;
 	}
 
-	RuntimeContext::scope::~scope()
+	RuntimeContext::frame::~frame()
 	{
-		_context._stack.resize(_stackSize);
+		_context.popTo(_stackTop);
+		_context._retvalIdx = _retvalIdx;
 	}
 }
@@ -0,0 +1,88 @@
+#include <cstdio>
+
+#include "SourceFile.hpp"
+#include "Errors.hpp"
+
+#if defined(_WIN32)
+#define SHARPSEN_NO_MMAP
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace sharpsenLang
+{
+#ifndef SHARPSEN_NO_MMAP
+	SourceFile::SourceFile(const char *path)
+		: _data(nullptr),
+		  _size(0)
+	{
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+		{
+			throw FileNotFound(std::string("'") + path + "' not found");
+		}
+
+		struct stat st;
+		bool mapped = fstat(fd, &st) == 0;
+		if (mapped && st.st_size > 0)
+		{
+			void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			mapped = data != MAP_FAILED;
+			if (mapped)
+			{
+				_data = static_cast<const char *>(data);
+				_size = size_t(st.st_size);
+			}
+		}
+		close(fd);
+
+		if (!mapped)
+		{
+			throw FileNotFound(std::string("'") + path + "' could not be read");
+		}
+	}
+
+	SourceFile::~SourceFile()
+	{
+		if (_data)
+		{
+			munmap(const_cast<char *>(_data), _size);
+		}
+	}
+
+	std::string_view SourceFile::view() const
+	{
+		return std::string_view(_data, _size);
+	}
+#else
+	SourceFile::SourceFile(const char *path)
+		: _data(nullptr),
+		  _size(0)
+	{
+		FILE *fp = fopen(path, "rb");
+		if (!fp)
+		{
+			throw FileNotFound(std::string("'") + path + "' not found");
+		}
+
+		char buffer[4096];
+		for (size_t n; (n = fread(buffer, 1, sizeof(buffer), fp)) > 0;)
+		{
+			_contents.append(buffer, n);
+		}
+		fclose(fp);
+	}
+
+	SourceFile::~SourceFile()
+	{
+	}
+
+	std::string_view SourceFile::view() const
+	{
+		return _contents;
+	}
+#endif
+}
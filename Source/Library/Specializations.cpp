@@ -0,0 +1,16 @@
+#include "Specializations.hpp"
+
+namespace sharpsenLang
+{
+	const Function &Specializations::get(size_t functionIndex, const Bindings &bindings, const std::function<Function()> &create)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto key = std::make_pair(functionIndex, bindings);
+		if (auto it = _functions.find(key); it != _functions.end())
+		{
+			return it->second;
+		}
+		return _functions.emplace(std::move(key), create()).first->second;
+	}
+
+}
@@ -3,6 +3,8 @@
 #include "Statement.hpp"
 #include "Expression.hpp"
 #include "RuntimeContext.hpp"
+#include "Bytecode.hpp"
+#include "CaseTable.hpp"
 
 namespace sharpsenLang
 {
@@ -63,6 +65,12 @@ namespace sharpsenLang
 				_expr->evaluate(context);
 				return Flow::normalFlow();
 			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				builder.lowerVoid(*_expr);
+				builder.releaseRegisters();
+			}
 		};
 
 		class BlockStatement : public Statement
@@ -77,7 +85,6 @@ namespace sharpsenLang
 
 			Flow execute(RuntimeContext &context) override
 			{
-				auto _ = context.enterScope();
 				for (const StatementPtr &statement : _statements)
 				{
 					if (Flow f = statement->execute(context); f.type() != FlowType::FlowNormal)
@@ -87,26 +94,81 @@ namespace sharpsenLang
 				}
 				return Flow::normalFlow();
 			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				for (const StatementPtr &statement : _statements)
+				{
+					statement->lower(builder);
+				}
+			}
 		};
 
-		class LocalDeclarationStatement : public Statement
+		// Locals declared together, stored into consecutive frame slots from the
+		// first. Sibling scopes reuse the slots, so blocks need no bookkeeping.
+		// Numbers and ints are stored unboxed and only boxed once a reference is
+		// taken.
+		class Declarations
 		{
 		private:
 			std::vector<Expression<Lvalue>::Ptr> _decls;
+			std::vector<UnboxedValue> _values;
+			size_t _slot;
 
 		public:
-			LocalDeclarationStatement(std::vector<Expression<Lvalue>::Ptr> decls) : _decls(std::move(decls))
+			Declarations(std::vector<Expression<Lvalue>::Ptr> decls, size_t slot) : _decls(std::move(decls)),
+																					 _slot(slot)
 			{
+				for (const Expression<Lvalue>::Ptr &decl : _decls)
+				{
+					_values.push_back(findUnboxedValue(*decl));
+				}
 			}
 
-			Flow execute(RuntimeContext &context) override
+			void execute(RuntimeContext &context) const
 			{
-				for (const Expression<Lvalue>::Ptr &decl : _decls)
+				for (size_t i = 0; i < _decls.size(); ++i)
 				{
-					context.push(decl->evaluate(context));
+					if (_values[i])
+					{
+						context.localValue(int(_slot + i)) = _values[i].evaluate(context);
+					}
+					else
+					{
+						context.localValue(int(_slot + i)) = Value(_decls[i]->evaluate(context));
+					}
+				}
+			}
+
+			void lower(BytecodeBuilder &builder) const
+			{
+				for (size_t i = 0; i < _decls.size(); ++i)
+				{
+					builder.declareLocal(*_decls[i], int(_slot + i));
 				}
+			}
+		};
+
+		class LocalDeclarationStatement : public Statement
+		{
+		private:
+			Declarations _decls;
+
+		public:
+			LocalDeclarationStatement(std::vector<Expression<Lvalue>::Ptr> decls, size_t slot) : _decls(std::move(decls), slot)
+			{
+			}
+
+			Flow execute(RuntimeContext &context) override
+			{
+				_decls.execute(context);
 				return Flow::normalFlow();
 			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				_decls.lower(builder);
+			}
 		};
 
 		class BreakStatement : public Statement
@@ -123,6 +185,11 @@ namespace sharpsenLang
 			{
 				return Flow::breakFlow(_breakLevel);
 			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				builder.breakFlow(_breakLevel);
+			}
 		};
 
 		class ContinueStatement : public Statement
@@ -134,23 +201,43 @@ namespace sharpsenLang
 			{
 				return Flow::continueFlow();
 			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				builder.continueFlow();
+			}
 		};
 
 		class ReturnStatement : public Statement
 		{
 		private:
 			Expression<Lvalue>::Ptr _expr;
+			// Numbers and ints are returned unboxed.
+			UnboxedValue _value;
 
 		public:
-			ReturnStatement(Expression<Lvalue>::Ptr expr) : _expr(std::move(expr))
+			ReturnStatement(Expression<Lvalue>::Ptr expr) : _expr(std::move(expr)),
+															_value(findUnboxedValue(*_expr))
 			{
 			}
 
 			Flow execute(RuntimeContext &context) override
 			{
-				context.retval() = _expr->evaluate(context);
+				if (_value)
+				{
+					context.retvalValue() = _value.evaluate(context);
+				}
+				else
+				{
+					context.retvalValue() = Value(_expr->evaluate(context));
+				}
 				return Flow::returnFlow();
 			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				builder.returnValue(*_expr);
+			}
 		};
 
 		class ReturnVoidStatement : public Statement
@@ -162,6 +249,35 @@ namespace sharpsenLang
 			{
 				return Flow::returnFlow();
 			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				builder.returnVoid();
+			}
+		};
+
+		class TailCallStatement : public Statement
+		{
+		private:
+			Expression<Void>::Ptr _call;
+
+		public:
+			TailCallStatement(Expression<void>::Ptr call) : _call(std::move(call))
+			{
+			}
+
+			Flow execute(RuntimeContext &context) override
+			{
+				_call->evaluate(context);
+				return Flow::returnFlow();
+			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				builder.lowerVoid(*_call);
+				builder.releaseRegisters();
+				builder.returnVoid();
+			}
 		};
 
 		class IfStatement : public Statement
@@ -187,33 +303,51 @@ namespace sharpsenLang
 				}
 				return _statements.back()->execute(context);
 			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				BytecodeBuilder::Label end = builder.createLabel();
+				for (size_t i = 0; i < _exprs.size(); ++i)
+				{
+					BytecodeBuilder::Label next = builder.createLabel();
+					Operand condition = builder.lowerNumber(*_exprs[i]);
+					builder.releaseRegisters();
+					builder.jumpIfFalse(condition, next);
+					_statements[i]->lower(builder);
+					builder.jump(end);
+					builder.bindLabel(next);
+				}
+				_statements.back()->lower(builder);
+				builder.bindLabel(end);
+			}
 		};
 
 		class IfDeclareStatement : public IfStatement
 		{
 		private:
-			std::vector<Expression<Lvalue>::Ptr> _decls;
+			Declarations _decls;
 
 		public:
 			IfDeclareStatement(
 				std::vector<Expression<Lvalue>::Ptr> decls,
+				size_t slot,
 				std::vector<Expression<Number>::Ptr> exprs,
 				std::vector<StatementPtr> statements) : IfStatement(std::move(exprs), std::move(statements)),
-														_decls(std::move(decls))
+														_decls(std::move(decls), slot)
 			{
 			}
 
 			Flow execute(RuntimeContext &context) override
 			{
-				auto _ = context.enterScope();
-
-				for (const Expression<Lvalue>::Ptr &decl : _decls)
-				{
-					context.push(decl->evaluate(context));
-				}
-
+				_decls.execute(context);
 				return IfStatement::execute(context);
 			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				_decls.lower(builder);
+				IfStatement::lower(builder);
+			}
 		};
 
 		class SwitchStatement : public Statement
@@ -223,6 +357,7 @@ namespace sharpsenLang
 			std::vector<StatementPtr> _statements;
 			std::unordered_map<Number, size_t> _cases;
 			size_t _dflt;
+			CaseTable _table;
 
 		public:
 			SwitchStatement(
@@ -232,14 +367,14 @@ namespace sharpsenLang
 				size_t dflt) : _expr(std::move(expr)),
 							   _statements(std::move(statements)),
 							   _cases(std::move(cases)),
-							   _dflt(dflt)
+							   _dflt(dflt),
+							   _table(_cases, _dflt)
 			{
 			}
 
 			Flow execute(RuntimeContext &context) override
 			{
-				auto it = _cases.find(_expr->evaluate(context));
-				for (size_t idx = (it == _cases.end() ? _dflt : it->second); idx < _statements.size(); ++idx)
+				for (size_t idx = _table.find(_expr->evaluate(context)); idx < _statements.size(); ++idx)
 				{
 					switch (Flow f = _statements[idx]->execute(context); f.type())
 					{
@@ -254,35 +389,59 @@ namespace sharpsenLang
 
 				return Flow::normalFlow();
 			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				std::vector<BytecodeBuilder::Label> labels;
+				labels.reserve(_statements.size() + 1);
+				for (size_t i = 0; i <= _statements.size(); ++i)
+				{
+					labels.push_back(builder.createLabel());
+				}
+
+				Operand value = builder.lowerNumber(*_expr);
+				builder.releaseRegisters();
+				builder.switchJump(value, _cases, labels, labels[_dflt]);
+
+				builder.enterBreakable(labels.back());
+				for (size_t i = 0; i < _statements.size(); ++i)
+				{
+					builder.bindLabel(labels[i]);
+					_statements[i]->lower(builder);
+				}
+				builder.leaveBreakable();
+				builder.bindLabel(labels.back());
+			}
 		};
 
 		class SwitchDeclareStatement : public SwitchStatement
 		{
 		private:
-			std::vector<Expression<Lvalue>::Ptr> _decls;
+			Declarations _decls;
 
 		public:
 			SwitchDeclareStatement(
 				std::vector<Expression<Lvalue>::Ptr> decls,
+				size_t slot,
 				Expression<Number>::Ptr expr,
 				std::vector<StatementPtr> statements,
 				std::unordered_map<Number, size_t> cases,
-				size_t dflt) : _decls(std::move(decls)),
-							   SwitchStatement(std::move(expr), std::move(statements), std::move(cases), dflt)
+				size_t dflt) : SwitchStatement(std::move(expr), std::move(statements), std::move(cases), dflt),
+							   _decls(std::move(decls), slot)
 			{
 			}
 
 			Flow execute(RuntimeContext &context) override
 			{
-				auto _ = context.enterScope();
-
-				for (const Expression<Lvalue>::Ptr &decl : _decls)
-				{
-					context.push(decl->evaluate(context));
-				}
-
+				_decls.execute(context);
 				return SwitchStatement::execute(context);
 			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				_decls.lower(builder);
+				SwitchStatement::lower(builder);
+			}
 		};
 
 		class WhileStatement : public Statement
@@ -315,6 +474,26 @@ namespace sharpsenLang
 
 				return Flow::normalFlow();
 			}
+
+			// The condition follows the body, so that an iteration takes a single jump.
+			void lower(BytecodeBuilder &builder) const override
+			{
+				BytecodeBuilder::Label body = builder.createLabel();
+				BytecodeBuilder::Label condition = builder.createLabel();
+				BytecodeBuilder::Label end = builder.createLabel();
+
+				builder.jump(condition);
+				builder.bindLabel(body);
+				builder.enterLoop(end, condition);
+				_statement->lower(builder);
+				builder.leaveBreakable();
+
+				builder.bindLabel(condition);
+				Operand value = builder.lowerNumber(*_expr);
+				builder.releaseRegisters();
+				builder.jumpIfTrue(value, body);
+				builder.bindLabel(end);
+			}
 		};
 
 		class DoStatement : public Statement
@@ -347,6 +526,24 @@ namespace sharpsenLang
 
 				return Flow::normalFlow();
 			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				BytecodeBuilder::Label body = builder.createLabel();
+				BytecodeBuilder::Label condition = builder.createLabel();
+				BytecodeBuilder::Label end = builder.createLabel();
+
+				builder.bindLabel(body);
+				builder.enterLoop(end, condition);
+				_statement->lower(builder);
+				builder.leaveBreakable();
+
+				builder.bindLabel(condition);
+				Operand value = builder.lowerNumber(*_expr);
+				builder.releaseRegisters();
+				builder.jumpIfTrue(value, body);
+				builder.bindLabel(end);
+			}
 		};
 
 		class ForStatementBase : public Statement
@@ -384,6 +581,31 @@ namespace sharpsenLang
 
 				return Flow::normalFlow();
 			}
+
+			// The condition follows the body and the step, like a while loop's.
+			void lower(BytecodeBuilder &builder) const override
+			{
+				BytecodeBuilder::Label body = builder.createLabel();
+				BytecodeBuilder::Label step = builder.createLabel();
+				BytecodeBuilder::Label condition = builder.createLabel();
+				BytecodeBuilder::Label end = builder.createLabel();
+
+				builder.jump(condition);
+				builder.bindLabel(body);
+				builder.enterLoop(end, step);
+				_statement->lower(builder);
+				builder.leaveBreakable();
+
+				builder.bindLabel(step);
+				builder.lowerVoid(*_expr3);
+				builder.releaseRegisters();
+
+				builder.bindLabel(condition);
+				Operand value = builder.lowerNumber(*_expr2);
+				builder.releaseRegisters();
+				builder.jumpIfTrue(value, body);
+				builder.bindLabel(end);
+			}
 		};
 
 		class ForStatement : public ForStatementBase
@@ -407,12 +629,19 @@ namespace sharpsenLang
 
 				return ForStatementBase::execute(context);
 			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				builder.lowerVoid(*_expr1);
+				builder.releaseRegisters();
+				ForStatementBase::lower(builder);
+			}
 		};
 
 		class ForDeclareStatement : public ForStatementBase
 		{
 		private:
-			std::vector<Expression<Lvalue>::Ptr> _decls;
+			Declarations _decls;
 			Expression<Number>::Ptr _expr2;
 			Expression<Void>::Ptr _expr3;
 			StatementPtr _statement;
@@ -420,24 +649,25 @@ namespace sharpsenLang
 		public:
 			ForDeclareStatement(
 				std::vector<Expression<Lvalue>::Ptr> decls,
+				size_t slot,
 				Expression<Number>::Ptr expr2,
 				Expression<Void>::Ptr expr3,
 				StatementPtr statement) : ForStatementBase(std::move(expr2), std::move(expr3), std::move(statement)),
-										  _decls(std::move(decls))
+										  _decls(std::move(decls), slot)
 			{
 			}
 
 			Flow execute(RuntimeContext &context) override
 			{
-				auto _ = context.enterScope();
-
-				for (const Expression<Lvalue>::Ptr &decl : _decls)
-				{
-					context.push(decl->evaluate(context));
-				}
-
+				_decls.execute(context);
 				return ForStatementBase::execute(context);
 			}
+
+			void lower(BytecodeBuilder &builder) const override
+			{
+				_decls.lower(builder);
+				ForStatementBase::lower(builder);
+			}
 		};
 	}
 
@@ -446,9 +676,9 @@ namespace sharpsenLang
 		return std::make_unique<SimpleStatement>(std::move(expr));
 	}
 
-	StatementPtr createLocalDeclarationStatement(std::vector<Expression<Lvalue>::Ptr> decls)
+	StatementPtr createLocalDeclarationStatement(std::vector<Expression<Lvalue>::Ptr> decls, size_t slot)
 	{
-		return std::make_unique<LocalDeclarationStatement>(std::move(decls));
+		return std::make_unique<LocalDeclarationStatement>(std::move(decls), slot);
 	}
 
 	StatementPtr createBlockStatement(std::vector<StatementPtr> statements)
@@ -481,14 +711,20 @@ namespace sharpsenLang
 		return std::make_unique<ReturnVoidStatement>();
 	}
 
+	StatementPtr createTailCallStatement(Expression<void>::Ptr call)
+	{
+		return std::make_unique<TailCallStatement>(std::move(call));
+	}
+
 	StatementPtr createIfStatement(
 		std::vector<Expression<Lvalue>::Ptr> decls,
+		size_t slot,
 		std::vector<Expression<Number>::Ptr> exprs,
 		std::vector<StatementPtr> statements)
 	{
 		if (!decls.empty())
 		{
-			return std::make_unique<IfDeclareStatement>(std::move(decls), std::move(exprs), std::move(statements));
+			return std::make_unique<IfDeclareStatement>(std::move(decls), slot, std::move(exprs), std::move(statements));
 		}
 		else
 		{
@@ -498,6 +734,7 @@ namespace sharpsenLang
 
 	StatementPtr createSwitchStatement(
 		std::vector<Expression<Lvalue>::Ptr> decls,
+		size_t slot,
 		Expression<Number>::Ptr expr,
 		std::vector<StatementPtr> statements,
 		std::unordered_map<Number, size_t> cases,
@@ -507,6 +744,7 @@ namespace sharpsenLang
 		{
 			return std::make_unique<SwitchDeclareStatement>(
 				std::move(decls),
+				slot,
 				std::move(expr),
 				std::move(statements),
 				std::move(cases), dflt);
@@ -541,10 +779,11 @@ namespace sharpsenLang
 
 	StatementPtr createForStatement(
 		std::vector<Expression<Lvalue>::Ptr> decls,
+		size_t slot,
 		Expression<Number>::Ptr expr2,
 		Expression<Void>::Ptr expr3,
 		StatementPtr statement)
 	{
-		return std::make_unique<ForDeclareStatement>(std::move(decls), std::move(expr2), std::move(expr3), std::move(statement));
+		return std::make_unique<ForDeclareStatement>(std::move(decls), slot, std::move(expr2), std::move(expr3), std::move(statement));
 	}
 }
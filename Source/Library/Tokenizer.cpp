@@ -3,9 +3,11 @@
 #include <cctype>
 #include <stack>
 #include <cstdlib>
+#include <type_traits>
 
 #include "Tokenizer.hpp"
 #include "PushBackStream.hpp"
+#include "BufferStream.hpp"
 #include "Errors.hpp"
 
 namespace sharpsenLang
@@ -37,32 +39,65 @@ namespace sharpsenLang
 			return CharacterType::Punct;
 		}
 
-		Token fetchWord(PushBackStream &stream)
+		template <typename Stream>
+		constexpr bool isBufferStream = std::is_same<Stream, BufferStream>::value;
+
+		Token ownedToken(std::string text, bool identifier, size_t lineNumber, size_t charIndex)
+		{
+			std::shared_ptr<const std::string> storage = std::make_shared<const std::string>(std::move(text));
+			std::string_view view = *storage;
+			if (identifier)
+			{
+				return Token(Identifier{view}, std::move(storage), lineNumber, charIndex);
+			}
+			return Token(view, std::move(storage), lineNumber, charIndex);
+		}
+
+		template <typename Stream>
+		Token fetchWord(Stream &stream)
 		{
 			size_t lineNumber = stream.lineNumber();
 			size_t charIndex = stream.charIndex();
 
-			std::string word;
+			std::string owned;
 
 			int c = stream();
+			int last = c;
 
 			bool isNumber = isdigit(c);
 
 			do
 			{
-				word.push_back(char(c));
+				if constexpr (!isBufferStream<Stream>)
+				{
+					owned.push_back(char(c));
+				}
+				last = c;
 				c = stream();
 
-				if (c == '.' && word.back() == '.')
+				if (c == '.' && last == '.')
 				{
-					stream.pushBack(word.back());
-					word.pop_back();
+					stream.pushBack(last);
+					if constexpr (!isBufferStream<Stream>)
+					{
+						owned.pop_back();
+					}
 					break;
 				}
 			} while (getCharacterType(c) == CharacterType::Alphanum || (isNumber && c == '.'));
 
 			stream.pushBack(c);
 
+			std::string_view word;
+			if constexpr (isBufferStream<Stream>)
+			{
+				word = stream.slice(charIndex, stream.charIndex());
+			}
+			else
+			{
+				word = owned;
+			}
+
 			if (std::optional<ReservedToken> t = getKeyword(word))
 			{
 				return Token(*t, lineNumber, charIndex);
@@ -71,14 +106,15 @@ namespace sharpsenLang
 			{
 				if (std::isdigit(word.front()))
 				{
+					std::string number(word);
 					char *endptr;
-					double num = strtol(word.c_str(), &endptr, 0);
+					double num = strtol(number.c_str(), &endptr, 0);
 					if (*endptr != 0)
 					{
-						num = strtod(word.c_str(), &endptr);
+						num = strtod(number.c_str(), &endptr);
 						if (*endptr != 0)
 						{
-							size_t remaining = word.size() - (endptr - word.c_str());
+							size_t remaining = number.size() - (endptr - number.c_str());
 							throw unexpectedError(
 								std::string(1, char(*endptr)),
 								stream.lineNumber(),
@@ -87,14 +123,19 @@ namespace sharpsenLang
 					}
 					return Token(num, lineNumber, charIndex);
 				}
+				else if constexpr (isBufferStream<Stream>)
+				{
+					return Token(Identifier{word}, lineNumber, charIndex);
+				}
 				else
 				{
-					return Token(Identifier{std::move(word)}, lineNumber, charIndex);
+					return ownedToken(std::move(owned), true, lineNumber, charIndex);
 				}
 			}
 		}
 
-		Token fetchOperator(PushBackStream &stream)
+		template <typename Stream>
+		Token fetchOperator(Stream &stream)
 		{
 			size_t lineNumber = stream.lineNumber();
 			size_t charIndex = stream.charIndex();
@@ -116,11 +157,16 @@ namespace sharpsenLang
 			}
 		}
 
-		Token fetchString(PushBackStream &stream)
+		template <typename Stream>
+		Token fetchString(Stream &stream)
 		{
 			size_t lineNumber = stream.lineNumber();
 			size_t charIndex = stream.charIndex();
 
+			// Literals read from a buffer stay views into it until the first
+			// escape sequence forces a copy.
+			size_t begin = charIndex;
+			bool copied = !isBufferStream<Stream>;
 			std::string str;
 
 			bool escaped = false;
@@ -129,6 +175,14 @@ namespace sharpsenLang
 			{
 				if (c == '\\')
 				{
+					if constexpr (isBufferStream<Stream>)
+					{
+						if (!copied)
+						{
+							str = stream.slice(begin, stream.charIndex() - 1);
+							copied = true;
+						}
+					}
 					escaped = true;
 				}
 				else
@@ -165,9 +219,19 @@ namespace sharpsenLang
 							stream.pushBack(c);
 							throw parsingError("Expected closing '\"'", stream.lineNumber(), stream.charIndex());
 						case '"':
-							return Token(std::move(str), lineNumber, charIndex);
+							if constexpr (isBufferStream<Stream>)
+							{
+								if (!copied)
+								{
+									return Token(stream.slice(begin, stream.charIndex() - 1), lineNumber, charIndex);
+								}
+							}
+							return ownedToken(std::move(str), false, lineNumber, charIndex);
 						default:
-							str.push_back(c);
+							if (copied)
+							{
+								str.push_back(c);
+							}
 						}
 					}
 				}
@@ -176,7 +240,8 @@ namespace sharpsenLang
 			throw parsingError("Expected closing '\"'", stream.lineNumber(), stream.charIndex());
 		}
 
-		void skipLineComment(PushBackStream &stream)
+		template <typename Stream>
+		void skipLineComment(Stream &stream)
 		{
 			int c;
 			do
@@ -190,7 +255,8 @@ namespace sharpsenLang
 			}
 		}
 
-		void skipBlockComment(PushBackStream &stream)
+		template <typename Stream>
+		void skipBlockComment(Stream &stream)
 		{
 			bool closing = false;
 			int c;
@@ -208,7 +274,8 @@ namespace sharpsenLang
 			throw parsingError("Expected closing '*/'", stream.lineNumber(), stream.charIndex());
 		}
 
-		Token tokenize(PushBackStream &stream)
+		template <typename Stream>
+		Token tokenize(Stream &stream)
 		{
 			while (true)
 			{
@@ -257,7 +324,17 @@ namespace sharpsenLang
 	TokensIterator::TokensIterator(PushBackStream &stream)
 		: _current(Eof(), 0, 0),
 		  _getNextToken([&stream]()
-						{ return tokenize(stream); })
+						{ return tokenize(stream); }),
+		  _buffered(nullptr)
+	{
+		++(*this);
+	}
+
+	TokensIterator::TokensIterator(BufferStream &stream)
+		: _current(Eof(), 0, 0),
+		  _getNextToken([&stream]()
+						{ return tokenize(stream); }),
+		  _buffered(nullptr)
 	{
 		++(*this);
 	}
@@ -276,7 +353,8 @@ namespace sharpsenLang
 								tokens.pop_front();
 								return ret;
 							}
-						})
+						}),
+		  _buffered(&tokens)
 	{
 		++(*this);
 	}
@@ -287,6 +365,19 @@ namespace sharpsenLang
 		return *this;
 	}
 
+	const Token *TokensIterator::lookAhead(size_t n) const
+	{
+		if (n == 0)
+		{
+			return &_current;
+		}
+		if (!_buffered || n > _buffered->size())
+		{
+			return nullptr;
+		}
+		return &(*_buffered)[n - 1];
+	}
+
 	const Token &TokensIterator::operator*() const
 	{
 		return _current;
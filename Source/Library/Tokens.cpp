@@ -1,16 +1,21 @@
-#include <stack>
+#include <array>
+#include <cstdint>
+#include <iterator>
 #include <string_view>
 
 #include "Tokens.hpp"
 #include "Lookup.hpp"
 #include "Helpers.hpp"
 #include "PushBackStream.hpp"
+#include "BufferStream.hpp"
 
 namespace sharpsenLang
 {
 	namespace
 	{
-		const Lookup<std::string_view, ReservedToken> operatorTokenMap{
+		using TokenEntry = std::pair<std::string_view, ReservedToken>;
+
+		constexpr TokenEntry operatorTokens[] = {
 			{"++", ReservedToken::Inc},
 			{"--", ReservedToken::Dec},
 
@@ -75,11 +80,12 @@ namespace sharpsenLang
 			{"]", ReservedToken::CloseSquare},
 		};
 
-		const Lookup<std::string_view, ReservedToken> keywordTokenMap{
+		constexpr TokenEntry keywordTokens[] = {
 			{"class", ReservedToken::KwClass},
-			
+
 			{"sizeof", ReservedToken::KwSizeof},
 			{"toString", ReservedToken::KwToString},
+			{"toInt", ReservedToken::KwToInt},
 
 			{"if", ReservedToken::KwIf},
 			{"else", ReservedToken::KwElse},
@@ -102,97 +108,166 @@ namespace sharpsenLang
 			{"void", ReservedToken::KwVoid},
 			{"number", ReservedToken::KwNumber},
 			{"string", ReservedToken::KwString},
+			{"int", ReservedToken::KwInt},
 
-			{"public", ReservedToken::KwPublic}};
+			{"public", ReservedToken::KwPublic}
+		};
 
 		const Lookup<ReservedToken, std::string_view> tokenStringMap =
 			([]()
 			 {
 				 std::vector<std::pair<ReservedToken, std::string_view>> container;
-				 container.reserve(operatorTokenMap.size() + keywordTokenMap.size());
-				 for (const auto &p : operatorTokenMap)
+				 container.reserve(std::size(operatorTokens) + std::size(keywordTokens));
+				 for (const auto &p : operatorTokens)
 				 {
 					 container.emplace_back(p.second, p.first);
 				 }
-				 for (const auto &p : keywordTokenMap)
+				 for (const auto &p : keywordTokens)
 				 {
 					 container.emplace_back(p.second, p.first);
 				 }
 				 return Lookup<ReservedToken, std::string_view>(std::move(container));
 			 })();
-	}
 
-	std::optional<ReservedToken> getKeyword(std::string_view word)
-	{
-		auto it = keywordTokenMap.find(word);
-		return it == keywordTokenMap.end() ? std::nullopt : std::make_optional(it->second);
-	}
+		// Keywords are found through a perfect hash of their length, first two
+		// characters and last character. The seed is searched for at compile time.
+		constexpr size_t keywordTableSize = 64;
 
-	namespace
-	{
-		class MaximalMunchComparator
+		constexpr size_t keywordHash(std::string_view word, uint32_t seed)
 		{
-		private:
-			size_t _idx;
+			uint32_t h = seed ^ uint32_t(word.size());
+			h = h * 31 + uint8_t(word[0]);
+			h = h * 31 + uint8_t(word[1]);
+			h = h * 31 + uint8_t(word[word.size() - 1]);
+			h ^= h >> 7;
+			return h % keywordTableSize;
+		}
 
-		public:
-			MaximalMunchComparator(size_t idx) : _idx(idx)
+		constexpr uint32_t findKeywordSeed()
+		{
+			for (uint32_t seed = 0; seed < 100000; ++seed)
 			{
+				bool used[keywordTableSize] = {};
+				bool collision = false;
+				for (const TokenEntry &e : keywordTokens)
+				{
+					size_t h = keywordHash(e.first, seed);
+					collision = collision || used[h];
+					used[h] = true;
+				}
+				if (!collision)
+				{
+					return seed;
+				}
 			}
+			return uint32_t(-1);
+		}
 
-			bool operator()(char l, char r) const
-			{
-				return l < r;
-			}
+		constexpr uint32_t keywordSeed = findKeywordSeed();
+		static_assert(keywordSeed != uint32_t(-1), "No perfect hash seed for the keyword table");
 
-			bool operator()(std::pair<std::string_view, ReservedToken> l, char r) const
-			{
-				return l.first.size() <= _idx || l.first[_idx] < r;
-			}
+		struct KeywordTable
+		{
+			TokenEntry slots[keywordTableSize];
 
-			bool operator()(char l, std::pair<std::string_view, ReservedToken> r) const
+			constexpr KeywordTable()
+				: slots()
 			{
-				return r.first.size() > _idx && l < r.first[_idx];
+				for (const TokenEntry &e : keywordTokens)
+				{
+					slots[keywordHash(e.first, keywordSeed)] = e;
+				}
 			}
+		};
+
+		constexpr KeywordTable keywordTable;
 
-			bool operator()(std::pair<std::string_view, ReservedToken> l, std::pair<std::string_view, ReservedToken> r) const
+		// Maximal munch over operators is a walk through a trie compiled into a
+		// transition table. State 0 is the root, and a zero transition means
+		// there is no longer operator.
+		constexpr size_t operatorStateCount = std::size(operatorTokens) + 1;
+
+		struct OperatorDfa
+		{
+			uint8_t next[operatorStateCount][128];
+			ReservedToken token[operatorStateCount];
+			bool accepting[operatorStateCount];
+
+			constexpr OperatorDfa()
+				: next(),
+				  token(),
+				  accepting()
 			{
-				return r.first.size() > _idx && (l.first.size() < _idx || l.first[_idx] < r.first[_idx]);
+				size_t states = 1;
+				for (const TokenEntry &e : operatorTokens)
+				{
+					size_t state = 0;
+					for (char c : e.first)
+					{
+						if (next[state][size_t(c)] == 0)
+						{
+							next[state][size_t(c)] = uint8_t(states++);
+						}
+						state = next[state][size_t(c)];
+					}
+					token[state] = e.second;
+					accepting[state] = true;
+				}
 			}
 		};
+
+		constexpr OperatorDfa operatorDfa;
 	}
 
-	std::optional<ReservedToken> getOperator(PushBackStream &stream)
+	std::optional<ReservedToken> getKeyword(std::string_view word)
 	{
-		auto candidates = std::make_pair(operatorTokenMap.begin(), operatorTokenMap.end());
+		if (word.size() < 2)
+		{
+			return std::nullopt;
+		}
+		const TokenEntry &e = keywordTable.slots[keywordHash(word, keywordSeed)];
+		return e.first == word ? std::make_optional(e.second) : std::nullopt;
+	}
 
+	template <typename Stream>
+	std::optional<ReservedToken> getOperator(Stream &stream)
+	{
 		std::optional<ReservedToken> ret;
-		size_t match_size = 0;
+		size_t state = 0;
 
-		std::stack<int> chars;
+		std::array<int, 4> chars;
+		size_t count = 0;
+		size_t matchSize = 0;
 
-		for (size_t idx = 0; candidates.first != candidates.second; ++idx)
+		while (true)
 		{
-			chars.push(stream());
-
-			candidates = std::equal_range(candidates.first, candidates.second, char(chars.top()), MaximalMunchComparator(idx));
-
-			if (candidates.first != candidates.second && candidates.first->first.size() == idx + 1)
+			int c = stream();
+			size_t nextState = c > 0 && c < 128 ? operatorDfa.next[state][c] : 0;
+			if (nextState == 0 || count == chars.size())
+			{
+				stream.pushBack(c);
+				break;
+			}
+			chars[count++] = c;
+			state = nextState;
+			if (operatorDfa.accepting[state])
 			{
-				match_size = idx + 1;
-				ret = candidates.first->second;
+				matchSize = count;
+				ret = operatorDfa.token[state];
 			}
 		}
 
-		while (chars.size() > match_size)
+		while (count > matchSize)
 		{
-			stream.pushBack(chars.top());
-			chars.pop();
+			stream.pushBack(chars[--count]);
 		}
 
 		return ret;
 	}
 
+	template std::optional<ReservedToken> getOperator(PushBackStream &stream);
+	template std::optional<ReservedToken> getOperator(BufferStream &stream);
+
 	Token::Token(TokenValue value, size_t lineNumber, size_t charIndex)
 		: _value(std::move(value)),
 		  _lineNumber(lineNumber),
@@ -200,6 +275,14 @@ namespace sharpsenLang
 	{
 	}
 
+	Token::Token(TokenValue value, std::shared_ptr<const std::string> storage, size_t lineNumber, size_t charIndex)
+		: _value(std::move(value)),
+		  _storage(std::move(storage)),
+		  _lineNumber(lineNumber),
+		  _charIndex(charIndex)
+	{
+	}
+
 	bool Token::isReservedToken() const
 	{
 		return std::holds_alternative<ReservedToken>(_value);
@@ -217,7 +300,7 @@ namespace sharpsenLang
 
 	bool Token::isString() const
 	{
-		return std::holds_alternative<std::string>(_value);
+		return std::holds_alternative<std::string_view>(_value);
 	}
 
 	bool Token::isEof() const
@@ -240,9 +323,9 @@ namespace sharpsenLang
 		return std::get<double>(_value);
 	}
 
-	const std::string &Token::getString() const
+	std::string_view Token::getString() const
 	{
-		return std::get<std::string>(_value);
+		return std::get<std::string_view>(_value);
 	}
 
 	const TokenValue &Token::getValue() const
@@ -260,6 +343,11 @@ namespace sharpsenLang
 		return _charIndex;
 	}
 
+	bool Token::ownsText() const
+	{
+		return bool(_storage);
+	}
+
 	bool Token::hasValue(const TokenValue &value) const
 	{
 		return _value == value;
@@ -305,13 +393,13 @@ namespace std
 					   {
 						   return to_string(d);
 					   },
-					   [](const std::string &str)
+					   [](std::string_view str)
 					   {
-						   return str;
+						   return std::string(str);
 					   },
 					   [](const Identifier &id)
 					   {
-						   return id.name;
+						   return std::string(id.name);
 					   },
 					   [](Eof)
 					   {
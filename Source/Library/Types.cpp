@@ -99,6 +99,7 @@ namespace sharpsenLang
 	const ClassType *TypeRegistry::getClassType(const std::string &className) const
 	{
 		ClassType ct{className};
+		std::shared_lock lock(_mutex);
 		if (auto foundType = _types.find(ct); foundType != _types.end())
 		{
 			return std::get_if<ClassType>(&(*foundType));
@@ -141,10 +142,20 @@ namespace sharpsenLang
 						return TypeRegistry::getNumberHandle();
 					case SimpleType::String:
 						return TypeRegistry::getStringHandle();
+					case SimpleType::Int:
+						return TypeRegistry::getIntHandle();
 					}
 				},
 				[this](const auto &t)
 				{
+					{
+						std::shared_lock lock(_mutex);
+						if (auto found = _types.find(t); found != _types.end())
+						{
+							return &(*found);
+						}
+					}
+					std::unique_lock lock(_mutex);
 					return &(*(_types.insert(t).first));
 				}},
 			t);
@@ -153,6 +164,7 @@ namespace sharpsenLang
 	Type TypeRegistry::voidType = SimpleType::Void;
 	Type TypeRegistry::numberType = SimpleType::Number;
 	Type TypeRegistry::stringType = SimpleType::String;
+	Type TypeRegistry::intType = SimpleType::Int;
 }
 
 namespace std
@@ -172,6 +184,8 @@ namespace std
 						return std::string("number");
 					case SimpleType::String:
 						return std::string("string");
+					case SimpleType::Int:
+						return std::string("int");
 					}
 				},
 				[](const ArrayType &at)
@@ -1,4 +1,7 @@
+#include <limits>
+
 #include "Variable.hpp"
+#include "VariablePool.hpp"
 
 namespace sharpsenLang
 {
@@ -20,7 +23,22 @@ namespace sharpsenLang
 	template <typename T>
 	VariablePtr VariableImpl<T>::clone() const
 	{
-		return std::make_shared<VariableImpl<T>>(cloneVariableValue(value));
+		return createVariable<T>(cloneVariableValue(value));
+	}
+
+	template <typename T>
+	void VariableImpl<T>::destroy() noexcept
+	{
+		VariablePool *pool = _pool;
+		this->~VariableImpl();
+		if (pool)
+		{
+			pool->deallocate(variablePoolIndex<T>(), this, sizeof(VariableImpl<T>));
+		}
+		else
+		{
+			::operator delete(this);
+		}
 	}
 
 	template <typename T>
@@ -30,6 +48,7 @@ namespace sharpsenLang
 	}
 
 	template class VariableImpl<Number>;
+	template class VariableImpl<Integer>;
 	template class VariableImpl<String>;
 	template class VariableImpl<Function>;
 	template class VariableImpl<Array>;
@@ -40,6 +59,11 @@ namespace sharpsenLang
 		return value;
 	}
 
+	Integer cloneVariableValue(Integer value)
+	{
+		return value;
+	}
+
 	String cloneVariableValue(const String &value)
 	{
 		return value;
@@ -52,22 +76,18 @@ namespace sharpsenLang
 
 	Array cloneVariableValue(const Array &value)
 	{
-		Array ret;
-		for (const VariablePtr &v : value)
-		{
-			ret.push_back(v->clone());
-		}
-		return ret;
+		return value;
 	}
 
 	Class cloneVariableValue(const Class &value)
 	{
-		Class ret;
-		for (const VariablePtr &v : value.properties)
+		std::vector<VariablePtr> properties;
+		properties.reserve(value.properties->size());
+		for (const VariablePtr &v : *value.properties)
 		{
-			ret.properties.push_back(v->clone());
+			properties.push_back(v->clone());
 		}
-		return ret;
+		return Class{std::make_shared<const std::vector<VariablePtr>>(std::move(properties))};
 	}
 
 	String convertToString(Number value)
@@ -82,12 +102,34 @@ namespace sharpsenLang
 		}
 	}
 
+	String convertToString(Integer value)
+	{
+		return fromStdString(std::to_string(value));
+	}
+
+	Integer convertToInteger(Number value)
+	{
+		if (value != value)
+		{
+			return 0;
+		}
+		if (value >= 0x1p63)
+		{
+			return std::numeric_limits<Integer>::max();
+		}
+		if (value < -0x1p63)
+		{
+			return std::numeric_limits<Integer>::min();
+		}
+		return Integer(value);
+	}
+
 	String convertToString(const String &value)
 	{
 		return value;
 	}
 
-	String convertToString(const Function &value)
+	String convertToString(const Function &)
 	{
 		return fromStdString("FUNCTION");
 	}
@@ -96,17 +138,24 @@ namespace sharpsenLang
 	{
 		std::string ret = "[";
 		const char *separator = "";
-		for (const VariablePtr &v : value)
+		for (const Value &v : value)
 		{
 			ret += separator;
-			ret += *(v->toString());
+			if (Variable *variable = v.variable())
+			{
+				ret += *(variable->toString());
+			}
+			else
+			{
+				ret += *convertToString(v.toNumber());
+			}
 			separator = ", ";
 		}
 		ret += "]";
 		return fromStdString(std::move(ret));
 	}
 
-	String convertToString(const Class &value)
+	String convertToString(const Class &)
 	{
 		return fromStdString("CLASS");
 	}
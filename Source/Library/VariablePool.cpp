@@ -0,0 +1,107 @@
+#include <new>
+
+#include "VariablePool.hpp"
+
+namespace sharpsenLang
+{
+	thread_local VariablePool *VariablePool::_current = nullptr;
+
+	VariablePool::VariablePool()
+		: _live(0),
+		  _detached(false)
+	{
+	}
+
+	VariablePool::~VariablePool()
+	{
+		for (FreeList &list : _lists)
+		{
+			while (list.head)
+			{
+				Block *block = list.head;
+				list.head = block->next;
+				::operator delete(block);
+			}
+		}
+	}
+
+	void *VariablePool::allocate(size_t list, size_t size)
+	{
+		FreeList &l = _lists[list];
+		if (l.blockSize == 0)
+		{
+			l.blockSize = size;
+		}
+
+		if (size != l.blockSize)
+		{
+			return ::operator new(size);
+		}
+
+		++_live;
+		if (Block *block = l.head)
+		{
+			++l.stats.hits;
+			l.head = block->next;
+			return block;
+		}
+
+		++l.stats.misses;
+		return ::operator new(size);
+	}
+
+	void VariablePool::deallocate(size_t list, void *p, size_t size)
+	{
+		FreeList &l = _lists[list];
+		if (size != l.blockSize)
+		{
+			::operator delete(p);
+			return;
+		}
+
+		Block *block = static_cast<Block *>(p);
+		block->next = l.head;
+		l.head = block;
+
+		if (--_live == 0 && _detached)
+		{
+			delete this;
+		}
+	}
+
+	VariablePoolStats VariablePool::stats() const
+	{
+		VariablePoolStats ret;
+		for (const FreeList &list : _lists)
+		{
+			ret.hits += list.stats.hits;
+			ret.misses += list.stats.misses;
+		}
+		return ret;
+	}
+
+	void VariablePool::detach()
+	{
+		if (_current == this)
+		{
+			_current = nullptr;
+		}
+
+		_detached = true;
+		if (_live == 0)
+		{
+			delete this;
+		}
+	}
+
+	VariablePool::Scope::Scope(VariablePool *pool)
+		: _previous(_current)
+	{
+		_current = pool;
+	}
+
+	VariablePool::Scope::~Scope()
+	{
+		_current = _previous;
+	}
+}
@@ -0,0 +1,662 @@
+#include <iterator>
+#include <vector>
+
+#include "VirtualMachine.hpp"
+#include "Array.hpp"
+#include "Bytecode.hpp"
+#include "RuntimeContext.hpp"
+#include "Errors.hpp"
+
+// Every OpCode, in declaration order.
+#define OPCODES(X) \
+	X(Move) \
+	X(MoveInteger) \
+	X(LoadGlobal) \
+	X(StoreGlobal) \
+	X(LoadLocalInteger) \
+	X(StoreLocalInteger) \
+	X(LoadGlobalInteger) \
+	X(StoreGlobalInteger) \
+	X(IntegerToNumber) \
+	X(NumberToInteger) \
+	X(Negative) \
+	X(Bnot) \
+	X(Lnot) \
+	X(Add) \
+	X(Sub) \
+	X(Mul) \
+	X(Div) \
+	X(Idiv) \
+	X(Mod) \
+	X(Band) \
+	X(Bor) \
+	X(Bxor) \
+	X(Bsl) \
+	X(Bsr) \
+	X(Eq) \
+	X(Ne) \
+	X(Lt) \
+	X(Gt) \
+	X(Le) \
+	X(Ge) \
+	X(NegativeInteger) \
+	X(BnotInteger) \
+	X(AddInteger) \
+	X(SubInteger) \
+	X(MulInteger) \
+	X(IdivInteger) \
+	X(ModInteger) \
+	X(BandInteger) \
+	X(BorInteger) \
+	X(BxorInteger) \
+	X(BslInteger) \
+	X(BsrInteger) \
+	X(EqInteger) \
+	X(NeInteger) \
+	X(LtInteger) \
+	X(GtInteger) \
+	X(LeInteger) \
+	X(GeInteger) \
+	X(IncrementLocal) \
+	X(DecrementLocal) \
+	X(IncrementLocalInteger) \
+	X(DecrementLocalInteger) \
+	X(AddLocalInteger) \
+	X(SubLocalInteger) \
+	X(IndexLocal) \
+	X(IndexLocalInRange) \
+	X(Jump) \
+	X(JumpIfFalse) \
+	X(JumpIfTrue) \
+	X(JumpIfLess) \
+	X(JumpIfNotLess) \
+	X(JumpIfEqual) \
+	X(JumpIfNotEqual) \
+	X(JumpIfLessInteger) \
+	X(JumpIfNotLessInteger) \
+	X(JumpIfEqualInteger) \
+	X(JumpIfNotEqualInteger) \
+	X(Switch) \
+	X(EvaluateVoid) \
+	X(EvaluateNumber) \
+	X(EvaluateInteger) \
+	X(DeclareLocal) \
+	X(DeclareLocalInteger) \
+	X(DeclareLocalTree) \
+	X(BeginCall) \
+	X(PushArgument) \
+	X(PushArgumentInteger) \
+	X(PushArgumentTree) \
+	X(PushLocalReference) \
+	X(PushGlobalReference) \
+	X(Call) \
+	X(CallLocal) \
+	X(CallGlobal) \
+	X(CallInteger) \
+	X(CallLocalInteger) \
+	X(CallGlobalInteger) \
+	X(TailCall) \
+	X(Return) \
+	X(ReturnInteger) \
+	X(ReturnTree) \
+	X(ReturnVoid)
+
+// Where the address of a label can be taken, each handler ends with its own
+// jump to the next instruction's handler. Those jumps are predicted far
+// better than the single one shared by the switch.
+#if defined(__GNUC__)
+#define THREADED_DISPATCH
+#define HANDLER(op) \
+	case OpCode::op: \
+	op##Handler
+#define NEXT \
+	i = &code[pc++]; \
+	goto *handlers[size_t(i->op)]
+#else
+#define HANDLER(op) case OpCode::op
+#define NEXT break
+#endif
+
+namespace sharpsenLang
+{
+	namespace
+	{
+		// The function's int registers, preceded by its int constants.
+		class RegistersRaii
+		{
+		private:
+			RuntimeContext &_context;
+			size_t _base;
+			size_t _constants;
+
+		public:
+			RegistersRaii(RuntimeContext &context, const BytecodeFunction &function)
+				: _context(context),
+				  _base(context.allocateRegisters(function.integerConstants().size() + function.integerRegisterCount())),
+				  _constants(function.integerConstants().size())
+			{
+				Register *r = get();
+				for (size_t idx = 0; idx < _constants; ++idx)
+				{
+					r[-1 - int(idx)] = function.integerConstants()[idx];
+				}
+			}
+
+			~RegistersRaii()
+			{
+				_context.releaseRegisters(_base);
+			}
+
+			Register *get() const
+			{
+				return _context.registers(_base) + _constants;
+			}
+		};
+
+#define OPCODE_VALUE(op) OpCode::op,
+		constexpr OpCode opCodes[] = {OPCODES(OPCODE_VALUE)};
+#undef OPCODE_VALUE
+
+		constexpr bool listsEveryOpCode()
+		{
+			for (size_t i = 0; i < std::size(opCodes); ++i)
+			{
+				if (opCodes[i] != OpCode(i))
+				{
+					return false;
+				}
+			}
+			return std::size(opCodes) == size_t(OpCode::ReturnVoid) + 1;
+		}
+
+		static_assert(listsEveryOpCode(), "OPCODES must list every OpCode in declaration order");
+	}
+
+	void executeBytecode(RuntimeContext &context, const BytecodeFunction &function)
+	{
+		const Instruction *code = function.code().data();
+		RegistersRaii registers(context, function);
+		Register *r = registers.get();
+		// Calls made from here restore the frame before they return. The number
+		// registers are its slots, which start out empty.
+		Value *locals = context.locals();
+		const std::vector<Register> &constants = function.constants();
+		Value *constantSlots = locals + function.firstRegister() + function.registerCount();
+		for (size_t idx = 0; idx < constants.size(); ++idx)
+		{
+			constantSlots[idx] = Value(constants[idx].number);
+		}
+
+#ifdef THREADED_DISPATCH
+#define HANDLER_ADDRESS(op) &&op##Handler,
+		static void *const handlers[] = {OPCODES(HANDLER_ADDRESS)};
+#undef HANDLER_ADDRESS
+#endif
+
+		for (size_t pc = 0;;)
+		{
+			const Instruction *i = &code[pc++];
+
+#ifdef THREADED_DISPATCH
+			goto *handlers[size_t(i->op)];
+#endif
+			switch (i->op)
+			{
+			HANDLER(Move):
+				locals[i->a].setNumber(locals[i->b].toNumber());
+				NEXT;
+			HANDLER(MoveInteger):
+				r[i->a] = r[i->b];
+				NEXT;
+			HANDLER(LoadGlobal):
+				locals[i->a].setNumber(context.globalValue(i->b).toNumber());
+				NEXT;
+			HANDLER(StoreGlobal):
+				context.globalValue(i->a).setNumber(locals[i->b].toNumber());
+				NEXT;
+			HANDLER(LoadLocalInteger):
+				r[i->a].integer = locals[i->b].toInteger();
+				NEXT;
+			HANDLER(StoreLocalInteger):
+				locals[i->a].setInteger(r[i->b].integer);
+				NEXT;
+			HANDLER(LoadGlobalInteger):
+				r[i->a].integer = context.globalValue(i->b).toInteger();
+				NEXT;
+			HANDLER(StoreGlobalInteger):
+				context.globalValue(i->a).setInteger(r[i->b].integer);
+				NEXT;
+			HANDLER(IntegerToNumber):
+				locals[i->a].setNumber(Number(r[i->b].integer));
+				NEXT;
+			HANDLER(NumberToInteger):
+				r[i->a].integer = convertToInteger(locals[i->b].toNumber());
+				NEXT;
+
+			HANDLER(Negative):
+				locals[i->a].setNumber(-locals[i->b].toNumber());
+				NEXT;
+			HANDLER(Bnot):
+				locals[i->a].setNumber(~int(locals[i->b].toNumber()));
+				NEXT;
+			HANDLER(Lnot):
+				locals[i->a].setNumber(!locals[i->b].toNumber());
+				NEXT;
+
+			HANDLER(Add):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(b + c);
+				NEXT;
+			}
+			HANDLER(Sub):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(b - c);
+				NEXT;
+			}
+			HANDLER(Mul):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(b * c);
+				NEXT;
+			}
+			HANDLER(Div):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(b / c);
+				NEXT;
+			}
+			HANDLER(Idiv):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(int(b / c));
+				NEXT;
+			}
+			HANDLER(Mod):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(b - c * int(b / c));
+				NEXT;
+			}
+			HANDLER(Band):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(int(b) & int(c));
+				NEXT;
+			}
+			HANDLER(Bor):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(int(b) | int(c));
+				NEXT;
+			}
+			HANDLER(Bxor):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(int(b) ^ int(c));
+				NEXT;
+			}
+			HANDLER(Bsl):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(int(b) << int(c));
+				NEXT;
+			}
+			HANDLER(Bsr):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(int(b) >> int(c));
+				NEXT;
+			}
+			HANDLER(Eq):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(!(b < c) && !(c < b));
+				NEXT;
+			}
+			HANDLER(Ne):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(b < c || c < b);
+				NEXT;
+			}
+			HANDLER(Lt):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(b < c);
+				NEXT;
+			}
+			HANDLER(Gt):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(c < b);
+				NEXT;
+			}
+			HANDLER(Le):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(!(c < b));
+				NEXT;
+			}
+			HANDLER(Ge):
+			{
+				Number b = locals[i->b].toNumber();
+				Number c = locals[i->c].toNumber();
+				locals[i->a].setNumber(!(b < c));
+				NEXT;
+			}
+
+			// Ints wrap around on overflow and take shift counts modulo 64.
+			HANDLER(NegativeInteger):
+				r[i->a].integer = Integer(0 - uint64_t(r[i->b].integer));
+				NEXT;
+			HANDLER(BnotInteger):
+				r[i->a].integer = ~r[i->b].integer;
+				NEXT;
+
+			HANDLER(AddInteger):
+				r[i->a].integer = Integer(uint64_t(r[i->b].integer) + uint64_t(r[i->c].integer));
+				NEXT;
+			HANDLER(SubInteger):
+				r[i->a].integer = Integer(uint64_t(r[i->b].integer) - uint64_t(r[i->c].integer));
+				NEXT;
+			HANDLER(MulInteger):
+				r[i->a].integer = Integer(uint64_t(r[i->b].integer) * uint64_t(r[i->c].integer));
+				NEXT;
+			HANDLER(IdivInteger):
+				runtimeAssertion(r[i->c].integer != 0, "Integer division by zero");
+				r[i->a].integer = r[i->c].integer == -1 ? Integer(0 - uint64_t(r[i->b].integer)) : r[i->b].integer / r[i->c].integer;
+				NEXT;
+			HANDLER(ModInteger):
+				runtimeAssertion(r[i->c].integer != 0, "Integer division by zero");
+				r[i->a].integer = r[i->c].integer == -1 ? 0 : r[i->b].integer % r[i->c].integer;
+				NEXT;
+			HANDLER(BandInteger):
+				r[i->a].integer = r[i->b].integer & r[i->c].integer;
+				NEXT;
+			HANDLER(BorInteger):
+				r[i->a].integer = r[i->b].integer | r[i->c].integer;
+				NEXT;
+			HANDLER(BxorInteger):
+				r[i->a].integer = r[i->b].integer ^ r[i->c].integer;
+				NEXT;
+			HANDLER(BslInteger):
+				r[i->a].integer = Integer(uint64_t(r[i->b].integer) << (r[i->c].integer & 63));
+				NEXT;
+			HANDLER(BsrInteger):
+				r[i->a].integer = r[i->b].integer >> (r[i->c].integer & 63);
+				NEXT;
+			HANDLER(EqInteger):
+				locals[i->a].setNumber(r[i->b].integer == r[i->c].integer);
+				NEXT;
+			HANDLER(NeInteger):
+				locals[i->a].setNumber(r[i->b].integer != r[i->c].integer);
+				NEXT;
+			HANDLER(LtInteger):
+				locals[i->a].setNumber(r[i->b].integer < r[i->c].integer);
+				NEXT;
+			HANDLER(GtInteger):
+				locals[i->a].setNumber(r[i->b].integer > r[i->c].integer);
+				NEXT;
+			HANDLER(LeInteger):
+				locals[i->a].setNumber(r[i->b].integer <= r[i->c].integer);
+				NEXT;
+			HANDLER(GeInteger):
+				locals[i->a].setNumber(r[i->b].integer >= r[i->c].integer);
+				NEXT;
+
+			HANDLER(IncrementLocal):
+				locals[i->a].setNumber(locals[i->a].toNumber() + 1);
+				NEXT;
+			HANDLER(DecrementLocal):
+				locals[i->a].setNumber(locals[i->a].toNumber() - 1);
+				NEXT;
+			HANDLER(IncrementLocalInteger):
+				locals[i->a].setInteger(Integer(uint64_t(locals[i->a].toInteger()) + 1));
+				NEXT;
+			HANDLER(DecrementLocalInteger):
+				locals[i->a].setInteger(Integer(uint64_t(locals[i->a].toInteger()) - 1));
+				NEXT;
+			HANDLER(AddLocalInteger):
+				locals[i->a].setInteger(Integer(uint64_t(locals[i->a].toInteger()) + uint64_t(r[i->b].integer)));
+				NEXT;
+			HANDLER(SubLocalInteger):
+				locals[i->a].setInteger(Integer(uint64_t(locals[i->a].toInteger()) - uint64_t(r[i->b].integer)));
+				NEXT;
+			HANDLER(IndexLocal):
+			{
+				Array &array = static_cast<VariableImpl<Array> *>(locals[i->b].variable())->value;
+				int idx = int(locals[i->c].toNumber());
+				runtimeAssertion(idx >= 0, "Negative index is invalid");
+				if (size_t(idx) >= array.size())
+				{
+					array.elements().resize(idx + 1, Value(Number(0)));
+				}
+				locals[i->a].setNumber(array[idx].toNumber());
+				NEXT;
+			}
+			HANDLER(IndexLocalInRange):
+			{
+				const Array &array = static_cast<VariableImpl<Array> *>(locals[i->b].variable())->value;
+				locals[i->a].setNumber(array[size_t(locals[i->c].toNumber())].toNumber());
+				NEXT;
+			}
+
+			HANDLER(Jump):
+				pc = i->a;
+				NEXT;
+			HANDLER(JumpIfFalse):
+				if (!locals[i->a].toNumber())
+				{
+					pc = i->b;
+				}
+				NEXT;
+			HANDLER(JumpIfTrue):
+				if (locals[i->a].toNumber())
+				{
+					pc = i->b;
+				}
+				NEXT;
+			HANDLER(JumpIfLess):
+				if (locals[i->a].toNumber() < locals[i->b].toNumber())
+				{
+					pc = i->c;
+				}
+				NEXT;
+			HANDLER(JumpIfNotLess):
+				if (!(locals[i->a].toNumber() < locals[i->b].toNumber()))
+				{
+					pc = i->c;
+				}
+				NEXT;
+			HANDLER(JumpIfEqual):
+			{
+				Number a = locals[i->a].toNumber();
+				Number b = locals[i->b].toNumber();
+				if (!(a < b) && !(b < a))
+				{
+					pc = i->c;
+				}
+				NEXT;
+			}
+			HANDLER(JumpIfNotEqual):
+			{
+				Number a = locals[i->a].toNumber();
+				Number b = locals[i->b].toNumber();
+				if (a < b || b < a)
+				{
+					pc = i->c;
+				}
+				NEXT;
+			}
+			HANDLER(JumpIfLessInteger):
+				if (r[i->a].integer < r[i->b].integer)
+				{
+					pc = i->c;
+				}
+				NEXT;
+			HANDLER(JumpIfNotLessInteger):
+				if (!(r[i->a].integer < r[i->b].integer))
+				{
+					pc = i->c;
+				}
+				NEXT;
+			HANDLER(JumpIfEqualInteger):
+				if (r[i->a].integer == r[i->b].integer)
+				{
+					pc = i->c;
+				}
+				NEXT;
+			HANDLER(JumpIfNotEqualInteger):
+				if (r[i->a].integer != r[i->b].integer)
+				{
+					pc = i->c;
+				}
+				NEXT;
+			HANDLER(Switch):
+			{
+				pc = function.switchTable(i->b).find(locals[i->a].toNumber());
+				NEXT;
+			}
+
+			HANDLER(EvaluateVoid):
+				function.voidExpression(i->a).evaluate(context);
+				r = registers.get();
+				NEXT;
+			HANDLER(EvaluateNumber):
+			{
+				Number value = function.numberExpression(i->b).evaluate(context);
+				r = registers.get();
+				locals[i->a].setNumber(value);
+				NEXT;
+			}
+			HANDLER(EvaluateInteger):
+			{
+				Integer value = function.integerExpression(i->b).evaluate(context);
+				r = registers.get();
+				r[i->a].integer = value;
+				NEXT;
+			}
+
+			HANDLER(DeclareLocal):
+				locals[i->a] = Value(locals[i->b].toNumber());
+				NEXT;
+			HANDLER(DeclareLocalInteger):
+				locals[i->a] = Value(r[i->b].integer);
+				NEXT;
+			HANDLER(DeclareLocalTree):
+				locals[i->a] = Value(function.lvalueExpression(i->b).evaluate(context));
+				r = registers.get();
+				NEXT;
+
+			HANDLER(BeginCall):
+				context.reserveArguments(i->a);
+				NEXT;
+			HANDLER(PushArgument):
+				context.argument(i->b) = Value(locals[i->a].toNumber());
+				NEXT;
+			HANDLER(PushArgumentInteger):
+				context.argument(i->b) = Value(r[i->a].integer);
+				NEXT;
+			HANDLER(PushArgumentTree):
+			{
+				VariablePtr argument = function.lvalueExpression(i->a).evaluate(context);
+				context.argument(i->b) = Value(std::move(argument));
+				r = registers.get();
+				NEXT;
+			}
+			HANDLER(PushLocalReference):
+				context.argument(i->b) = Value(context.local(i->a));
+				NEXT;
+			HANDLER(PushGlobalReference):
+				context.argument(i->b) = Value(context.global(i->a));
+				NEXT;
+
+			HANDLER(Call):
+			{
+				Value ret = context.callFrame(context.getFunction(i->b), i->c);
+				r = registers.get();
+				if (i->a != NoResult)
+				{
+					locals[i->a].setNumber(ret.toNumber());
+				}
+				NEXT;
+			}
+			HANDLER(CallLocal):
+			HANDLER(CallGlobal):
+			{
+				VariablePtr callee = i->op == OpCode::CallLocal ? context.local(i->b) : context.global(i->b);
+				Function f = static_cast<VariableImpl<Function> *>(callee.get())->value;
+				Value ret = context.callFrame(f, i->c);
+				r = registers.get();
+				if (i->a != NoResult)
+				{
+					locals[i->a].setNumber(ret.toNumber());
+				}
+				NEXT;
+			}
+			HANDLER(CallInteger):
+			{
+				Value ret = context.callFrame(context.getFunction(i->b), i->c);
+				r = registers.get();
+				if (i->a != NoResult)
+				{
+					r[i->a].integer = ret.toInteger();
+				}
+				NEXT;
+			}
+			HANDLER(CallLocalInteger):
+			HANDLER(CallGlobalInteger):
+			{
+				VariablePtr callee = i->op == OpCode::CallLocalInteger ? context.local(i->b) : context.global(i->b);
+				Function f = static_cast<VariableImpl<Function> *>(callee.get())->value;
+				Value ret = context.callFrame(f, i->c);
+				r = registers.get();
+				if (i->a != NoResult)
+				{
+					r[i->a].integer = ret.toInteger();
+				}
+				NEXT;
+			}
+
+			HANDLER(TailCall):
+				context.tailCall(context.getFunction(i->a), i->b);
+				return;
+
+			HANDLER(Return):
+				context.retvalValue() = Value(locals[i->a].toNumber());
+				return;
+			HANDLER(ReturnInteger):
+				context.retvalValue() = Value(r[i->a].integer);
+				return;
+			HANDLER(ReturnTree):
+				context.retvalValue() = Value(function.lvalueExpression(i->a).evaluate(context));
+				return;
+			HANDLER(ReturnVoid):
+				return;
+			}
+		}
+	}
+}
+
+#undef HANDLER
+#undef NEXT
+#undef THREADED_DISPATCH
+#undef OPCODES
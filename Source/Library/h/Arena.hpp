@@ -0,0 +1,96 @@
+#pragma once
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <utility>
+
+namespace sharpsenLang
+{
+	// Bump allocator for short-lived compile-time structures. Memory is
+	// handed out from large blocks and only reclaimed all at once.
+	class Arena
+	{
+		Arena(const Arena &) = delete;
+		void operator=(const Arena &) = delete;
+
+	private:
+		std::vector<std::unique_ptr<char[]>> _blocks;
+		char *_current;
+		size_t _remaining;
+		size_t _blockSize;
+		size_t _bytesAllocated;
+
+	public:
+		explicit Arena(size_t blockSize = 1 << 16);
+
+		void *allocate(size_t size, size_t alignment);
+
+		template <typename T, typename... Args>
+		T *create(Args &&...args)
+		{
+			return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		}
+
+		std::string_view copyString(std::string_view text);
+
+		void release();
+
+		size_t blockCount() const;
+		size_t bytesAllocated() const;
+	};
+
+	template <typename T>
+	class ArenaAllocator
+	{
+		template <typename U>
+		friend class ArenaAllocator;
+
+	private:
+		Arena *_arena;
+
+	public:
+		using value_type = T;
+
+		ArenaAllocator(Arena &arena)
+			: _arena(&arena)
+		{
+		}
+
+		template <typename U>
+		ArenaAllocator(const ArenaAllocator<U> &other)
+			: _arena(other._arena)
+		{
+		}
+
+		T *allocate(size_t n)
+		{
+			return static_cast<T *>(_arena->allocate(n * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T *, size_t)
+		{
+		}
+
+		template <typename U>
+		bool operator==(const ArenaAllocator<U> &other) const
+		{
+			return _arena == other._arena;
+		}
+
+		template <typename U>
+		bool operator!=(const ArenaAllocator<U> &other) const
+		{
+			return _arena != other._arena;
+		}
+	};
+
+	// Runs the destructor of an arena-allocated object without freeing its memory.
+	template <typename T>
+	struct ArenaDeleter
+	{
+		void operator()(T *p) const
+		{
+			p->~T();
+		}
+	};
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#include "Value.hpp"
+
+namespace sharpsenLang
+{
+	// Copy-on-write vector of NaN-boxed values backing arrays and tuples, so
+	// number[] stays a contiguous run of doubles until an element is referenced.
+	// Copies share storage and the first write through either side clones the
+	// elements, so passing an array by value is a reference count bump.
+	//
+	// Element boxes handed out by reference() can outlive the access and be
+	// written later, bypassing elements(). Storage that did so is marked as
+	// escaped and is only shared again once none of its boxes is referenced
+	// from outside; until then copies are deep.
+	class Array
+	{
+	private:
+		struct Storage
+		{
+			std::vector<Value> elements;
+			bool escaped = false;
+		};
+
+		std::shared_ptr<Storage> _storage;
+
+		static const std::vector<Value> &emptyElements();
+		bool canShare() const;
+		void detach();
+
+	public:
+		using const_iterator = std::vector<Value>::const_iterator;
+
+		Array() = default;
+		Array(std::vector<Value> elements);
+		Array(std::initializer_list<Value> elements);
+
+		template <typename It>
+		Array(It first, It last)
+			: Array(std::vector<Value>(first, last))
+		{
+		}
+
+		Array(const Array &other);
+		Array(Array &&other) noexcept = default;
+		Array &operator=(const Array &other);
+		Array &operator=(Array &&other) noexcept = default;
+
+		size_t size() const
+		{
+			return _storage ? _storage->elements.size() : 0;
+		}
+
+		bool empty() const
+		{
+			return size() == 0;
+		}
+
+		const Value &operator[](size_t idx) const
+		{
+			return _storage->elements[idx];
+		}
+
+		const_iterator begin() const
+		{
+			return (_storage ? _storage->elements : emptyElements()).begin();
+		}
+
+		const_iterator end() const
+		{
+			return (_storage ? _storage->elements : emptyElements()).end();
+		}
+
+		// Elements for writing, cloned first if the storage is shared.
+		std::vector<Value> &elements()
+		{
+			if (!_storage || _storage.use_count() != 1)
+			{
+				detach();
+			}
+			return _storage->elements;
+		}
+
+		// Boxed element that the caller may keep and write through.
+		VariablePtr reference(size_t idx)
+		{
+			std::vector<Value> &values = elements();
+			_storage->escaped = true;
+			return values[idx].boxed();
+		}
+
+		bool sharesStorage(const Array &other) const
+		{
+			return _storage && _storage == other._storage;
+		}
+	};
+}
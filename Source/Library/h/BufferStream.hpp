@@ -0,0 +1,58 @@
+#pragma once
+#include <string_view>
+
+namespace sharpsenLang
+{
+	// Character stream over a caller-owned buffer. Tokens produced from it
+	// may refer to slices of the buffer, so it has to outlive them.
+	class BufferStream
+	{
+	private:
+		std::string_view _buffer;
+		size_t _position;
+		size_t _lineNumber;
+
+	public:
+		BufferStream(std::string_view buffer)
+			: _buffer(buffer),
+			  _position(0),
+			  _lineNumber(0)
+		{
+		}
+
+		int operator()()
+		{
+			int ret = _position < _buffer.size() ? static_cast<unsigned char>(_buffer[_position]) : -1;
+			if (ret == '\n')
+			{
+				++_lineNumber;
+			}
+			++_position;
+			return ret;
+		}
+
+		void pushBack(int c)
+		{
+			if (c == '\n')
+			{
+				--_lineNumber;
+			}
+			--_position;
+		}
+
+		std::string_view slice(size_t begin, size_t end) const
+		{
+			return _buffer.substr(begin, end - begin);
+		}
+
+		size_t lineNumber() const
+		{
+			return _lineNumber;
+		}
+
+		size_t charIndex() const
+		{
+			return _position;
+		}
+	};
+}
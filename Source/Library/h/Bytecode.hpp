@@ -0,0 +1,307 @@
+#pragma once
+#include <climits>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "Variable.hpp"
+#include "Value.hpp"
+#include "Expression.hpp"
+#include "Statement.hpp"
+#include "CaseTable.hpp"
+
+namespace sharpsenLang
+{
+	// Number registers are frame slots, so the locals are registers too. The
+	// temporaries follow the locals and the constants follow the temporaries.
+	// Ints are kept in a separate register file, below which their constants are.
+	enum struct OpCode : unsigned char
+	{
+		Move,
+		MoveInteger,
+		LoadGlobal,
+		StoreGlobal,
+		LoadLocalInteger,
+		StoreLocalInteger,
+		LoadGlobalInteger,
+		StoreGlobalInteger,
+		IntegerToNumber,
+		NumberToInteger,
+
+		Negative,
+		Bnot,
+		Lnot,
+
+		Add,
+		Sub,
+		Mul,
+		Div,
+		Idiv,
+		Mod,
+		Band,
+		Bor,
+		Bxor,
+		Bsl,
+		Bsr,
+		Eq,
+		Ne,
+		Lt,
+		Gt,
+		Le,
+		Ge,
+
+		NegativeInteger,
+		BnotInteger,
+
+		AddInteger,
+		SubInteger,
+		MulInteger,
+		IdivInteger,
+		ModInteger,
+		BandInteger,
+		BorInteger,
+		BxorInteger,
+		BslInteger,
+		BsrInteger,
+		EqInteger,
+		NeInteger,
+		LtInteger,
+		GtInteger,
+		LeInteger,
+		GeInteger,
+
+		// Updates of a local whose result is unused, and a[i] reads of local
+		// number arrays with a number local index.
+		IncrementLocal,
+		DecrementLocal,
+		IncrementLocalInteger,
+		DecrementLocalInteger,
+		AddLocalInteger,
+		SubLocalInteger,
+		IndexLocal,
+		IndexLocalInRange,
+
+		Jump,
+		JumpIfFalse,
+		JumpIfTrue,
+		// Comparisons fused with the jump on their result.
+		JumpIfLess,
+		JumpIfNotLess,
+		JumpIfEqual,
+		JumpIfNotEqual,
+		JumpIfLessInteger,
+		JumpIfNotLessInteger,
+		JumpIfEqualInteger,
+		JumpIfNotEqualInteger,
+		Switch,
+
+		EvaluateVoid,
+		EvaluateNumber,
+		EvaluateInteger,
+
+		DeclareLocal,
+		DeclareLocalInteger,
+		DeclareLocalTree,
+
+		BeginCall,
+		PushArgument,
+		PushArgumentInteger,
+		PushArgumentTree,
+		PushLocalReference,
+		PushGlobalReference,
+
+		Call,
+		CallLocal,
+		CallGlobal,
+		CallInteger,
+		CallLocalInteger,
+		CallGlobalInteger,
+		TailCall,
+
+		Return,
+		ReturnInteger,
+		ReturnTree,
+		ReturnVoid,
+	};
+
+	struct Instruction
+	{
+		OpCode op;
+		int a;
+		int b;
+		int c;
+	};
+
+	// The register of a call whose result is dropped.
+	constexpr int NoResult = INT_MIN;
+
+	enum struct OperandKind
+	{
+		None,
+		Register,
+		Local,
+		Global,
+		Function,
+	};
+
+	struct Operand
+	{
+		OperandKind kind = OperandKind::None;
+		int index = 0;
+
+		static Operand none();
+		static Operand inRegister(int index);
+		static Operand local(int index);
+		static Operand global(int index);
+		static Operand function(int index);
+
+		bool isLocation() const;
+	};
+
+	class BytecodeFunction
+	{
+		friend class BytecodeBuilder;
+
+	private:
+		SharedStatementPtr _body;
+		std::vector<Instruction> _code;
+		std::vector<Register> _constants;
+		std::vector<Register> _integerConstants;
+		std::vector<CaseTable> _switchTables;
+		std::vector<const Expression<Void> *> _voidExpressions;
+		std::vector<const Expression<Number> *> _numberExpressions;
+		std::vector<const Expression<Integer> *> _integerExpressions;
+		std::vector<const Expression<Lvalue> *> _lvalueExpressions;
+		size_t _localCount;
+		size_t _registerCount;
+		size_t _integerRegisterCount;
+
+	public:
+		BytecodeFunction(SharedStatementPtr body, size_t localCount);
+
+		const std::vector<Instruction> &code() const;
+		// Slots of the locals, the temporaries and the constants.
+		size_t frameSize() const;
+		size_t firstRegister() const;
+		size_t registerCount() const;
+		// Number constants, held in the slots after the temporaries.
+		const std::vector<Register> &constants() const;
+		// Int constants are held in the int registers below the first, constant
+		// idx in register -1 - idx. Both kinds are set when the function is entered.
+		const std::vector<Register> &integerConstants() const;
+		const CaseTable &switchTable(int idx) const;
+		const Expression<Void> &voidExpression(int idx) const;
+		const Expression<Number> &numberExpression(int idx) const;
+		const Expression<Integer> &integerExpression(int idx) const;
+		const Expression<Lvalue> &lvalueExpression(int idx) const;
+		size_t integerRegisterCount() const;
+	};
+
+	class BytecodeBuilder
+	{
+	public:
+		using Label = int;
+
+		struct Mark
+		{
+			size_t code;
+			size_t constants;
+			size_t integerConstants;
+			size_t switchTables;
+			size_t voidExpressions;
+			size_t numberExpressions;
+			size_t integerExpressions;
+			size_t lvalueExpressions;
+			size_t labels;
+			int nextRegister;
+			int nextIntegerRegister;
+		};
+
+	private:
+		struct Breakable
+		{
+			Label breakLabel;
+			Label continueLabel;
+			bool isLoop;
+		};
+
+		// Constants are numbered from here until the code is finished, when they
+		// are moved after the temporaries.
+		static constexpr int firstConstant = 1 << 24;
+
+		BytecodeFunction &_function;
+		std::vector<int> _labels;
+		std::vector<Breakable> _breakables;
+		int _nextRegister;
+		int _nextIntegerRegister;
+
+		static Operand constantRegister(std::vector<Register> &constants, Register value, int first);
+		bool isTemporary(Operand value) const;
+		bool isBound(size_t position) const;
+		// The last instruction, if it computes the temporary value and isn't the
+		// target of a jump, so that it can compute into another register instead.
+		Instruction *producer(Operand value);
+		void emitCall(Operand callee, size_t argc, Operand result, OpCode function, OpCode local, OpCode global);
+
+	public:
+		BytecodeBuilder(BytecodeFunction &function);
+
+		Mark mark() const;
+		void rollback(const Mark &m);
+
+		void emit(OpCode op, int a = 0, int b = 0, int c = 0);
+
+		Operand allocateRegister();
+		void releaseRegisters();
+		Operand constant(Number value);
+		// A local is read in place, so its register changes with the local.
+		Operand load(Operand location);
+		Operand copy(Operand value);
+		// Returns the register holding the stored value.
+		Operand store(Operand location, Operand value);
+		// True if the code emitted since m may change the number in value.
+		bool mayWrite(const Mark &m, Operand value) const;
+
+		// Registers and locations holding ints.
+		Operand allocateIntegerRegister();
+		Operand integerConstant(Integer value);
+		Operand loadInteger(Operand location);
+		Operand storeInteger(Operand location, Operand value);
+
+		Operand lowerVoid(const Expression<Void> &expr);
+		Operand lowerNumber(const Expression<Number> &expr);
+		Operand lowerLnumber(const Expression<Lnumber> &expr);
+		Operand lowerInteger(const Expression<Integer> &expr);
+		Operand lowerLinteger(const Expression<Linteger> &expr);
+
+		Label createLabel();
+		void bindLabel(Label label);
+		void jump(Label label);
+		// A comparison computing the condition just before is fused with the
+		// jump, and then the condition's register isn't set.
+		void jumpIfFalse(Operand condition, Label label);
+		void jumpIfTrue(Operand condition, Label label);
+		void switchJump(Operand value, const std::unordered_map<Number, size_t> &cases, const std::vector<Label> &labels, Label dflt);
+
+		void declareLocal(const Expression<Lvalue> &expr, int slot);
+
+		void enterBreakable(Label breakLabel);
+		void enterLoop(Label breakLabel, Label continueLabel);
+		void leaveBreakable();
+		void breakFlow(int breakLevel);
+		void continueFlow();
+
+		void beginCall(size_t argc);
+		void pushArgument(const Expression<Lvalue> &expr, size_t slot);
+		void call(Operand callee, size_t argc, Operand result);
+		void callInteger(Operand callee, size_t argc, Operand result);
+		void tailCall(Operand callee, size_t argc);
+
+		void returnValue(const Expression<Lvalue> &expr);
+		void returnVoid();
+
+		void finish();
+	};
+
+	Function createBytecodeFunction(SharedStatementPtr body, size_t frameSize);
+}
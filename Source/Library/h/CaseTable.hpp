@@ -0,0 +1,85 @@
+#pragma once
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Variable.hpp"
+
+namespace sharpsenLang
+{
+	// Maps the case labels of a switch to their targets. Labels that are mostly
+	// consecutive integers are looked up by index after a bounds check, other
+	// small sets by binary search, and only large sparse sets by hashing.
+	class CaseTable
+	{
+	private:
+		enum struct Kind
+		{
+			Dense,
+			Sorted,
+			Hashed,
+		};
+
+		Kind _kind;
+		size_t _dflt;
+		Number _min;
+		std::vector<size_t> _dense;
+		std::vector<std::pair<Number, size_t>> _sorted;
+		std::unordered_map<Number, size_t> _hashed;
+
+	public:
+		CaseTable(const std::unordered_map<Number, size_t> &cases, size_t dflt);
+
+		size_t find(Number value) const
+		{
+			switch (_kind)
+			{
+			case Kind::Dense:
+			{
+				// Fails for NaN and for values between or outside the labels.
+				Number offset = value - _min;
+				if (offset >= 0 && offset < Number(_dense.size()) && Number(size_t(offset)) == offset)
+				{
+					return _dense[size_t(offset)];
+				}
+				return _dflt;
+			}
+			case Kind::Sorted:
+			{
+				auto it = std::lower_bound(
+					_sorted.begin(), _sorted.end(), value,
+					[](const std::pair<Number, size_t> &p, Number v)
+					{
+						return p.first < v;
+					});
+				return it != _sorted.end() && it->first == value ? it->second : _dflt;
+			}
+			default:
+			{
+				auto it = _hashed.find(value);
+				return it == _hashed.end() ? _dflt : it->second;
+			}
+			}
+		}
+
+		// Replaces every target, including the default one, with f(target).
+		template <typename F>
+		void retarget(F f)
+		{
+			_dflt = f(_dflt);
+			for (size_t &target : _dense)
+			{
+				target = f(target);
+			}
+			for (auto &p : _sorted)
+			{
+				p.second = f(p.second);
+			}
+			for (auto &p : _hashed)
+			{
+				p.second = f(p.second);
+			}
+		}
+	};
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+namespace sharpsenLang
+{
+	struct CompileStats
+	{
+		// Expression tree nodes removed by constant folding and algebraic simplification.
+		size_t removedNodes = 0;
+
+		// Call sites compiled as a copy of the called function's body.
+		size_t inlinedCalls = 0;
+
+		// Copies of functions compiled for the functions passed to them.
+		size_t specializations = 0;
+
+		// Return statements compiled as a call in place of the returning function.
+		size_t tailCalls = 0;
+
+		// Loop subexpressions evaluated once before the loop instead of on every iteration.
+		size_t hoistedExpressions = 0;
+
+		// Array indexes compiled without the bounds check and growth path, as a
+		// loop counter keeps them within the array.
+		size_t removedBoundsChecks = 0;
+
+		// Operations on number locals and constants built as a single node.
+		size_t fusedExpressions = 0;
+	};
+
+	// Live counters behind CompileStats. They are shared between the compiler
+	// and the program, so bodies compiled lazily or on other threads are counted.
+	class CompileCounters
+	{
+	private:
+		std::atomic<size_t> _removedNodes{0};
+		std::atomic<size_t> _inlinedCalls{0};
+		std::atomic<size_t> _specializations{0};
+		std::atomic<size_t> _tailCalls{0};
+		std::atomic<size_t> _hoistedExpressions{0};
+		std::atomic<size_t> _removedBoundsChecks{0};
+		std::atomic<size_t> _fusedExpressions{0};
+
+	public:
+		void addRemovedNodes(size_t count)
+		{
+			_removedNodes.fetch_add(count, std::memory_order_relaxed);
+		}
+
+		void addInlinedCall()
+		{
+			_inlinedCalls.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void addSpecialization()
+		{
+			_specializations.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void addTailCall()
+		{
+			_tailCalls.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void addHoistedExpression()
+		{
+			_hoistedExpressions.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void addRemovedBoundsCheck()
+		{
+			_removedBoundsChecks.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void addFusedExpression()
+		{
+			_fusedExpressions.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		CompileStats stats() const
+		{
+			CompileStats ret;
+			ret.removedNodes = _removedNodes.load(std::memory_order_relaxed);
+			ret.inlinedCalls = _inlinedCalls.load(std::memory_order_relaxed);
+			ret.specializations = _specializations.load(std::memory_order_relaxed);
+			ret.tailCalls = _tailCalls.load(std::memory_order_relaxed);
+			ret.hoistedExpressions = _hoistedExpressions.load(std::memory_order_relaxed);
+			ret.removedBoundsChecks = _removedBoundsChecks.load(std::memory_order_relaxed);
+			ret.fusedExpressions = _fusedExpressions.load(std::memory_order_relaxed);
+			return ret;
+		}
+	};
+}
@@ -5,6 +5,8 @@
 #include "Types.hpp"
 #include "Tokens.hpp"
 #include "Statement.hpp"
+#include "ModuleSettings.hpp"
+#include "Program.hpp"
 
 namespace sharpsenLang
 {
@@ -14,10 +16,11 @@ namespace sharpsenLang
 
 	using Function = std::function<void(RuntimeContext &)>;
 
-	RuntimeContext compile(
+	ProgramPtr compile(
 		TokensIterator &it,
 		const std::vector<std::pair<std::string, Function>> &externalFunctions,
-		std::vector<std::string> publicDeclarations);
+		std::vector<std::string> publicDeclarations,
+		const ModuleSettings &settings = ModuleSettings());
 
 	TypeHandle parseType(CompilerContext &ctx, TokensIterator &it);
 
@@ -2,11 +2,18 @@
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "Types.hpp"
+#include "ModuleSettings.hpp"
+#include "Arena.hpp"
+#include "CompileStats.hpp"
+#include "Specializations.hpp"
 
 namespace sharpsenLang
 {
+	struct FunctionBody;
 
 	enum struct IdentifierScope
 	{
@@ -22,15 +29,19 @@ namespace sharpsenLang
 		TypeHandle _typeId;
 		size_t _index;
 		IdentifierScope _scope;
+		bool _reference;
 
 	public:
-		IdentifierInfo(TypeHandle typeId, size_t index, IdentifierScope scope);
+		IdentifierInfo(TypeHandle typeId, size_t index, IdentifierScope scope, bool reference = false);
 
 		TypeHandle typeId() const;
 
 		size_t index() const;
 
 		IdentifierScope getScope() const;
+
+		// True for parameters taken by reference, which may name another variable.
+		bool isReference() const;
 	};
 
 	class ClassInfo : public IdentifierInfo
@@ -51,7 +62,7 @@ namespace sharpsenLang
 
 	protected:
 		const IdentifierInfo *insertIdentifier(std::string name, TypeHandle typeId,
-											   size_t index, IdentifierScope scope);
+											   size_t index, IdentifierScope scope, bool reference = false);
 		size_t identifiersSize() const;
 
 	public:
@@ -87,6 +98,8 @@ namespace sharpsenLang
 											   TypeHandle typeId) override;
 
 		std::unique_ptr<LocalVariableLookup> detachParent();
+
+		int nextIdentifierIndex() const;
 	};
 
 	class ParamLookup : public LocalVariableLookup
@@ -97,7 +110,10 @@ namespace sharpsenLang
 	public:
 		ParamLookup();
 
-		const IdentifierInfo *createParam(std::string name, TypeHandle typeId);
+		const IdentifierInfo *createParam(std::string name, TypeHandle typeId, bool byRef = false);
+
+		// Declares a parameter that names a known function and takes no argument.
+		const IdentifierInfo *bindParam(std::string name, TypeHandle typeId, size_t functionIndex);
 	};
 
 	class FunctionLookup : public IdentifierLookup
@@ -123,15 +139,59 @@ namespace sharpsenLang
 		bool canDeclare(const std::string &name) const;
 	};
 
+	// The variables a loop being compiled assigns, directly or by growing an array.
+	struct LoopWrites
+	{
+		std::unordered_set<const IdentifierInfo *> identifiers;
+
+		// The ones assigned as a whole or passed by reference, rather than only
+		// through their elements or members.
+		std::unordered_set<const IdentifierInfo *> replaced;
+
+		// Set once the loop calls a function or writes a variable that may be
+		// referenced elsewhere, after which globals and reference parameters may
+		// change without being named.
+		bool aliased = false;
+
+		// Like aliased, but only set by calls and by variables replaced as a whole.
+		bool aliasedReplaced = false;
+	};
+
+	// An array indexed by the counter of a loop such as
+	// `for (number i = 0; i < sizeof(a); ++i)` while its body compiles. The
+	// indexes are built before the body is known, against a flag the loop sets
+	// once the body is built if it may change the counter or the array.
+	struct IndexRange
+	{
+		const IdentifierInfo *counter;
+		const IdentifierInfo *array;
+		std::shared_ptr<bool> checked = std::make_shared<bool>(false);
+		size_t indexes = 0;
+	};
+
 	class CompilerContext
 	{
 	private:
-		FunctionLookup _functions;
-		ClassLookup _classes;
-		GlobalVariableLookup _globals;
+		struct SharedState
+		{
+			FunctionLookup functions;
+			ClassLookup classes;
+			GlobalVariableLookup globals;
+			TypeRegistry types;
+			ModuleSettings settings;
+			std::shared_ptr<CompileCounters> counters = std::make_shared<CompileCounters>();
+			std::unordered_map<size_t, std::shared_ptr<const FunctionBody>> functionBodies;
+			std::weak_ptr<Specializations> specializations;
+		};
+
+		std::shared_ptr<SharedState> _shared;
 		ParamLookup *_params;
 		std::unique_ptr<LocalVariableLookup> _locals;
-		TypeRegistry _types;
+		size_t _frameSize;
+		std::vector<size_t> _inlining;
+		std::vector<LoopWrites *> _loops;
+		std::vector<IndexRange *> _indexRanges;
+		Arena _arena;
 		class ScopeRaii
 		{
 		private:
@@ -152,12 +212,41 @@ namespace sharpsenLang
 			~FunctionRaii();
 		};
 
+		// Compiles an inlined body with its own params and locals, hiding the
+		// locals of the function it is inlined into.
+		class InlineRaii
+		{
+		private:
+			CompilerContext &_context;
+			ParamLookup *_params;
+			std::unique_ptr<LocalVariableLookup> _locals;
+			size_t _frameSize;
+
+		public:
+			InlineRaii(CompilerContext &context, size_t functionIndex);
+			~InlineRaii();
+		};
+
+		CompilerContext(std::shared_ptr<SharedState> shared);
+
 		void enterFunction();
 		void enterScope();
 		void leaveScope();
 
 	public:
-		CompilerContext();
+		CompilerContext(ModuleSettings settings = ModuleSettings());
+
+		// Creates a context sharing the declarations and types of this one, with its
+		// own locals and arena. Forks may compile function bodies concurrently: the
+		// type registry is synchronized and the other lookups are only read.
+		std::unique_ptr<CompilerContext> fork() const;
+
+		const ModuleSettings &settings() const;
+
+		CompileCounters &counters();
+		std::shared_ptr<const CompileCounters> sharedCounters() const;
+
+		Arena &arena();
 
 		TypeHandle getHandle(const Type &t);
 
@@ -169,7 +258,15 @@ namespace sharpsenLang
 
 		const IdentifierInfo *createIdentifier(std::string name, TypeHandle typeId);
 
-		const IdentifierInfo *createParam(std::string name, TypeHandle typeId);
+		const IdentifierInfo *createParam(std::string name, TypeHandle typeId, bool byRef = false);
+
+		// Declares a parameter that names a known function and takes no argument.
+		const IdentifierInfo *bindParam(std::string name, TypeHandle typeId, size_t functionIndex);
+
+		size_t frameSize() const;
+
+		// The frame slot of the next local declared in the current scope.
+		size_t nextLocalSlot() const;
 
 		const IdentifierInfo *createFunction(std::string name, TypeHandle typeId);
 
@@ -177,7 +274,40 @@ namespace sharpsenLang
 
 		bool canDeclare(const std::string &name) const;
 
+		// Must be called before function bodies are compiled.
+		void addFunctionBody(size_t functionIndex, std::shared_ptr<const FunctionBody> body);
+
+		const FunctionBody *findFunctionBody(size_t functionIndex) const;
+
+		// The body to compile in place of a call to the function, or null if it
+		// isn't inlinable or is already being inlined at this point.
+		const FunctionBody *findInlineFunction(size_t functionIndex) const;
+
+		// True while compiling a body into the call site of its function.
+		bool isInlining() const;
+
+		// Specializations are owned by the program being compiled; without one
+		// functions are not specialized.
+		void setSpecializations(const std::shared_ptr<Specializations> &specializations);
+
+		// The function compiled with the bindings, or null if it can't be specialized.
+		const Function *specialize(size_t functionIndex, const Specializations::Bindings &bindings);
+
+		// The loops being compiled record what their expressions write until they are left.
+		void enterLoop(LoopWrites &writes);
+		void leaveLoop();
+		const std::vector<LoopWrites *> &loops() const;
+
+		// While a loop body compiles, its counter may index the array in range.
+		void enterIndexRange(IndexRange &range);
+		void leaveIndexRange();
+
+		// The check flag of the range the counter indexes the array in, or null.
+		// Each index built against it is counted.
+		std::shared_ptr<const bool> findIndexRange(const IdentifierInfo *counter, const IdentifierInfo *array);
+
 		ScopeRaii scope();
 		FunctionRaii function();
+		InlineRaii inlineFunction(size_t functionIndex);
 	};
 }
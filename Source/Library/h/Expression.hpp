@@ -3,13 +3,20 @@
 
 #include "Variable.hpp"
 #include "Types.hpp"
+#include "Arena.hpp"
 
 
 namespace sharpsenLang
 {
+	struct Node;
+	using NodePtr = std::unique_ptr<Node, ArenaDeleter<Node>>;
+
 	class RuntimeContext;
+	class Value;
 	class TokensIterator;
 	class CompilerContext;
+	class BytecodeBuilder;
+	struct Operand;
 
 	template <typename R>
 	class Expression
@@ -24,6 +31,14 @@ namespace sharpsenLang
 		using Ptr = std::unique_ptr<const Expression>;
 
 		virtual R evaluate(RuntimeContext &context) const = 0;
+
+		// Emits bytecode for the expression. Returns false when the expression has no
+		// bytecode form; the builder then discards the partial output and evaluates the tree.
+		virtual bool lower(BytecodeBuilder &, Operand &) const
+		{
+			return false;
+		}
+
 		virtual ~Expression() = default;
 	};
 
@@ -35,4 +50,34 @@ namespace sharpsenLang
 		TypeHandle typeId,
 		bool allow_comma);
 	Expression<Lvalue>::Ptr buildDefaultInitialization(TypeHandle typeId);
+
+	// The number or int a by-value initializer or argument evaluates. Both are
+	// null if it isn't one. Stack slots store such values unboxed, without a
+	// variable.
+	struct UnboxedValue
+	{
+		const Expression<Number> *number = nullptr;
+		const Expression<Integer> *integer = nullptr;
+
+		explicit operator bool() const;
+		Value evaluate(RuntimeContext &context) const;
+	};
+
+	UnboxedValue findUnboxedValue(const Expression<Lvalue> &expr);
+
+	// Parses and optimizes an expression without building it, so the tree can be
+	// inspected or rewritten first. The builders below take such trees.
+	NodePtr parseExpression(CompilerContext &context, TokensIterator &it, TypeHandle typeId, bool allow_comma);
+	Expression<void>::Ptr buildVoidExpression(CompilerContext &context, const NodePtr &np);
+	Expression<Number>::Ptr buildNumberExpression(CompilerContext &context, const NodePtr &np);
+	Expression<Lvalue>::Ptr buildInitializationExpression(CompilerContext &context, const NodePtr &np, TypeHandle typeId);
+
+	// Builds the value of a return statement. A call of a named function returning
+	// returnTypeId is instead built into tailCall, as an expression that schedules
+	// the call with RuntimeContext::tailCall, and null is returned.
+	Expression<Lvalue>::Ptr buildReturnExpression(
+		CompilerContext &context,
+		TokensIterator &it,
+		TypeHandle returnTypeId,
+		Expression<void>::Ptr &tailCall);
 }
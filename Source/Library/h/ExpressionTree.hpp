@@ -5,6 +5,7 @@
 
 #include "Tokens.hpp"
 #include "Types.hpp"
+#include "Arena.hpp"
 
 namespace sharpsenLang
 {
@@ -23,6 +24,7 @@ namespace sharpsenLang
 		Lnot,
 		Size,
 		ToString,
+		ToInt,
 
 		Add,
 		Sub,
@@ -70,9 +72,10 @@ namespace sharpsenLang
 	};
 
 	struct Node;
-	using NodePtr = std::unique_ptr<Node>;
+	using NodePtr = std::unique_ptr<Node, ArenaDeleter<Node>>;
+	using NodeList = std::vector<NodePtr, ArenaAllocator<NodePtr>>;
 
-	using NodeValue = std::variant<NodeOperation, std::string, double, Identifier>;
+	using NodeValue = std::variant<NodeOperation, std::string_view, double, Identifier>;
 
 	class CompilerContext;
 
@@ -80,14 +83,14 @@ namespace sharpsenLang
 	{
 	private:
 		NodeValue _value;
-		std::vector<NodePtr> _children;
+		NodeList _children;
 		TypeHandle _typeId;
 		bool _lvalue;
 		size_t _lineNumber;
 		size_t _charIndex;
 
 	public:
-		Node(CompilerContext &context, NodeValue value, std::vector<NodePtr> children, size_t lineNumber, size_t charIndex, bool canBeUndefined = false);
+		Node(CompilerContext &context, NodeValue value, NodeList children, size_t lineNumber, size_t charIndex, bool canBeUndefined = false);
 
 		const NodeValue &getValue() const;
 
@@ -97,11 +100,13 @@ namespace sharpsenLang
 		bool isString() const;
 
 		NodeOperation getNodeOperation() const;
-		const std::string& getIdentifier() const;
+		std::string_view getIdentifier() const;
 		double getNumber() const;
 		std::string_view getString() const;
 
-		const std::vector<NodePtr> &getChildren() const;
+		const NodeList &getChildren() const;
+		// For tree rewrites. A replacement child has to keep the child's type.
+		NodePtr &getChild(size_t idx);
 
 		TypeHandle getTypeId() const;
 		bool isLvalue() const;
@@ -109,7 +114,18 @@ namespace sharpsenLang
 		size_t getLineNumber() const;
 		size_t getCharIndex() const;
 
-		void checkConversion(TypeHandle typeId, bool lvalue) const;
+		// Throws if the node can't be converted. Integral literals in an
+		// initializer list converted to ints are retyped.
+		void checkConversion(TypeHandle typeId, bool lvalue);
+
+		// Names and strings are kept as views, so their text has to outlive the node.
+		static NodePtr create(CompilerContext &context, NodeValue value, NodeList children, size_t lineNumber, size_t charIndex, bool canBeUndefined = false);
+		static NodeList createList(CompilerContext &context);
 	};
 
+	// True if an arithmetic, bitwise or comparison operation on the nodes is
+	// computed on ints: one of them is an int and the other one is an int or an
+	// integral number literal.
+	bool isIntegerOperation(const Node &node1, const Node &node2);
+
 }
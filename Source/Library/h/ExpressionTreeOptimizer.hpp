@@ -0,0 +1,19 @@
+#pragma once
+#include <memory>
+
+#include "Arena.hpp"
+
+namespace sharpsenLang
+{
+	struct Node;
+	using NodePtr = std::unique_ptr<Node, ArenaDeleter<Node>>;
+
+	class CompilerContext;
+
+	// True if evaluating the node has no side effects, so dropping it is unobservable.
+	bool isPure(const Node &node);
+
+	// Folds constant subexpressions, drops identity operations and collapses
+	// constant ternaries and logical operators. Every rewritten subtree keeps its type.
+	NodePtr optimizeExpressionTree(CompilerContext &context, NodePtr np);
+}
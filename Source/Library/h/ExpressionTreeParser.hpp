@@ -2,11 +2,12 @@
 #include <memory>
 
 #include "Types.hpp"
+#include "Arena.hpp"
 
 namespace sharpsenLang
 {
 	struct Node;
-	using NodePtr = std::unique_ptr<Node>;
+	using NodePtr = std::unique_ptr<Node, ArenaDeleter<Node>>;
 
 	class TokensIterator;
 
@@ -1,15 +1,18 @@
 #pragma once
 #include <deque>
 #include <functional>
+#include <memory>
 
 #include "Tokens.hpp"
 #include "Types.hpp"
+#include "Specializations.hpp"
 
 namespace sharpsenLang
 {
 	class CompilerContext;
 	class RuntimeContext;
 	class TokensIterator;
+	struct ModuleSettings;
 	using Function = std::function<void(RuntimeContext &)>;
 
 	struct FunctionDeclaration
@@ -18,23 +21,47 @@ namespace sharpsenLang
 		TypeHandle typeId;
 		std::vector<std::string> params;
 		TypeHandle parentTypeId = nullptr;
-		bool isMethod() {
+		bool isMethod() const {
 			return parentTypeId;
 		}
 	};
 
 	FunctionDeclaration parseFunctionDeclaration(CompilerContext &ctx, TokensIterator &it);
 
+	// Declaration and body of a script function, kept for compiling it again at
+	// call sites: inlined, or specialized for the functions passed to it.
+	struct FunctionBody
+	{
+		FunctionDeclaration decl;
+		std::deque<Token> tokens;
+
+		// Short enough to inline and never names the function itself.
+		bool inlinable;
+
+		// The body is a single `return` statement, so it can be built as an
+		// expression instead of running in a frame of its own.
+		bool expressionBody;
+
+		// By-value function parameters, so a known function can be bound to them.
+		// A copy whose body assigns a bound parameter or passes it by reference
+		// doesn't compile, as the parameter is no lvalue there.
+		std::vector<bool> bindableParams;
+	};
+
 	class IncompleteFunction
 	{
 	private:
 		FunctionDeclaration _decl;
 		size_t _index;
 		std::deque<Token> _tokens;
+		Specializations::Bindings _bindings;
 
 	public:
 		IncompleteFunction(CompilerContext &ctx, TokensIterator &it, std::string parentClass = "");
 
+		// A copy of the function with the bound parameters replaced by the functions.
+		IncompleteFunction(const FunctionBody &body, Specializations::Bindings bindings);
+
 		IncompleteFunction(IncompleteFunction &&orig) noexcept;
 
 		void updateParentClass(TypeHandle parentClass);
@@ -42,5 +69,16 @@ namespace sharpsenLang
 		const FunctionDeclaration &getDecl() const;
 
 		Function compile(CompilerContext &ctx);
+
+		// The body, if call sites may inline or specialize the function.
+		std::shared_ptr<const FunctionBody> body(const ModuleSettings &settings) const;
 	};
+
+	// Compiles the function on its first call. If it doesn't compile, calls go to
+	// the fallback instead when there is one; otherwise they raise the error.
+	Function createLazyFunction(std::shared_ptr<CompilerContext> ctx, IncompleteFunction function, Function fallback = nullptr);
+
+	// Calls the function from a specialization of it for the bindings, passing
+	// the bound functions back in with the specialization's own arguments.
+	Function createUnspecializedCall(size_t functionIndex, Specializations::Bindings bindings);
 }
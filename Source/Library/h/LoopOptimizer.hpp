@@ -0,0 +1,111 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Arena.hpp"
+#include "Expression.hpp"
+#include "CompilerContext.hpp"
+
+namespace sharpsenLang
+{
+	struct Node;
+	using NodePtr = std::unique_ptr<Node, ArenaDeleter<Node>>;
+
+	class TokensIterator;
+
+	// Records the variables the expression writes in every loop being compiled.
+	void recordLoopWrites(CompilerContext &context, const Node &node);
+
+	// Moves the pure subexpressions of a while or for loop's condition and step
+	// that the loop can't change into hidden locals initialized before the loop.
+	// The condition and step are parsed before the body but built after it, once
+	// everything the loop writes is known. Writes are recorded from construction,
+	// so a for loop's initialization counts as part of the loop.
+	class LoopInvariants
+	{
+		LoopInvariants(const LoopInvariants &) = delete;
+		void operator=(const LoopInvariants &) = delete;
+
+	private:
+		static constexpr size_t noCandidate = size_t(-1);
+
+		struct Candidate
+		{
+			NodePtr *node;
+			// The closest candidate containing this one, or noCandidate.
+			size_t enclosing;
+		};
+
+		CompilerContext &_context;
+		LoopWrites _writes;
+		NodePtr _condition;
+		NodePtr _step;
+		std::vector<Candidate> _candidates;
+		std::vector<std::string> _slots;
+		size_t _slot;
+		std::vector<NodePtr> _hoisted;
+
+		bool isInvariant(const Node &node) const;
+		void collectCandidates(NodePtr &np, size_t enclosing);
+		void hoist();
+
+	public:
+		LoopInvariants(CompilerContext &context);
+		~LoopInvariants();
+
+		void parseCondition(TokensIterator &it);
+		void parseStep(TokensIterator &it);
+
+		// Declares a local for each subexpression that may be hoisted. Called
+		// after the condition and step are parsed and before the body is compiled,
+		// so the body's locals come after them.
+		void reserve();
+
+		// The frame slot of the first reserved local.
+		size_t slot() const;
+
+		// The condition is built first, hoisting the subexpressions that are still
+		// invariant from both the condition and the step.
+		Expression<Number>::Ptr buildCondition();
+		Expression<void>::Ptr buildStep();
+
+		// Initializers of the reserved locals, in declaration order. Locals whose
+		// subexpression turned out to be written by the body are set to zero.
+		std::vector<Expression<Lvalue>::Ptr> initializers();
+	};
+
+	// Recognizes `for (number i = c; i < sizeof(a) - d; ++i)` loops, where c and d
+	// are non-negative literals, d may be left out, `<=` needs d of at least one
+	// and the step may also be `i++` or `i += e`. Unless the body may assign i or
+	// replace a, a[i] stays in range while the body runs. Index expressions are
+	// built as the body is parsed, so the header is matched from the tokens ahead
+	// and the indexes share a flag set once the body's writes are recorded. They
+	// stay checked if the body may write i or replace a.
+	class CountedLoop
+	{
+		CountedLoop(const CountedLoop &) = delete;
+		void operator=(const CountedLoop &) = delete;
+
+	private:
+		CompilerContext &_context;
+		std::string _counter;
+		std::string _array;
+		bool _matched;
+		bool _entered;
+		IndexRange _range;
+		LoopWrites _writes;
+
+		bool match(const TokensIterator &it);
+
+	public:
+		// Called with the iterator just past the opening parenthesis.
+		CountedLoop(CompilerContext &context, const TokensIterator &it);
+		~CountedLoop();
+
+		// Called around the body, after the loop's declarations are compiled and
+		// before its condition and step are built.
+		void enterBody();
+		void leaveBody();
+	};
+}
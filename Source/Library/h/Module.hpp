@@ -3,10 +3,14 @@
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <string_view>
 #include <iostream>
 
 #include "Variable.hpp"
 #include "RuntimeContext.hpp"
+#include "Program.hpp"
+#include "Helpers.hpp"
+#include "ModuleSettings.hpp"
 
 namespace sharpsenLang
 {
@@ -24,7 +28,19 @@ namespace sharpsenLang
 				std::tuple<Unpacked...> t) const
 			{
 				using NextUnpacker = Unpacker<R, std::tuple<Unpacked..., Left0>, std::tuple<Left...>>;
-				if constexpr (std::is_convertible<const std::string &, Left0>::value)
+				if constexpr (std::is_same<Integer, Left0>::value)
+				{
+					return NextUnpacker()(
+						ctx,
+						f,
+						std::tuple_cat(
+							std::move(t),
+							std::tuple<Left0>(
+								ctx.localValue(
+									   -1 - int(sizeof...(Unpacked)))
+									.toInteger())));
+				}
+				else if constexpr (std::is_convertible<const std::string &, Left0>::value)
 				{
 					return NextUnpacker()(
 						ctx,
@@ -46,10 +62,9 @@ namespace sharpsenLang
 						std::tuple_cat(
 							std::move(t),
 							std::tuple<Left0>(
-								ctx.local(
+								ctx.localValue(
 									   -1 - int(sizeof...(Unpacked)))
-									->staticPointerDowncast<Lnumber>()
-									->value)));
+									.toNumber())));
 				}
 			}
 		};
@@ -78,14 +93,18 @@ namespace sharpsenLang
 				else
 				{
 					R retval = Unpacker<R, std::tuple<>, std::tuple<Args...>>()(ctx, f, std::tuple<>());
-					if constexpr (std::is_convertible<R, std::string>::value)
+					if constexpr (std::is_same<R, Integer>::value)
 					{
-						ctx.retval() = std::make_shared<VariableImpl<String>>(std::make_shared<std::string>(std::move(retval)));
+						ctx.retvalValue() = Value(retval);
+					}
+					else if constexpr (std::is_convertible<R, std::string>::value)
+					{
+						ctx.retvalValue() = Value(createVariable<String>(std::make_shared<std::string>(std::move(retval))));
 					}
 					else
 					{
 						static_assert(std::is_convertible<R, Number>::value);
-						ctx.retval() = std::make_shared<VariableImpl<Number>>(retval);
+						ctx.retvalValue() = Value(Number(retval));
 					}
 				}
 			};
@@ -100,6 +119,10 @@ namespace sharpsenLang
 				{
 					return "void";
 				}
+				else if constexpr (std::is_same<T, Integer>::value)
+				{
+					return "int";
+				}
 				else if constexpr (std::is_convertible<T, std::string>::value)
 				{
 					return "string";
@@ -117,7 +140,11 @@ namespace sharpsenLang
 		{
 			static constexpr const char *result()
 			{
-				if constexpr (std::is_convertible<const std::string &, T>::value)
+				if constexpr (std::is_same<T, Integer>::value)
+				{
+					return "int";
+				}
+				else if constexpr (std::is_convertible<const std::string &, T>::value)
 				{
 					return "string";
 				}
@@ -161,14 +188,21 @@ namespace sharpsenLang
 			}
 		}
 
-		inline VariablePtr toVariable(Number n)
-		{
-			return std::make_shared<VariableImpl<Number>>(n);
-		}
-
-		inline VariablePtr toVariable(std::string str)
+		template <typename T>
+		VariablePtr toVariable(T t)
 		{
-			return std::make_shared<VariableImpl<String>>(std::make_shared<std::string>(std::move(str)));
+			if constexpr (std::is_same<T, Integer>::value)
+			{
+				return createVariable<Integer>(t);
+			}
+			else if constexpr (std::is_convertible<T, std::string>::value)
+			{
+				return createVariable<String>(std::make_shared<std::string>(std::move(t)));
+			}
+			else
+			{
+				return createVariable<Number>(Number(t));
+			}
 		}
 
 		template <typename T>
@@ -178,12 +212,29 @@ namespace sharpsenLang
 			{
 				return std::move(*v->staticPointerDowncast<Lstring>()->value);
 			}
+			else if constexpr (std::is_same<T, Integer>::value)
+			{
+				return v->staticPointerDowncast<Linteger>()->value;
+			}
 			else
 			{
 				static_assert(std::is_same<Number, T>::value);
 				return v->staticPointerDowncast<Lnumber>()->value;
 			}
 		}
+
+		template <typename R, typename... Args>
+		R callFunction(RuntimeContext &ctx, const Function &f, Args... args)
+		{
+			if constexpr (std::is_same<R, void>::value)
+			{
+				ctx.call(f, {toVariable(std::move(args))...});
+			}
+			else
+			{
+				return moveFromVariable<R>(ctx.call(f, {toVariable(std::move(args))...}));
+			}
+		}
 	}
 
 	class ModuleImpl;
@@ -198,6 +249,7 @@ namespace sharpsenLang
 
 	public:
 		Module();
+		explicit Module(ModuleSettings settings);
 
 		template <typename R, typename... Args>
 		void addExternalFunction(const char *name, std::function<R(Args...)> f)
@@ -212,30 +264,34 @@ namespace sharpsenLang
 		{
 			std::shared_ptr<Function> fptr = std::make_shared<Function>();
 			std::string decl = details::createFunctionDeclaration<R, Args...>(name.c_str());
-			addPublicFunctionDeclaration(std::move(decl), std::move(name), fptr);
+			addPublicFunctionDeclaration(std::move(decl), name, fptr);
 
-			return [this, fptr](Args... args)
-			{
-				if constexpr (std::is_same<R, void>::value)
+			// The returned caller runs on the module's own instance, or on an
+			// instance created from program() when passed one as first argument.
+			return overloaded{
+				[this, fptr](Args... args)
 				{
-					getRuntimeContext()->call(
-						*fptr,
-						{details::toVariable(std::move(args))...});
-				}
-				else
+					return details::callFunction<R>(*getRuntimeContext(), *fptr, std::move(args)...);
+				},
+				[name](RuntimeContext &instance, Args... args)
 				{
-					return details::moveFromVariable<R>(getRuntimeContext()->call(
-						*fptr,
-						{details::toVariable(args)...}));
-				}
-			};
+					return details::callFunction<R>(instance, instance.getPublicFunction(name.c_str()), std::move(args)...);
+				}};
 		}
 
 		void load(const char *path);
 		bool tryLoad(const char *path, std::ostream *err = nullptr) noexcept;
 
+		// The source buffer only has to stay alive for the duration of the call.
+		void loadSource(std::string_view source);
+		bool tryLoadSource(std::string_view source, std::ostream *err = nullptr) noexcept;
+
 		void resetGlobals();
 
+		// The compiled program of the last successful load. Each thread can run it
+		// through its own RuntimeContext without compiling the source again.
+		const ProgramPtr &program() const;
+
 		~Module();
 	};
 }
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+
+namespace sharpsenLang
+{
+	enum struct ExecutionEngine
+	{
+		Tree,
+		Vm,
+	};
+
+	struct ModuleSettings
+	{
+		ExecutionEngine engine = ExecutionEngine::Tree;
+
+		// Number of value slots reserved for the call stack. Running out of them
+		// raises a RuntimeError instead of growing the stack.
+		size_t stackCapacity = 1 << 14;
+
+		// Defer compiling function bodies until their first call. Errors in a body
+		// are then reported as a RuntimeError when the function is first invoked.
+		bool lazyCompile = false;
+
+		// Number of threads compiling function bodies once all declarations are
+		// known. Zero uses one thread per hardware core.
+		size_t compileThreads = 1;
+
+		// Fold constant subexpressions and drop identity operations such as `x * 1`
+		// before building expressions. Removed nodes are counted in CompileStats.
+		bool optimizeExpressions = true;
+
+		// Calls to functions whose body is at most this many tokens long and never
+		// names the function itself are compiled as a copy of the body, saving the
+		// call. By-ref parameters still alias the caller's variables. Zero disables
+		// inlining; the bytecode engine never inlines.
+		size_t inlineThreshold = 32;
+
+		// Compile a copy of a function for each set of named functions passed to its
+		// function parameters, calling them directly so they can be inlined. Only
+		// parameters the function never assigns are specialized, and only by the
+		// tree engine.
+		bool specializeFunctionArguments = true;
+
+		// Compile `return f(...)` of a named function returning the same type as a
+		// call made in place of the returning function's frame, so self and mutual
+		// recursion through such calls runs in constant stack space.
+		bool eliminateTailCalls = true;
+
+		// Evaluate the parts of a while or for loop's condition and step that the
+		// loop can't change once before the loop, instead of on every iteration.
+		// Hoisted subexpressions are counted in CompileStats.
+		bool hoistLoopInvariants = true;
+
+		// Index arrays without a bounds check in the body of a loop such as
+		// `for (number i = 0; i < sizeof(a); ++i)` that never assigns i or a, nor
+		// passes them by reference. Removed checks are counted in CompileStats.
+		bool eliminateBoundsChecks = true;
+
+		// Build the most common shapes on number locals, such as `i < n`,
+		// `x = y + z` and `a[i]`, as single nodes reading and writing the frame
+		// directly. Fused nodes are counted in CompileStats.
+		bool fuseExpressions = true;
+	};
+}
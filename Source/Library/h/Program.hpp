@@ -0,0 +1,46 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Variable.hpp"
+#include "Expression.hpp"
+#include "CompileStats.hpp"
+#include "Specializations.hpp"
+
+namespace sharpsenLang
+{
+	// The compiled, immutable part of a module. A single program may back any
+	// number of RuntimeContext instances, including instances on different threads.
+	class Program
+	{
+	private:
+		std::vector<Function> _functions;
+		std::vector<Class> _classes;
+		std::unordered_map<std::string, size_t> _publicFunctions;
+		std::vector<Expression<Lvalue>::Ptr> _initializers;
+		size_t _stackCapacity;
+		std::shared_ptr<const CompileCounters> _counters;
+		std::shared_ptr<Specializations> _specializations;
+
+	public:
+		Program(
+			std::vector<Expression<Lvalue>::Ptr> initializers,
+			std::vector<Function> functions,
+			std::vector<Class> classes,
+			std::unordered_map<std::string, size_t> publicFunctions,
+			size_t stackCapacity,
+			std::shared_ptr<const CompileCounters> counters,
+			std::shared_ptr<Specializations> specializations);
+
+		const std::vector<Function> &functions() const;
+		const Function &getFunction(int idx) const;
+		const Function *findPublicFunction(const std::string &name) const;
+		const std::vector<Expression<Lvalue>::Ptr> &initializers() const;
+		size_t stackCapacity() const;
+		CompileStats compileStats() const;
+	};
+
+	using ProgramPtr = std::shared_ptr<const Program>;
+}
@@ -7,52 +7,118 @@
 #include <unordered_map>
 
 #include "Variable.hpp"
+#include "Value.hpp"
 #include "Lookup.hpp"
 #include "Expression.hpp"
+#include "Program.hpp"
+#include "VariablePool.hpp"
 
 namespace sharpsenLang
 {
+	// A running instance of a Program, owning the globals and the call stack.
+	// Instances are cheap to create and must not be shared between threads.
 	class RuntimeContext
 	{
 	private:
-		std::vector<Function> _functions;
-		std::vector<Class> _classes;
-		std::unordered_map<std::string, size_t> _publicFunctions;
-		std::vector<Expression<Lvalue>::Ptr> _initializers;
-		std::vector<VariablePtr> _globals;
-		std::deque<VariablePtr> _stack;
+		ProgramPtr _program;
+		const Function *_functions;
+		std::unique_ptr<VariablePool, VariablePool::Detach> _pool;
+		std::vector<Value> _globals;
+		std::unique_ptr<Value[]> _stack;
+		size_t _stackCapacity;
+		size_t _stackTop;
 		size_t _retvalIdx;
+		std::vector<Register> _registers;
+		const Function *_tailCall;
+		std::vector<Value> _tailArguments;
 
-		class scope
+		void popTo(size_t top);
+		void runTailCalls(size_t base);
+
+		template <typename T>
+		Value callImpl(const Function &f, std::vector<T> &params);
+
+		class frame
 		{
 		private:
 			RuntimeContext &_context;
-			size_t _stackSize;
+			size_t _stackTop;
+			size_t _retvalIdx;
 
 		public:
-			scope(RuntimeContext &context);
-			~scope();
+			frame(RuntimeContext &context, size_t argc, size_t frameSize);
+			~frame();
 		};
 
 	public:
-		RuntimeContext(
-			std::vector<Expression<Lvalue>::Ptr> initializers,
-			std::vector<Function> functions,
-			std::vector<Class> classes,
-			std::unordered_map<std::string, size_t> publicFunctions);
+		explicit RuntimeContext(ProgramPtr program);
+
+		const ProgramPtr &program() const;
+		const VariablePool &variablePool() const;
 
 		void initialize();
 
-		VariablePtr &global(int idx);
-		VariablePtr &retval();
-		VariablePtr &local(int idx);
+		VariablePtr global(int idx);
+		VariablePtr local(int idx);
+
+		Value &globalValue(int idx);
+		Value &retvalValue();
+		Value &localValue(int idx);
+
+		// The running function's frame, indexed like localValue. The stack never
+		// moves, so the pointer stays valid until the frame is left.
+		Value *locals();
 
 		const Function &getFunction(int idx) const;
 		const Function &getPublicFunction(const char *name) const;
 
-		scope enterScope();
-		void push(VariablePtr v);
+		// Reserves the slots of the running function's locals. Declarations store
+		// into them, and they are only cleared when the frame is left.
+		void enterFrame(size_t frameSize);
+
+		size_t allocateRegisters(size_t count);
+		void releaseRegisters(size_t base);
+		Register *registers(size_t base);
+
+		void reserveArguments(size_t count);
+		Value &argument(size_t idx);
+		Value callFrame(const Function &f, size_t argc);
+
+		// Frame for a function body compiled into its call site, over the argc
+		// arguments reserved like for callFrame. Leaving it pops the arguments.
+		frame enterInlineFrame(size_t argc, size_t frameSize);
+
+		// Calls f with the argc arguments reserved like for callFrame once the
+		// running function has returned, in place of its frame. f must outlive
+		// the frame, so it can't be a function value held by a local.
+		void tailCall(const Function &f, size_t argc);
 
 		VariablePtr call(const Function &f, std::vector<VariablePtr> params);
+		Value callValue(const Function &f, std::vector<Value> params);
 	};
+
+	inline Value &RuntimeContext::retvalValue()
+	{
+		return _stack[_retvalIdx];
+	}
+
+	inline Value &RuntimeContext::localValue(int idx)
+	{
+		return _stack[_retvalIdx + idx];
+	}
+
+	inline Value *RuntimeContext::locals()
+	{
+		return &_stack[_retvalIdx];
+	}
+
+	inline Register *RuntimeContext::registers(size_t base)
+	{
+		return _registers.data() + base;
+	}
+
+	inline Value &RuntimeContext::argument(size_t idx)
+	{
+		return _stack[_stackTop - 1 - idx];
+	}
 }
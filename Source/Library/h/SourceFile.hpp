@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace sharpsenLang
+{
+	// Read-only view of a whole source file. The file is memory-mapped where
+	// the platform allows it and read into memory otherwise.
+	class SourceFile
+	{
+		SourceFile(const SourceFile &) = delete;
+		void operator=(const SourceFile &) = delete;
+
+	private:
+		const char *_data;
+		size_t _size;
+		std::string _contents;
+
+	public:
+		SourceFile(const char *path);
+		~SourceFile();
+
+		std::string_view view() const;
+	};
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace sharpsenLang
+{
+	class RuntimeContext;
+	using Function = std::function<void(RuntimeContext &)>;
+
+	// Copies of script functions compiled with some of their function parameters
+	// bound to functions known at the call site. The program owns them and call
+	// sites point into them, so they are never removed.
+	class Specializations
+	{
+	public:
+		// The function index bound to each parameter, or NoBinding.
+		using Bindings = std::vector<size_t>;
+		static constexpr size_t NoBinding = size_t(-1);
+
+	private:
+		std::mutex _mutex;
+		std::map<std::pair<size_t, Bindings>, Function> _functions;
+
+	public:
+		// The specialization of the function for the bindings, made by create the
+		// first time it is asked for.
+		const Function &get(size_t functionIndex, const Bindings &bindings, const std::function<Function()> &create);
+	};
+}
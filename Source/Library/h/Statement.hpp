@@ -34,6 +34,7 @@ namespace sharpsenLang
 	};
 
 	class RuntimeContext;
+	class BytecodeBuilder;
 
 	class Statement
 	{
@@ -45,6 +46,7 @@ namespace sharpsenLang
 
 	public:
 		virtual Flow execute(RuntimeContext &context) = 0;
+		virtual void lower(BytecodeBuilder &builder) const = 0;
 		virtual ~Statement() = default;
 	};
 
@@ -53,7 +55,8 @@ namespace sharpsenLang
 
 	StatementPtr createSimpleStatement(Expression<void>::Ptr expr);
 
-	StatementPtr createLocalDeclarationStatement(std::vector<Expression<Lvalue>::Ptr> decls);
+	// The declared locals take consecutive frame slots from slot on.
+	StatementPtr createLocalDeclarationStatement(std::vector<Expression<Lvalue>::Ptr> decls, size_t slot);
 
 	StatementPtr createBlockStatement(std::vector<StatementPtr> statements);
 	SharedStatementPtr createSharedBlockStatement(std::vector<StatementPtr> statements);
@@ -66,13 +69,19 @@ namespace sharpsenLang
 
 	StatementPtr createReturnVoidStatement();
 
+	// Returns by making the call scheduled by evaluating the expression, see
+	// buildReturnExpression.
+	StatementPtr createTailCallStatement(Expression<void>::Ptr call);
+
 	StatementPtr createIfStatement(
 		std::vector<Expression<Lvalue>::Ptr> decls,
+		size_t slot,
 		std::vector<Expression<Number>::Ptr> exprs,
 		std::vector<StatementPtr> statements);
 
 	StatementPtr createSwitchStatement(
 		std::vector<Expression<Lvalue>::Ptr> decls,
+		size_t slot,
 		Expression<Number>::Ptr expr,
 		std::vector<StatementPtr> statements,
 		std::unordered_map<Number, size_t> cases,
@@ -90,6 +99,7 @@ namespace sharpsenLang
 
 	StatementPtr createForStatement(
 		std::vector<Expression<Lvalue>::Ptr> decls,
+		size_t slot,
 		Expression<Number>::Ptr expr2,
 		Expression<Void>::Ptr expr3,
 		StatementPtr statement);
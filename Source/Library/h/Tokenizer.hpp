@@ -11,6 +11,7 @@
 namespace sharpsenLang
 {
 	class PushBackStream;
+	class BufferStream;
 
 	class TokensIterator
 	{
@@ -20,9 +21,11 @@ namespace sharpsenLang
 	private:
 		std::function<Token()> _getNextToken;
 		Token _current;
+		const std::deque<Token> *_buffered;
 
 	public:
 		TokensIterator(PushBackStream &stream);
+		TokensIterator(BufferStream &stream);
 		TokensIterator(std::deque<Token> &tokens);
 
 		const Token &operator*() const;
@@ -30,6 +33,10 @@ namespace sharpsenLang
 
 		TokensIterator &operator++();
 
+		// The token n places after the current one, or null if it is past the end
+		// or the tokens are read from a stream as they are consumed.
+		const Token *lookAhead(size_t n) const;
+
 		explicit operator bool() const;
 	};
 }
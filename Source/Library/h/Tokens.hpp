@@ -1,5 +1,7 @@
 #pragma once
+#include <memory>
 #include <optional>
+#include <string>
 #include <string_view>
 #include <ostream>
 #include <variant>
@@ -75,6 +77,7 @@ namespace sharpsenLang
 
 		KwSizeof,
 		KwToString,
+		KwToInt,
 
 		KwIf,
 		KwElse,
@@ -97,19 +100,19 @@ namespace sharpsenLang
 		KwVoid,
 		KwNumber,
 		KwString,
+		KwInt,
 
 		KwPublic,
 	};
 
-	class PushBackStream;
-
 	std::optional<ReservedToken> getKeyword(std::string_view word);
 
-	std::optional<ReservedToken> getOperator(PushBackStream &stream);
+	template <typename Stream>
+	std::optional<ReservedToken> getOperator(Stream &stream);
 
 	struct Identifier
 	{
-		std::string name;
+		std::string_view name;
 	};
 
 	bool operator==(const Identifier &id1, const Identifier &id2);
@@ -122,17 +125,21 @@ namespace sharpsenLang
 	bool operator==(const Eof &, const Eof &);
 	bool operator!=(const Eof &, const Eof &);
 
-	using TokenValue = std::variant<ReservedToken, Identifier, double, std::string, Eof>;
+	using TokenValue = std::variant<ReservedToken, Identifier, double, std::string_view, Eof>;
 
+	// Identifiers and strings are views. They point either into the source
+	// buffer or, when the text had to be built up, into _storage.
 	class Token
 	{
 	private:
 		TokenValue _value;
+		std::shared_ptr<const std::string> _storage;
 		size_t _lineNumber;
 		size_t _charIndex;
 
 	public:
 		Token(TokenValue value, size_t lineNumber = 0, size_t charIndex = 0);
+		Token(TokenValue value, std::shared_ptr<const std::string> storage, size_t lineNumber, size_t charIndex);
 
 		bool isReservedToken() const;
 		bool isIdentifier() const;
@@ -143,13 +150,17 @@ namespace sharpsenLang
 		ReservedToken getReservedToken() const;
 		const Identifier &getIdentifier() const;
 		double getNumber() const;
-		const std::string &getString() const;
+		std::string_view getString() const;
 		const TokenValue &getValue() const;
 
 		size_t getLineNumber() const;
 		size_t getCharIndex() const;
 
 		bool hasValue(const TokenValue &value) const;
+
+		// True if the text is held in _storage, which goes away with the last
+		// copy of the token rather than with the source.
+		bool ownsText() const;
 	};
 }
 
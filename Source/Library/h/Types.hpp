@@ -3,6 +3,8 @@
 #include <variant>
 #include <unordered_map>
 #include <set>
+#include <mutex>
+#include <shared_mutex>
 #include <ostream>
 
 namespace sharpsenLang
@@ -12,6 +14,7 @@ namespace sharpsenLang
 		Void,
 		Number,
 		String,
+		Int,
 	};
 
 	struct ArrayType;
@@ -84,10 +87,12 @@ namespace sharpsenLang
 		};
 		std::set<Type, TypesLess> _types;
 		std::set<UndefinedInfo, UndefinedLess> _undefinedTypes;
+		mutable std::shared_mutex _mutex;
 
 		static Type voidType;
 		static Type numberType;
 		static Type stringType;
+		static Type intType;
 
 	public:
 		TypeRegistry();
@@ -114,6 +119,11 @@ namespace sharpsenLang
 		{
 			return &stringType;
 		}
+
+		static TypeHandle getIntHandle()
+		{
+			return &intType;
+		}
 	};
 }
 
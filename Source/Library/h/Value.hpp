@@ -0,0 +1,248 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+#include "Variable.hpp"
+#include "VariablePool.hpp"
+
+namespace sharpsenLang
+{
+	// 64-bit NaN-boxed slot. Numbers are stored inline, and so are ints that fit in the
+	// 48-bit payload; anything else (and values that are referenced from the tree engine
+	// or through `number&` and `int&` parameters) is a Variable pointer in the payload
+	// that holds one reference. Inline values are boxed on demand by boxed().
+	class Value
+	{
+	private:
+		static constexpr uint64_t TagMask = 0xFFFF000000000000ull;
+		static constexpr uint64_t PointerTag = 0xFFFC000000000000ull;
+		static constexpr uint64_t IntegerTag = 0xFFFD000000000000ull;
+		static constexpr uint64_t CanonicalNaN = 0x7FF8000000000000ull;
+
+		uint64_t _bits;
+
+		static uint64_t numberBits(Number n);
+		static bool isInline(Integer i);
+		bool isPointer() const;
+		Variable *pointer() const;
+		void setPointer(Variable *v);
+		void release();
+
+	public:
+		Value();
+		explicit Value(Number n);
+		explicit Value(Integer i);
+		explicit Value(VariablePtr v);
+
+		Value(const Value &other);
+		Value(Value &&other) noexcept;
+		Value &operator=(const Value &other);
+		Value &operator=(Value &&other) noexcept;
+		~Value();
+
+		bool isNumber() const;
+		Number number() const;
+
+		Number toNumber() const;
+		void setNumber(Number n);
+
+		bool isInteger() const;
+		Integer toInteger() const;
+		void setInteger(Integer i);
+
+		VariablePtr boxed();
+
+		// The boxed variable, or null for inline values and empty values.
+		Variable *variable() const;
+	};
+
+	// A bytecode register. The instruction writing it decides whether it holds a
+	// number or an int.
+	union Register
+	{
+		Number number;
+		Integer integer;
+	};
+
+	inline uint64_t Value::numberBits(Number n)
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &n, sizeof(bits));
+		return n == n ? bits : CanonicalNaN;
+	}
+
+	// Ints that survive the round trip through the sign-extended payload.
+	inline bool Value::isInline(Integer i)
+	{
+		return Integer(uint64_t(i) << 16) >> 16 == i;
+	}
+
+	inline bool Value::isPointer() const
+	{
+		return (_bits & TagMask) == PointerTag;
+	}
+
+	inline Variable *Value::pointer() const
+	{
+		return reinterpret_cast<Variable *>(_bits & ~TagMask);
+	}
+
+	inline void Value::setPointer(Variable *v)
+	{
+		_bits = PointerTag | reinterpret_cast<uint64_t>(v);
+	}
+
+	inline void Value::release()
+	{
+		if (Variable *v = variable())
+		{
+			v->release();
+		}
+	}
+
+	inline Value::Value()
+		: _bits(PointerTag)
+	{
+	}
+
+	inline Value::Value(Number n)
+		: _bits(numberBits(n))
+	{
+	}
+
+	inline Value::Value(Integer i)
+		: _bits(IntegerTag | (uint64_t(i) & ~TagMask))
+	{
+		if (!isInline(i))
+		{
+			setPointer(createVariable<Integer>(i).detach());
+		}
+	}
+
+	inline Value::Value(VariablePtr v)
+		: _bits(PointerTag | reinterpret_cast<uint64_t>(v.detach()))
+	{
+	}
+
+	inline Value::Value(const Value &other)
+		: _bits(other._bits)
+	{
+		if (Variable *v = variable())
+		{
+			v->addRef();
+		}
+	}
+
+	inline Value::Value(Value &&other) noexcept
+		: _bits(other._bits)
+	{
+		other._bits = PointerTag;
+	}
+
+	inline Value &Value::operator=(const Value &other)
+	{
+		if (this != &other)
+		{
+			*this = Value(other);
+		}
+		return *this;
+	}
+
+	inline Value &Value::operator=(Value &&other) noexcept
+	{
+		if (this != &other)
+		{
+			release();
+			_bits = other._bits;
+			other._bits = PointerTag;
+		}
+		return *this;
+	}
+
+	inline Value::~Value()
+	{
+		release();
+	}
+
+	// Canonicalized NaNs leave the tags above every number's bits.
+	inline bool Value::isNumber() const
+	{
+		return _bits < PointerTag;
+	}
+
+	inline Number Value::number() const
+	{
+		Number n;
+		std::memcpy(&n, &_bits, sizeof(n));
+		return n;
+	}
+
+	inline Number Value::toNumber() const
+	{
+		if (isNumber())
+		{
+			return number();
+		}
+		return static_cast<VariableImpl<Number> *>(pointer())->value;
+	}
+
+	// An empty slot takes the number inline.
+	inline void Value::setNumber(Number n)
+	{
+		if (_bits <= PointerTag)
+		{
+			_bits = numberBits(n);
+		}
+		else
+		{
+			static_cast<VariableImpl<Number> *>(pointer())->value = n;
+		}
+	}
+
+	inline bool Value::isInteger() const
+	{
+		return (_bits & TagMask) == IntegerTag;
+	}
+
+	inline Integer Value::toInteger() const
+	{
+		if (isInteger())
+		{
+			return Integer(_bits << 16) >> 16;
+		}
+		return static_cast<VariableImpl<Integer> *>(pointer())->value;
+	}
+
+	// Ints too wide for the payload box the slot, and later writes go to the box.
+	inline void Value::setInteger(Integer i)
+	{
+		if (isPointer())
+		{
+			static_cast<VariableImpl<Integer> *>(pointer())->value = i;
+		}
+		else
+		{
+			*this = Value(i);
+		}
+	}
+
+	inline VariablePtr Value::boxed()
+	{
+		if (isNumber())
+		{
+			setPointer(createVariable<Number>(number()).detach());
+		}
+		else if (isInteger())
+		{
+			setPointer(createVariable<Integer>(toInteger()).detach());
+		}
+		return VariablePtr(pointer());
+	}
+
+	inline Variable *Value::variable() const
+	{
+		return isPointer() ? pointer() : nullptr;
+	}
+}
+
+#include "Array.hpp"
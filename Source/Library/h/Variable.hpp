@@ -1,60 +1,236 @@
 #pragma once
+#include <cstdint>
 #include <memory>
-#include <deque>
 #include <vector>
 #include <functional>
 #include <string>
+#include <type_traits>
+#include <utility>
 
 namespace sharpsenLang
 {
 
 	class Variable;
 
-	using VariablePtr = std::shared_ptr<Variable>;
-
 	template <class T>
 	class VariableImpl;
 
 	class RuntimeContext;
+	class VariablePool;
+	class Value;
+	class Array;
+
+	// Intrusive, non-atomic reference to a script variable. Variables belong to a
+	// single RuntimeContext and are only ever touched by the thread running it.
+	template <typename T>
+	class VariableRef
+	{
+		template <typename U>
+		friend class VariableRef;
+
+	private:
+		T *_ptr;
+
+	public:
+		using element_type = T;
+
+		VariableRef() noexcept : _ptr(nullptr)
+		{
+		}
+
+		VariableRef(std::nullptr_t) noexcept : _ptr(nullptr)
+		{
+		}
+
+		explicit VariableRef(T *ptr) noexcept : _ptr(ptr)
+		{
+			if (_ptr)
+			{
+				_ptr->addRef();
+			}
+		}
+
+		VariableRef(const VariableRef &other) noexcept : VariableRef(other._ptr)
+		{
+		}
+
+		VariableRef(VariableRef &&other) noexcept : _ptr(other._ptr)
+		{
+			other._ptr = nullptr;
+		}
+
+		template <typename U, typename = std::enable_if_t<std::is_convertible<U *, T *>::value>>
+		VariableRef(const VariableRef<U> &other) noexcept : VariableRef(other._ptr)
+		{
+		}
+
+		template <typename U, typename = std::enable_if_t<std::is_convertible<U *, T *>::value>>
+		VariableRef(VariableRef<U> &&other) noexcept : _ptr(other._ptr)
+		{
+			other._ptr = nullptr;
+		}
+
+		~VariableRef()
+		{
+			if (_ptr)
+			{
+				_ptr->release();
+			}
+		}
+
+		VariableRef &operator=(VariableRef other) noexcept
+		{
+			std::swap(_ptr, other._ptr);
+			return *this;
+		}
+
+		void reset() noexcept
+		{
+			VariableRef().swap(*this);
+		}
+
+		// Gives up the reference without releasing it.
+		T *detach() noexcept
+		{
+			T *ptr = _ptr;
+			_ptr = nullptr;
+			return ptr;
+		}
+
+		void swap(VariableRef &other) noexcept
+		{
+			std::swap(_ptr, other._ptr);
+		}
+
+		T *get() const noexcept
+		{
+			return _ptr;
+		}
+
+		T *operator->() const noexcept
+		{
+			return _ptr;
+		}
+
+		T &operator*() const noexcept
+		{
+			return *_ptr;
+		}
+
+		explicit operator bool() const noexcept
+		{
+			return _ptr != nullptr;
+		}
+
+		template <typename U>
+		bool operator==(const VariableRef<U> &other) const noexcept
+		{
+			return _ptr == other._ptr;
+		}
+
+		template <typename U>
+		bool operator!=(const VariableRef<U> &other) const noexcept
+		{
+			return _ptr != other._ptr;
+		}
+
+		bool operator==(std::nullptr_t) const noexcept
+		{
+			return _ptr == nullptr;
+		}
+
+		bool operator!=(std::nullptr_t) const noexcept
+		{
+			return _ptr != nullptr;
+		}
+	};
+
+	template <typename T, typename U>
+	VariableRef<T> staticPointerCast(const VariableRef<U> &ref) noexcept
+	{
+		return VariableRef<T>(static_cast<T *>(ref.get()));
+	}
+
+	template <typename T, typename U>
+	VariableRef<T> staticPointerCast(VariableRef<U> &&ref) noexcept
+	{
+		VariableRef<T> ret(static_cast<T *>(ref.get()));
+		ref.reset();
+		return ret;
+	}
+
+	using VariablePtr = VariableRef<Variable>;
 
 	using Void = void;
 	using Number = double;
+	using Integer = std::int64_t;
 	using String = std::shared_ptr<std::string>;
-	using Array = std::deque<VariablePtr>;
 	using Function = std::function<void(RuntimeContext &)>;
 	using Tuple = Array;
 	using InitializerList = Array;
 
 	struct Class
 	{
-		std::vector<VariablePtr> properties;
+		// Property boxes are never replaced after construction, so copies share the list.
+		std::shared_ptr<const std::vector<VariablePtr>> properties;
 	};
 
 	using Lvalue = VariablePtr;
-	using Lnumber = std::shared_ptr<VariableImpl<Number>>;
-	using Lstring = std::shared_ptr<VariableImpl<String>>;
-	using Larray = std::shared_ptr<VariableImpl<Array>>;
-	using Lfunction = std::shared_ptr<VariableImpl<Function>>;
-	using Ltuple = std::shared_ptr<VariableImpl<Tuple>>;
-	using Lclass = std::shared_ptr<VariableImpl<Class>>;
-
-	class Variable : public std::enable_shared_from_this<Variable>
+	using Lnumber = VariableRef<VariableImpl<Number>>;
+	using Linteger = VariableRef<VariableImpl<Integer>>;
+	using Lstring = VariableRef<VariableImpl<String>>;
+	using Larray = VariableRef<VariableImpl<Array>>;
+	using Lfunction = VariableRef<VariableImpl<Function>>;
+	using Ltuple = VariableRef<VariableImpl<Tuple>>;
+	using Lclass = VariableRef<VariableImpl<Class>>;
+
+	template <typename T>
+	VariableRef<VariableImpl<T>> createVariable(T value);
+
+	class Variable
 	{
+		template <typename T>
+		friend VariableRef<VariableImpl<T>> createVariable(T value);
+
 	private:
 		Variable(const Variable &) = delete;
 		void operator=(const Variable &) = delete;
 
+		size_t _refCount = 0;
+
 	protected:
+		VariablePool *_pool = nullptr;
+
 		Variable() = default;
 
+		// Destroys the variable and returns its memory to where it came from.
+		virtual void destroy() noexcept = 0;
+
 	public:
 		virtual ~Variable() = default;
 
+		size_t refCount() const noexcept
+		{
+			return _refCount;
+		}
+
+		void addRef() noexcept
+		{
+			++_refCount;
+		}
+
+		void release() noexcept
+		{
+			if (--_refCount == 0)
+			{
+				destroy();
+			}
+		}
+
 		template <typename T>
 		T staticPointerDowncast()
 		{
-			return std::static_pointer_cast<
-				VariableImpl<typename T::element_type::ValueType>>(shared_from_this());
+			return T(static_cast<typename T::element_type *>(this));
 		}
 
 		virtual VariablePtr clone() const = 0;
@@ -74,25 +250,38 @@ namespace sharpsenLang
 
 		VariablePtr clone() const override;
 
+	protected:
+		void destroy() noexcept override;
+
+	public:
+
 		String toString() const override;
 	};
 
 	Number cloneVariableValue(Number value);
+	Integer cloneVariableValue(Integer value);
 	String cloneVariableValue(const String &value);
 	Function cloneVariableValue(const Function &value);
 	Array cloneVariableValue(const Array &value);
 	Class cloneVariableValue(const Class &value);
 
 	template <class T>
-	T cloneVariableValue(const std::shared_ptr<VariableImpl<T>> &v)
+	T cloneVariableValue(const VariableRef<VariableImpl<T>> &v)
 	{
 		return cloneVariableValue(v->value);
 	}
 
 	String convertToString(Number value);
+	String convertToString(Integer value);
 	String convertToString(const String &value);
 	String convertToString(const Function &value);
 	String convertToString(const Array &value);
 	String convertToString(const Lvalue &var);
 	String convertToString(const Class &var);
+
+	// Truncates toward zero. NaN converts to zero and numbers out of range
+	// saturate, where a plain cast would be undefined.
+	Integer convertToInteger(Number value);
 }
+
+#include "Value.hpp"
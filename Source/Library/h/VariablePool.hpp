@@ -0,0 +1,144 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "Variable.hpp"
+
+namespace sharpsenLang
+{
+	struct VariablePoolStats
+	{
+		size_t hits = 0;
+		size_t misses = 0;
+	};
+
+	template <typename T>
+	constexpr size_t variablePoolIndex()
+	{
+		if constexpr (std::is_same<T, Number>::value)
+		{
+			return 0;
+		}
+		else if constexpr (std::is_same<T, String>::value)
+		{
+			return 1;
+		}
+		else if constexpr (std::is_same<T, Function>::value)
+		{
+			return 2;
+		}
+		else if constexpr (std::is_same<T, Array>::value)
+		{
+			return 3;
+		}
+		else if constexpr (std::is_same<T, Class>::value)
+		{
+			return 4;
+		}
+		else
+		{
+			static_assert(std::is_same<T, Integer>::value);
+			return 5;
+		}
+	}
+
+	// Freelists of VariableImpl objects, one per value type. A pool is owned by
+	// a RuntimeContext and is not thread safe: variables it handed out have to be
+	// released on the thread running that context. The pool itself stays alive
+	// until both its owner and the last of its variables are gone.
+	class VariablePool
+	{
+		VariablePool(const VariablePool &) = delete;
+		void operator=(const VariablePool &) = delete;
+
+	private:
+		struct Block
+		{
+			Block *next;
+		};
+
+		struct FreeList
+		{
+			Block *head = nullptr;
+			size_t blockSize = 0;
+			VariablePoolStats stats;
+		};
+
+		std::array<FreeList, 6> _lists;
+		size_t _live;
+		bool _detached;
+
+		static thread_local VariablePool *_current;
+
+		~VariablePool();
+
+	public:
+		VariablePool();
+
+		void *allocate(size_t list, size_t size);
+		void deallocate(size_t list, void *p, size_t size);
+
+		template <typename T>
+		VariablePoolStats stats() const
+		{
+			return _lists[variablePoolIndex<T>()].stats;
+		}
+
+		VariablePoolStats stats() const;
+
+		// Called by the owner instead of deleting the pool.
+		void detach();
+
+		static VariablePool *current()
+		{
+			return _current;
+		}
+
+		// Makes a pool the target of createVariable on this thread while alive.
+		class Scope
+		{
+		private:
+			VariablePool *_previous;
+
+		public:
+			Scope(VariablePool *pool);
+			~Scope();
+		};
+
+		struct Detach
+		{
+			void operator()(VariablePool *pool) const
+			{
+				pool->detach();
+			}
+		};
+	};
+
+	template <typename T>
+	VariableRef<VariableImpl<T>> createVariable(T value)
+	{
+		VariablePool *pool = VariablePool::current();
+		if (!pool)
+		{
+			return VariableRef<VariableImpl<T>>(new VariableImpl<T>(std::move(value)));
+		}
+
+		constexpr size_t list = variablePoolIndex<T>();
+		void *memory = pool->allocate(list, sizeof(VariableImpl<T>));
+		VariableImpl<T> *variable;
+		try
+		{
+			variable = new (memory) VariableImpl<T>(std::move(value));
+		}
+		catch (...)
+		{
+			pool->deallocate(list, memory, sizeof(VariableImpl<T>));
+			throw;
+		}
+		variable->_pool = pool;
+		return VariableRef<VariableImpl<T>>(variable);
+	}
+}
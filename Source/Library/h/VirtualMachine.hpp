@@ -0,0 +1,9 @@
+#pragma once
+
+namespace sharpsenLang
+{
+	class RuntimeContext;
+	class BytecodeFunction;
+
+	void executeBytecode(RuntimeContext &context, const BytecodeFunction &function);
+}
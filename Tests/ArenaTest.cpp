@@ -0,0 +1,66 @@
+#include <iostream>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "Arena.hpp"
+
+using namespace sharpsenLang;
+
+class ArenaTest : public ::testing::Test
+{
+protected:
+    ArenaTest() {}
+
+    void SetUp() override
+    {
+    }
+
+    void TearDown() override {}
+
+    ~ArenaTest() {}
+
+    static void TearDownTestSuite() {}
+};
+
+TEST_F(ArenaTest, Alignment)
+{
+    Arena arena(64);
+    arena.allocate(1, 1);
+    void *p = arena.allocate(sizeof(double), alignof(double));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % alignof(double), 0u);
+    EXPECT_EQ(arena.bytesAllocated(), 1 + sizeof(double));
+}
+
+TEST_F(ArenaTest, Blocks)
+{
+    Arena arena(64);
+    for (int i = 0; i < 8; ++i)
+    {
+        arena.allocate(16, 8);
+    }
+    EXPECT_EQ(arena.blockCount(), 2u);
+
+    arena.allocate(1000, 8);
+    EXPECT_EQ(arena.blockCount(), 3u);
+
+    arena.release();
+    EXPECT_EQ(arena.blockCount(), 0u);
+    EXPECT_EQ(arena.bytesAllocated(), 0u);
+}
+
+TEST_F(ArenaTest, Create)
+{
+    Arena arena;
+    using String = std::unique_ptr<std::string, ArenaDeleter<std::string>>;
+    std::vector<String, ArenaAllocator<String>> strings{ArenaAllocator<String>(arena)};
+
+    for (int i = 0; i < 100; ++i)
+    {
+        strings.emplace_back(arena.create<std::string>(std::to_string(i)));
+    }
+
+    EXPECT_EQ(*strings[42], "42");
+    EXPECT_EQ(arena.blockCount(), 1u);
+}
@@ -0,0 +1,116 @@
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+#include <gtest/gtest.h>
+
+#include "CaseTable.hpp"
+
+using namespace sharpsenLang;
+
+class CaseTableTest : public ::testing::Test
+{
+protected:
+    CaseTableTest() {}
+
+    void SetUp() override
+    {
+    }
+
+    void TearDown() override {}
+
+    ~CaseTableTest() {}
+
+    static void TearDownTestSuite() {}
+
+    static constexpr size_t dflt = 1000;
+
+    static void expectMisses(const CaseTable &table)
+    {
+        EXPECT_EQ(table.find(std::numeric_limits<Number>::quiet_NaN()), dflt);
+        EXPECT_EQ(table.find(std::numeric_limits<Number>::infinity()), dflt);
+        EXPECT_EQ(table.find(-std::numeric_limits<Number>::infinity()), dflt);
+        EXPECT_EQ(table.find(1e300), dflt);
+    }
+};
+
+TEST_F(CaseTableTest, Empty)
+{
+    CaseTable table({}, dflt);
+    EXPECT_EQ(table.find(0), dflt);
+    expectMisses(table);
+}
+
+TEST_F(CaseTableTest, Dense)
+{
+    std::unordered_map<Number, size_t> cases;
+    for (int i = -3; i < 250; i += 2)
+    {
+        cases.emplace(i, size_t(i + 3));
+    }
+    CaseTable table(cases, dflt);
+
+    for (int i = -3; i < 250; i += 2)
+    {
+        EXPECT_EQ(table.find(i), size_t(i + 3));
+        EXPECT_EQ(table.find(i + 1), dflt);
+        EXPECT_EQ(table.find(i + 0.5), dflt);
+    }
+    EXPECT_EQ(table.find(-5), dflt);
+    EXPECT_EQ(table.find(-3.5), dflt);
+    EXPECT_EQ(table.find(251), dflt);
+    expectMisses(table);
+}
+
+TEST_F(CaseTableTest, NegativeZero)
+{
+    CaseTable table({{-0.0, 1}, {1, 2}}, dflt);
+    EXPECT_EQ(table.find(0), 1);
+    EXPECT_EQ(table.find(-0.0), 1);
+}
+
+TEST_F(CaseTableTest, Sorted)
+{
+    std::unordered_map<Number, size_t> cases;
+    for (int i = 0; i < 40; ++i)
+    {
+        cases.emplace(i * 1000 - 0.25, size_t(i));
+    }
+    CaseTable table(cases, dflt);
+
+    for (int i = 0; i < 40; ++i)
+    {
+        EXPECT_EQ(table.find(i * 1000 - 0.25), size_t(i));
+        EXPECT_EQ(table.find(i * 1000), dflt);
+    }
+    expectMisses(table);
+}
+
+TEST_F(CaseTableTest, Hashed)
+{
+    std::unordered_map<Number, size_t> cases;
+    for (int i = 0; i < 300; ++i)
+    {
+        cases.emplace(i * 1000, size_t(i));
+    }
+    CaseTable table(cases, dflt);
+
+    for (int i = 0; i < 300; ++i)
+    {
+        EXPECT_EQ(table.find(i * 1000), size_t(i));
+        EXPECT_EQ(table.find(i * 1000 + 1), dflt);
+    }
+    expectMisses(table);
+}
+
+TEST_F(CaseTableTest, Retarget)
+{
+    CaseTable table({{1, 1}, {2, 2}, {4, 3}}, dflt);
+    table.retarget(
+        [](size_t target)
+        {
+            return target * 10;
+        });
+    EXPECT_EQ(table.find(2), 20);
+    EXPECT_EQ(table.find(3), dflt * 10);
+    EXPECT_EQ(table.find(7), dflt * 10);
+}
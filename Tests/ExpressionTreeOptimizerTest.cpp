@@ -0,0 +1,103 @@
+#include <iostream>
+#include <string_view>
+#include <gtest/gtest.h>
+
+#include "BufferStream.hpp"
+#include "CompilerContext.hpp"
+#include "ExpressionTree.hpp"
+#include "ExpressionTreeOptimizer.hpp"
+#include "ExpressionTreeParser.hpp"
+#include "Tokenizer.hpp"
+
+using namespace sharpsenLang;
+
+class ExpressionTreeOptimizerTest : public ::testing::Test
+{
+protected:
+    ExpressionTreeOptimizerTest() {}
+
+    void SetUp() override
+    {
+        context.createIdentifier("x", TypeRegistry::getNumberHandle());
+        context.createIdentifier("s", TypeRegistry::getStringHandle());
+    }
+
+    void TearDown() override {}
+
+    ~ExpressionTreeOptimizerTest() {}
+
+    static void TearDownTestSuite() {}
+
+    NodePtr optimize(std::string_view input)
+    {
+        BufferStream stream(input);
+        TokensIterator it(stream);
+        NodePtr np = parseExpressionTree(context, it, TypeRegistry::getVoidHandle(), true);
+        return optimizeExpressionTree(context, std::move(np));
+    }
+
+    size_t removedNodes() const
+    {
+        return context.sharedCounters()->stats().removedNodes;
+    }
+
+    CompilerContext context;
+};
+
+TEST_F(ExpressionTreeOptimizerTest, FoldNumbers)
+{
+    NodePtr np = optimize("2 * 3 + 4 - (-1) + (7 \\ 2) + (1 << 4) + (5 == 5)");
+    ASSERT_TRUE(np->isNumber());
+    EXPECT_EQ(np->getNumber(), 6 + 4 + 1 + 3 + 16 + 1);
+    EXPECT_EQ(removedNodes(), 19);
+}
+
+TEST_F(ExpressionTreeOptimizerTest, FoldStrings)
+{
+    NodePtr np = optimize("\"a\" .. \"b\" .. 1.5 .. toString(2)");
+    ASSERT_TRUE(np->isString());
+    EXPECT_EQ(np->getString(), "ab1.5000002");
+
+    np = optimize("(\"a\" < \"b\") + (\"a\" == \"b\")");
+    ASSERT_TRUE(np->isNumber());
+    EXPECT_EQ(np->getNumber(), 1);
+}
+
+TEST_F(ExpressionTreeOptimizerTest, Identities)
+{
+    NodePtr np = optimize("(x * 1 + 0) / (2 - 1) - 0");
+    ASSERT_TRUE(np->isIdentifier());
+    EXPECT_EQ(np->getIdentifier(), "x");
+    EXPECT_EQ(removedNodes(), 10);
+
+    np = optimize("s .. \"\"");
+    ASSERT_TRUE(np->isIdentifier());
+    EXPECT_EQ(np->getIdentifier(), "s");
+
+    np = optimize("x * 2");
+    EXPECT_TRUE(np->isNodeOperation());
+}
+
+TEST_F(ExpressionTreeOptimizerTest, TernaryAndLogical)
+{
+    NodePtr np = optimize("1 ? x : 2");
+    ASSERT_TRUE(np->isIdentifier());
+
+    np = optimize("(0 && x) + (x || 3) + (x > 1 && 0)");
+    ASSERT_TRUE(np->isNumber());
+    EXPECT_EQ(np->getNumber(), 1);
+
+    np = optimize("x++ && 0");
+    ASSERT_TRUE(np->isNodeOperation());
+    EXPECT_EQ(np->getNodeOperation(), NodeOperation::Land);
+}
+
+TEST_F(ExpressionTreeOptimizerTest, KeepUndefinedIntConversions)
+{
+    for (std::string_view input : {"1 << 40", "1e12 & 1", "1 \\ 0"})
+    {
+        NodePtr np = optimize(input);
+        EXPECT_TRUE(np->isNodeOperation()) << input;
+    }
+    EXPECT_EQ(removedNodes(), 0);
+}
@@ -0,0 +1,1432 @@
+#include <iostream>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "Module.hpp"
+#include "Errors.hpp"
+
+using namespace sharpsenLang;
+
+class ModuleTest : public ::testing::Test
+{
+protected:
+    ModuleTest() {}
+
+    void SetUp() override
+    {
+    }
+
+    void TearDown() override
+    {
+        std::remove(path.c_str());
+    }
+
+    ~ModuleTest() {}
+
+    static void TearDownTestSuite() {}
+
+    struct RunResult
+    {
+        Number value;
+        CompileStats stats;
+    };
+
+    // Loads the source with the given settings and returns what main() returns.
+    // The setup callback can add external functions before the source is loaded.
+    RunResult run(const ModuleSettings &settings, const std::string &source, const std::function<void(Module &)> &setup = nullptr)
+    {
+        {
+            std::ofstream file(path);
+            file << source;
+        }
+
+        Module module(settings);
+        if (setup)
+        {
+            setup(module);
+        }
+        auto sMain = module.createPublicFunctionCaller<Number>("main");
+        EXPECT_TRUE(module.tryLoad(path.c_str(), &std::cerr));
+        Number value = sMain();
+        return {value, module.program()->compileStats()};
+    }
+
+    Number run(ExecutionEngine engine, const std::string &source)
+    {
+        ModuleSettings settings;
+        settings.engine = engine;
+        return run(settings, source).value;
+    }
+
+    void expectResult(const std::string &source, Number expected)
+    {
+        EXPECT_EQ(run(ExecutionEngine::Tree, source), expected);
+        EXPECT_EQ(run(ExecutionEngine::Vm, source), expected);
+    }
+
+    std::string path = testing::TempDir() + "ModuleTest.stk";
+};
+
+TEST_F(ModuleTest, Arithmetic)
+{
+    auto input = R"(
+        public function number main() {
+            number x = 7;
+            number y = 2;
+            number r = x + y * 3;
+            r -= x / y;
+            r += x \ y;
+            r += x % y;
+            r += (x & 3) + (x | 8);
+            r += (x ^ 1) + (x << 2);
+            r += (x >> 1) + -y;
+            r += ~x;
+            return r;
+        }
+    )";
+    expectResult(input, 13 - 3.5 + 3 + 1 + 3 + 15 + 6 + 28 + 3 - 2 - 8);
+}
+
+TEST_F(ModuleTest, AssignmentOperators)
+{
+    auto input = R"(
+        number g = 5;
+
+        public function number main() {
+            number x = 10;
+            x += 5;
+            x -= 3;
+            x /= 4;
+            g += x++;
+            g -= --x;
+            x \= 2;
+            x %= 5;
+            x <<= 3;
+            x |= 3;
+            x &= 14;
+            x ^= 1;
+            x >>= 1;
+            return x * 100 + g;
+        }
+    )";
+    expectResult(input, 5 * 100 + 5);
+}
+
+TEST_F(ModuleTest, MultiplyAssignment)
+{
+    auto input = R"(
+        number g = 3;
+
+        public function number main() {
+            number x = 7;
+            x *= 3;
+            g *= x;
+            number[] arr;
+            arr[0] = 2;
+            arr[0] *= 5;
+            return x * 10000 + g * 10 + arr[0];
+        }
+    )";
+    expectResult(input, 21 * 10000 + 63 * 10 + 10);
+}
+
+TEST_F(ModuleTest, ControlFlow)
+{
+    auto input = R"(
+        public function number main() {
+            number s = 0;
+            for (number i = 0; i < 100; ++i) {
+                if (i % 2 == 0 && i != 10)
+                    continue;
+                else if (i > 50 || i == 13)
+                    break;
+                number j = 0;
+                while (1) {
+                    if (++j >= 3)
+                        break;
+                }
+                do {
+                    s += j;
+                } while (0);
+                switch (i % 5) {
+                    case 0:
+                        s += 100;
+                    case 1:
+                        s += 10;
+                        break;
+                    default:
+                        s += 1;
+                }
+            }
+            return s > 1000 ? s - 1000 : s;
+        }
+    )";
+    expectResult(input, 13 + 4 + 113 + 4 + 4 + 113 + 13);
+}
+
+TEST_F(ModuleTest, Switch)
+{
+    auto input = R"(
+        function number dense(number x) {
+            switch (x) {
+                case 0:
+                    return 10;
+                case 1:
+                case 2:
+                    return 20;
+                case 4:
+                    return 40;
+                default:
+                    return 1;
+            }
+        }
+
+        function number sparse(number x) {
+            switch (x) {
+                case 999:
+                    return 10;
+                case 0.5:
+                    return 20;
+                case 100000:
+                    return 30;
+            }
+            return 1;
+        }
+
+        public function number main() {
+            number r = 0;
+            for (number i = -1; i < 5; ++i)
+                r = r * 100 + dense(i) + dense(i + 0.5);
+            r = r * 100 + sparse(999) + sparse(0.5) + sparse(100000) + sparse(0) + sparse(1);
+            return r;
+        }
+    )";
+    expectResult(input, (((((2.0 * 100 + 11) * 100 + 21) * 100 + 21) * 100 + 2) * 100 + 41) * 100 + 62);
+}
+
+TEST_F(ModuleTest, Calls)
+{
+    auto input = R"(
+        function number fib(number n) {
+            if (n < 2)
+                return n;
+            return fib(n - 1) + fib(n - 2);
+        }
+
+        function void increment(number& x) {
+            ++x;
+        }
+
+        function number apply(number(number) f, number x) {
+            return f(x);
+        }
+
+        public function number main() {
+            number x = fib(15);
+            increment(&x);
+            return apply(fib, 10) + x;
+        }
+    )";
+    expectResult(input, 55 + 610 + 1);
+}
+
+TEST_F(ModuleTest, CallArguments)
+{
+    auto input = R"(
+        function number digits(number a, number b, number c) {
+            return a * 100 + b * 10 + c;
+        }
+
+        public function number main() {
+            number x = 1;
+            number(number, number, number) f = digits;
+            number direct = digits(x++, digits(0, 0, x++), x++);
+            number dynamic = f(x++, f(0, 0, x++), x++);
+            return direct * 1000 + dynamic;
+        }
+    )";
+    expectResult(input, 123 * 1000 + 456);
+}
+
+TEST_F(ModuleTest, OperandOrder)
+{
+    auto input = R"(
+        number log = 0;
+
+        function number f(number x) {
+            log = log * 10 + x;
+            return x;
+        }
+
+        function number h(number& x) {
+            x = x + 5;
+            return 1;
+        }
+
+        public function number main() {
+            number d = f(1) - f(2);
+            number x = 1;
+            number y = h(&x) * 100 + x;
+            number z = f(3) * 10 + f(4);
+            return log * 10000 + y * 10 + z + d;
+        }
+    )";
+    expectResult(input, 1234 * 10000 + 106 * 10 + 34 - 1);
+}
+
+TEST_F(ModuleTest, LocalOperands)
+{
+    auto input = R"(
+        function number h(number& x) {
+            x = x * 2;
+            return 1;
+        }
+
+        public function number main() {
+            number x = 3;
+            number a = x + (x = 5);
+            number b = x++ + x;
+            number c = x + h(&x);
+            number d = (x += 1) - x;
+            number e = 0;
+            for (number i = 0; i < 10; ++i) {
+                if (i == 3)
+                    continue;
+                e += i;
+            }
+            number f = 10;
+            while (f > 2)
+                f -= 3;
+            number g = x >= 13 ? x : 0;
+            return a + b * 100 + c * 10000 + d + e * 1000000 + f * 100000000 + g * 1000000000;
+        }
+    )";
+    expectResult(input, 8 + 11 * 100 + 7 * 10000 + 42 * 1000000 + 1 * 100000000 + 13 * 1000000000.0);
+}
+
+TEST_F(ModuleTest, TreeFallback)
+{
+    auto input = R"(
+        public function number main() {
+            number[] arr;
+            for (number i = 0; i < 10; ++i)
+                arr[i] = i * i;
+            string s = "a" .. toString(arr[3]);
+            return arr[9] + sizeof(arr) + sizeof(s);
+        }
+    )";
+    expectResult(input, 81 + 10 + 1);
+}
+
+TEST_F(ModuleTest, Arrays)
+{
+    auto input = R"(
+        function void swap(number& x, number& y) {
+            number t = x;
+            x = y;
+            y = t;
+        }
+
+        public function number main() {
+            number[] a;
+            a[4] = 5;
+            for (number i = 0; i < 4; ++i)
+                a[i] = i + 1;
+            swap(&a[0], &a[4]);
+            number[] b = a;
+            b[0] = 100;
+            a[1] += 10;
+            ++a[2];
+            string[] s;
+            s[2] = "c";
+            s[0] = s[2] .. "d";
+            number[][] m;
+            m[1][1] = 7;
+            return a[0] * 10000 + a[1] * 100 + a[2] + a[4] + b[0] + sizeof(s) + (s[0] == "cd") + sizeof(m) + m[1][1] + m[0][0];
+        }
+    )";
+    expectResult(input, 5 * 10000 + 12 * 100 + 4 + 1 + 100 + 3 + 1 + 2 + 7);
+}
+
+TEST_F(ModuleTest, ArrayElementConversion)
+{
+    auto input = R"(
+        public function number main() {
+            number[] a;
+            a[0] = 12;
+            string s = a[0];
+            s = s .. a[0];
+            return s == "1212";
+        }
+    )";
+    expectResult(input, 1);
+}
+
+TEST_F(ModuleTest, ArrayCopyOnWrite)
+{
+    auto input = R"(
+        function number sum(number[] a) {
+            number s = 0;
+            for (number i = 0; i < sizeof(a); ++i)
+                s += a[i];
+            a[0] = 1000;
+            return s;
+        }
+
+        function number alias(number[]& a, number& x) {
+            number[] b = a;
+            x = 50;
+            return b[0];
+        }
+
+        function number nested(number[][]& m, number& x) {
+            number[][] copy = m;
+            x = 60;
+            return copy[1][0];
+        }
+
+        public function number main() {
+            number[] a;
+            for (number i = 0; i < 10; ++i)
+                a[i] = i + 1;
+            number[][] m;
+            m[1][0] = 3;
+            number r = sum(a) * 1000 + sum(a);
+            number[] b = a;
+            ++b[1];
+            r = r * 100 + a[1] * 10 + b[1];
+            r = r * 100 + alias(&a, &a[0]);
+            r = r * 100 + a[0];
+            r = r * 100 + nested(&m, &m[1][0]);
+            return r * 100 + m[1][0];
+        }
+    )";
+    expectResult(input, ((((55055.0 * 100 + 23) * 100 + 1) * 100 + 50) * 100 + 3) * 100 + 60);
+}
+
+TEST_F(ModuleTest, ConstantFolding)
+{
+    auto input = R"(
+        number g = 2 * 3 + 1;
+
+        public function number main() {
+            number x = g * 1 + 0;
+            string s = "ab" .. (1 + 2) .. "";
+            number r = 1 ? x * (4 \ 3) : 100;
+            r += (0 && x++) + (1 || x++) + x;
+            r += sizeof(s) + (s == "ab3") * 1000;
+            return -r + (1 << 3) - ~0;
+        }
+    )";
+
+    for (bool optimize : {false, true})
+    {
+        ModuleSettings settings;
+        settings.optimizeExpressions = optimize;
+
+        RunResult result = run(settings, input);
+        EXPECT_EQ(result.value, -(7 + 1 + 7 + 1 + 1000) + 8 + 1);
+        EXPECT_EQ(result.stats.removedNodes > 0, optimize);
+    }
+}
+
+TEST_F(ModuleTest, Inlining)
+{
+    auto input = R"(
+        number calls = 0;
+
+        function number less(number x, number y) {
+            return x < y;
+        }
+
+        function void swap(number &x, number &y) {
+            number t = x;
+            x = y;
+            y = t;
+        }
+
+        function number count(number &n) {
+            ++calls;
+            return ++n;
+        }
+
+        function string greet(string s) {
+            s = "hi " .. s;
+            return s;
+        }
+
+        function number even(number n) {
+            return n == 0 ? 1 : odd(n - 1);
+        }
+
+        function number odd(number n) {
+            return n == 0 ? 0 : even(n - 1);
+        }
+
+        public function number main() {
+            number[] a = {5, 3, 9, 1, 7};
+            for (number i = 0; i < sizeof(a); ++i) {
+                for (number j = sizeof(a) - 1; j > i; --j) {
+                    if (less(a[j], a[j - 1])) {
+                        swap(&a[j], &a[j - 1]);
+                    }
+                }
+            }
+            number r = 0;
+            for (number i = 0; i < sizeof(a); ++i) {
+                r = r * 10 + a[i];
+            }
+
+            number n = 0;
+            count(&n);
+            number c = count(&n) * 2;
+            r = r * 10 + c + calls;
+
+            string s = "you";
+            string g = greet(s);
+            r = r * 10 + (g == "hi you") + (s == "you");
+
+            r = r * 10 + even(7) * 2 + odd(7);
+            return r;
+        }
+    )";
+
+    for (size_t threshold : {size_t(0), ModuleSettings().inlineThreshold})
+    {
+        ModuleSettings settings;
+        settings.inlineThreshold = threshold;
+
+        RunResult result = run(settings, input);
+        EXPECT_EQ(result.value, ((13579 * 10 + 6) * 10 + 2) * 10 + 1);
+        EXPECT_EQ(result.stats.inlinedCalls > 0, threshold != 0);
+    }
+}
+
+TEST_F(ModuleTest, InliningSkipsRecursion)
+{
+    auto input = R"(
+        function number fib(number n) {
+            return n < 2 ? n : fib(n - 1) + fib(n - 2);
+        }
+
+        public function number main() {
+            return fib(10);
+        }
+    )";
+
+    Module module;
+    auto sMain = module.createPublicFunctionCaller<Number>("main");
+    ASSERT_TRUE(module.tryLoadSource(input, &std::cerr));
+    EXPECT_EQ(sMain(), 55);
+    EXPECT_EQ(module.program()->compileStats().inlinedCalls, 0);
+}
+
+TEST_F(ModuleTest, Specialization)
+{
+    auto input = R"(
+        function void quicksort(number[]& a, number lo, number hi, number(number, number) comp) {
+            if (lo >= hi) {
+                return;
+            }
+            number i = lo;
+            for (number j = lo; j < hi; ++j) {
+                if (comp(a[j], a[hi])) {
+                    number t = a[i];
+                    a[i] = a[j];
+                    a[j] = t;
+                    ++i;
+                }
+            }
+            number t = a[i];
+            a[i] = a[hi];
+            a[hi] = t;
+            quicksort(&a, lo, i - 1, comp);
+            quicksort(&a, i + 1, hi, comp);
+        }
+
+        function number less(number x, number y) {
+            return x < y;
+        }
+
+        function number twice(number x) {
+            return 2 * x;
+        }
+
+        function number apply(number(number) f, number x) {
+            return f(x);
+        }
+
+        function number rebind(number(number) f, number x) {
+            f = twice;
+            return f(x) + 1;
+        }
+
+        function number mul(number x, number y) {
+            return x * y;
+        }
+
+        function number add(number x, number y) {
+            return x + y;
+        }
+
+        function number swapper(number(number, number) f, number x) {
+            if (x > 3) {
+                return x - 3;
+            }
+            (f) = mul;
+            return swapper(f, f(x, 2));
+        }
+
+        public function number main() {
+            number[] a = {5, 3, 9, 1, 7};
+            number[] b = a;
+            quicksort(&a, 0, sizeof(a) - 1, less);
+            quicksort(&b, 0, sizeof(b) - 1, greater);
+
+            number r = 0;
+            for (number i = 0; i < sizeof(a); ++i) {
+                r = r * 100 + a[i] * 10 + b[i];
+            }
+
+            number(number) f = twice;
+            r = r * 10 + apply(twice, 3);
+            r = r * 10 + apply(f, 4);
+            r = r * 10 + rebind(twice, 0);
+            r = r * 10 + swapper(add, 1);
+            return r;
+        }
+    )";
+
+    auto addGreater = [](Module &module)
+    {
+        module.addExternalFunction("greater", std::function<Number(Number, Number)>([](Number x, Number y)
+                                                                                     { return Number(x > y); }));
+    };
+
+    for (int i = 0; i < 3; ++i)
+    {
+        ModuleSettings settings;
+        settings.specializeFunctionArguments = i != 1;
+        settings.engine = i == 2 ? ExecutionEngine::Vm : ExecutionEngine::Tree;
+
+        RunResult result = run(settings, input, addGreater);
+        EXPECT_EQ(result.value, ((((1937557391.0 * 10 + 6) * 10 + 8) * 10 + 1) * 10 + 1));
+        EXPECT_EQ(result.stats.specializations, i == 0 ? 2 : 0);
+    }
+}
+
+TEST_F(ModuleTest, TailCalls)
+{
+    auto input = R"(
+        function number count(number n, number acc) {
+            if (n == 0)
+                return acc;
+            return count(n - 1, acc + 1);
+        }
+
+        function number isEven(number n) {
+            if (n == 0)
+                return 1;
+            return isOdd(n - 1);
+        }
+
+        function number isOdd(number n) {
+            if (n == 0)
+                return 0;
+            return isEven(n - 1);
+        }
+
+        function number sum(number[]& a, number i, number acc) {
+            for (number j = i; j < sizeof(a); ++j) {
+                number t = a[j];
+                return sum(&a, j + 1, acc + t);
+            }
+            return acc;
+        }
+
+        function string repeat(string s, number n) {
+            return n > 1 ? s .. repeat(s, n - 1) : s;
+        }
+
+        function string join(string acc, string s, number n) {
+            if (n == 0)
+                return acc;
+            return join(acc .. s, s, n - 1);
+        }
+
+        public function number main() {
+            number[] a;
+            for (number i = 0; i < 20000; ++i)
+                a[i] = i % 10;
+            number r = count(100000, 0);
+            r = r * 10 + isEven(50001);
+            r = r * 10 + isOdd(50001);
+            r = r * 100000 + sum(&a, 0, 0);
+            return r * 10 + (join("", "ab", 30000) == repeat("ab", 3) .. join("", "ab", 29997));
+        }
+    )";
+
+    for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+    {
+        ModuleSettings settings;
+        settings.engine = engine;
+        settings.stackCapacity = 1024;
+
+        Module module(settings);
+        auto sMain = module.createPublicFunctionCaller<Number>("main");
+        ASSERT_TRUE(module.tryLoadSource(input, &std::cerr));
+        EXPECT_EQ(sMain(), (((100000.0 * 10 + 0) * 10 + 1) * 100000 + 90000) * 10 + 1);
+        EXPECT_EQ(module.program()->compileStats().tailCalls, 5);
+    }
+}
+
+TEST_F(ModuleTest, LoopInvariants)
+{
+    auto input = R"(
+        number g = 1;
+
+        function void bump() {
+            ++g;
+        }
+
+        function number aliased(number& x, number& y) {
+            number k = 0;
+            while (k < x + 1) {
+                ++k;
+                if (k < 3)
+                    ++y;
+            }
+            return k;
+        }
+
+        function number hoisted(number hi) {
+            number[] a;
+            a[hi - 1] = 1;
+            number acc = 0;
+            for (number i = 0; i < sizeof(a) - 1; ++i)
+                acc += i;
+            number n = 10;
+            number k = 0;
+            while ((k < n * 2) && (k < hi + 5))
+                ++k;
+            number j;
+            for (j = 0; j < n / 2; j += hi / hi)
+                acc += j;
+            return acc * 100 + k * 10 + j;
+        }
+
+        function number written() {
+            number k = 0;
+            number m = 3;
+            while (k < m * 2) {
+                ++k;
+                if (k % 3 == 0)
+                    ++m;
+            }
+            number c = 0;
+            while (c < g + 1) {
+                ++c;
+                if (c < 5)
+                    bump();
+            }
+            number[] b;
+            number d = 0;
+            while (d < sizeof(b) + 1) {
+                number t = b[d];
+                if (++d == 10)
+                    break;
+            }
+            number a = 2;
+            number r = aliased(&a, &a);
+            return k * 1000000 + c * 10000 + d * 100 + r * 10 + a;
+        }
+
+        function number guarded() {
+            int x = 10;
+            int y = 0;
+            number i = 0;
+            while (y != 0 && (x \ y) / 2 > i) {
+                ++i;
+            }
+            return i;
+        }
+
+        public function number main() {
+            return hoisted(10) * 100000000 + written() + guarded();
+        }
+    )";
+
+    for (bool hoist : {true, false})
+    {
+        for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+        {
+            ModuleSettings settings;
+            settings.engine = engine;
+            settings.hoistLoopInvariants = hoist;
+
+            RunResult result = run(settings, input);
+            EXPECT_EQ(result.value, (4600 + 155) * 100000000.0 + 14 * 1000000 + 6 * 10000 + 10 * 100 + 5 * 10 + 4);
+            EXPECT_EQ(result.stats.hoistedExpressions, hoist ? 5 : 0);
+        }
+    }
+}
+
+TEST_F(ModuleTest, BoundsChecks)
+{
+    auto input = R"(
+        number[] g = {1, 2, 3};
+
+        function void reset() {
+            g = {9};
+        }
+
+        function void shrink(number[]& b) {
+            b = {5};
+        }
+
+        function number counted() {
+            number[] a = {0, 0, 0, 0, 0};
+            for (number i = 0; i < sizeof(a); ++i)
+                a[i] = i * 2;
+            number s = 0;
+            for (number i = 1; i <= sizeof(a) - 1; i++)
+                s += a[i];
+            for (number i = 0; i < sizeof(a) - 2; i += 2) {
+                s += a[i] * 100;
+            }
+            for (number i = 0; i < sizeof(g); ++i)
+                s += g[i] * 1000;
+            return s;
+        }
+
+        function number checked() {
+            number[] a = {1, 2, 3};
+            number s = 0;
+            for (number i = 0; i < sizeof(a); ++i) {
+                s += a[i];
+                ++i;
+            }
+            for (number i = 0; i < sizeof(a); ++i) {
+                s += a[i] * 10;
+                a = {7};
+            }
+            a = {1, 2, 3};
+            for (number i = 0; i < sizeof(a); ++i) {
+                s += a[i] * 100;
+                shrink(&a);
+            }
+            number j = 0;
+            for (number i = j; i < sizeof(a); ++i)
+                s += a[i] * 1000;
+            for (number i = 0; i < sizeof(g); ++i) {
+                s += g[i] * 10000;
+                reset();
+            }
+            return s;
+        }
+
+        public function number main() {
+            return counted() * 100000 + checked();
+        }
+    )";
+
+    for (bool eliminate : {true, false})
+    {
+        for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+        {
+            ModuleSettings settings;
+            settings.engine = engine;
+            settings.eliminateBoundsChecks = eliminate;
+
+            RunResult result = run(settings, input);
+            EXPECT_EQ(result.stats.removedBoundsChecks, eliminate ? 4 : 0);
+            EXPECT_EQ(result.value, (6000 + 400 + 20) * 100000 + 10000 + 5000 + 100 + 10 + 4);
+        }
+    }
+}
+
+TEST_F(ModuleTest, BoundsCheckLvalues)
+{
+    auto input = R"(
+        function void clear(number[]& b) {
+            number[] e;
+            b = e;
+        }
+
+        function void twice(number& x) {
+            x *= 2;
+        }
+
+        function number elements() {
+            number[] a = {1, 2, 3};
+            number s = 0;
+            for (number i = 0; i < sizeof(a); ++i) {
+                twice(&a[i]);
+                (s) += a[i];
+            }
+            return s;
+        }
+
+        function number byReference() {
+            number[] a = {1, 2, 3};
+            number s = 0;
+            for (number i = 0; i < sizeof(a); ++i) {
+                clear(&(a));
+                s += a[i] + 1;
+            }
+            return s;
+        }
+
+        function number parenthesized() {
+            number[] a = {1, 2, 3};
+            number[] e;
+            number s = 0;
+            for (number i = 0; i < sizeof(a); ++i) {
+                (a) = e;
+                s += a[i] + 2;
+            }
+            return s;
+        }
+
+        function number ternary(number c) {
+            number[] a = {1, 2, 3};
+            number[] b;
+            number s = 0;
+            for (number i = 0; i < sizeof(a); ++i) {
+                (c ? a : b) = b;
+                s += a[i] + 4;
+            }
+            return s;
+        }
+
+        function number comma() {
+            number[] a = {1, 2, 3};
+            number[] e;
+            number s = 0;
+            for (number i = 0; i < sizeof(a); ++i) {
+                (s, a) = e;
+                s += a[i] + 8;
+            }
+            return s;
+        }
+
+        public function number main() {
+            return elements() * 10000 + byReference() * 1000 + parenthesized() * 100 + ternary(1) * 10 + comma();
+        }
+    )";
+
+    for (bool eliminate : {true, false})
+    {
+        for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+        {
+            ModuleSettings settings;
+            settings.engine = engine;
+            settings.eliminateBoundsChecks = eliminate;
+
+            RunResult result = run(settings, input);
+            EXPECT_EQ(result.stats.removedBoundsChecks, eliminate ? 2 : 0);
+            EXPECT_EQ(result.value, 12 * 10000 + 1000 + 200 + 40 + 8);
+        }
+    }
+}
+
+TEST_F(ModuleTest, FrameSlots)
+{
+    auto input = R"(
+        function number sum(number[] a) {
+            number s = 0;
+            for (number i = 0; i < sizeof(a); ++i)
+                s += a[i];
+            return s;
+        }
+
+        function number depth(number n) {
+            if (n == 0)
+                return 0;
+            {
+                number[] a = {n};
+                {
+                    number b = depth(n - 1);
+                    return a[0] + b;
+                }
+            }
+        }
+
+        public function number main() {
+            number acc = 0;
+            for (number i = 0; i < 3; ++i) {
+                number[] fresh;
+                fresh[i] = i + 1;
+                acc += sizeof(fresh) * 100;
+            }
+            {
+                number[] a = {1, 2, 3};
+                acc += sum(a);
+            }
+            {
+                number b = 40;
+                number c = sum({b, b});
+                acc += c;
+            }
+            number k = 0;
+            while (1) {
+                number t = k;
+                if (++k == 5)
+                    break;
+            }
+            if (number x = k * 1000; x > 0)
+                acc += x;
+            return acc + depth(4) * 100000;
+        }
+    )";
+
+    for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+    {
+        ModuleSettings settings;
+        settings.engine = engine;
+
+        Module module(settings);
+        auto sMain = module.createPublicFunctionCaller<Number>("main");
+        ASSERT_TRUE(module.tryLoadSource(input, &std::cerr));
+        EXPECT_EQ(sMain(), 10 * 100000 + 5000 + 600 + 80 + 6);
+    }
+}
+
+TEST_F(ModuleTest, StackOverflow)
+{
+    {
+        std::ofstream file(path);
+        file << R"(
+            function number recurse(number n) {
+                return recurse(n + 1) + 1;
+            }
+
+            public function number main(number n) {
+                return n > 0 ? recurse(0) : 42;
+            }
+        )";
+    }
+
+    for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+    {
+        ModuleSettings settings;
+        settings.engine = engine;
+        settings.stackCapacity = 1024;
+
+        Module module(settings);
+        auto sMain = module.createPublicFunctionCaller<Number, Number>("main");
+        ASSERT_TRUE(module.tryLoad(path.c_str(), &std::cerr));
+        EXPECT_THROW(sMain(1), RuntimeError);
+        EXPECT_EQ(sMain(0), 42);
+    }
+}
+
+TEST_F(ModuleTest, LoadSource)
+{
+    std::string source = R"(
+        public function number main() {
+            return 7;
+        }
+    )";
+
+    Module module;
+    auto sMain = module.createPublicFunctionCaller<Number>("main");
+    ASSERT_TRUE(module.tryLoadSource(source, &std::cerr));
+    source.assign(source.size(), ' ');
+    EXPECT_EQ(sMain(), 7);
+
+    // Specialized copies are compiled on their first call, after the buffer is gone.
+    source = R"(
+        function number twice(number x) {
+            return 2 * x;
+        }
+
+        function number apply(number(number) f, number n) {
+            string s = "";
+            for (number i = 0; i < n; ++i)
+                s = s .. "x";
+            return f(n) + (s == "xxx") * 100;
+        }
+
+        public function number main() {
+            return apply(twice, 3);
+        }
+    )";
+    ASSERT_TRUE(module.tryLoadSource(source, &std::cerr));
+    source.assign(source.size(), ' ');
+    EXPECT_EQ(sMain(), 106);
+    EXPECT_EQ(module.program()->compileStats().specializations, 1);
+
+    std::ostringstream err;
+    EXPECT_FALSE(module.tryLoadSource("public function number main() { return y; }", &err));
+    EXPECT_NE(err.str().find("return y;"), std::string::npos);
+}
+
+TEST_F(ModuleTest, LazyCompile)
+{
+    const std::string input = R"(
+        function number fib(number n) {
+            if (n < 2)
+                return n;
+            return fib(n - 1) + fib(n - 2);
+        }
+
+        function number apply(number(number) f, number x) {
+            return f(x);
+        }
+
+        function number broken() {
+            return undeclared;
+        }
+
+        public function number main(number n) {
+            return n > 0 ? apply(fib, n) + fib(n) : broken();
+        }
+    )";
+
+    for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+    {
+        ModuleSettings settings;
+        settings.engine = engine;
+
+        Module eager(settings);
+        eager.createPublicFunctionCaller<Number, Number>("main");
+        std::ostringstream err;
+        EXPECT_FALSE(eager.tryLoadSource(input, &err));
+
+        settings.lazyCompile = true;
+
+        std::string source = input;
+        Module module(settings);
+        auto sMain = module.createPublicFunctionCaller<Number, Number>("main");
+        ASSERT_TRUE(module.tryLoadSource(source, &std::cerr));
+        source.assign(source.size(), ' ');
+
+        EXPECT_EQ(sMain(10), 110);
+        EXPECT_EQ(sMain(15), 1220);
+        EXPECT_THROW(sMain(0), RuntimeError);
+        EXPECT_THROW(sMain(0), RuntimeError);
+        EXPECT_EQ(sMain(1), 2);
+    }
+}
+
+TEST_F(ModuleTest, ParallelCompile)
+{
+    std::string source = R"(
+        function number f0(number n) {
+            return n;
+        }
+    )";
+    for (int i = 1; i < 200; ++i)
+    {
+        std::string index = std::to_string(i);
+        std::string dimensions;
+        for (int j = 0; j < i % 5; ++j)
+        {
+            dimensions += "[]";
+        }
+        source += "function number f" + index + "(number n) {\n"
+                  "    number[] a;\n"
+                  "    [number, number" + dimensions + "] t;\n"
+                  "    a[0] = " + index + ";\n"
+                  "    return f" + std::to_string(i - 1) + "(n) + a[0] + sizeof(t);\n"
+                  "}\n";
+    }
+    source += "public function number main() { return f199(1); }\n";
+
+    for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+    {
+        ModuleSettings settings;
+        settings.engine = engine;
+        settings.compileThreads = 4;
+
+        Module module(settings);
+        auto sMain = module.createPublicFunctionCaller<Number>("main");
+        ASSERT_TRUE(module.tryLoadSource(source, &std::cerr));
+        EXPECT_EQ(sMain(), 1 + 199 * 200 / 2 + 199);
+    }
+
+    std::string broken = source;
+    broken.insert(broken.find("a[0] = 150;"), "x = 1;");
+    broken.insert(broken.find("a[0] = 20;"), "y = 1;");
+
+    std::string errors[2];
+    for (size_t threads : {1, 4})
+    {
+        ModuleSettings settings;
+        settings.compileThreads = threads;
+
+        Module module(settings);
+        module.createPublicFunctionCaller<Number>("main");
+        std::ostringstream err;
+        EXPECT_FALSE(module.tryLoadSource(broken, &err));
+        errors[threads == 4] = err.str();
+    }
+    EXPECT_NE(errors[0].find("y = 1;"), std::string::npos);
+    EXPECT_EQ(errors[0], errors[1]);
+}
+
+TEST_F(ModuleTest, ProgramInstances)
+{
+    auto input = R"(
+        number counter = 0;
+
+        function number fib(number n) {
+            return n < 2 ? n : fib(n - 1) + fib(n - 2);
+        }
+
+        public function number next(number n) {
+            counter += fib(n);
+            return counter;
+        }
+    )";
+
+    for (bool lazy : {false, true})
+    {
+        ModuleSettings settings;
+        settings.engine = ExecutionEngine::Vm;
+        settings.lazyCompile = lazy;
+
+        Module module(settings);
+        auto sNext = module.createPublicFunctionCaller<Number, Number>("next");
+        ASSERT_TRUE(module.tryLoadSource(input, &std::cerr));
+
+        RuntimeContext first(module.program());
+        RuntimeContext second(module.program());
+        EXPECT_EQ(sNext(first, 10), 55);
+        EXPECT_EQ(sNext(first, 10), 110);
+        EXPECT_EQ(sNext(second, 1), 1);
+        EXPECT_EQ(sNext(3), 2);
+
+        ProgramPtr program = module.program();
+        ASSERT_TRUE(module.tryLoadSource("public function number next(number n) { return -n; }", &std::cerr));
+        EXPECT_EQ(sNext(4), -4);
+
+        std::vector<Number> results(4);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            threads.emplace_back([&, i]()
+                                 {
+                RuntimeContext instance(program);
+                for (int j = 0; j < 10; ++j)
+                {
+                    results[i] = sNext(instance, Number(i + 5));
+                } });
+        }
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+        EXPECT_EQ(results, (std::vector<Number>{50, 80, 130, 210}));
+    }
+}
+
+TEST_F(ModuleTest, FusedExpressions)
+{
+    auto input = R"(
+        function void bump(number& x) {
+            ++x;
+        }
+
+        function number compute(number n) {
+            number[] a = {5, 6, 7};
+            number s = 0;
+            number t = 0;
+            for (number i = 0; i < n; ++i) {
+                t = i * i;
+                s += t - i;
+                if (i >= 2)
+                    s += a[i];
+                t = 3 - i;
+            }
+            number k = 4;
+            s += a[k] + a[1];
+            s += sizeof(a) * 100;
+            k = s % 7;
+            number r = 0;
+            bump(&r);
+            r = r + s;
+            return s * 10 + k + r * 1000 + (k < 5) * 100000;
+        }
+
+        public function number main() {
+            return compute(5) * 1000000 + compute(0);
+        }
+    )";
+
+    for (bool fuse : {true, false})
+    {
+        for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+        {
+            ModuleSettings settings;
+            settings.engine = engine;
+            settings.fuseExpressions = fuse;
+
+            RunResult result = run(settings, input);
+            // The tree engine inlines bump, which builds its fused ++x again.
+            size_t fused = engine == ExecutionEngine::Tree ? 19 : 18;
+            EXPECT_EQ(result.stats.fusedExpressions, fuse ? fused : 0);
+            EXPECT_EQ(result.value, 639331 * 1000000.0 + 612062);
+        }
+    }
+}
+
+TEST_F(ModuleTest, LocalUpdates)
+{
+    auto input = R"(
+        public function number main() {
+            number x = 1;
+            int c = 10;
+            number[] a = {1, 2, 3, 4};
+            number s = 0;
+            for (number i = 0; i < sizeof(a); ++i) {
+                s += a[i];
+                ++x;
+                x -= 0.5;
+                ++c;
+                c += 3;
+                --c;
+                c -= 2;
+            }
+            number y = x++;
+            number z = --x;
+            int d = c--;
+            int e = ++c;
+            x *= 2;
+            c *= 3;
+            return s + x * 100 + y * 10000 + z * 1000000 + c * 100000000 + (d + e) * 100000000000;
+        }
+    )";
+
+    for (bool fuse : {true, false})
+    {
+        for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+        {
+            ModuleSettings settings;
+            settings.engine = engine;
+            settings.fuseExpressions = fuse;
+            EXPECT_EQ(run(settings, input).value, 2804203030610.0);
+        }
+    }
+}
+
+TEST_F(ModuleTest, IntegerType)
+{
+    auto input = R"(
+        function int fnv(int[] data) {
+            int h = 3421674724;
+            h = (h << 32) | 2216829733;
+            for (number i = 0; i < sizeof(data); ++i) {
+                h ^= data[i];
+                h = h * 1099511628211;
+            }
+            return h;
+        }
+
+        public function int hash(int n) {
+            int[] data;
+            for (int i = 0; i < n; ++i)
+                data[i] = i * 37 % 256;
+            return fnv(data);
+        }
+
+        public function string show(int n) {
+            int q = n \ 7;
+            int r = n % 7;
+            number half = n / 2;
+            int big = 1;
+            big <<= 40;
+            int neg = -big >> 38;
+            number widened = (big >> 20) + 0.5;
+            int truncated = toInt(-2.75);
+            return toString(q) .. " " .. r .. " " .. half .. " " .. (big + -1) .. " " .. neg .. " " ..
+                widened .. " " .. truncated .. " " .. (q < r) .. " " .. (n == 7.0);
+        }
+
+        public function int divide(int a, int b) {
+            return a \ b;
+        }
+
+        public function int twice(int x) {
+            return double(x);
+        }
+    )";
+
+    std::uint64_t h = 14695981039346656037ULL;
+    for (int i = 0; i < 100; ++i)
+    {
+        h ^= std::uint64_t(i * 37 % 256);
+        h *= 1099511628211ULL;
+    }
+
+    for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+    {
+        ModuleSettings settings;
+        settings.engine = engine;
+
+        Module module(settings);
+        module.addExternalFunction("double", std::function<Integer(Integer)>([](Integer x)
+                                                                             { return x * 2; }));
+        auto sHash = module.createPublicFunctionCaller<Integer, Integer>("hash");
+        auto sShow = module.createPublicFunctionCaller<std::string, Integer>("show");
+        auto sDivide = module.createPublicFunctionCaller<Integer, Integer, Integer>("divide");
+        auto sTwice = module.createPublicFunctionCaller<Integer, Integer>("twice");
+        ASSERT_TRUE(module.tryLoadSource(input, &std::cerr));
+
+        EXPECT_EQ(sHash(100), Integer(h));
+        EXPECT_EQ(sShow(-23), "-3 -2 -11.500000 1099511627775 -4 1048576.500000 -2 1 0");
+        EXPECT_EQ(sDivide(-9223372036854775807LL - 1, -1), -9223372036854775807LL - 1);
+        EXPECT_THROW(sDivide(1, 0), RuntimeError);
+        EXPECT_EQ(sTwice(Integer(1) << 60), Integer(1) << 61);
+    }
+}
+
+TEST_F(ModuleTest, IntegerConversions)
+{
+    auto input = R"(
+        function int first(int[] a) {
+            return a[0];
+        }
+
+        public function string main(number x) {
+            int[] a = {3, -4, 5};
+            [int, number] t = {7, 0.5};
+            int i = x < 0 ? 8 : a[1];
+            int h = toInt(x / 3);
+            return toString(first(a) + a[1] + a[2]) .. " " .. t[0] .. " " .. i .. " " .. h .. " " .. toInt(1e300);
+        }
+    )";
+
+    for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+    {
+        ModuleSettings settings;
+        settings.engine = engine;
+
+        Module module(settings);
+        auto sMain = module.createPublicFunctionCaller<std::string, Number>("main");
+        ASSERT_TRUE(module.tryLoadSource(input, &std::cerr));
+
+        EXPECT_EQ(sMain(10), "4 7 -4 3 9223372036854775807");
+        EXPECT_EQ(sMain(-8), "4 7 8 -2 9223372036854775807");
+    }
+
+    for (const char *broken : {
+             "public function number main() { number x = 7; int h = x / 3; return h; }",
+             "function int f(int i) { return i; } public function number main() { return f(1.5); }",
+             "public function number main() { int[] a = {1, 2.5}; return 0; }",
+             "public function number main() { int i; i += 0.5; return i; }",
+         })
+    {
+        Module module;
+        module.createPublicFunctionCaller<Number>("main");
+        std::ostringstream err;
+        EXPECT_FALSE(module.tryLoadSource(broken, &err)) << broken;
+        EXPECT_NE(err.str().find("' to 'int"), std::string::npos) << err.str();
+    }
+}
@@ -5,6 +5,7 @@
 #include "PushBackStream.hpp"
 #include "TestHelpers.hpp"
 #include "Tokenizer.hpp"
+#include "BufferStream.hpp"
 
 using namespace sharpsenLang;
 
@@ -52,6 +53,18 @@ protected:
         return result;
     }
 
+    std::vector<Token> getBufferResult(std::string_view input)
+    {
+        BufferStream stream(input);
+        std::vector<Token> result;
+        TokensIterator it(stream);
+        for (; it; ++it)
+        {
+            result.push_back(*it);
+        }
+        return result;
+    }
+
     PushBackStreamMocker pb;
 };
 
@@ -112,7 +125,6 @@ TEST_F(TokenizerTest, DeclareClass)
         {ReservedToken::CloseCurly},
         {ReservedToken::Semicolon},
     };
-    bool r = expected == result;
     EXPECT_EQ(expected, result);
 }
 
@@ -133,7 +145,6 @@ TEST_F(TokenizerTest, MethodCall)
         {ReservedToken::CloseRound},
         {ReservedToken::Semicolon},
     };
-    bool r = expected == result;
     EXPECT_EQ(expected, result);
 }
 
@@ -411,3 +422,45 @@ TEST_F(TokenizerTest, ComplexFunction)
     };
     EXPECT_EQ(expected, result);
 }
+
+TEST_F(TokenizerTest, BufferMatchesStream)
+{
+    std::string input = R"(
+        // line comment
+        string s = "a\tb" .. "c" .. toString(1..2);
+        /* block
+           comment */
+        number x = 0x1F + 2.5e1 >>= y;
+        if (x <= 3 && !s) { x \= 2; }
+    )";
+
+    auto expected = getResult(input);
+    auto result = getBufferResult(input);
+
+    ASSERT_EQ(expected.size(), result.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        EXPECT_EQ(expected[i], result[i]);
+        EXPECT_EQ(expected[i].getLineNumber(), result[i].getLineNumber());
+        EXPECT_EQ(expected[i].getCharIndex(), result[i].getCharIndex());
+    }
+}
+
+TEST_F(TokenizerTest, BufferTokensAreViews)
+{
+    std::string input = "name = \"plain\" .. \"esc\\n\";";
+
+    auto result = getBufferResult(input);
+
+    ASSERT_EQ(result.size(), 6u);
+    std::string_view name = result[0].getIdentifier().name;
+    std::string_view plain = result[2].getString();
+    std::string_view escaped = result[4].getString();
+
+    EXPECT_EQ(name, "name");
+    EXPECT_EQ(name.data(), input.data());
+    EXPECT_EQ(plain, "plain");
+    EXPECT_EQ(plain.data(), input.data() + 8);
+    EXPECT_EQ(escaped, "esc\n");
+    EXPECT_FALSE(escaped.data() >= input.data() && escaped.data() < input.data() + input.size());
+}
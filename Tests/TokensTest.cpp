@@ -37,13 +37,14 @@ protected:
       std::string keyStr = key;                    \
       auto keyword = getKeyword(keyStr);           \
                                                    \
-      EXPECT_EQ(ReservedToken::##token, *keyword); \
+      EXPECT_EQ(ReservedToken::token, *keyword);   \
    }
 
 TEST_KEYWORD("class", KwClass)
 
 TEST_KEYWORD("sizeof", KwSizeof)
 TEST_KEYWORD("toString", KwToString)
+TEST_KEYWORD("toInt", KwToInt)
 
 TEST_KEYWORD("if", KwIf)
 TEST_KEYWORD("else", KwElse)
@@ -77,6 +78,14 @@ TEST_F(TokensTest, GetKeywordFail)
    EXPECT_FALSE(keyword);
 }
 
+TEST_F(TokensTest, GetKeywordNearMiss)
+{
+   for (std::string key : {"", "i", "d", "iff", "Do", "elsee", "swatch", "functio", "numbers", "tostring"})
+   {
+      EXPECT_FALSE(getKeyword(key)) << key;
+   }
+}
+
 #define TEST_OPERATOR(key, token)                  \
    TEST_F(TokensTest, GetOperator_##token)         \
    {                                               \
@@ -85,7 +94,7 @@ TEST_F(TokensTest, GetKeywordFail)
                                                    \
       auto keyword = getOperator(pb);              \
                                                    \
-      EXPECT_EQ(ReservedToken::##token, *keyword); \
+      EXPECT_EQ(ReservedToken::token, *keyword);   \
    }
 
 TEST_OPERATOR("++", Inc)
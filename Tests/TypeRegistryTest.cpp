@@ -42,6 +42,14 @@ TEST_F(TypeRegistryTest, CheckNumber)
     EXPECT_EQ(tr.getNumberHandle(), number);
 }
 
+TEST_F(TypeRegistryTest, CheckInt)
+{
+    auto integer = tr.getHandle(SimpleType::Int);
+
+    EXPECT_EQ(tr.getIntHandle(), integer);
+    EXPECT_NE(tr.getNumberHandle(), integer);
+}
+
 TEST_F(TypeRegistryTest, CheckNumberArray)
 {
     ArrayType numberArray{tr.getNumberHandle()};
@@ -0,0 +1,137 @@
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include <gtest/gtest.h>
+
+#include "Value.hpp"
+
+using namespace sharpsenLang;
+
+class ValueTest : public ::testing::Test
+{
+protected:
+    ValueTest() {}
+
+    void SetUp() override
+    {
+    }
+
+    void TearDown() override {}
+
+    ~ValueTest() {}
+
+    static void TearDownTestSuite() {}
+};
+
+TEST_F(ValueTest, Number)
+{
+    for (Number n : {0.0, -0.0, 1.5, -42.0, std::numeric_limits<Number>::infinity(), -std::numeric_limits<Number>::infinity()})
+    {
+        Value value(n);
+        EXPECT_TRUE(value.isNumber());
+        EXPECT_EQ(value.number(), n);
+        EXPECT_EQ(value.toNumber(), n);
+    }
+}
+
+TEST_F(ValueTest, NaN)
+{
+    Value value(-std::numeric_limits<Number>::quiet_NaN());
+    EXPECT_TRUE(value.isNumber());
+    EXPECT_TRUE(std::isnan(value.number()));
+}
+
+TEST_F(ValueTest, Empty)
+{
+    Value value;
+    EXPECT_FALSE(value.isNumber());
+    EXPECT_FALSE(value.boxed());
+}
+
+TEST_F(ValueTest, BoxNumber)
+{
+    Value value(3.0);
+    Lnumber box = value.boxed()->staticPointerDowncast<Lnumber>();
+    EXPECT_FALSE(value.isNumber());
+    EXPECT_EQ(box->value, 3);
+
+    value.setNumber(4);
+    EXPECT_EQ(box->value, 4);
+
+    box->value = 5;
+    EXPECT_EQ(value.toNumber(), 5);
+}
+
+TEST_F(ValueTest, CopySharesBox)
+{
+    Value value(createVariable<Number>(1));
+    Value copy(value);
+
+    copy.setNumber(2);
+    EXPECT_EQ(value.toNumber(), 2);
+    EXPECT_EQ(value.boxed(), copy.boxed());
+}
+
+TEST_F(ValueTest, CopyCountsReferences)
+{
+    Value value(createVariable<String>(std::make_shared<std::string>("abc")));
+    Variable *variable = value.variable();
+    EXPECT_EQ(variable->refCount(), 1);
+    {
+        Value copy(value);
+        EXPECT_EQ(copy.variable(), variable);
+        EXPECT_EQ(variable->refCount(), 2);
+    }
+    EXPECT_EQ(variable->refCount(), 1);
+
+    VariablePtr box = value.boxed();
+    EXPECT_EQ(box.get(), variable);
+    EXPECT_EQ(variable->refCount(), 2);
+}
+
+TEST_F(ValueTest, Move)
+{
+    Value value(createVariable<String>(std::make_shared<std::string>("abc")));
+    Value moved(std::move(value));
+
+    EXPECT_EQ(*moved.boxed()->staticPointerDowncast<Lstring>()->value, "abc");
+
+    value = Value(7.0);
+    EXPECT_EQ(value.toNumber(), 7);
+}
+
+TEST_F(ValueTest, Integer)
+{
+    for (Integer i : {Integer(0), Integer(-1), Integer(42), (Integer(1) << 47) - 1, -(Integer(1) << 47)})
+    {
+        Value value(i);
+        EXPECT_TRUE(value.isInteger());
+        EXPECT_FALSE(value.isNumber());
+        EXPECT_EQ(value.toInteger(), i);
+    }
+}
+
+TEST_F(ValueTest, BoxLargeInteger)
+{
+    for (Integer i : {Integer(1) << 47, std::numeric_limits<Integer>::max(), std::numeric_limits<Integer>::min()})
+    {
+        Value value(i);
+        EXPECT_FALSE(value.isInteger());
+        EXPECT_EQ(value.toInteger(), i);
+        EXPECT_EQ(value.variable()->refCount(), 1);
+    }
+}
+
+TEST_F(ValueTest, BoxInteger)
+{
+    Value value(Integer(3));
+    Linteger box = value.boxed()->staticPointerDowncast<Linteger>();
+    EXPECT_FALSE(value.isInteger());
+    EXPECT_EQ(box->value, 3);
+
+    value.setInteger(std::numeric_limits<Integer>::max());
+    EXPECT_EQ(box->value, std::numeric_limits<Integer>::max());
+
+    box->value = 5;
+    EXPECT_EQ(value.toInteger(), 5);
+}
@@ -0,0 +1,187 @@
+#include <iostream>
+#include <gtest/gtest.h>
+
+#include "VariablePool.hpp"
+#include "Module.hpp"
+
+using namespace sharpsenLang;
+
+class VariablePoolTest : public ::testing::Test
+{
+protected:
+    VariablePoolTest() {}
+
+    void SetUp() override
+    {
+    }
+
+    void TearDown() override {}
+
+    ~VariablePoolTest() {}
+
+    static void TearDownTestSuite() {}
+
+    using PoolPtr = std::unique_ptr<VariablePool, VariablePool::Detach>;
+};
+
+TEST_F(VariablePoolTest, ReusesReleasedVariables)
+{
+    PoolPtr pool(new VariablePool());
+    VariablePool::Scope scope(pool.get());
+
+    Lnumber first = createVariable<Number>(1);
+    Variable *address = first.get();
+    first.reset();
+
+    Lnumber second = createVariable<Number>(2);
+    EXPECT_EQ(second.get(), address);
+    EXPECT_EQ(second->value, 2);
+
+    Lstring string = createVariable<String>(std::make_shared<std::string>("abc"));
+    EXPECT_EQ(pool->stats<Number>().hits, 1);
+    EXPECT_EQ(pool->stats<Number>().misses, 1);
+    EXPECT_EQ(pool->stats<String>().misses, 1);
+    EXPECT_EQ(pool->stats().misses, 2);
+}
+
+TEST_F(VariablePoolTest, InactiveWithoutScope)
+{
+    PoolPtr pool(new VariablePool());
+    {
+        VariablePool::Scope scope(pool.get());
+        EXPECT_EQ(VariablePool::current(), pool.get());
+    }
+    EXPECT_EQ(VariablePool::current(), nullptr);
+
+    Lnumber number = createVariable<Number>(1);
+    EXPECT_EQ(pool->stats().misses, 0);
+}
+
+TEST_F(VariablePoolTest, OutlivesOwner)
+{
+    Larray array;
+    {
+        PoolPtr pool(new VariablePool());
+        VariablePool::Scope scope(pool.get());
+        array = createVariable<Array>(Array{Value(createVariable<Number>(1)), Value(2.0)});
+    }
+    VariablePtr copy = array->clone();
+    EXPECT_EQ(copy->staticPointerDowncast<Larray>()->value.size(), 2);
+    array.reset();
+}
+
+TEST_F(VariablePoolTest, RuntimeContextStats)
+{
+    Module module;
+    auto sMain = module.createPublicFunctionCaller<Number>("main");
+    ASSERT_TRUE(module.tryLoadSource(R"(
+        function void bump(number& x) {
+            ++x;
+        }
+
+        public function number main() {
+            number s = 0;
+            for (number i = 0; i < 100; ++i) {
+                number x = i;
+                bump(&x);
+                s += x;
+            }
+            return s;
+        }
+    )", &std::cerr));
+
+    RuntimeContext instance(module.program());
+    EXPECT_EQ(sMain(instance), 5050);
+
+    VariablePoolStats stats = instance.variablePool().stats<Number>();
+    EXPECT_GE(stats.hits, 99);
+    EXPECT_LT(stats.misses, 10);
+}
+
+TEST_F(VariablePoolTest, UnboxedLocals)
+{
+    auto input = R"(
+        function number square(number x) {
+            number y = x * x;
+            return y;
+        }
+
+        function void bump(number& x) {
+            x += 1;
+        }
+
+        public function number main() {
+            number s = 0;
+            for (number i = 0; i < 100; ++i) {
+                number t;
+                t = square(i);
+                t -= i;
+                s += t++;
+            }
+            number r = 1;
+            bump(&r);
+            return s + r;
+        }
+    )";
+
+    for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+    {
+        ModuleSettings settings;
+        settings.engine = engine;
+        Module module(settings);
+        auto sMain = module.createPublicFunctionCaller<Number>("main");
+        ASSERT_TRUE(module.tryLoadSource(input, &std::cerr));
+
+        RuntimeContext instance(module.program());
+        EXPECT_EQ(sMain(instance), 323402);
+
+        // Only r is boxed, once its reference is passed to bump, besides the
+        // result handed back to the caller.
+        VariablePoolStats stats = instance.variablePool().stats<Number>();
+        EXPECT_EQ(stats.hits + stats.misses, 2);
+    }
+}
+
+TEST_F(VariablePoolTest, UnboxedIntegerLocals)
+{
+    auto input = R"(
+        function int square(int x) {
+            int y = x * x;
+            return y;
+        }
+
+        function void bump(int& x) {
+            x += 1;
+        }
+
+        public function int main() {
+            int s = 0;
+            for (int i = 0; i < 100; ++i) {
+                int t;
+                t = square(i);
+                t -= i % 7;
+                s += t++ >> 1;
+            }
+            int r = 1;
+            bump(&r);
+            return s + r;
+        }
+    )";
+
+    for (ExecutionEngine engine : {ExecutionEngine::Tree, ExecutionEngine::Vm})
+    {
+        ModuleSettings settings;
+        settings.engine = engine;
+        Module module(settings);
+        auto sMain = module.createPublicFunctionCaller<Integer>("main");
+        ASSERT_TRUE(module.tryLoadSource(input, &std::cerr));
+
+        RuntimeContext instance(module.program());
+        EXPECT_EQ(sMain(instance), 164005);
+
+        // Only r is boxed, once its reference is passed to bump, besides the
+        // result handed back to the caller.
+        VariablePoolStats stats = instance.variablePool().stats<Integer>();
+        EXPECT_EQ(stats.hits + stats.misses, 2);
+    }
+}
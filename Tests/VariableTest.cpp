@@ -1,8 +1,10 @@
 #include <iostream>
 #include <thread>
+#include <deque>
 #include <gtest/gtest.h>
 
 #include "Variable.hpp"
+#include "VariablePool.hpp"
 
 using namespace sharpsenLang;
 
@@ -22,13 +24,15 @@ protected:
     template <class T, class... Args>
     T makeVariable(Args... args)
     {
-        return std::make_shared<VariableImpl<T::element_type::ValueType>>(args...);
+        using ValueType = typename T::element_type::ValueType;
+        return createVariable<ValueType>(ValueType(args...));
     }
 
     template <class T, class... Args>
     T makeVariable(std::initializer_list<Args...> args)
     {
-        return std::make_shared<VariableImpl<T::element_type::ValueType>>(args);
+        using ValueType = typename T::element_type::ValueType;
+        return createVariable<ValueType>(ValueType(args.begin(), args.end()));
     }
 
     static void TearDownTestSuite() {}
@@ -59,7 +63,7 @@ TEST_F(VariableTest, Array)
     for (size_t i = 0; i < expected.size(); i++)
     {
         auto expectedValue = expected.at(i)->staticPointerDowncast<Lnumber>()->value;
-        auto value = array->value.at(i)->staticPointerDowncast<Lnumber>()->value;
+        auto value = array->value.reference(i)->staticPointerDowncast<Lnumber>()->value;
         EXPECT_EQ(expectedValue, value);
     }
 }
@@ -73,7 +77,7 @@ TEST_F(VariableTest, Touple)
     for (size_t i = 0; i < expected.size(); i++)
     {
         auto expectedValue = expected.at(i)->staticPointerDowncast<Lnumber>()->value;
-        auto value = array->value.at(i)->staticPointerDowncast<Lnumber>()->value;
+        auto value = array->value.reference(i)->staticPointerDowncast<Lnumber>()->value;
         EXPECT_EQ(expectedValue, value);
     }
 }
@@ -116,11 +120,40 @@ TEST_F(VariableTest, ArrayCopy)
     for (size_t i = 0; i < expected.size(); i++)
     {
         auto expectedValue = expected.at(i)->staticPointerDowncast<Lnumber>()->value;
-        auto value = array->value.at(i)->staticPointerDowncast<Lnumber>()->value;
+        auto value = cloned->staticPointerDowncast<Larray>()->value.reference(i)->staticPointerDowncast<Lnumber>()->value;
         EXPECT_EQ(expectedValue, value);
     }
 }
 
+TEST_F(VariableTest, ArrayCopyOnWrite)
+{
+    Array array{Value(1.0), Value(2.0), Value(3.0)};
+    Array copy = array;
+    EXPECT_TRUE(copy.sharesStorage(array));
+
+    copy.elements()[0].setNumber(10);
+    EXPECT_FALSE(copy.sharesStorage(array));
+    EXPECT_EQ(array[0].toNumber(), 1);
+    EXPECT_EQ(copy[0].toNumber(), 10);
+
+    Lnumber element = array.reference(1)->staticPointerDowncast<Lnumber>();
+    Array aliased = array;
+    EXPECT_FALSE(aliased.sharesStorage(array));
+    element->value = 20;
+    EXPECT_EQ(array[1].toNumber(), 20);
+    EXPECT_EQ(aliased[1].toNumber(), 2);
+
+    element.reset();
+    Array shared = array;
+    EXPECT_TRUE(shared.sharesStorage(array));
+
+    Array integers{Value(Integer(1)), Value(Integer(2))};
+    Linteger integer = integers.reference(0)->staticPointerDowncast<Linteger>();
+    integer.reset();
+    Array sharedIntegers = integers;
+    EXPECT_TRUE(sharedIntegers.sharesStorage(integers));
+}
+
 TEST_F(VariableTest, ToupleCopy)
 {
     std::initializer_list<VariablePtr> initializerList = {makeVariable<Lnumber>(1), makeVariable<Lnumber>(2), makeVariable<Lnumber>(3)};
@@ -134,7 +167,7 @@ TEST_F(VariableTest, ToupleCopy)
     for (size_t i = 0; i < expected.size(); i++)
     {
         auto expectedValue = expected.at(i)->staticPointerDowncast<Lnumber>()->value;
-        auto value = touple->value.at(i)->staticPointerDowncast<Lnumber>()->value;
+        auto value = touple->value.reference(i)->staticPointerDowncast<Lnumber>()->value;
         EXPECT_EQ(expectedValue, value);
     }
 }